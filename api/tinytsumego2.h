@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * @file tinytsumego2.h
+ * @brief Generated top-level public metadata for the shared library build.
+ */
+
+/** @brief CMake project name for the current build. */
+#define PROJECT_NAME "tinytsumego2"
+/** @brief Major version component for the current build. */
+#define VERSION_MAJOR "2"
+/** @brief Minor version component for the current build. */
+#define VERSION_MINOR "3"
+/** @brief Patch version component for the current build. */
+#define VERSION_PATCH "0"
+
+/**
+ * @brief Write a human-readable version string into the provided buffer.
+ *
+ * @param out Output buffer large enough to hold the formatted version string.
+ */
+void version(char *out);
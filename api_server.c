@@ -0,0 +1,848 @@
+#define _GNU_SOURCE // Expose declarations of memmem() and accept4()
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/collection.h"
+#include "tinytsumego2/json_api.h"
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/util.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Same limits as the Python bridge
+#define DEFAULT_PORT (8361)
+#define MAX_BODY_SIZE (64 * 1024)
+
+// Longest accepted request line and headers
+#define MAX_HEADER_SIZE (8 * 1024)
+
+// Stop answering pipelined requests until this much output has been sent
+#define OUTPUT_HIGH_WATER (256 * 1024)
+
+#define MAX_EVENTS (256)
+
+static const char ROOT_PAGE[] = "\n                    <html><head><title>TinyTsumego JSON API</title></head><body>\n"
+                                "                    <p>This is a the root of the TinyTsumego JSON API</p>\n"
+                                "                    </body></html>\n\n                ";
+
+typedef struct served_collection {
+  collection meta;
+  dual_graph_reader *reader;
+} served_collection;
+
+typedef struct connection {
+  int fd;
+  char *in;
+  size_t in_length;
+  char *out;
+  size_t out_length;
+  size_t out_capacity;
+  size_t out_sent;
+  // No further requests are read once set and the connection is closed when the output has been sent
+  bool closing;
+  struct connection *next_job;
+  struct connection *prev_live;
+  struct connection *next_live;
+} connection;
+
+typedef struct request {
+  const char *method;
+  size_t method_length;
+  const char *target;
+  size_t target_length;
+  bool keep_alive;
+  // -1 when absent and -2 when not a number
+  long long content_length;
+  bool chunked;
+  const char *body;
+} request;
+
+// Global config is bad, but this is a single-purpose executable
+static const char *allow_origin = NULL;
+static served_collection *served = NULL;
+static size_t num_served = 0;
+static response_cache cache;
+static int epoll_fd = -1;
+static volatile sig_atomic_t stopping = 0;
+
+// Connections waiting for a worker
+static connection *jobs_head = NULL;
+static connection *jobs_tail = NULL;
+static bool jobs_closed = false;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+// Every open connection so that shutdown can release them
+static connection *live = NULL;
+static pthread_mutex_t live_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void on_signal(int signum) {
+  (void)signum;
+  stopping = 1;
+}
+
+static const char *reason_phrase(int code) {
+  switch (code) {
+  case 200:
+    return "OK";
+  case 204:
+    return "No Content";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 411:
+    return "Length Required";
+  case 413:
+    return "Request Entity Too Large";
+  case 418:
+    return "I'm a Teapot";
+  case 431:
+    return "Request Header Fields Too Large";
+  case 501:
+    return "Not Implemented";
+  default:
+    return "Unknown";
+  }
+}
+
+static void append_output(connection *conn, const char *data, size_t length) {
+  if (conn->out_length + length > conn->out_capacity) {
+    while (conn->out_length + length > conn->out_capacity) {
+      conn->out_capacity = conn->out_capacity ? 2 * conn->out_capacity : 4096;
+    }
+    conn->out = xrealloc(conn->out, conn->out_capacity);
+  }
+  memcpy(conn->out + conn->out_length, data, length);
+  conn->out_length += length;
+}
+
+static void respond(connection *conn, const request *req, int code, const char *content_type, const char *body, size_t length) {
+  char header[1024];
+  int n = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n", code, reason_phrase(code));
+  if (allow_origin) {
+    n += snprintf(header + n, sizeof(header) - n, "Access-Control-Allow-Origin: %s\r\n", allow_origin);
+  }
+  if (code == 204) {
+    n += snprintf(header + n, sizeof(header) - n, "Allow: OPTIONS, GET, POST\r\nAccess-Control-Allow-Headers: Content-type\r\n");
+  } else {
+    n += snprintf(header + n, sizeof(header) - n,
+                  "X-Content-Type-Options: nosniff\r\nX-Frame-Options: DENY\r\nContent-type: %s\r\nContent-Length: %zu\r\n",
+                  content_type, length);
+  }
+  const bool keep_alive = req && req->keep_alive && !conn->closing;
+  n += snprintf(header + n, sizeof(header) - n, "Connection: %s\r\n\r\n", keep_alive ? "keep-alive" : "close");
+  append_output(conn, header, n);
+  append_output(conn, body, length);
+  if (!keep_alive) {
+    conn->closing = true;
+  }
+}
+
+// Respond with a JSON document followed by a newline like the Python bridge. Writers are plain functions of a closure so that
+// no trampolines end up on the stack.
+static void respond_json(connection *conn, const request *req, int code, void (*write)(FILE *stream, const void *closure),
+                         const void *closure) {
+  char *body = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&body, &length);
+  write(stream, closure);
+  fputc('\n', stream);
+  fclose(stream);
+  respond(conn, req, code, "application/json", body, length);
+  free(body);
+}
+
+static void write_error(FILE *stream, const void *message) { write_error_json(stream, message); }
+
+static void respond_error(connection *conn, const request *req, int code, const char *message) {
+  respond_json(conn, req, code, write_error, message);
+}
+
+typedef struct collections_closure {
+  const collection *collections;
+  size_t num_collections;
+  bool deep;
+} collections_closure;
+
+static void write_collections(FILE *stream, const void *closure) {
+  const collections_closure *cc = closure;
+  write_collections_json(stream, cc->collections, cc->num_collections, cc->deep);
+}
+
+static void write_collection(FILE *stream, const void *c) { write_collection_json(stream, c); }
+
+typedef struct tsumego_closure {
+  const collection *c;
+  const tsumego *t;
+} tsumego_closure;
+
+static void write_tsumego(FILE *stream, const void *closure) {
+  const tsumego_closure *tc = closure;
+  write_tsumego_json(stream, tc->c, tc->t);
+}
+
+typedef struct state_closure {
+  dual_graph_reader *reader;
+  reader_context *ctx;
+  const state *s;
+} state_closure;
+
+static void write_state_response(FILE *stream, const void *closure) {
+  const state_closure *sc = closure;
+  write_state_response_json(stream, &cache, sc->reader, sc->ctx, sc->s);
+}
+
+static served_collection *find_collection(const char *slug, size_t length) {
+  for (size_t i = 0; i < num_served; ++i) {
+    if (strlen(served[i].meta.slug) == length && !memcmp(served[i].meta.slug, slug, length)) {
+      return served + i;
+    }
+  }
+  return NULL;
+}
+
+// Path components of a request target with surrounding slashes stripped
+typedef struct path_parts {
+  size_t num_parts;
+  const char *parts[4];
+  size_t lengths[4];
+  const char *query;
+  size_t query_length;
+} path_parts;
+
+static path_parts split_target(const request *req) {
+  path_parts result = {0};
+  const char *p = req->target;
+  const char *end = req->target + req->target_length;
+  const char *question = memchr(p, '?', end - p);
+  if (question) {
+    result.query = question + 1;
+    result.query_length = end - question - 1;
+    end = question;
+  }
+  // Drop scheme and authority of absolute targets
+  if (end - p > 7 && (!strncmp(p, "http://", 7) || !strncmp(p, "https://", 8))) {
+    p = strstr(p, "//") + 2;
+    while (p < end && *p != '/') {
+      p++;
+    }
+  }
+  while (p < end && *p == '/') {
+    p++;
+  }
+  while (end > p && end[-1] == '/') {
+    end--;
+  }
+  if (p == end) {
+    return result;
+  }
+  for (;;) {
+    const char *slash = memchr(p, '/', end - p);
+    const char *stop = slash ? slash : end;
+    if (result.num_parts < 4) {
+      result.parts[result.num_parts] = p;
+      result.lengths[result.num_parts] = stop - p;
+    }
+    result.num_parts++;
+    if (!slash) {
+      return result;
+    }
+    p = slash + 1;
+  }
+}
+
+static bool part_is(const path_parts *pp, size_t i, const char *str) {
+  return i < pp->num_parts && pp->lengths[i] == strlen(str) && !memcmp(pp->parts[i], str, pp->lengths[i]);
+}
+
+static void respond_state(connection *conn, const request *req, const served_collection *sc, reader_context *ctx, const state *s) {
+  const state_closure closure = {sc->reader, ctx, s};
+  respond_json(conn, req, 200, write_state_response, &closure);
+}
+
+static void handle_get(connection *conn, const request *req, reader_context *contexts) {
+  const path_parts pp = split_target(req);
+  if (!pp.num_parts) {
+    respond(conn, req, 200, "text/html", ROOT_PAGE, sizeof(ROOT_PAGE) - 1);
+    return;
+  }
+  if (part_is(&pp, 0, "tsumego")) {
+    if (pp.num_parts == 1) {
+      const bool deep = pp.query_length == 6 && !memcmp(pp.query, "deep=1", 6);
+      collection *cs = xmalloc(num_served * sizeof(collection));
+      for (size_t i = 0; i < num_served; ++i) {
+        cs[i] = served[i].meta;
+      }
+      const collections_closure closure = {cs, num_served, deep};
+      respond_json(conn, req, 200, write_collections, &closure);
+      free(cs);
+      return;
+    }
+    const served_collection *sc = find_collection(pp.parts[1], pp.lengths[1]);
+    if (!sc) {
+      char message[256];
+      snprintf(message, sizeof(message), "Collection %.*s not found", (int)pp.lengths[1], pp.parts[1]);
+      respond_error(conn, req, 404, message);
+      return;
+    }
+    if (pp.num_parts == 2) {
+      respond_json(conn, req, 200, write_collection, &(sc->meta));
+      return;
+    }
+    if (pp.num_parts == 3) {
+      for (size_t j = 0; j < sc->meta.num_tsumegos; ++j) {
+        const tsumego *t = sc->meta.tsumegos + j;
+        if (strlen(t->slug) == pp.lengths[2] && !memcmp(t->slug, pp.parts[2], pp.lengths[2])) {
+          const tsumego_closure closure = {&(sc->meta), t};
+          respond_json(conn, req, 200, write_tsumego, &closure);
+          return;
+        }
+      }
+      char message[256];
+      snprintf(message, sizeof(message), "Tsumego %.*s not found", (int)pp.lengths[2], pp.parts[2]);
+      respond_error(conn, req, 404, message);
+      return;
+    }
+    // Fallback for precomputed responses that were not exported
+    if (pp.num_parts == 4 && part_is(&pp, 2, "moves")) {
+      state s;
+      // Lookups of states from other roots read arbitrary keys
+      if (!parse_state_address(pp.parts[3], pp.lengths[3], sc->meta.root.wide, &s) || !is_reader_state(sc->reader, &s)) {
+        respond_error(conn, req, 400, "Invalid state address");
+        return;
+      }
+      respond_state(conn, req, sc, contexts + (sc - served), &s);
+      return;
+    }
+  }
+  respond_error(conn, req, 404, "Resource not found");
+}
+
+static void handle_post(connection *conn, const request *req, reader_context *contexts) {
+  const path_parts pp = split_target(req);
+  if (pp.num_parts != 2 || !part_is(&pp, 0, "tsumego")) {
+    respond_error(conn, req, 405, "POST not allowed");
+    return;
+  }
+  served_collection *sc = find_collection(pp.parts[1], pp.lengths[1]);
+  if (!sc) {
+    char message[256];
+    snprintf(message, sizeof(message), "Collection %.*s not found", (int)pp.lengths[1], pp.parts[1]);
+    respond_error(conn, req, 404, message);
+    return;
+  }
+  state s;
+  const move_request_status status = parse_move_request(req->body, req->content_length, sc->meta.root.wide, &s);
+  if (status == MALFORMED_JSON) {
+    respond_error(conn, req, 400, "Malformed JSON body");
+    return;
+  }
+  if (status == MISSING_STATE) {
+    respond_error(conn, req, 400, "Missing \"state\" field");
+    return;
+  }
+  // Same check as the fallback of GET requests
+  if (status == INVALID_STATE || !is_reader_state(sc->reader, &s)) {
+    respond_error(conn, req, 400, "Invalid \"state\" field");
+    return;
+  }
+
+  respond_state(conn, req, sc, contexts + (sc - served), &s);
+}
+
+static bool header_is(const char *line, size_t length, const char *name, const char **value, size_t *value_length) {
+  const size_t n = strlen(name);
+  if (length <= n || strncasecmp(line, name, n) || line[n] != ':') {
+    return false;
+  }
+  *value = line + n + 1;
+  *value_length = length - n - 1;
+  while (*value_length && (**value == ' ' || **value == '\t')) {
+    (*value)++;
+    (*value_length)--;
+  }
+  while (*value_length && ((*value)[*value_length - 1] == ' ' || (*value)[*value_length - 1] == '\t')) {
+    (*value_length)--;
+  }
+  return true;
+}
+
+static bool contains_token(const char *value, size_t length, const char *token) {
+  const size_t n = strlen(token);
+  for (size_t i = 0; i + n <= length; ++i) {
+    if (!strncasecmp(value + i, token, n)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Parse the request at the start of the input. Returns the size of the request line and headers, zero if they are
+// incomplete or -1 if they are malformed or too large.
+static long parse_request(const connection *conn, request *req) {
+  const char *in = conn->in;
+  const char *end = memmem(in, conn->in_length, "\r\n\r\n", 4);
+  if (!end) {
+    return conn->in_length >= MAX_HEADER_SIZE ? -1 : 0;
+  }
+  const size_t header_size = end - in + 4;
+  if (header_size > MAX_HEADER_SIZE) {
+    return -1;
+  }
+
+  *req = (request){0};
+  req->content_length = -1;
+  const char *line_end = memmem(in, header_size, "\r\n", 2);
+  const char *space = memchr(in, ' ', line_end - in);
+  if (!space) {
+    return -1;
+  }
+  req->method = in;
+  req->method_length = space - in;
+  req->target = space + 1;
+  const char *version = memchr(req->target, ' ', line_end - req->target);
+  if (!version) {
+    return -1;
+  }
+  req->target_length = version - req->target;
+  version++;
+  if (line_end - version != 8 || strncmp(version, "HTTP/1.", 7)) {
+    return -1;
+  }
+  req->keep_alive = version[7] != '0';
+
+  for (const char *line = line_end + 2; line < end; line = line_end + 2) {
+    line_end = memmem(line, end + 2 - line, "\r\n", 2);
+    const char *value;
+    size_t value_length;
+    if (header_is(line, line_end - line, "Content-Length", &value, &value_length)) {
+      if (req->content_length != -1) {
+        continue;
+      }
+      req->content_length = value_length ? 0 : -2;
+      for (size_t i = 0; i < value_length; ++i) {
+        if (value[i] < '0' || value[i] > '9') {
+          req->content_length = -2;
+          break;
+        }
+        // Saturate so that huge lengths are reported as too large
+        if (req->content_length <= MAX_BODY_SIZE) {
+          req->content_length = 10 * req->content_length + (value[i] - '0');
+        }
+      }
+    } else if (header_is(line, line_end - line, "Transfer-Encoding", &value, &value_length)) {
+      req->chunked = true;
+    } else if (header_is(line, line_end - line, "Connection", &value, &value_length)) {
+      if (contains_token(value, value_length, "close")) {
+        req->keep_alive = false;
+      } else if (contains_token(value, value_length, "keep-alive")) {
+        req->keep_alive = true;
+      }
+    }
+  }
+  req->body = in + header_size;
+  return header_size;
+}
+
+static bool method_is(const request *req, const char *method) {
+  return req->method_length == strlen(method) && !memcmp(req->method, method, req->method_length);
+}
+
+// Answer complete requests at the start of the input. Returns false once no more requests can be answered for now.
+static bool handle_request(connection *conn, reader_context *contexts) {
+  request req;
+  const long header_size = parse_request(conn, &req);
+  if (!header_size) {
+    return false;
+  }
+  if (header_size < 0) {
+    conn->closing = true;
+    respond_error(conn, NULL, conn->in_length >= MAX_HEADER_SIZE ? 431 : 400, "Bad request");
+    return false;
+  }
+
+  // The body of a rejected request is not read so the connection can not be reused
+  const bool has_length = req.content_length >= 0;
+  const bool valid_length = has_length && req.content_length <= MAX_BODY_SIZE;
+  if (method_is(&req, "POST")) {
+    if (req.chunked || req.content_length == -1) {
+      conn->closing = true;
+      respond_error(conn, &req, 411, "Length required");
+      return false;
+    }
+    if (req.content_length == -2) {
+      conn->closing = true;
+      respond_error(conn, &req, 400, "Invalid Content-Length");
+      return false;
+    }
+    if (req.content_length <= 0 || req.content_length > MAX_BODY_SIZE) {
+      conn->closing = true;
+      respond_error(conn, &req, 413, "Request body too large");
+      return false;
+    }
+  } else if (req.chunked || req.content_length == -2 || (has_length && !valid_length)) {
+    conn->closing = true;
+  }
+
+  const size_t body_length = valid_length ? req.content_length : 0;
+  if (conn->in_length < header_size + body_length) {
+    if (!conn->closing) {
+      return false;
+    }
+  }
+
+  if (method_is(&req, "GET")) {
+    handle_get(conn, &req, contexts);
+  } else if (method_is(&req, "POST")) {
+    handle_post(conn, &req, contexts);
+  } else if (method_is(&req, "OPTIONS")) {
+    respond(conn, &req, 204, NULL, "", 0);
+  } else if (method_is(&req, "PUT")) {
+    const path_parts pp = split_target(&req);
+    if (pp.num_parts == 1 && part_is(&pp, 0, "coffee")) {
+      respond_error(conn, &req, 418, "Do not PUT coffee grounds into a teapot, which I am, by the way...");
+    } else {
+      respond_error(conn, &req, 405, "PUT not allowed");
+    }
+  } else if (method_is(&req, "DELETE")) {
+    respond_error(conn, &req, 405, "DELETE not allowed");
+  } else {
+    respond_error(conn, &req, 501, "Unsupported method");
+  }
+
+  if (conn->closing) {
+    return false;
+  }
+  const size_t consumed = header_size + body_length;
+  memmove(conn->in, conn->in + consumed, conn->in_length - consumed);
+  conn->in_length -= consumed;
+  return true;
+}
+
+static void arm(connection *conn, uint32_t events) {
+  struct epoll_event event = {.events = events | EPOLLONESHOT | EPOLLRDHUP, .data.ptr = conn};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) < 0) {
+    perror("epoll_ctl");
+  }
+}
+
+static void close_connection(connection *conn) {
+  pthread_mutex_lock(&live_mutex);
+  if (conn->prev_live) {
+    conn->prev_live->next_live = conn->next_live;
+  } else {
+    live = conn->next_live;
+  }
+  if (conn->next_live) {
+    conn->next_live->prev_live = conn->prev_live;
+  }
+  pthread_mutex_unlock(&live_mutex);
+  close(conn->fd);
+  free(conn->in);
+  free(conn->out);
+  free(conn);
+}
+
+// Send pending output. Returns false if the socket is full or broken.
+static bool flush_output(connection *conn, bool *broken) {
+  while (conn->out_sent < conn->out_length) {
+    const ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_length - conn->out_sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      *broken = errno != EAGAIN && errno != EWOULDBLOCK;
+      return false;
+    }
+    conn->out_sent += n;
+  }
+  conn->out_length = 0;
+  conn->out_sent = 0;
+  return true;
+}
+
+// Exclusive to one worker until the connection is armed again
+static void serve_connection(connection *conn, reader_context *contexts) {
+  bool broken = false;
+  bool peer_closed = false;
+  for (;;) {
+    if (!flush_output(conn, &broken)) {
+      if (broken) {
+        close_connection(conn);
+      } else {
+        arm(conn, EPOLLOUT);
+      }
+      return;
+    }
+    if (conn->closing) {
+      close_connection(conn);
+      return;
+    }
+
+    // Read what fits and answer every complete request
+    while (!peer_closed && conn->in_length < MAX_HEADER_SIZE + MAX_BODY_SIZE) {
+      const ssize_t n = recv(conn->fd, conn->in + conn->in_length, MAX_HEADER_SIZE + MAX_BODY_SIZE - conn->in_length, 0);
+      if (n > 0) {
+        conn->in_length += n;
+      } else if (n == 0) {
+        peer_closed = true;
+      } else if (errno != EINTR) {
+        peer_closed = errno != EAGAIN && errno != EWOULDBLOCK;
+        break;
+      }
+    }
+    bool progress = false;
+    while (conn->out_length < OUTPUT_HIGH_WATER && handle_request(conn, contexts)) {
+      progress = true;
+    }
+    if (conn->out_length) {
+      continue;
+    }
+    if (peer_closed) {
+      close_connection(conn);
+      return;
+    }
+    if (!progress) {
+      arm(conn, EPOLLIN);
+      return;
+    }
+  }
+}
+
+static void push_job(connection *conn) {
+  pthread_mutex_lock(&jobs_mutex);
+  conn->next_job = NULL;
+  if (jobs_tail) {
+    jobs_tail->next_job = conn;
+  } else {
+    jobs_head = conn;
+  }
+  jobs_tail = conn;
+  pthread_cond_signal(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+}
+
+static void *work(void *arg) {
+  const size_t index = (size_t)arg;
+  // Per-thread contexts keep the readers free of shared mutable state
+  reader_context *contexts = xmalloc(num_served * sizeof(reader_context));
+  for (size_t i = 0; i < num_served; ++i) {
+    contexts[i] = create_reader_context(served[i].reader, index + 1);
+  }
+  for (;;) {
+    pthread_mutex_lock(&jobs_mutex);
+    while (!jobs_head && !jobs_closed) {
+      pthread_cond_wait(&jobs_cond, &jobs_mutex);
+    }
+    connection *conn = jobs_head;
+    if (conn) {
+      jobs_head = conn->next_job;
+      if (!jobs_head) {
+        jobs_tail = NULL;
+      }
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+    if (!conn) {
+      break;
+    }
+    serve_connection(conn, contexts);
+  }
+  for (size_t i = 0; i < num_served; ++i) {
+    free_reader_context(contexts + i);
+  }
+  free(contexts);
+  return NULL;
+}
+
+static void accept_connections(int listen_fd) {
+  for (;;) {
+    const int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("accept");
+      }
+      return;
+    }
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    connection *conn = xcalloc(1, sizeof(connection));
+    conn->fd = fd;
+    conn->in = xmalloc(MAX_HEADER_SIZE + MAX_BODY_SIZE);
+    pthread_mutex_lock(&live_mutex);
+    conn->next_live = live;
+    if (live) {
+      live->prev_live = conn;
+    }
+    live = conn;
+    pthread_mutex_unlock(&live_mutex);
+
+    struct epoll_event event = {.events = EPOLLIN | EPOLLONESHOT | EPOLLRDHUP, .data.ptr = conn};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+      perror("epoll_ctl");
+      close_connection(conn);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // Strip flags so that positional arguments keep their place
+  int port = DEFAULT_PORT;
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t cache_capacity = RESPONSE_CACHE_CAPACITY;
+  int num_args = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--dev") == 0) {
+      allow_origin = "*";
+    } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      num_threads = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--cache-capacity") == 0 && i + 1 < argc) {
+      cache_capacity = strtoull(argv[++i], NULL, 10);
+    } else {
+      argv[num_args++] = argv[i];
+    }
+  }
+  argc = num_args;
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <collection folder or .bundle> [--port N] [--threads N] [--cache-capacity N] [--dev]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  const char *path = argv[1];
+
+  // Every reader is loaded up front so that workers never mutate shared state
+  size_t num_collections;
+  collection *collections = get_collections(&num_collections);
+  served = xmalloc(num_collections * sizeof(served_collection));
+  solution_bundle bundle = {0};
+  const bool is_bundle = strlen(path) > 7 && !strcmp(path + strlen(path) - 7, ".bundle");
+  if (is_bundle) {
+    printf("Reading bundle %s\n", path);
+    bundle = load_solution_bundle(path);
+  }
+  for (size_t i = 0; i < num_collections; ++i) {
+    dual_graph_reader *reader = NULL;
+    if (is_bundle) {
+      reader = get_bundle_reader(&bundle, collections[i].slug);
+    } else {
+      char *filename = xmalloc(strlen(path) + strlen(collections[i].slug) + strlen("/.bin") + 1);
+      sprintf(filename, "%s/%s.bin", path, collections[i].slug);
+      if (access(filename, R_OK) == 0) {
+        printf("Reading %s\n", filename);
+        reader = allocate_dual_graph_reader(filename);
+      }
+      free(filename);
+    }
+    if (reader) {
+      printf("Adding metadata for %s\n", collections[i].slug);
+      served[num_served++] = (served_collection){collections[i], reader};
+    } else {
+      printf("Missing binary for %s\n", collections[i].slug);
+    }
+  }
+  cache = create_response_cache(cache_capacity);
+
+  const int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perror("socket");
+    return EXIT_FAILURE;
+  }
+  const int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in address = {0};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+    perror("bind");
+    return EXIT_FAILURE;
+  }
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+  struct sigaction action = {0};
+  action.sa_handler = on_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  pthread_t *workers = xmalloc(num_threads * sizeof(pthread_t));
+  for (long i = 0; i < num_threads; ++i) {
+    pthread_create(workers + i, NULL, work, (void *)i);
+  }
+  printf("Serving %zu collections at http://localhost:%d/ with %ld threads\n", num_served, port, num_threads);
+  fflush(stdout);
+
+  // The event loop only accepts and dispatches. Workers do all reading, answering and writing.
+  struct epoll_event events[MAX_EVENTS];
+  while (!stopping) {
+    const int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno != EINTR) {
+        perror("epoll_wait");
+        break;
+      }
+      continue;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.ptr) {
+        push_job(events[i].data.ptr);
+      } else {
+        accept_connections(listen_fd);
+      }
+    }
+  }
+
+  printf("\nClosing server...\n");
+  pthread_mutex_lock(&jobs_mutex);
+  jobs_closed = true;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&jobs_mutex);
+  for (long i = 0; i < num_threads; ++i) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  close(listen_fd);
+  while (live) {
+    close_connection(live);
+  }
+  close(epoll_fd);
+
+  printf("Cleaning up...\n");
+  print_response_cache_stats(&cache);
+  free_response_cache(&cache);
+  if (is_bundle) {
+    unload_solution_bundle(&bundle);
+  } else {
+    for (size_t i = 0; i < num_served; ++i) {
+      unload_dual_graph_reader(served[i].reader);
+      free(served[i].reader);
+    }
+  }
+  free(served);
+  for (size_t i = 0; i < num_collections; ++i) {
+    free(collections[i].tsumegos);
+  }
+  free(collections);
+
+  return EXIT_SUCCESS;
+}
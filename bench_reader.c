@@ -0,0 +1,371 @@
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/collection.h"
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/util.h"
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_REQUESTS (100000)
+#define DEFAULT_WALK_LENGTH (12)
+
+// Requests claimed by a thread at a time
+#define CLAIM_SIZE (64)
+
+typedef enum query_kind {
+  MOVE_INFOS_QUERY,
+  DEAD_STONES_QUERY,
+  NUM_QUERY_KINDS,
+} query_kind;
+
+static const char *QUERY_NAMES[NUM_QUERY_KINDS] = {"move infos", "dead stones"};
+
+// Request as stored by --record. Recorded streams are raw arrays of these.
+typedef struct replay_request {
+  char slug[BUNDLE_SLUG_SIZE];
+  int32_t kind;
+  state s;
+} replay_request;
+
+typedef struct benchmark_reader {
+  const char *filename;
+  char slug[BUNDLE_SLUG_SIZE];
+  dual_graph_reader dgr;
+  const collection *meta;
+} benchmark_reader;
+
+typedef struct benchmark {
+  benchmark_reader *readers;
+  size_t num_readers;
+  const replay_request *requests;
+  // Index of the reader of each request
+  const size_t *reader_indices;
+  size_t num_requests;
+  // NULL to query the readers directly
+  response_cache *cache;
+  size_t next_request;
+  // Nanoseconds spent on each request
+  uint64_t *latencies;
+} benchmark;
+
+static uint64_t nanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int compare_latencies(const void *a_, const void *b_) {
+  const uint64_t a = *(const uint64_t *)a_;
+  const uint64_t b = *(const uint64_t *)b_;
+  return (a > b) - (a < b);
+}
+
+// Nearest-rank percentile of sorted latencies in microseconds
+static double percentile(const uint64_t *sorted, size_t count, double p) {
+  size_t rank = (size_t)(p * count + 0.999999);
+  if (rank < 1) {
+    rank = 1;
+  }
+  return 1e-3 * sorted[rank - 1];
+}
+
+static void *work(void *arg) {
+  benchmark *b = arg;
+  reader_context *contexts = xmalloc(b->num_readers * sizeof(reader_context));
+  for (size_t i = 0; i < b->num_readers; ++i) {
+    contexts[i] = create_reader_context(&(b->readers[i].dgr), nanoseconds());
+  }
+  for (;;) {
+    const size_t start = __atomic_fetch_add(&(b->next_request), CLAIM_SIZE, __ATOMIC_RELAXED);
+    if (start >= b->num_requests) {
+      break;
+    }
+    const size_t end = start + CLAIM_SIZE < b->num_requests ? start + CLAIM_SIZE : b->num_requests;
+    for (size_t i = start; i < end; ++i) {
+      const replay_request *r = b->requests + i;
+      const size_t index = b->reader_indices[i];
+      dual_graph_reader *dgr = &(b->readers[index].dgr);
+      reader_context *ctx = contexts + index;
+      const uint64_t before = nanoseconds();
+      if (r->kind == MOVE_INFOS_QUERY) {
+        int num_move_infos;
+        free(b->cache ? cached_move_infos(b->cache, dgr, ctx, &(r->s), &num_move_infos)
+                      : dual_graph_reader_move_infos_r(dgr, ctx, &(r->s), &num_move_infos));
+      } else {
+        // Servers answer states after two passes with the terminal of the same position before them
+        state terminal = r->s;
+        terminal.passes = 0;
+        terminal.ko = 0;
+        terminal.ko_threats = 0;
+        volatile stones_t dead = b->cache ? cached_dead_stones(b->cache, dgr, ctx, &terminal)
+                                          : dual_graph_reader_dead_stones_r(dgr, ctx, &terminal);
+        (void)dead;
+      }
+      b->latencies[i] = nanoseconds() - before;
+    }
+  }
+  for (size_t i = 0; i < b->num_readers; ++i) {
+    free_reader_context(contexts + i);
+  }
+  free(contexts);
+  return NULL;
+}
+
+// Random walks from the tsumegos with a move info query at every position and a dead stone query at the end
+static replay_request *generate_requests(benchmark_reader *readers, size_t num_readers, size_t num_requests, int walk_length,
+                                         rng_state *rng) {
+  replay_request *result = xmalloc(num_requests * sizeof(replay_request));
+  size_t n = 0;
+  while (n < num_requests) {
+    const benchmark_reader *br = readers + rng_next(rng) % num_readers;
+    state s = br->meta->tsumegos[rng_next(rng) % br->meta->num_tsumegos].state;
+    s.wide = br->meta->root.wide;
+    const int length = 1 + rng_next(rng) % walk_length;
+    for (int ply = 0; ply < length && n < num_requests; ++ply) {
+      result[n++] = (replay_request){.kind = MOVE_INFOS_QUERY, .s = s};
+      memcpy(result[n - 1].slug, br->slug, BUNDLE_SLUG_SIZE);
+
+      // Play a random move that keeps the game going. Two passes end the walk with a dead stone query.
+      state child = s;
+      move_result r = ILLEGAL;
+      for (int attempt = 0; attempt < 4 * br->dgr.num_moves && (r <= TARGET_LOST || r == TAKE_TARGET); ++attempt) {
+        child = s;
+        r = make_move(&child, br->dgr.moves[rng_next(rng) % br->dgr.num_moves]);
+      }
+      if (r <= TARGET_LOST || r == TAKE_TARGET) {
+        break;
+      }
+      s = child;
+      if (r == SECOND_PASS || ply == length - 1) {
+        if (n < num_requests) {
+          s.passes = 2;
+          result[n++] = (replay_request){.kind = DEAD_STONES_QUERY, .s = s};
+          memcpy(result[n - 1].slug, br->slug, BUNDLE_SLUG_SIZE);
+        }
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+static void load_readers(benchmark_reader *readers, size_t num_readers) {
+  for (size_t i = 0; i < num_readers; ++i) {
+    readers[i].dgr = load_dual_graph_reader(readers[i].filename);
+  }
+}
+
+static void unload_readers(benchmark_reader *readers, size_t num_readers) {
+  for (size_t i = 0; i < num_readers; ++i) {
+    unload_dual_graph_reader(&(readers[i].dgr));
+  }
+}
+
+// Ask the kernel to drop cached pages of the files. Pages mapped by other processes stay resident.
+static void drop_page_cache(const benchmark_reader *readers, size_t num_readers) {
+  for (size_t i = 0; i < num_readers; ++i) {
+    const int fd = open(readers[i].filename, O_RDONLY);
+    if (fd < 0) {
+      perror(readers[i].filename);
+      exit(EXIT_FAILURE);
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+static void run_benchmark(benchmark *b, int num_threads, const char *label) {
+  b->next_request = 0;
+  pthread_t *threads = xmalloc(num_threads * sizeof(pthread_t));
+  const uint64_t start = nanoseconds();
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_create(threads + i, NULL, work, b);
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  const double seconds = 1e-9 * (nanoseconds() - start);
+  free(threads);
+
+  printf("%d thread%s, %s page cache: %zu queries in %.3f s (%.0f / s)\n", num_threads, num_threads == 1 ? "" : "s", label,
+         b->num_requests, seconds, b->num_requests / seconds);
+  uint64_t *sorted = xmalloc(b->num_requests * sizeof(uint64_t));
+  for (int kind = 0; kind < NUM_QUERY_KINDS; ++kind) {
+    size_t count = 0;
+    for (size_t i = 0; i < b->num_requests; ++i) {
+      if (b->requests[i].kind == kind) {
+        sorted[count++] = b->latencies[i];
+      }
+    }
+    if (!count) {
+      continue;
+    }
+    qsort(sorted, count, sizeof(uint64_t), compare_latencies);
+    printf("  %-11s %8zu queries %9.0f / s   p50 %9.1f us   p99 %9.1f us   p999 %9.1f us\n", QUERY_NAMES[kind], count,
+           count / seconds, percentile(sorted, count, 0.5), percentile(sorted, count, 0.99), percentile(sorted, count, 0.999));
+  }
+  free(sorted);
+}
+
+int main(int argc, char *argv[]) {
+  // Strip flags so that positional arguments keep their place
+  size_t num_requests = DEFAULT_NUM_REQUESTS;
+  int walk_length = DEFAULT_WALK_LENGTH;
+  unsigned long long seed = 0;
+  size_t cache_capacity = 0;
+  const char *record_filename = NULL;
+  const char *replay_filename = NULL;
+  int thread_counts[2] = {1, (int)sysconf(_SC_NPROCESSORS_ONLN)};
+  int num_thread_counts = thread_counts[1] > 1 ? 2 : 1;
+  int num_args = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+      num_requests = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--walk-length") == 0 && i + 1 < argc) {
+      walk_length = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      thread_counts[0] = atoi(argv[++i]);
+      num_thread_counts = 1;
+    } else if (strcmp(argv[i], "--cache-capacity") == 0 && i + 1 < argc) {
+      cache_capacity = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_filename = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_filename = argv[++i];
+    } else {
+      argv[num_args++] = argv[i];
+    }
+  }
+  argc = num_args;
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <dual graph>... [--requests N] [--walk-length N] [--seed N] [--threads N] [--cache-capacity N] "
+            "[--record file] [--replay file]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (walk_length < 1 || thread_counts[0] < 1) {
+    fprintf(stderr, "Walk length and thread count must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  // Readers are named after their files like in a collection folder
+  size_t num_collections;
+  collection *collections = get_collections(&num_collections);
+  const size_t num_readers = argc - 1;
+  benchmark_reader *readers = xcalloc(num_readers, sizeof(benchmark_reader));
+  for (size_t i = 0; i < num_readers; ++i) {
+    readers[i].filename = argv[i + 1];
+    char *copy = strdup(argv[i + 1]);
+    snprintf(readers[i].slug, BUNDLE_SLUG_SIZE, "%s", basename(copy));
+    free(copy);
+    char *extension = strrchr(readers[i].slug, '.');
+    if (extension) {
+      *extension = '\0';
+    }
+    for (size_t j = 0; j < num_collections; ++j) {
+      if (!strcmp(collections[j].slug, readers[i].slug)) {
+        readers[i].meta = collections + j;
+      }
+    }
+    if (!replay_filename && !readers[i].meta) {
+      fprintf(stderr, "No tsumegos for %s\n", readers[i].slug);
+      return EXIT_FAILURE;
+    }
+  }
+  load_readers(readers, num_readers);
+
+  replay_request *requests;
+  if (replay_filename) {
+    FILE *f = fopen(replay_filename, "rb");
+    if (!f) {
+      perror(replay_filename);
+      return EXIT_FAILURE;
+    }
+    fseek(f, 0, SEEK_END);
+    num_requests = ftell(f) / sizeof(replay_request);
+    fseek(f, 0, SEEK_SET);
+    requests = xmalloc(num_requests * sizeof(replay_request));
+    if (fread(requests, sizeof(replay_request), num_requests, f) != num_requests) {
+      fprintf(stderr, "Failed to read %s\n", replay_filename);
+      return EXIT_FAILURE;
+    }
+    fclose(f);
+  } else {
+    rng_state rng = seed_rng(seed);
+    requests = generate_requests(readers, num_readers, num_requests, walk_length, &rng);
+  }
+  if (!num_requests) {
+    fprintf(stderr, "No requests to replay\n");
+    return EXIT_FAILURE;
+  }
+  if (record_filename) {
+    FILE *f = fopen(record_filename, "wb");
+    if (!f) {
+      perror(record_filename);
+      return EXIT_FAILURE;
+    }
+    fwrite(requests, sizeof(replay_request), num_requests, f);
+    fclose(f);
+    printf("Recorded %zu requests to %s\n", num_requests, record_filename);
+  }
+
+  size_t *reader_indices = xmalloc(num_requests * sizeof(size_t));
+  for (size_t i = 0; i < num_requests; ++i) {
+    reader_indices[i] = SIZE_MAX;
+    for (size_t j = 0; j < num_readers; ++j) {
+      if (!strncmp(requests[i].slug, readers[j].slug, BUNDLE_SLUG_SIZE)) {
+        reader_indices[i] = j;
+      }
+    }
+    if (reader_indices[i] == SIZE_MAX) {
+      fprintf(stderr, "No dual graph for %.*s\n", BUNDLE_SLUG_SIZE, requests[i].slug);
+      return EXIT_FAILURE;
+    }
+  }
+
+  response_cache cache = {0};
+  if (cache_capacity) {
+    cache = create_response_cache(cache_capacity);
+  }
+  benchmark b = {readers, num_readers, requests, reader_indices, num_requests, cache_capacity ? &cache : NULL, 0,
+                 xmalloc(num_requests * sizeof(uint64_t))};
+
+  for (int t = 0; t < num_thread_counts; ++t) {
+    // Cold runs start from freshly loaded readers on files evicted from the page cache
+    unload_readers(readers, num_readers);
+    if (cache_capacity) {
+      free_response_cache(&cache);
+      cache = create_response_cache(cache_capacity);
+    }
+    drop_page_cache(readers, num_readers);
+    load_readers(readers, num_readers);
+    run_benchmark(&b, thread_counts[t], "cold");
+    run_benchmark(&b, thread_counts[t], "warm");
+  }
+
+  if (cache_capacity) {
+    print_response_cache_stats(&cache);
+    free_response_cache(&cache);
+  }
+  free(b.latencies);
+  free(reader_indices);
+  free(requests);
+  unload_readers(readers, num_readers);
+  free(readers);
+  for (size_t i = 0; i < num_collections; ++i) {
+    free(collections[i].tsumegos);
+  }
+  free(collections);
+  return EXIT_SUCCESS;
+}
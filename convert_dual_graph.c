@@ -0,0 +1,31 @@
+#include "tinytsumego2/dual_reader.h"
+#include <stdio.h>
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <version 5 input> <output>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  struct stat sb;
+  int fd;
+  char *buffer = file_to_mmap(argv[1], &sb, &fd);
+
+  FILE *f = fopen(argv[2], "wb");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s for writing\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+  const size_t total = convert_dual_graph_v5(buffer, f);
+  fclose(f);
+  munmap(buffer, sb.st_size);
+  close(fd);
+
+  printf("Converted %zu bytes into %zu bytes\n", (size_t)sb.st_size, total);
+
+  // Validate the result by loading it
+  dual_graph_reader dgr = load_dual_graph_reader(argv[2]);
+  printf("Key-space size = %zu, %d moves\n", dgr.keyspace._.size, dgr.num_moves);
+  unload_dual_graph_reader(&dgr);
+
+  return EXIT_SUCCESS;
+}
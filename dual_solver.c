@@ -71,7 +71,7 @@ int main(int argc, char *argv[]) {
       write_dual_graph(&dg, &fht, f);
       fclose(f);
       free(fht.bulk_map);
-      free(fht.tail_keys);
+      free(fht.tail_offsets);
       free(fht.tail_values);
     }
     free_dual_graph(&dg);
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE // Expose tdestroy()
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/collection.h"
+#include "tinytsumego2/json_api.h"
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/util.h"
+#include <errno.h>
+#include <search.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_MAX_DEPTH (8)
+#define DEFAULT_MAX_STATES (100000)
+
+static void make_folder(const char *path) {
+  if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static int compare_addresses(const void *a, const void *b) { return strcmp(a, b); }
+
+// Write the exact body the API would send in response to a move request for the state
+static void export_response(const char *folder, const char *slug, const char *address, response_cache *cache,
+                            dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  char *filename = xmalloc(strlen(folder) + strlen(slug) + strlen(address) + strlen("//.json") + 1);
+  sprintf(filename, "%s/%s/%s.json", folder, slug, address);
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    perror(filename);
+    exit(EXIT_FAILURE);
+  }
+  write_state_response_json(f, cache, dgr, ctx, s);
+  fputc('\n', f);
+  fclose(f);
+  free(filename);
+}
+
+// Export responses to the states reachable from the tsumegos of the collection in breadth-first order
+static size_t export_collection(const collection *c, dual_graph_reader *dgr, const char *folder, int max_depth, size_t max_states,
+                                response_cache *cache) {
+  char *path = xmalloc(strlen(folder) + strlen(c->slug) + strlen("//index") + 1);
+  sprintf(path, "%s/%s", folder, c->slug);
+  make_folder(path);
+  sprintf(path, "%s/%s/index", folder, c->slug);
+  FILE *index = fopen(path, "w");
+  if (!index) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  size_t num_frontier = c->num_tsumegos;
+  state *frontier = xmalloc(num_frontier * sizeof(state));
+  for (size_t i = 0; i < num_frontier; ++i) {
+    frontier[i] = c->tsumegos[i].state;
+    frontier[i].wide = c->root.wide;
+  }
+
+  void *visited = NULL;
+  size_t num_visited = 0;
+  state *layer = xmalloc(num_frontier * sizeof(state));
+  char (*addresses)[STATE_ADDRESS_SIZE] = xmalloc(num_frontier * sizeof(*addresses));
+
+  for (int depth = 0; depth <= max_depth && num_frontier; ++depth) {
+    // Keep the states seen for the first time while the budget lasts
+    layer = xrealloc(layer, num_frontier * sizeof(state));
+    addresses = xrealloc(addresses, num_frontier * sizeof(*addresses));
+    size_t num_layer = 0;
+    for (size_t i = 0; i < num_frontier && num_visited < max_states; ++i) {
+      format_state_address(frontier + i, addresses[num_layer]);
+      char *key = strdup(addresses[num_layer]);
+      if (*(char **)tsearch(key, &visited, compare_addresses) != key) {
+        free(key);
+        continue;
+      }
+      layer[num_layer++] = frontier[i];
+      num_visited++;
+    }
+
+#pragma omp parallel
+    {
+      reader_context ctx = create_reader_context(dgr, 0);
+#pragma omp for schedule(dynamic, 16)
+      for (size_t i = 0; i < num_layer; ++i) {
+        export_response(folder, c->slug, addresses[i], cache, dgr, &ctx, layer + i);
+      }
+      free_reader_context(&ctx);
+    }
+    for (size_t i = 0; i < num_layer; ++i) {
+      fprintf(index, "%s\n", addresses[i]);
+    }
+
+    // Expand the accepted states. States after two passes are answered with dead stones and have no children.
+    num_frontier = 0;
+    if (depth == max_depth) {
+      break;
+    }
+    frontier = xrealloc(frontier, num_layer * dgr->num_moves * sizeof(state));
+    for (size_t i = 0; i < num_layer; ++i) {
+      if (layer[i].passes >= 2) {
+        continue;
+      }
+      for (int j = 0; j < dgr->num_moves; ++j) {
+        state child = layer[i];
+        const move_result r = make_move(&child, dgr->moves[j]);
+        if (r <= TARGET_LOST || r == TAKE_TARGET) {
+          continue;
+        }
+        frontier[num_frontier++] = child;
+      }
+    }
+  }
+
+  fclose(index);
+  tdestroy(visited, free);
+  free(addresses);
+  free(layer);
+  free(frontier);
+  free(path);
+  return num_visited;
+}
+
+int main(int argc, char *argv[]) {
+  // Strip flags so that positional arguments keep their place
+  int max_depth = DEFAULT_MAX_DEPTH;
+  size_t max_states = DEFAULT_MAX_STATES;
+  int num_args = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+      max_depth = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc) {
+      max_states = strtoull(argv[++i], NULL, 10);
+    } else {
+      argv[num_args++] = argv[i];
+    }
+  }
+  argc = num_args;
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <collection folder or .bundle> <output folder> [collection slug] [--depth N] [--max-states N]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *path = argv[1];
+  const char *folder = argv[2];
+  const char *target_slug = argc > 3 ? argv[3] : NULL;
+
+  make_folder(folder);
+
+  size_t num_collections;
+  collection *collections = get_collections(&num_collections);
+  solution_bundle bundle = {0};
+  const bool is_bundle = strlen(path) > 7 && !strcmp(path + strlen(path) - 7, ".bundle");
+  if (is_bundle) {
+    printf("Reading bundle %s\n", path);
+    bundle = load_solution_bundle(path);
+  }
+  response_cache cache = create_response_cache(RESPONSE_CACHE_CAPACITY);
+
+  size_t total = 0;
+  for (size_t i = 0; i < num_collections; ++i) {
+    const collection *c = collections + i;
+    if (target_slug && strcmp(c->slug, target_slug)) {
+      continue;
+    }
+    dual_graph_reader *reader = NULL;
+    if (is_bundle) {
+      reader = get_bundle_reader(&bundle, c->slug);
+    } else {
+      char *filename = xmalloc(strlen(path) + strlen(c->slug) + strlen("/.bin") + 1);
+      sprintf(filename, "%s/%s.bin", path, c->slug);
+      if (access(filename, R_OK) == 0) {
+        printf("Reading %s\n", filename);
+        reader = allocate_dual_graph_reader(filename);
+      }
+      free(filename);
+    }
+    if (!reader) {
+      printf("Missing binary for %s\n", c->slug);
+      continue;
+    }
+
+    const size_t num_exported = export_collection(c, reader, folder, max_depth, max_states, &cache);
+    printf("Exported %zu responses for %s\n", num_exported, c->slug);
+    total += num_exported;
+
+    if (!is_bundle) {
+      unload_dual_graph_reader(reader);
+      free(reader);
+    }
+  }
+  printf("Exported %zu responses in total\n", total);
+
+  print_response_cache_stats(&cache);
+  free_response_cache(&cache);
+  if (is_bundle) {
+    unload_solution_bundle(&bundle);
+  }
+  for (size_t i = 0; i < num_collections; ++i) {
+    free(collections[i].tsumegos);
+  }
+  free(collections);
+  return EXIT_SUCCESS;
+}
@@ -1,14 +1,49 @@
+#include "tinytsumego2/bundle.h"
 #include "tinytsumego2/collection.h"
 #include "tinytsumego2/dual_reader.h"
 #include "tinytsumego2/dual_solver.h"
+#include "tinytsumego2/planner.h"
 #include "tinytsumego2/util.h"
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 int main(int argc, char *argv[]) {
+  // Strip flags so that positional arguments keep their place
+  bool compress_ids = false;
+  bool bundle = false;
+  bool move_tables = false;
+  bool terminal_tables = false;
+  int hot_plies = -1;
+  bool prune = false;
+  planner_options options = default_planner_options();
+  int num_args = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], "--compress-ids") == 0) {
+      compress_ids = true;
+    } else if (strcmp(argv[i], "--bundle") == 0) {
+      bundle = true;
+    } else if (strcmp(argv[i], "--move-table") == 0) {
+      move_tables = true;
+    } else if (strcmp(argv[i], "--terminal-table") == 0) {
+      terminal_tables = true;
+    } else if (strcmp(argv[i], "--hot-plies") == 0 && i + 1 < argc) {
+      hot_plies = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--prune") == 0) {
+      prune = true;
+    } else if (strcmp(argv[i], "--ram-budget") == 0 && i + 1 < argc) {
+      options.ram_budget = (size_t)atoll(argv[++i]) << 20;
+    } else if (strcmp(argv[i], "--symmetric-node-cost") == 0 && i + 1 < argc) {
+      options.node_costs[SYMMETRIC_KEYSPACE] = atof(argv[++i]);
+    } else {
+      argv[num_args++] = argv[i];
+    }
+  }
+  argc = num_args;
+
   if (argc <= 2) {
     printf("Generating solutions to all public tsumegos...\n");
   }
@@ -45,7 +80,18 @@ int main(int argc, char *argv[]) {
     }
     printf("%s\n", collections[i].title);
     print_state(&(collections[i].root));
-    dual_graph dg = create_dual_graph(&(collections[i].root), collections[i].type);
+    keyspace_plan plan = plan_keyspace(&(collections[i].root), &options);
+    print_keyspace_plan(&plan);
+    // Move and terminal tables are only built for compressed keyspaces
+    const keyspace_type type = (move_tables || terminal_tables) ? COMPRESSED_KEYSPACE : plan.choice;
+    if (plan.estimates[type].solver_bytes > options.ram_budget) {
+      fprintf(stderr, "Solving %s needs an estimated %zu bytes which is over the budget of %zu bytes\n", collections[i].slug,
+              plan.estimates[type].solver_bytes, options.ram_budget);
+      exit(EXIT_FAILURE);
+    }
+    dual_graph dg = create_dual_graph(&(collections[i].root), type);
+    dg.side_table = create_side_table(&dg);
+    printf("%zu ko and atari states in the side table\n", dg.side_table.size);
     for (int j = 0;; j++) {
       bool verbose = (j < 8) || (j % (j >> 2) == 0);
       if (!iterate_dual_graph(&dg, verbose))
@@ -77,21 +123,123 @@ int main(int argc, char *argv[]) {
       size_t value_map_size = 0;
       frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
       printf("%zu unique value quads in the graph\n", value_map_size);
+      if (compress_ids) {
+        fht.id_layout = BLOCK_IDS;
+      }
 
       char *filename = xmalloc((strlen(path) + strlen(collections[i].slug) + strlen(".bin") + 1) * sizeof(char));
       sprintf(filename, "%s%s.bin", path, collections[i].slug);
       printf("Storing solution to %s\n", filename);
       FILE *f = fopen(filename, "wb");
-      write_dual_graph(&dg, &fht, f);
+      if (prune || move_tables || terminal_tables || hot_plies >= 0) {
+        // Extend a reader over the freshly serialized graph one table at a time
+        char *buffer = NULL;
+        size_t length = 0;
+        FILE *stream = open_memstream(&buffer, &length);
+        write_dual_graph(&dg, &fht, stream);
+        fclose(stream);
+        dual_graph_reader dgr = {0};
+        dgr.fd = -1;
+        dgr.buffer = buffer;
+        unbuffer_dual_graph_reader(&dgr);
+        char *extended = NULL;
+        void reload() {
+          fclose(stream);
+          unload_dual_graph_reader(&dgr);
+          free(buffer);
+          buffer = extended;
+          dgr = (dual_graph_reader){0};
+          dgr.fd = -1;
+          dgr.buffer = buffer;
+          unbuffer_dual_graph_reader(&dgr);
+        }
+        state *origins = xmalloc(collections[i].num_tsumegos * sizeof(state));
+        for (size_t j = 0; j < collections[i].num_tsumegos; ++j) {
+          origins[j] = collections[i].tsumegos[j].state;
+        }
+        // Prune first so that the tables below only cover what remains reachable
+        if (prune) {
+          const size_t full_length = length;
+          stream = open_memstream(&extended, &length);
+          write_pruned_dual_graph(&dgr, origins, collections[i].num_tsumegos, stream);
+          reload();
+          printf("%zu of %zu keys reachable from the tsumegos\n", dgr.value_table.num_stored_keys, dgr.keyspace._.size);
+          const section_entry *index = find_dual_graph_section(dgr.directory, STORED_KEY_LIST_SECTION);
+          if (!index) {
+            index = find_dual_graph_section(dgr.directory, STORED_KEYS_SECTION);
+          }
+          printf("%zu bytes instead of %zu, %zu of them indexing the stored keys\n", length, full_length, (size_t)index->length);
+        }
+        if (move_tables) {
+          move_table mt = prepare_move_table(&dgr);
+          printf("%zu distinct move records for %zu keys\n", mt.num_records, mt.size);
+          stream = open_memstream(&extended, &length);
+          write_dual_graph_with_move_table(&dgr, &mt, stream);
+          free_move_table(&mt);
+          reload();
+        }
+        if (terminal_tables) {
+          printf("Resolving terminal steps\n");
+          terminal_table tt = prepare_terminal_table(&dgr, true);
+          stream = open_memstream(&extended, &length);
+          write_dual_graph_with_terminal_table(&dgr, &tt, stream);
+          free_terminal_table(&tt);
+          reload();
+        }
+        if (hot_plies >= 0) {
+          hot_table ht = prepare_hot_table(&dgr, origins, collections[i].num_tsumegos, hot_plies);
+          printf("%zu hot keys within %d plies of the tsumegos\n", ht.size, hot_plies);
+          stream = open_memstream(&extended, &length);
+          write_dual_graph_with_hot_table(&dgr, &ht, stream);
+          free_hot_table(&ht);
+          reload();
+        }
+        free(origins);
+        fwrite(buffer, 1, length, f);
+        unload_dual_graph_reader(&dgr);
+        free(buffer);
+      } else {
+        write_dual_graph(&dg, &fht, f);
+      }
       fclose(f);
       free(fht.bulk_map);
-      free(fht.tail_keys);
+      free(fht.tail_offsets);
       free(fht.tail_values);
       free(filename);
       free_dual_graph(&dg);
       free(collections[i].tsumegos);
     }
   }
+
+  if (path && bundle) {
+    // Bundle every collection solved so far including ones from earlier runs
+    char **slugs = xmalloc(num_collections * sizeof(char *));
+    char **filenames = xmalloc(num_collections * sizeof(char *));
+    size_t num_bundled = 0;
+    for (size_t i = 0; i < num_collections; ++i) {
+      char *filename = xmalloc((strlen(path) + strlen(collections[i].slug) + strlen(".bin") + 1) * sizeof(char));
+      sprintf(filename, "%s%s.bin", path, collections[i].slug);
+      if (access(filename, R_OK)) {
+        fprintf(stderr, "Missing binary for %s\n", collections[i].slug);
+        free(filename);
+        continue;
+      }
+      slugs[num_bundled] = collections[i].slug;
+      filenames[num_bundled++] = filename;
+    }
+    char *filename = xmalloc((strlen(path) + strlen("collections.bundle") + 1) * sizeof(char));
+    sprintf(filename, "%scollections.bundle", path);
+    printf("Storing bundle to %s\n", filename);
+    FILE *f = fopen(filename, "wb");
+    write_solution_bundle(slugs, filenames, num_bundled, f);
+    fclose(f);
+    free(filename);
+    for (size_t i = 0; i < num_bundled; ++i) {
+      free(filenames[i]);
+    }
+    free(filenames);
+    free(slugs);
+  }
   free(collections);
 
   return EXIT_SUCCESS;
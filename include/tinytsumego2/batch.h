@@ -0,0 +1,51 @@
+#pragma once
+#include "tinytsumego2/dual_reader.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file batch.h
+ * @brief Parallel evaluation of many states against one dual graph reader.
+ *
+ * Every thread queries the shared reader through its own reader_context so the reader is never mutated. Results are
+ * independent of the number of threads.
+ */
+
+/**
+ * @brief Look up the value bounds of a batch of states.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param states States to evaluate.
+ * @param count Number of states.
+ * @param values Output array of `count` value bounds.
+ */
+void dual_graph_reader_batch_values(const dual_graph_reader *dgr, const state *states, size_t count, dual_value *values);
+
+/**
+ * @brief Annotate the moves of a batch of states.
+ *
+ * The move infos of `states[i]` occupy `result[offsets[i]]` up to but not including `result[offsets[i + 1]]`.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param states States whose moves should be annotated.
+ * @param count Number of states.
+ * @param offsets Output array of `count + 1` offsets into the result.
+ * @return Newly allocated move-info array owned by the caller.
+ */
+move_info *dual_graph_reader_batch_move_infos(const dual_graph_reader *dgr, const state *states, size_t count, size_t *offsets);
+
+/**
+ * @brief Follow optimal play from a batch of states.
+ *
+ * Loops are broken by a generator seeded with `seed + i` for `states[i]` so results do not depend on scheduling.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param states Starting states.
+ * @param count Number of states.
+ * @param ts Tactical scoring mode.
+ * @param low Follow `dual_graph_reader_low_terminal()` instead of `dual_graph_reader_high_terminal()`.
+ * @param seed Base seed of the generators.
+ * @param terminals Output array of `count` terminal states.
+ */
+void dual_graph_reader_batch_terminals(const dual_graph_reader *dgr, const state *states, size_t count, tactics ts, bool low,
+                                       unsigned long long seed, state *terminals);
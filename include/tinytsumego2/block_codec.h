@@ -0,0 +1,104 @@
+#pragma once
+#include "tinytsumego2/util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file block_codec.h
+ * @brief Compression of value ids in fixed key-range blocks with an LRU cache of decoded blocks.
+ */
+
+/** @brief Number of keys per compressed id block. Must be a multiple of TAIL_BUCKET_SIZE. */
+#define ID_BLOCK_SIZE (1024)
+
+/** @brief Default number of decoded blocks kept in RAM per reader. */
+#define ID_BLOCK_CACHE_CAPACITY (1024)
+
+/** @brief Number of zero bytes appended after the last encoded block so that decoding may read ahead. */
+#define ID_BLOCK_PADDING (8)
+
+/**
+ * @brief Bounded LRU cache of decoded id blocks.
+ *
+ * Encoded blocks are referenced in place, typically inside a memory-mapped file.
+ */
+typedef struct id_block_cache {
+  /** @brief Total number of ids in all blocks. */
+  size_t size;
+  /** @brief Number of blocks. */
+  size_t num_blocks;
+  /** @brief Byte offsets of each encoded block into `data` followed by the total encoded size. */
+  const uint64_t *offsets;
+  /** @brief Encoded blocks. */
+  const unsigned char *data;
+
+  /** @brief Maximum number of decoded blocks. */
+  size_t capacity;
+  /** @brief Number of slots in use. */
+  size_t num_used;
+  /** @brief Number of slots with storage. Grows up to `capacity` as blocks are decoded. */
+  size_t num_allocated;
+  /** @brief Decoded ids of each slot. */
+  value_id_t *ids;
+  /** @brief Block held by each slot. */
+  size_t *blocks;
+  /** @brief Slot holding each block or SIZE_MAX when not cached. NULL until the first lookup. */
+  size_t *slots;
+  /** @brief Next more recently used slot or SIZE_MAX. */
+  size_t *newer;
+  /** @brief Next less recently used slot or SIZE_MAX. */
+  size_t *older;
+  /** @brief Most recently used slot. */
+  size_t newest;
+  /** @brief Least recently used slot. */
+  size_t oldest;
+
+  /** @brief Number of lookups served from the cache. */
+  size_t hits;
+  /** @brief Number of lookups that decoded a block. */
+  size_t misses;
+} id_block_cache;
+
+/** @brief Return an upper bound on the encoded size of `count` ids. */
+size_t max_encoded_ids_size(size_t count);
+
+/**
+ * @brief Encode a block of ids.
+ *
+ * Runs of equal ids are replaced by (id, length) pairs. Ids are ranked by the number of runs they start and both the rank
+ * and the length are written as Elias gamma codes. Blocks that do not compress are stored verbatim.
+ *
+ * @param ids Ids to encode.
+ * @param count Number of ids, at most ID_BLOCK_SIZE.
+ * @param out Output buffer of at least `max_encoded_ids_size(count)` bytes.
+ * @return Number of bytes written.
+ */
+size_t encode_ids(const value_id_t *ids, size_t count, unsigned char *out);
+
+/**
+ * @brief Decode a block produced by `encode_ids()`.
+ *
+ * May read up to ID_BLOCK_PADDING bytes past the end of the encoded block.
+ *
+ * @return False if the palette or a rank or run length is out of range, leaving `ids` partially written.
+ */
+bool decode_ids(const unsigned char *in, size_t count, value_id_t *ids);
+
+/**
+ * @brief Create an empty cache over encoded blocks of `size` ids in total.
+ *
+ * Nothing is allocated up front. The first lookup allocates the block index of `num_blocks` words and slot storage then
+ * doubles as needed, so a full cache holds `capacity * ID_BLOCK_SIZE` ids, 2 MiB at the default capacity.
+ */
+id_block_cache create_id_block_cache(size_t size, const uint64_t *offsets, const unsigned char *data, size_t capacity);
+
+/**
+ * @brief Return the decoded ids of a block, decoding it and evicting the least recently used block if necessary.
+ *
+ * Exits if the block is malformed.
+ */
+const value_id_t *get_id_block(id_block_cache *cache, size_t block);
+
+/** @brief Free resources associated with an id block cache. */
+void free_id_block_cache(id_block_cache *cache);
@@ -0,0 +1,96 @@
+#pragma once
+#include "tinytsumego2/dual_reader.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+/**
+ * @file bundle.h
+ * @brief Single-file archives of several serialized dual graphs sharing identical sections.
+ */
+
+/** @brief Magic bytes opening every solution bundle. */
+#define SOLUTION_BUNDLE_MAGIC ("TSBUNDLE")
+
+/** @brief Maximum length of a collection slug in a bundle including the terminating zero. */
+#define BUNDLE_SLUG_SIZE (64)
+
+/**
+ * @brief Fixed header of a solution bundle.
+ *
+ * The header is followed by `num_collections` bundle entries. Each entry points to a container_header and a section
+ * directory like those of a standalone dual graph, except that section offsets are relative to the start of the bundle
+ * and `file_size` is the size of the bundle. Sections with identical contents are stored once.
+ */
+typedef struct bundle_header {
+  /** @brief SOLUTION_BUNDLE_MAGIC without the terminating zero. */
+  char magic[8];
+  /** @brief Dual graph format version of the contained collections. */
+  int32_t version;
+  /** @brief Number of bundle entries. */
+  uint32_t num_collections;
+  /** @brief Total size of the bundle in bytes. */
+  uint64_t file_size;
+} bundle_header;
+
+/** @brief Directory entry locating the section directory of one collection. */
+typedef struct bundle_entry {
+  /** @brief Zero-terminated slug of the collection. */
+  char slug[BUNDLE_SLUG_SIZE];
+  /** @brief Offset of the container header of the collection. */
+  uint64_t directory_offset;
+} bundle_entry;
+
+/**
+ * @brief Write a bundle of dual graphs serialized by `write_dual_graph()`.
+ *
+ * @param slugs Slugs of the collections.
+ * @param filenames Paths of the serialized dual graphs in the same order.
+ * @param num_collections Number of collections.
+ * @param stream Output stream.
+ * @return Number of bytes written.
+ */
+size_t write_solution_bundle(char **slugs, char **filenames, size_t num_collections, FILE *restrict stream);
+
+/** @brief Memory-mapped bundle with readers initialized on first access. */
+typedef struct solution_bundle {
+  /** @brief Number of collections. */
+  size_t num_collections;
+  /** @brief Bundle entries inside the mapping. */
+  const bundle_entry *entries;
+  /** @brief Reader of each collection. Only valid when `initialized` is set. */
+  dual_graph_reader *readers;
+  /** @brief Whether each reader has been initialized. */
+  bool *initialized;
+
+  /** @brief File metadata for resource management. */
+  struct stat sb;
+  /** @brief File descriptor backing the memory map. */
+  int fd;
+  /** @brief Pointer to the memory-mapped bundle. */
+  char *buffer;
+} solution_bundle;
+
+/**
+ * @brief Map a bundle without initializing any of its readers.
+ *
+ * @param filename Path to a bundle written by `write_solution_bundle()`.
+ * @return Bundle backed by a memory-mapped file.
+ */
+solution_bundle load_solution_bundle(const char *filename);
+
+/**
+ * @brief Return the reader of a collection initializing it on first access. Not thread-safe.
+ *
+ * @param bundle Loaded bundle.
+ * @param slug Slug of the collection.
+ * @return Reader owned by the bundle or NULL when the bundle has no such collection or its container is malformed.
+ */
+dual_graph_reader *get_bundle_reader(solution_bundle *bundle, const char *slug);
+
+/** @brief Unload all initialized readers and unmap the bundle. */
+void unload_solution_bundle(solution_bundle *bundle);
+
+/** @brief Allocate a bundle for Python ctypes bindings. */
+solution_bundle *allocate_solution_bundle(const char *filename);
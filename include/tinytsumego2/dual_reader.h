@@ -1,8 +1,10 @@
 #pragma once
+#include "tinytsumego2/block_codec.h"
 #include "tinytsumego2/dual_solver.h"
 #include "tinytsumego2/scoring.h"
 #include "tinytsumego2/stones.h"
 #include "tinytsumego2/util.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/stat.h>
 
@@ -11,8 +13,17 @@
  * @brief Memory-mapped read-only access to serialized dual solver output.
  */
 
-/** @brief Sentinel used when a value lookup must fall through to the overflow table. */
-#define VALUE_ID_SENTINEL (USHRT_MAX)
+/** @brief Sentinel id of the given bit width used when a value lookup must fall through to the overflow table. */
+#define VALUE_ID_SENTINEL(width) ((value_id_t)((1U << (width)) - 1))
+
+/** @brief Base-2 logarithm of the number of keys covered by each tail offset. */
+#define TAIL_BUCKET_SHIFT (7)
+
+/** @brief Number of keys covered by each tail offset. */
+#define TAIL_BUCKET_SIZE (1ULL << TAIL_BUCKET_SHIFT)
+
+/** @brief Number of keys covered by each block of the stored key bitmap of pruned tables. */
+#define STORED_KEYS_BLOCK_SIZE (512)
 
 /** @brief Plain and forcing value bounds for one state. */
 typedef struct dual_value {
@@ -20,11 +31,89 @@ typedef struct dual_value {
   value forcing;
 } dual_value;
 
-/** @brief Plain and forcing Q7 value bounds for one state. */
-typedef struct dual_table_value {
-  table_value plain;
-  table_value forcing;
-} dual_table_value;
+/** @brief Storage layout of the dense value ids in a serialized dual graph. */
+typedef enum id_layout {
+  /** @brief Bit-packed ids with random access. */
+  PACKED_IDS,
+  /** @brief Blocks of ID_BLOCK_SIZE ids compressed using `encode_ids()` and decoded on demand. */
+  BLOCK_IDS,
+} id_layout;
+
+/** @brief Magic bytes opening every serialized dual graph. */
+#define DUAL_GRAPH_MAGIC ("TSUMEGO2")
+
+/** @brief Types of the sections of a serialized dual graph. */
+typedef enum section_type {
+  /** @brief Scalar fields of the graph, the compressor and the tables. */
+  METADATA_SECTION,
+  /** @brief Checkpoints of the keyspace compressor. */
+  CHECKPOINTS_SECTION,
+  /** @brief Deltas of the keyspace compressor. */
+  DELTAS_SECTION,
+  /** @brief Tables of the specific keyspace. Absent for mock keyspaces. */
+  KEYSPACE_SECTION,
+  /** @brief Legal root moves. */
+  MOVES_SECTION,
+  /** @brief Bit-packed value ids. Only present with PACKED_IDS. */
+  BULK_IDS_SECTION,
+  /** @brief Offsets of the compressed id blocks. Only present with BLOCK_IDS. */
+  ID_BLOCK_OFFSETS_SECTION,
+  /** @brief Compressed id blocks. Only present with BLOCK_IDS. */
+  ID_BLOCKS_SECTION,
+  /** @brief Values addressed by the ids. */
+  BULK_MAP_SECTION,
+  /** @brief Values that did not fit the bulk map. */
+  TAIL_VALUES_SECTION,
+  /** @brief Tail offsets of each bucket of keys. */
+  TAIL_OFFSETS_SECTION,
+  /** @brief Open-addressing slots of the side table keys. */
+  SIDE_KEYS_SECTION,
+  /** @brief Side table values. */
+  SIDE_VALUES_SECTION,
+  /** @brief Move record id of each key. Optional. */
+  MOVE_IDS_SECTION,
+  /** @brief Deduplicated move records. Optional. */
+  MOVE_RECORDS_SECTION,
+  /** @brief Plies to resolution and next move of every key. Optional. */
+  TERMINAL_STEPS_SECTION,
+  /** @brief Open-addressing slots of the values near the published tsumegos. Optional. */
+  HOT_SLOTS_SECTION,
+  /** @brief Rank bitmap of the keys whose values are stored. Only present in pruned exports. */
+  STORED_KEYS_SECTION,
+  /** @brief Sorted keys whose values are stored. Replaces the bitmap in pruned exports that keep few keys of a large keyspace. */
+  STORED_KEY_LIST_SECTION,
+  /** @brief Number of section types. */
+  NUM_SECTION_TYPES,
+} section_type;
+
+/** @brief Directory entry locating one section of a serialized dual graph. */
+typedef struct section_entry {
+  /** @brief One of section_type. */
+  uint32_t type;
+  /** @brief Alignment of the section offset in bytes. */
+  uint32_t alignment;
+  /** @brief Offset of the section from the start of the file. */
+  uint64_t offset;
+  /** @brief Length of the section in bytes. */
+  uint64_t length;
+} section_entry;
+
+/**
+ * @brief Fixed header of a serialized dual graph.
+ *
+ * The header is followed by `num_sections` directory entries. Each section starts at a multiple of TABLE_ALIGNMENT so that
+ * its arrays can be used in place from a memory map.
+ */
+typedef struct container_header {
+  /** @brief DUAL_GRAPH_MAGIC without the terminating zero. */
+  char magic[8];
+  /** @brief Format version. */
+  int32_t version;
+  /** @brief Number of directory entries. */
+  uint32_t num_sections;
+  /** @brief Total size of the file in bytes. */
+  uint64_t file_size;
+} container_header;
 
 /**
  * @brief Build-once associative structure optimized for integer keys
@@ -36,18 +125,124 @@ typedef struct frozen_hash_table {
   /** @brief Dense mapping from value identifiers to stored values. */
   dual_table_value *bulk_map;
 
-  /** @brief Dense ids or VALUE_ID_SENTINEL when lookup must fall through. */
-  value_id_t *bulk_ids;
+  /** @brief Number of bits per dense id. The bulk map holds fewer than `1 << id_width` entries. */
+  int id_width;
+  /** @brief Bit-packed dense ids or VALUE_ID_SENTINEL(id_width) when lookup must fall through. Padded by one word. */
+  uint64_t *bulk_ids;
 
   /** @brief Number of overflow entries in the sparse tail section. */
   size_t tail_size;
   /** @brief Values stored in the sparse tail section. */
   dual_table_value *tail_values;
 
-  /** @brief Sorted odd-index tail keys used to derive tail lookup positions. */
-  size_t *tail_keys;
+  /**
+   * @brief Number of tail entries preceding each bucket of TAIL_BUCKET_SIZE keys.
+   *
+   * The tail position of a key is its bucket offset plus the number of sentinels in `bulk_ids` between the start of the bucket
+   * and the key itself. Empty when there is no tail.
+   */
+  size_t *tail_offsets;
+
+  /** @brief Layout used by `write_dual_graph()` or found when reading. */
+  id_layout id_layout;
+  /** @brief Cache of decoded id blocks. Only used with BLOCK_IDS. */
+  id_block_cache *id_blocks;
+
+  /** @brief Number of stored keys when pruned. */
+  size_t num_stored_keys;
+  /**
+   * @brief Bitmap of the keys whose values are stored or NULL when every key is stored.
+   *
+   * Each block of STORED_KEYS_BLOCK_SIZE keys is one word counting the stored keys of the preceding blocks followed by the
+   * bits of the block. Ids and tail offsets of pruned tables are indexed by the rank of the key, and so are move and terminal
+   * tables of the reader. Other keys resolve to the full Q7 range.
+   */
+  const uint64_t *stored_keys;
+  /** @brief True when `stored_keys` lists the `num_stored_keys` keys in increasing order instead. */
+  bool stored_keys_sorted;
 } frozen_hash_table;
 
+/**
+ * @brief Precomputed move annotations of every keyspace state.
+ *
+ * Each record holds `num_words` 64-bit masks of legal, low-ideal, high-ideal and forcing moves in that order followed by the
+ * low and high gain of every move. Identical records are shared between keys.
+ */
+typedef struct move_table {
+  /** @brief Number of keys covered. Only the stored keys of pruned readers. Zero when the table is absent. */
+  size_t size;
+  /** @brief Number of distinct records. */
+  size_t num_records;
+  /** @brief Number of 64-bit words in each mask. */
+  size_t num_words;
+  /** @brief Size of one record in bytes. */
+  size_t record_size;
+  /** @brief Record index of each key or of its rank among the stored keys. */
+  uint32_t *ids;
+  /** @brief Packed records. */
+  unsigned char *records;
+} move_table;
+
+/** @brief Size of one move record in bytes for a root with `num_moves` moves including the pass. */
+size_t move_record_size(int num_moves);
+
+/** @brief Plies value of states from which optimal play was not resolved. */
+#define UNRESOLVED_PLIES (UINT16_MAX)
+
+/** @brief Track of `dual_graph_reader_low_terminal()`. */
+#define LOW_TRACK (0)
+/** @brief Track of `dual_graph_reader_high_terminal()`. */
+#define HIGH_TRACK (1)
+
+/** @brief Shortest continuation of optimal forcing play from one keyspace state, indexed by track. */
+typedef struct terminal_step {
+  /** @brief Number of plies until the game ends or UNRESOLVED_PLIES. */
+  uint16_t plies[2];
+  /** @brief Index of the first move of the continuation into the root move list. */
+  uint8_t moves[2];
+} terminal_step;
+
+/**
+ * @brief Precomputed distances to resolution of every keyspace state under forcing tactics.
+ *
+ * The low track follows moves that keep the low bound and then switches to the high track and vice versa. Following the
+ * stored moves is deterministic and the remaining plies decrease by one every move.
+ */
+typedef struct terminal_table {
+  /** @brief Number of keys covered. Only the stored keys of pruned readers. Zero when the table is absent. */
+  size_t size;
+  /** @brief Step of each key or of its rank among the stored keys. */
+  terminal_step *steps;
+} terminal_table;
+
+/** @brief Key of the empty slots of a hot table. */
+#define HOT_EMPTY_KEY (UINT64_MAX)
+
+/** @brief Slot of a hot table. */
+typedef struct hot_slot {
+  /** @brief Key or HOT_EMPTY_KEY. */
+  uint64_t key;
+  /** @brief Q7 value of the key. */
+  dual_table_value value;
+  /** @brief Always zero. Pads slots to 16 bytes. */
+  uint32_t padding;
+} hot_slot;
+
+/**
+ * @brief Values of the keys visited by queries near the published tsumegos.
+ *
+ * Linear probing over a power-of-two number of slots that are at most half full. The table is small enough to stay in the
+ * CPU caches and is consulted before the frozen hash table so popular lookups do not touch the scattered bulk ids.
+ */
+typedef struct hot_table {
+  /** @brief Number of slots. Zero when the table is absent. */
+  size_t num_slots;
+  /** @brief Number of occupied slots. */
+  size_t size;
+  /** @brief Slots. */
+  hot_slot *slots;
+} hot_table;
+
 /**
  * @brief Read-only view of a serialized dual_graph.
  */
@@ -68,17 +263,36 @@ typedef struct dual_graph_reader {
   /** @brief Compressed lookup table from keys to dual values. */
   frozen_hash_table value_table;
 
+  /** @brief Materialized values of ko and atari states. */
+  side_table side_table;
+
+  /** @brief Optional precomputed move annotations. Only produced for compressed keyspaces. */
+  move_table move_table;
+
+  /** @brief Optional precomputed terminal steps. Only produced for compressed keyspaces. */
+  terminal_table terminal_table;
+
+  /** @brief Optional values near the published tsumegos copied to RAM. */
+  hot_table hot_table;
+
   /** @brief File metadata for resource management. */
   struct stat sb;
 
   /** @brief File descriptor backing the memory map. */
   int fd;
 
-  /** @brief Pointer to the memory-mapped file contents. */
+  /** @brief Pointer to the memory-mapped file contents. Section offsets are relative to this. */
   char *buffer;
 
+  /** @brief Container header and section directory. Defaults to `buffer` and differs only for readers inside bundles. */
+  const char *directory;
+
   /** @brief Convert a state into the serialized graph's key space. */
   size_t (*to_key)(const struct dual_graph_reader *dgr, const state *s);
+  /** @brief Atari predicate selected for the root like in `create_dual_graph()`. */
+  bool (*in_atari)(const state *s);
+  /** @brief Capture predicate selected for the root like in `create_dual_graph()`. */
+  bool (*can_take)(const state *s);
 } dual_graph_reader;
 
 /** @brief Information about one candidate move returned to clients. */
@@ -94,6 +308,8 @@ typedef struct move_info {
 /**
  * @brief Serialize a solved dual graph and its frozen hash table to a stream.
  *
+ * The output starts with a container_header and a section directory followed by the sections described by section_type.
+ *
  * @param dg Solved dual graph to serialize.
  * @param fht Frozen hash table paired with `dg`.
  * @param stream Output stream receiving the serialized bytes.
@@ -101,6 +317,42 @@ typedef struct move_info {
  */
 size_t write_dual_graph(const dual_graph *restrict dg, const frozen_hash_table *restrict fht, FILE *restrict stream);
 
+/**
+ * @brief Check the header and the section directory of a standalone serialized dual graph.
+ *
+ * Every section must lie within the file at its declared alignment. Problems are reported to stderr.
+ *
+ * @param buffer Start of the file.
+ * @param size Size of the file.
+ * @return True when the container is well formed.
+ */
+bool validate_dual_graph(const char *buffer, size_t size);
+
+/**
+ * @brief Variant of `validate_dual_graph()` for containers whose header is not at the start of the file, e.g. in bundles.
+ *
+ * @param buffer Start of the file. Section offsets are relative to it.
+ * @param size Size of the file.
+ * @param directory_offset Offset of the container header in the file.
+ * @return True when the header and the directory fit the file and the container is well formed.
+ */
+bool validate_dual_graph_at(const char *buffer, size_t size, size_t directory_offset);
+
+/** @brief Return the directory entry of a section of a validated dual graph or NULL when the section is absent. */
+const section_entry *find_dual_graph_section(const char *buffer, section_type type);
+
+/**
+ * @brief Rewrite a version 5 dual graph in the current format.
+ *
+ * Keyspace tables are recomputed from the root and the side table is left empty. Exits if the recomputed keyspace does not
+ * match the one used to write the file.
+ *
+ * @param buffer Contents of the version 5 file.
+ * @param stream Output stream.
+ * @return Number of bytes written.
+ */
+size_t convert_dual_graph_v5(char *buffer, FILE *restrict stream);
+
 /**
  * @brief Populate structured fields from the raw memory-mapped buffer.
  *
@@ -116,6 +368,52 @@ void unbuffer_dual_graph_reader(dual_graph_reader *dgr);
  */
 dual_graph_reader load_dual_graph_reader(const char *filename);
 
+/**
+ * @brief Load a dual graph reader selecting how the file is kept in RAM.
+ *
+ * With LOCKED_RESIDENCY the compressor, keyspace, tail offset, id block offset and side key sections are locked using
+ * `mlock()`. Failure to lock is reported but not fatal.
+ *
+ * @param filename Path to a serialized dual-graph file.
+ * @param policy Residency policy of the mapping.
+ * @return Reader backed by a memory-mapped file.
+ */
+dual_graph_reader load_dual_graph_reader_with_policy(const char *filename, residency_policy policy);
+
+/**
+ * @brief Load a dual graph reader without exiting on unreadable or malformed files.
+ *
+ * The file is validated against its size on disk before any section is used.
+ *
+ * @param filename Path to a serialized dual-graph file.
+ * @param policy Residency policy of the mapping.
+ * @param result Output reader, left unloaded on failure.
+ * @return True if the reader was loaded. On failure nothing stays mapped or open.
+ */
+bool try_load_dual_graph_reader_with_policy(const char *filename, residency_policy policy, dual_graph_reader *result);
+
+/** @brief Return the number of heap bytes owned by a reader excluding the memory map. */
+size_t dual_graph_reader_private_bytes(const dual_graph_reader *dgr);
+
+/** @brief Number of pages of one section and how many of them are resident in RAM. */
+typedef struct section_residency {
+  size_t num_pages;
+  size_t num_resident;
+} section_residency;
+
+/**
+ * @brief Report resident pages of each section using `mincore()`.
+ *
+ * Pages shared by neighboring sections are counted for both.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param residency Output array indexed by section_type. Absent sections report zero pages.
+ */
+void get_dual_graph_residency(const dual_graph_reader *dgr, section_residency residency[NUM_SECTION_TYPES]);
+
+/** @brief Print the residency of each section present in the file. */
+void print_dual_graph_residency(const dual_graph_reader *dgr);
+
 /**
  * @brief Look up the plain and forcing value bounds for a state.
  *
@@ -125,6 +423,18 @@ dual_graph_reader load_dual_graph_reader(const char *filename);
  */
 dual_value get_dual_graph_reader_value(const dual_graph_reader *dgr, const state *s);
 
+/**
+ * @brief Look up the plain and forcing Q7 value bounds for a state.
+ *
+ * The whole compensation search runs in fixed point. `get_dual_graph_reader_value()` converts this result with
+ * `table_value_to_value()` so the two never disagree.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param s State to evaluate.
+ * @return Plain and forcing Q7 value bounds for `s`.
+ */
+dual_table_value get_dual_graph_reader_table_value(const dual_graph_reader *dgr, const state *s);
+
 /**
  * @brief Compute annotated move information for a position.
  *
@@ -152,6 +462,12 @@ void unload_dual_graph_reader(dual_graph_reader *dgr);
  */
 dual_graph_reader *allocate_dual_graph_reader(const char *filename);
 
+/** @brief Allocate a dual graph reader with a residency policy for Python ctypes bindings. */
+dual_graph_reader *allocate_dual_graph_reader_with_policy(const char *filename, residency_policy policy);
+
+/** @brief Like `allocate_dual_graph_reader_with_policy()` but return NULL on unreadable or malformed files. */
+dual_graph_reader *try_allocate_dual_graph_reader_with_policy(const char *filename, residency_policy policy);
+
 /**
  * @brief Return raw move data for legacy Python integration helpers.
  *
@@ -165,23 +481,86 @@ stones_t *dual_graph_reader_python_stuff(dual_graph_reader *dgr, state *root, in
 /**
  * @brief Follow optimal play to a terminal state when repetitions are disallowed.
  *
+ * Forcing walks follow the terminal table deterministically when the reader carries one. Other walks break loops randomly.
+ *
  * @param dgr Loaded dual-graph reader.
  * @param origin Starting state.
  * @param ts Tactical scoring mode.
- * @return Terminal state reached under optimal play.
+ * @return Terminal state reached under optimal play. The origin if the tables admit no continuation.
  */
 state dual_graph_reader_low_terminal(dual_graph_reader *dgr, const state *origin, tactics ts);
 
 /**
  * @brief Follow optimal play to a terminal state when repetitions are allowed.
  *
+ * Forcing walks follow the terminal table deterministically when the reader carries one. Other walks break loops randomly.
+ *
  * @param dgr Loaded dual-graph reader.
  * @param origin Starting state.
  * @param ts Tactical scoring mode.
- * @return Terminal state reached under optimal play.
+ * @return Terminal state reached under optimal play. The origin if the tables admit no continuation.
  */
 state dual_graph_reader_high_terminal(dual_graph_reader *dgr, const state *origin, tactics ts);
 
+/**
+ * @brief Return the stones that are dead in both forcing terminals reached from a state.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param s State whose stones should be judged.
+ * @return Stones of `s` removed in both terminal states.
+ */
+stones_t dual_graph_reader_dead_stones(dual_graph_reader *dgr, const state *s);
+
+/**
+ * @brief Mutable per-thread state for queries on a shared reader.
+ *
+ * A loaded reader is immutable. Functions with the `_r` suffix keep all scratch state in the context so any number of
+ * threads may query the same reader concurrently as long as each thread owns its context. The functions without the
+ * suffix share the decoded id blocks of the reader and the global jkiss generator and must not run concurrently.
+ */
+typedef struct reader_context {
+  /** @brief Generator used to break loops when following optimal play. */
+  rng_state rng;
+  /** @brief Private cache of decoded id blocks, allocated as it fills. NULL unless the reader uses BLOCK_IDS. */
+  id_block_cache *id_blocks;
+} reader_context;
+
+/**
+ * @brief Create a context for querying `dgr` from one thread.
+ *
+ * @param dgr Loaded dual-graph reader. Must outlive the context.
+ * @param seed Seed of the context generator.
+ * Contexts of BLOCK_IDS readers cost a few words until used. The first lookup allocates an index of 8 bytes per id block
+ * and the decoded blocks grow up to the capacity of the reader cache, 2 MiB by default.
+ *
+ * @return Context owning its cache. Release with `free_reader_context()`.
+ */
+reader_context create_reader_context(const dual_graph_reader *dgr, unsigned long long seed);
+
+/** @brief Release the cache owned by a context. */
+void free_reader_context(reader_context *ctx);
+
+/** @brief Thread-safe variant of `get_dual_graph_reader_table_value()`. */
+dual_table_value get_dual_graph_reader_table_value_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s);
+
+/** @brief Thread-safe variant of `get_dual_graph_reader_value()`. */
+dual_value get_dual_graph_reader_value_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s);
+
+/** @brief Thread-safe variant of `dual_graph_reader_move_infos()`. */
+move_info *dual_graph_reader_move_infos_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s, int *num_move_infos);
+
+/** @brief Thread-safe variant of `dual_graph_reader_low_terminal()` drawing randomness from `ctx`. */
+state dual_graph_reader_low_terminal_r(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts);
+
+/** @brief Thread-safe variant of `dual_graph_reader_high_terminal()` drawing randomness from `ctx`. */
+state dual_graph_reader_high_terminal_r(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts);
+
+/** @brief Thread-safe variant of `dual_graph_reader_dead_stones()` drawing randomness from `ctx`. */
+stones_t dual_graph_reader_dead_stones_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s);
+
+/** @brief Allocate a reader context for Python ctypes bindings. */
+reader_context *allocate_reader_context(const dual_graph_reader *dgr, unsigned long long seed);
+
 /**
  * @brief Compare two dual_table_value instances. Compatible with `qsort()`.
  *
@@ -194,21 +573,171 @@ int compare_dual_table_values(const void *a_, const void *b_);
 /**
  * @brief Build a frozen hash table for `write_dual_graph()` without bulk_ids.
  *
+ * The id width is chosen to minimize the combined size of the packed ids, the bulk map and the tail.
+ *
  * @param dg Solved dual graph to compress.
  * @param num_unique Output parameter receiving the number of unique values.
  * @return Frozen hash table with the bulk map and tail sections initialized.
  */
 frozen_hash_table prepare_frozen_hash(const dual_graph *dg, size_t *num_unique);
 
+/** @brief Return the number of tail offsets stored for a table of `size` keys with `tail_size` tail entries. */
+size_t frozen_tail_offsets_size(size_t size, size_t tail_size);
+
+/** @brief Return the number of words in the stored key bitmap of a pruned table over `size` keys. */
+size_t stored_keys_size(size_t size);
+
+/** @brief Return the rank of a key among the stored keys of a pruned table or SIZE_MAX if its value is not stored. */
+size_t stored_key_rank(const frozen_hash_table *fht, size_t key);
+
+/** @brief Return the number of 64-bit words holding `size` packed ids of `width` bits. */
+size_t frozen_ids_size(size_t size, int width);
+
+/** @brief Store a dense id in a bit-packed id array. */
+void set_frozen_hash_id(uint64_t *bulk_ids, int width, size_t key, value_id_t id);
+
+/** @brief Extract the dense id of a key from the bit-packed id array without branching. */
+value_id_t get_frozen_hash_id(const frozen_hash_table *fht, size_t key);
+
 /**
  * @brief Look up a dual-table value by original graph key.
  *
+ * Tail lookups touch one tail offset and at most one bucket of `bulk_ids`. Decodes into the shared block cache of `fht`
+ * with BLOCK_IDS so it is not thread-safe then.
+ *
  * @param fht Frozen hash table to query.
  * @param key Original graph key.
  * @return Stored dual-table value for `key`.
  */
 dual_table_value get_frozen_hash_value(const frozen_hash_table *fht, size_t key);
 
+/**
+ * @brief Materialize the values of ko and atari children of every state in a solved graph.
+ *
+ * Reuses the entries of the side table of the graph when it has one. The values agree with `get_dual_graph_reader_value()`
+ * on a reader loaded from the same graph. Mock graphs produce an empty table.
+ *
+ * @param dg Solved dual graph.
+ * @return Side table owning its arrays. Release with `free_side_table()`.
+ */
+side_table prepare_side_table(const dual_graph *dg);
+
+/**
+ * @brief Annotate the moves of every keyspace state of a loaded reader.
+ *
+ * `dual_graph_reader_move_infos()` answers from the table with a single lookup when the reader carries it. Pruned readers
+ * only annotate their stored keys. Symmetric and mock keyspaces produce an empty table.
+ *
+ * @param dgr Loaded dual-graph reader without a move table.
+ * @return Move table owning its arrays. Release with `free_move_table()`.
+ */
+move_table prepare_move_table(const dual_graph_reader *dgr);
+
+/**
+ * @brief Serialize a loaded dual graph together with a move table.
+ *
+ * The sections of `dgr` are copied verbatim and any earlier move table is replaced.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param mt Move table built by `prepare_move_table()` for the same graph.
+ * @param stream Output stream receiving the serialized bytes.
+ * @return Number of bytes written.
+ */
+size_t write_dual_graph_with_move_table(const dual_graph_reader *dgr, const move_table *mt, FILE *restrict stream);
+
+/** @brief Release the arrays of a move table built by `prepare_move_table()`. */
+void free_move_table(move_table *mt);
+
+/**
+ * @brief Resolve the forcing terminal tracks of every keyspace state of a loaded reader.
+ *
+ * Sweeps the keyspace in parallel until no distance improves. Each step keeps the first move of minimal distance, so the table
+ * does not depend on the number of threads. States that only reach resolution through longer detours of ko, atari or
+ * pass states than MAX_COMPENSATION_DEPTH stay unresolved and fall back to the randomized walk. Pruned readers only resolve
+ * their stored keys. Symmetric and mock keyspaces produce an empty table.
+ *
+ * @param dgr Loaded dual-graph reader without a terminal table.
+ * @param verbose Report progress of each sweep.
+ * @return Terminal table owning its array. Release with `free_terminal_table()`.
+ */
+terminal_table prepare_terminal_table(const dual_graph_reader *dgr, bool verbose);
+
+/**
+ * @brief Serialize a loaded dual graph together with a terminal table.
+ *
+ * The sections of `dgr` are copied verbatim and any earlier terminal table is replaced.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param tt Terminal table built by `prepare_terminal_table()` for the same graph.
+ * @param stream Output stream receiving the serialized bytes.
+ * @return Number of bytes written.
+ */
+size_t write_dual_graph_with_terminal_table(const dual_graph_reader *dgr, const terminal_table *tt, FILE *restrict stream);
+
+/** @brief Release the array of a terminal table built by `prepare_terminal_table()`. */
+void free_terminal_table(terminal_table *tt);
+
+/**
+ * @brief Collect the values looked up by queries near a set of origins.
+ *
+ * Every state within `plies` moves of an origin is evaluated together with its children so that both values and move hints
+ * of the region are answered from the table.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param origins States to expand, typically the tsumegos of the collection.
+ * @param num_origins Number of origins.
+ * @param plies Depth of the region in moves.
+ * @return Hot table owning its slots. Release with `free_hot_table()`.
+ */
+hot_table prepare_hot_table(const dual_graph_reader *dgr, const state *origins, size_t num_origins, int plies);
+
+/** @brief Look up a key in a hot table. Returns false when the key is absent. */
+bool get_hot_table_value(const hot_table *ht, size_t key, dual_table_value *v);
+
+/**
+ * @brief Serialize a loaded dual graph together with a hot table.
+ *
+ * The sections of `dgr` are copied verbatim and any earlier hot table is replaced.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param ht Hot table built by `prepare_hot_table()` for the same graph.
+ * @param stream Output stream receiving the serialized bytes.
+ * @return Number of bytes written.
+ */
+size_t write_dual_graph_with_hot_table(const dual_graph_reader *dgr, const hot_table *ht, FILE *restrict stream);
+
+/** @brief Release the slots of a hot table built by `prepare_hot_table()`. */
+void free_hot_table(hot_table *ht);
+
+/**
+ * @brief Serialize only the values that can be reached by play from a set of origins.
+ *
+ * The closure follows every legal move of both players and records every key that a value, move hint or dead stone query on a
+ * reachable state looks up. Those values are stored by rank of their key so answers stay identical for every reachable query
+ * while the rest of the keyspace is dropped. The keys are indexed by a ranked bitmap over the keyspace or by a sorted list,
+ * whichever is smaller. The side table keeps the ko and atari states of the closure. Move and terminal tables of `dgr` are not
+ * copied. Prepare them from the pruned reader so that they only cover the stored keys.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param origins States to expand, typically the tsumegos of the collection.
+ * @param num_origins Number of origins.
+ * @param stream Output stream receiving the serialized bytes.
+ * @return Number of bytes written.
+ */
+size_t write_pruned_dual_graph(const dual_graph_reader *dgr, const state *origins, size_t num_origins, FILE *restrict stream);
+
+/**
+ * @brief Check that a client state can be looked up from a reader.
+ *
+ * Tsumegos may trim the areas of the root but never extend them. External liberties and ko threats must fit the keyspace and
+ * the stones of states outside atari must be stored in it. Lookups of other states read arbitrary or out of range keys.
+ *
+ * @param dgr Loaded dual-graph reader.
+ * @param s Game state provided by the client.
+ * @return True if the state is legal and belongs to the root of the reader.
+ */
+bool is_reader_state(const dual_graph_reader *dgr, const state *s);
+
 /**
  * @brief Normalize client state for internal consumption.
  *
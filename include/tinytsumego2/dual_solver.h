@@ -2,7 +2,9 @@
 #include "tinytsumego2/keyspace.h"
 #include "tinytsumego2/scoring.h"
 #include "tinytsumego2/state.h"
+#include "tinytsumego2/util.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @file dual_solver.h
@@ -19,6 +21,36 @@
  */
 typedef enum { COMPRESSED_KEYSPACE, SYMMETRIC_KEYSPACE, MOCK_KEYSPACE } keyspace_type;
 
+/** @brief Plain and forcing Q7 value bounds for one state. */
+typedef struct dual_table_value {
+  table_value plain;
+  table_value forcing;
+} dual_table_value;
+
+/** @brief Key of the empty slots of a side table. */
+#define SIDE_EMPTY_KEY (SIZE_MAX)
+
+/**
+ * @brief Open-addressing map from side keys to fully compensated values.
+ *
+ * Keyspaces exclude states with an active ko, previous passes or the target in atari. Values of such states are normally
+ * recovered by a shallow negamax. The side table materializes those results for the ko and atari children of keyspace states.
+ * Linear probing over a power-of-two number of slots that are at most three quarters full.
+ *
+ * States after a pass are not stored. There is one of them for every keyspace state and they only cost a single ply of table
+ * lookups.
+ */
+typedef struct side_table {
+  /** @brief Number of entries. */
+  size_t size;
+  /** @brief Number of slots. Zero when the table is absent. */
+  size_t num_slots;
+  /** @brief Side keys as produced by `side_key()` or SIDE_EMPTY_KEY. */
+  size_t *keys;
+  /** @brief Q7 values associated with `keys`. */
+  dual_table_value *values;
+} side_table;
+
 /**
  * @brief Implicit game graph storing both plain and forcing values.
  *
@@ -45,6 +77,13 @@ typedef struct dual_graph {
   /** @brief Forcing tactical values indexed by compressed or symmetric keys. */
   table_value *forcing_values;
 
+  /**
+   * @brief Optional values of the ko and atari children of keyspace states. Assign from `create_side_table()`.
+   *
+   * Sweeps refresh every entry once and look children up instead of compensating for each of their parents.
+   */
+  side_table side_table;
+
   /** @brief Convert a state to the key type used by this graph. */
   size_t (*to_key)(struct dual_graph *dg, const state *s);
   /** @brief Recover a state from a compressed key. */
@@ -70,6 +109,73 @@ typedef struct dual_graph {
   table_value batch_forcing[BATCH_SIZE];
 } dual_graph;
 
+/** @brief Test whether the single target chain of the player is in atari. Faster than `target_in_atari()`. */
+bool in_atari_single(const state *s);
+
+/** @brief Test whether the single target chain of the opponent can be captured. Faster than `target_capturable()`. */
+bool can_take_single(const state *s);
+
+/** @brief Predicate for positions without targets. Always false. */
+bool there_is_no_target(const state *s);
+
+/**
+ * @brief Pick the cheapest target predicates that are exact for every descendant of `root`.
+ *
+ * @param root Root state whose target chains are counted.
+ * @param in_atari Output parameter receiving the replacement for `target_in_atari()`.
+ * @param can_take Output parameter receiving the replacement for `target_capturable()`.
+ */
+void select_target_predicates(const state *root, bool (**in_atari)(const state *s), bool (**can_take)(const state *s));
+
+/**
+ * @brief Encode a state excluded from the keyspace as a side-table key.
+ *
+ * Symmetric keyspaces encode the canonical orientation of the stones and the ko point.
+ *
+ * @param type Type of the keyspace.
+ * @param ks Compressed or symmetric keyspace of the root.
+ * @param s Child state of the root with an active ko or the target in atari but no previous passes.
+ * @return Key combining the fast key of the stones with the button and the ko point.
+ */
+size_t side_key(keyspace_type type, const abstract_keyspace *ks, const state *s);
+
+/** @brief Recover a state from a key produced by `side_key()`. */
+state from_side_key(keyspace_type type, const abstract_keyspace *ks, size_t key);
+
+/**
+ * @brief Collect the ko and atari children of every keyspace state of a graph.
+ *
+ * Children of parents that hand over the button to the opponent are included for the benefit of readers. Values are left at
+ * the full range until the first sweep refreshes them. Mock graphs produce an empty table.
+ *
+ * @param dg Dual graph. Its values are not used.
+ * @return Side table owning its arrays. Release with `free_side_table()` or by assigning it to the graph.
+ */
+side_table create_side_table(const dual_graph *dg);
+
+/**
+ * @brief Look up a materialized value.
+ *
+ * @param st Side table to query.
+ * @param key Side key of the state.
+ * @param v Output parameter receiving the value when found.
+ * @return True when the key is present.
+ */
+bool get_side_table_value(const side_table *st, size_t key, dual_table_value *v);
+
+/**
+ * @brief Copy the entries of a side table whose keys are listed.
+ *
+ * @param st Side table to copy from.
+ * @param keys Distinct side keys to keep. Keys missing from `st` are skipped.
+ * @param num_keys Number of keys.
+ * @return Side table owning its arrays. Release with `free_side_table()`.
+ */
+side_table subset_side_table(const side_table *st, const size_t *keys, size_t num_keys);
+
+/** @brief Release the arrays of a side table. */
+void free_side_table(side_table *st);
+
 /** @brief Print the contents of a dual game graph. */
 void print_dual_graph(dual_graph *dg);
 
@@ -82,9 +188,12 @@ dual_graph *allocate_dual_graph(const state *root, keyspace_type type);
 /** @brief Look up the solved value range of a state using the selected tactics. */
 value get_dual_graph_value(dual_graph *dg, const state *s, tactics ts);
 
-/** @brief Follow optimal play to a terminal state when repetitions are disallowed. */
+/** @brief Follow optimal play to a terminal state when repetitions are disallowed. Breaks loops using the global jkiss generator. */
 state dual_graph_low_terminal(dual_graph *dg, const state *origin, tactics ts);
 
+/** @brief Variant of `dual_graph_low_terminal()` that breaks loops using a caller-owned generator. */
+state dual_graph_low_terminal_r(dual_graph *dg, rng_state *rng, const state *origin, tactics ts);
+
 /** @brief Follow optimal play to a terminal state when repetitions are allowed. */
 state dual_graph_high_terminal(dual_graph *dg, const state *origin, tactics ts);
 
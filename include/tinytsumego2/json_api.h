@@ -0,0 +1,114 @@
+#pragma once
+#include "tinytsumego2/collection.h"
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/state.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @file json_api.h
+ * @brief JSON documents of the tsumego HTTP API.
+ *
+ * Output is byte-for-byte identical to `json.dumps()` of the Python bridge without the trailing newline. Stones are
+ * written as arrays of row bitmasks starting from the top row.
+ */
+
+/** @brief Maximum length of a state address including the terminating zero. */
+#define STATE_ADDRESS_SIZE (8 * 17 + 4 * 12 + 1)
+
+/** @brief Outcome of parsing the body of a move request. */
+typedef enum move_request_status {
+  /** @brief The state was parsed. */
+  MOVE_REQUEST_OK,
+  /** @brief The body is not valid JSON. */
+  MALFORMED_JSON,
+  /** @brief The body has no "state" member. */
+  MISSING_STATE,
+  /** @brief The "state" member lacks a field or has a field of the wrong type. */
+  INVALID_STATE,
+} move_request_status;
+
+/** @brief Write a number the way Python formats the `repr()` of a float. */
+void write_json_float(FILE *stream, double x);
+
+/** @brief Write a UTF-8 string as a quoted JSON string with non-ASCII characters escaped. */
+void write_json_string(FILE *stream, const char *str);
+
+/** @brief Write stones as an array of row bitmasks. */
+void write_stones_json(FILE *stream, stones_t stones, bool wide);
+
+/** @brief Write a state in the format accepted by `parse_move_request()`. */
+void write_state_json(FILE *stream, const state *s);
+
+/** @brief Write the `{"moves": [...]}` response to a move request. */
+void write_move_infos_json(FILE *stream, const move_info *move_infos, int num_move_infos);
+
+/** @brief Write the `{"deadStones": [...]}` response to a move request after two passes. */
+void write_dead_stones_json(FILE *stream, stones_t dead_stones, bool wide);
+
+/**
+ * @brief Write the response to a move request for a state.
+ *
+ * States after two passes are answered with dead stones and all others with move hints.
+ *
+ * @param stream Output stream.
+ * @param cache Response cache shared by all collections.
+ * @param dgr Reader of the collection.
+ * @param ctx Context of the calling thread or NULL to use the shared context of the reader.
+ * @param s Requested state.
+ */
+void write_state_response_json(FILE *stream, response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s);
+
+/** @brief Write an `{"error": ...}` response. */
+void write_error_json(FILE *stream, const char *message);
+
+/**
+ * @brief Write the listing of collections.
+ *
+ * @param stream Output stream.
+ * @param collections Collections to list.
+ * @param num_collections Number of collections.
+ * @param deep List the slugs of the tsumegos instead of the titles of the collections.
+ */
+void write_collections_json(FILE *stream, const collection *collections, size_t num_collections, bool deep);
+
+/** @brief Write the title, root and tsumego subtitles of a collection. */
+void write_collection_json(FILE *stream, const collection *c);
+
+/** @brief Write one tsumego of a collection. */
+void write_tsumego_json(FILE *stream, const collection *c, const tsumego *t);
+
+/**
+ * @brief Parse the state of a move request body of the form `{"state": {...}}`.
+ *
+ * @param body Request body. Need not be zero-terminated.
+ * @param length Length of the body in bytes.
+ * @param wide Whether stones use the 16-column board layout of the collection.
+ * @param s Output parameter receiving the state.
+ * @return MOVE_REQUEST_OK or the reason the body was rejected.
+ */
+move_request_status parse_move_request(const char *body, size_t length, bool wide, state *s);
+
+/**
+ * @brief Format the address of a state used to name its precomputed response.
+ *
+ * The address lists the stones in hexadecimal followed by passes, ko threats, button and turn in decimal, all separated by
+ * underscores. Every state has exactly one address.
+ *
+ * @param s State to address.
+ * @param address Output buffer of STATE_ADDRESS_SIZE bytes.
+ */
+void format_state_address(const state *s, char *address);
+
+/**
+ * @brief Parse an address produced by `format_state_address()`.
+ *
+ * @param address Address. Need not be zero-terminated.
+ * @param length Length of the address in bytes.
+ * @param wide Whether stones use the 16-column board layout of the collection.
+ * @param s Output parameter receiving the state.
+ * @return True if the address is the address of the parsed state.
+ */
+bool parse_state_address(const char *address, size_t length, bool wide, state *s);
@@ -74,11 +74,16 @@ typedef struct symmetric_keyspace {
   monotonic_compressor compressor;
 
   symmetry symmetry;
+  /** @brief Two when the root has fixed stones and keys must track the side to move, otherwise one. */
+  size_t color_m;
 } symmetric_keyspace;
 
 /** @brief Function pointer type used to mark keys that should be retained. */
 typedef bool (*indicator_f)(const size_t key);
 
+/** @brief Function pointer type used to mark 64 consecutive keys at once. Bit `i` corresponds to key `first + i`. */
+typedef unsigned long long (*mask_indicator_f)(const size_t first);
+
 /** @brief Create a tight keyspace helper for a given root state. */
 tight_keyspace create_tight_keyspace(const state *root, const bool symmetric_threats);
 
@@ -91,12 +96,50 @@ state from_tight_key_fast(const tight_keyspace *tks, size_t key);
 /** @brief Release allocations owned by a tight keyspace. */
 void free_tight_keyspace(tight_keyspace *tks);
 
+/**
+ * @brief Serialize a tight keyspace including its lookup tables.
+ *
+ * Tables are padded to TABLE_ALIGNMENT relative to the start of the stream so that they can be mapped in place.
+ *
+ * @param tks Tight keyspace to serialize.
+ * @param offset Number of bytes already written to the stream.
+ * @param stream Output stream.
+ * @return Number of bytes written.
+ */
+size_t write_tight_keyspace(const tight_keyspace *restrict tks, size_t offset, FILE *restrict stream);
+
+/** @brief Approximate number of bytes `write_tight_keyspace()` stores for a root without building the tables. */
+size_t tight_keyspace_bytes(const state *root, const bool symmetric_threats);
+
+/**
+ * @brief Point a tight keyspace to tables serialized by `write_tight_keyspace()` without copying them.
+ *
+ * @param tks Tight keyspace to initialize. Release using `unmap_tight_keyspace()`.
+ * @param map Cursor into the mapped file.
+ * @param base Start of the mapped file.
+ * @return Cursor advanced past the keyspace.
+ */
+char *map_tight_keyspace(tight_keyspace *tks, char *map, const char *base);
+
+/** @brief Release the small allocations of a tight keyspace initialized by `map_tight_keyspace()`. */
+void unmap_tight_keyspace(tight_keyspace *tks);
+
+/** @brief Return true when a simple state belongs in compressed and symmetric keyspaces. */
+bool is_keyspace_state(const state *s);
+
 /** @brief Construct a compressed keyspace that stores only legal game states. */
 compressed_keyspace create_compressed_keyspace(const state *root);
 
 /** @brief Build a compressor for a monotonic sequence with legal membership indicated by the second argument. */
 monotonic_compressor create_monotonic_compressor(size_t num_keys, indicator_f indicator);
 
+/**
+ * @brief Build a compressor from membership masks of 64 consecutive keys.
+ *
+ * The masks are evaluated in parallel. Bits beyond `num_keys` are ignored.
+ */
+monotonic_compressor create_monotonic_compressor_64(size_t num_keys, mask_indicator_f indicator);
+
 /** @brief Compress a key by skipping entries that were not indicated. */
 size_t compress_key(const monotonic_compressor *mc, const size_t key);
 
@@ -124,6 +167,13 @@ bool was_compressed_legal(const compressed_keyspace *cks, size_t key);
 /** @brief Release allocations owned by a compressed keyspace. */
 void free_compressed_keyspace(compressed_keyspace *cks);
 
+/**
+ * @brief Set up the symmetry and fast keys of a symmetric keyspace without compressing it.
+ *
+ * Only the fast-key functions are usable on the result. Release with `free_symmetric_keyspace()`.
+ */
+symmetric_keyspace prepare_symmetric_keyspace(const state *root);
+
 /** @brief Construct a symmetry-reduced keyspace of legal canonical states. */
 symmetric_keyspace create_symmetric_keyspace(const state *root);
 
@@ -133,6 +183,22 @@ size_t to_symmetric_key(const symmetric_keyspace *sks, const state *s);
 /** @brief Recover a canonical state from its compressed index. */
 state from_symmetric_key(const symmetric_keyspace *sks, size_t key);
 
+/** @brief Return true when the stones of a child state of the root form a legal canonical state of the keyspace. */
+bool has_symmetric_key(const symmetric_keyspace *sks, const state *s);
+
+/**
+ * @brief Fast key of a child state of the root that also distinguishes its ko point.
+ *
+ * Stones that are symmetric about the core can have several keys. The mirror image with the smallest key and ko point is used
+ * so that every orientation of the state agrees.
+ *
+ * @param sks Symmetric keyspace of the root.
+ * @param s Child state of the root.
+ * @param ko Output parameter receiving the ko point in the orientation of the returned key.
+ * @return Fast key of the chosen mirror image.
+ */
+size_t to_fast_ko_key(const symmetric_keyspace *sks, const state *s, stones_t *ko);
+
 /** @brief Release allocations owned by a symmetric keyspace. */
 void free_symmetric_keyspace(symmetric_keyspace *sks);
 
@@ -0,0 +1,107 @@
+#pragma once
+#include "tinytsumego2/dual_solver.h"
+#include "tinytsumego2/state.h"
+#include <stdbool.h>
+
+/**
+ * @file planner.h
+ * @brief Cheap up-front estimates for choosing a keyspace before solving.
+ */
+
+/** @brief Default number of stone arrangements sampled per keyspace type. */
+#define PLANNER_NUM_SAMPLES (4096)
+
+/** @brief Default relative cost of expanding a node of a compressed keyspace. */
+#define PLANNER_COMPRESSED_NODE_COST (1.0)
+
+/**
+ * @brief Default relative cost of expanding a node of a symmetric keyspace.
+ *
+ * Canonicalizing symmetric keys measured 1.4 to 4 times slower than tight keys on the public collections.
+ */
+#define PLANNER_SYMMETRIC_NODE_COST (3.0)
+
+/** @brief Assumed number of bits per packed value id. The public collections use 7 to 10. */
+#define PLANNER_ID_WIDTH (10)
+
+/** @brief Assumed number of distinct move records per key. The public collections have 0.08 to 0.13. */
+#define PLANNER_MOVE_RECORD_FRACTION (0.125)
+
+/** @brief Parameters of `plan_keyspace()`. */
+typedef struct planner_options {
+  /** @brief Number of bytes available for solving. */
+  size_t ram_budget;
+  /** @brief Relative cost of expanding a node indexed by `keyspace_type`. */
+  double node_costs[MOCK_KEYSPACE];
+  /** @brief Number of stone arrangements to sample per keyspace type. */
+  int num_samples;
+} planner_options;
+
+/** @brief Estimated costs of solving and serving a root with one keyspace type. */
+typedef struct keyspace_estimate {
+  /** @brief Keyspace type being estimated. */
+  keyspace_type type;
+  /** @brief False when the root cannot be represented using this type. */
+  bool supported;
+  /** @brief Number of raw fast keys enumerated by each sweep. Counted up to symmetry and thus slightly low for symmetric ones. */
+  size_t raw_size;
+  /** @brief Estimated fraction of raw keys that are stored. */
+  double legal_density;
+  /** @brief Estimated number of stored nodes. */
+  size_t num_nodes;
+  /** @brief Estimated RAM used by `create_dual_graph()` and its sweeps. */
+  size_t solver_bytes;
+  /** @brief Approximate bytes of the keyspace compressor and tables. Stored with every layout. */
+  size_t keyspace_bytes;
+  /** @brief Estimated bytes of bit-packed value ids assuming PLANNER_ID_WIDTH bits per id. */
+  size_t packed_id_bytes;
+  /** @brief Estimated bytes of block-compressed value ids assuming they compress no better than packed ids. */
+  size_t block_id_bytes;
+  /** @brief Upper bound on the bytes of the side table. Zero for symmetric keyspaces. */
+  size_t side_bytes;
+  /** @brief Estimated bytes of the optional move table. Zero for symmetric keyspaces. */
+  size_t move_table_bytes;
+  /** @brief Bytes of the optional terminal table. Zero for symmetric keyspaces. */
+  size_t terminal_table_bytes;
+  /** @brief Estimated size of the file written by `write_dual_graph()` with packed ids and without optional tables. */
+  size_t reader_bytes;
+  /** @brief Deterministic cost of one sweep in units of compressed child expansions. Used to compare keyspace types. */
+  double sweep_cost;
+  /** @brief Wall-clock seconds for one sweep extrapolated from timed child expansions and the node cost. Only reported. */
+  double sweep_seconds;
+} keyspace_estimate;
+
+/** @brief Report comparing every keyspace type for a root. */
+typedef struct keyspace_plan {
+  /** @brief RAM budget the plan was made for. */
+  size_t ram_budget;
+  /** @brief Estimates indexed by `keyspace_type`. */
+  keyspace_estimate estimates[MOCK_KEYSPACE];
+  /** @brief Recommended keyspace type. */
+  keyspace_type choice;
+  /** @brief False when not even the smallest supported keyspace fits the budget. */
+  bool fits;
+} keyspace_plan;
+
+/** @brief Return the amount of physical RAM on this machine in bytes. */
+size_t physical_ram();
+
+/** @brief Return options that budget all physical RAM and use the default node costs and sample count. */
+planner_options default_planner_options();
+
+/**
+ * @brief Estimate keyspace sizes, memory footprints and sweep times without building any keyspace tables.
+ *
+ * Legal densities are sampled from random stone arrangements of the root. Table sizes follow from the shape of the root.
+ *
+ * The supported keyspace with the lowest sweep cost that fits the budget is chosen. If none fit the smallest one is chosen
+ * instead. The choice does not depend on timings.
+ *
+ * @param root Root state to plan for.
+ * @param options Budget, node costs and sample count.
+ * @return Plan with one estimate per keyspace type.
+ */
+keyspace_plan plan_keyspace(const state *root, const planner_options *options);
+
+/** @brief Print a human-readable planner report. */
+void print_keyspace_plan(const keyspace_plan *plan);
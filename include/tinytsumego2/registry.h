@@ -0,0 +1,98 @@
+#pragma once
+#include "tinytsumego2/dual_reader.h"
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @file registry.h
+ * @brief Thread-safe registry of dual graph readers loaded on demand and evicted in least recently used order.
+ */
+
+/** @brief One collection known to a registry. */
+typedef struct registry_entry {
+  /** @brief Identifier used to look up the reader. */
+  char *slug;
+  /** @brief Path to the serialized dual graph. */
+  char *filename;
+  /** @brief Loaded reader or NULL. */
+  dual_graph_reader *reader;
+  /** @brief Heap bytes owned by the loaded reader. */
+  size_t private_bytes;
+  /** @brief Number of outstanding `acquire_reader()` calls without a matching `release_reader()`. */
+  size_t num_users;
+  /** @brief Registry clock at the last acquisition or release. */
+  size_t last_used;
+} registry_entry;
+
+/**
+ * @brief Readers by slug with bounded residency.
+ *
+ * Readers in use are never evicted so the limits may be exceeded temporarily when every loaded reader is in use.
+ */
+typedef struct reader_registry {
+  /** @brief Number of registered collections. */
+  size_t num_entries;
+  /** @brief Registered collections. */
+  registry_entry *entries;
+
+  /** @brief Maximum number of loaded readers. Zero for no limit. */
+  size_t max_readers;
+  /** @brief Maximum number of heap bytes owned by loaded readers. Zero for no limit. */
+  size_t max_bytes;
+
+  /** @brief Number of loaded readers. */
+  size_t num_loaded;
+  /** @brief Heap bytes owned by loaded readers. */
+  size_t loaded_bytes;
+  /** @brief Incremented on every acquisition and release. */
+  size_t clock;
+
+  /** @brief Number of acquisitions of loaded readers. */
+  size_t hits;
+  /** @brief Number of acquisitions that loaded a reader. */
+  size_t misses;
+  /** @brief Number of readers unloaded to respect the limits. */
+  size_t evictions;
+  /** @brief Number of acquisitions that failed because the file was unreadable or malformed. */
+  size_t failures;
+
+  /** @brief Guards all fields above. */
+  pthread_mutex_t mutex;
+} reader_registry;
+
+/** @brief Create an empty registry. Release with `free_reader_registry()`. */
+reader_registry create_reader_registry(size_t max_readers, size_t max_bytes);
+
+/** @brief Register a serialized dual graph under a slug without loading it. */
+void register_reader(reader_registry *registry, const char *slug, const char *filename);
+
+/**
+ * @brief Register every `.bin` file of a folder using the file name without extension as the slug.
+ *
+ * @return Number of registered files.
+ */
+size_t register_reader_folder(reader_registry *registry, const char *path);
+
+/** @brief Return true if a collection with the given slug has been registered. */
+bool is_registered(reader_registry *registry, const char *slug);
+
+/**
+ * @brief Return the reader of a slug, loading it and evicting idle readers as necessary.
+ *
+ * The reader stays loaded until released. Loading happens while holding the registry lock. The file is validated
+ * against its size on disk so an unreadable or malformed file fails the acquisition instead of terminating the process.
+ *
+ * @param registry Registry to query.
+ * @param slug Slug of the collection.
+ * @return Reader or NULL if the slug is not registered or its file could not be loaded.
+ */
+dual_graph_reader *acquire_reader(reader_registry *registry, const char *slug);
+
+/** @brief Mark a reader returned by `acquire_reader()` as no longer in use. */
+void release_reader(reader_registry *registry, const dual_graph_reader *reader);
+
+/** @brief Unload all readers and release the registry. No reader may be in use. */
+void free_reader_registry(reader_registry *registry);
+
+/** @brief Allocate a registry for Python ctypes bindings. */
+reader_registry *allocate_reader_registry(size_t max_readers, size_t max_bytes);
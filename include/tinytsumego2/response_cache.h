@@ -0,0 +1,144 @@
+#pragma once
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/symmetry.h"
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @file response_cache.h
+ * @brief Thread-safe cache of move hints and dead stones keyed by normalized states up to symmetry.
+ *
+ * Queries are normalized with `strip_aesthetics()` and brought to the least of their mirror images snapped to the
+ * upper-left corner. Responses are stored in that canonical frame and mapped back to the frame of each query.
+ *
+ * The key is the full state including its geometry so a single cache may serve every collection.
+ */
+
+/** @brief Default number of responses kept by the server. */
+#define RESPONSE_CACHE_CAPACITY (65536)
+
+/** @brief Kind of a cached response. */
+typedef enum response_kind {
+  /** @brief Result of `dual_graph_reader_move_infos()`. */
+  MOVE_INFOS_RESPONSE,
+  /** @brief Result of `cached_dead_stones()`. */
+  DEAD_STONES_RESPONSE,
+} response_kind;
+
+/** @brief One cached response in the canonical frame of its key. */
+typedef struct cached_response {
+  /** @brief Kind of the response. */
+  response_kind kind;
+  /** @brief Canonical normalized state. */
+  state key;
+  /** @brief Number of annotated moves. */
+  int num_move_infos;
+  /** @brief Annotated moves as stones in the canonical frame. */
+  stones_t *moves;
+  /** @brief Move annotations. Coordinates are not used. */
+  move_info *move_infos;
+  /** @brief Dead stones in the canonical frame. */
+  stones_t dead_stones;
+  /** @brief Next slot in the same hash bucket or SIZE_MAX. */
+  size_t next;
+  /** @brief Next more recently used slot or SIZE_MAX. */
+  size_t newer;
+  /** @brief Next less recently used slot or SIZE_MAX. */
+  size_t older;
+} cached_response;
+
+/** @brief Snapshot of the counters of a response cache. */
+typedef struct response_cache_stats {
+  /** @brief Number of cached responses. */
+  size_t size;
+  /** @brief Maximum number of cached responses. */
+  size_t capacity;
+  /** @brief Number of queries answered from the cache. */
+  size_t hits;
+  /** @brief Number of queries answered by the reader. */
+  size_t misses;
+  /** @brief Number of responses dropped to make room. */
+  size_t evictions;
+} response_cache_stats;
+
+/**
+ * @brief Bounded cache of responses evicted in least recently used order.
+ *
+ * Misses are resolved without holding the lock so concurrent queries only serialize on the lookup.
+ */
+typedef struct response_cache {
+  /** @brief Maximum number of cached responses. */
+  size_t capacity;
+  /** @brief Number of slots in use. */
+  size_t num_used;
+  /** @brief Response slots. */
+  cached_response *slots;
+  /** @brief Number of hash buckets. A power of two. */
+  size_t num_buckets;
+  /** @brief First slot of each hash bucket or SIZE_MAX. */
+  size_t *buckets;
+  /** @brief Most recently used slot. */
+  size_t newest;
+  /** @brief Least recently used slot. */
+  size_t oldest;
+
+  /** @brief Number of queries answered from the cache. */
+  size_t hits;
+  /** @brief Number of queries answered by the reader. */
+  size_t misses;
+  /** @brief Number of responses dropped to make room. */
+  size_t evictions;
+
+  /** @brief Guards all fields above. */
+  pthread_mutex_t mutex;
+} response_cache;
+
+/** @brief Create an empty cache holding at most `capacity` responses. Release with `free_response_cache()`. */
+response_cache create_response_cache(size_t capacity);
+
+/**
+ * @brief Return the least mirror image of a state snapped to the upper-left corner.
+ *
+ * @param s Legal state.
+ * @param op Output parameter receiving the mirror operations applied after snapping `s`.
+ * @return Canonical state.
+ */
+state canonical_state(const state *s, mirror_op_t *op);
+
+/**
+ * @brief Cached equivalent of `dual_graph_reader_move_infos()`.
+ *
+ * @param cache Cache to query.
+ * @param dgr Loaded dual-graph reader.
+ * @param ctx Context of the calling thread or NULL to use the shared context of the reader.
+ * @param s State whose moves should be annotated.
+ * @param num_move_infos Output parameter receiving the number of annotated moves.
+ * @return Newly allocated move-info array owned by the caller in the same order as the uncached function.
+ */
+move_info *cached_move_infos(response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s,
+                             int *num_move_infos);
+
+/**
+ * @brief Find the stones that are dead under both low and high forcing play.
+ *
+ * Stones are judged in the normalized state so aesthetic stones are never reported.
+ *
+ * @param cache Cache to query.
+ * @param dgr Loaded dual-graph reader.
+ * @param ctx Context of the calling thread or NULL to use the shared context of the reader.
+ * @param s State after the game has ended. Passes, ko and ko threats should already be cleared.
+ * @return Dead stones in the frame of `s`.
+ */
+stones_t cached_dead_stones(response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s);
+
+/** @brief Return a consistent snapshot of the cache counters. */
+response_cache_stats get_response_cache_stats(response_cache *cache);
+
+/** @brief Print the cache counters and the hit rate. */
+void print_response_cache_stats(response_cache *cache);
+
+/** @brief Release all cached responses and the cache. No query may be in progress. */
+void free_response_cache(response_cache *cache);
+
+/** @brief Allocate a cache for Python ctypes bindings. */
+response_cache *allocate_response_cache(size_t capacity);
@@ -156,6 +156,9 @@ int compensated_liberty_score(const state *s);
 /** @brief Count simple area without removing dead stones. */
 int simple_area_score(const state *s);
 
+/** @brief Return the stones of `s` that are surrounded by the other color in `terminal`. */
+stones_t dead_stones(const state *s, const state *terminal);
+
 /** @brief Return true when two game states are identical. */
 bool equals(const state *a, const state *b);
 
@@ -185,6 +188,19 @@ move_result normalize_immortal_regions(state *root, state *s);
 /** @brief Return true when the state satisfies legality constraints, including no chain without liberties. */
 bool is_legal(const state *s);
 
+/**
+ * @brief Evaluate `is_legal()` for up to 64 states at once.
+ *
+ * Stones are transposed into one word per board point with one bit per state so that liberty
+ * existence can be flooded through all states simultaneously. States with an active ko fall back to `is_legal()`.
+ * All states must share the visual area and board geometry.
+ *
+ * @param states Array of states to evaluate.
+ * @param count Number of states, at most 64.
+ * @return Mask with bit `i` set when `states[i]` is legal.
+ */
+unsigned long long is_legal_64(const state *states, int count);
+
 /** @brief Return true when a target chain can be captured in one move. */
 bool target_capturable(const state *s);
 
@@ -156,6 +156,13 @@ int ctz(const stones_t stones);
 /** @brief Count leading zero bits after the last set bit. */
 int clz(const stones_t stones);
 
+/**
+ * @brief Transpose a 64x64 bit matrix in place.
+ *
+ * Afterwards bit `i` of `rows[j]` holds what was bit `j` of `rows[i]`.
+ */
+void transpose_64(stones_t *rows);
+
 /**
  * @brief Compute liberties for stones inside a given empty region.
  *
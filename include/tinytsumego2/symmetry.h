@@ -2,6 +2,7 @@
 
 #include "tinytsumego2/state.h"
 #include "tinytsumego2/stones.h"
+#include <stdio.h>
 #include <stdlib.h>
 
 /**
@@ -10,6 +11,10 @@
  *
  * These routines make 9x2, 10x2, 11x2, 12x2, 6x3, 7x3, 8x3, 5x4, 6x4, and 5x5
  * problem spaces tractable by reducing out spatial symmetries.
+ *
+ * Plain rectangles use hand-tuned cores. Other roots, such as corner shapes
+ * that are only symmetric about the main diagonal, fall back to a generic core
+ * built from the automorphisms of the root masks.
  */
 
 /** @brief No mirror operation. */
@@ -45,6 +50,12 @@ typedef struct symmetry {
   /** @brief Indexer for the symmetry core used to determine the correct mirrors for the pulp. */
   core_idx_f core_idx;
 
+  /** @brief Core points of a generic symmetry, or zero when `core_idx` is hand-tuned. */
+  stones_t core_mask;
+
+  /** @brief Points whose contents are encoded by the key. Everything else is fixed by the root. */
+  stones_t variable_area;
+
   /** @brief Number of points outside the reduced core. */
   int pulp_count;
   /** @brief One-bit bitboards for the pulp points. */
@@ -56,6 +67,9 @@ typedef struct symmetry {
   /** @brief Mapping from non-reduced core indices to canonical indices. */
   size_t *core_map;
 
+  /** @brief Number of non-reduced core indices covered by `pulp_ops` and `core_map`. */
+  size_t num_core_indices;
+
   /** @brief Modulus used when building canonical keys. */
   size_t core_m;
 
@@ -126,14 +140,73 @@ stones_t stones_mirror_h_w8(stones_t stones);
 /** @brief Horizontal mirror helper for alternate-width bitboards with width 9. */
 stones_t stones_mirror_h_w9(stones_t stones);
 
+/** @brief Select the mirrors of the bounding box of the visual area. Unavailable mirrors are left `NULL`. */
+void pick_mirrors(symmetry *sym, const state *s);
+
+/** @brief Apply a packed mirror operation using the mirrors available in `sym`. */
+stones_t apply_mirror_op(const symmetry *sym, const mirror_op_t op, stones_t stones);
+
+/**
+ * @brief Find the board symmetries that map every mask of the root onto itself.
+ *
+ * The root must be snapped to the upper-left corner.
+ *
+ * @param s Root state.
+ * @param ops Output array with room for 8 operations. The identity comes first.
+ * @return Number of automorphisms found. One means the root is asymmetric.
+ */
+int compute_automorphisms(const state *s, mirror_op_t *ops);
+
+/** @brief Return true when the mirrors of `sym` support `op` and it maps every mask of `s` to itself. */
+bool preserves_root(const symmetry *sym, const mirror_op_t op, const state *s);
+
 /** @brief Compute symmetry reduction data for a root state. */
 symmetry compute_symmetry(const state *s);
 
+/**
+ * @brief Count the stone arrangements of the variable area that are distinct up to the automorphisms of the root.
+ *
+ * Lower bound on the size of `compute_symmetry()` that does not build any tables.
+ */
+size_t count_symmetry_orbits(const state *s);
+
+/** @brief Approximate number of bytes `write_symmetry()` stores for a root assuming a generic core of maximal size. */
+size_t estimate_symmetry_bytes(const state *s);
+
 /** @brief Map black/white bitboards to a canonical symmetry-reduced key. */
 size_t to_symmetric_bw_key(const symmetry *sym, const stones_t black, const stones_t white);
 
+/** @brief Return the mirror operation that `to_symmetric_bw_key()` applies to the bitboards or UCHAR_MAX if they are illegal. */
+mirror_op_t symmetric_bw_op(const symmetry *sym, const stones_t black, const stones_t white);
+
 /** @brief Recover canonical black/white bitboards from a symmetry-reduced key. */
 void from_symmetric_bw_key(const symmetry *sym, size_t key, stones_t *black, stones_t *white);
 
 /** @brief Release allocations owned by a symmetry descriptor. */
 void free_symmetry(symmetry *sym);
+
+/**
+ * @brief Serialize a symmetry including its core and pulp tables.
+ *
+ * Mirror functions and core indexers are stored as indices into a fixed registry. Tables are padded to TABLE_ALIGNMENT
+ * relative to the start of the stream so that they can be mapped in place.
+ *
+ * @param sym Symmetry to serialize.
+ * @param offset Number of bytes already written to the stream.
+ * @param stream Output stream.
+ * @return Number of bytes written.
+ */
+size_t write_symmetry(const symmetry *restrict sym, size_t offset, FILE *restrict stream);
+
+/**
+ * @brief Point a symmetry to tables serialized by `write_symmetry()` without copying them.
+ *
+ * @param sym Symmetry to initialize. Release using `unmap_symmetry()`.
+ * @param map Cursor into the mapped file.
+ * @param base Start of the mapped file.
+ * @return Cursor advanced past the symmetry.
+ */
+char *map_symmetry(symmetry *sym, char *map, const char *base);
+
+/** @brief Release the small allocations of a symmetry initialized by `map_symmetry()`. */
+void unmap_symmetry(symmetry *sym);
@@ -28,6 +28,19 @@ typedef unsigned short int value_id_t;
 /** @brief Write an array and accumulate serialized byte count in `total`. */
 #define WRITE_ARRAY(total, stream, ptr, count) ((total) += fwrite((ptr), sizeof(*(ptr)), (count), (stream)) * sizeof(*(ptr)))
 
+/** @brief Alignment of serialized tables that are mapped in place. */
+#define TABLE_ALIGNMENT (64)
+
+/** @brief Write zero bytes until `total` is a multiple of TABLE_ALIGNMENT. */
+#define WRITE_PADDING(total, stream)                                                                                                       \
+  do {                                                                                                                                     \
+    static const char __zeros[TABLE_ALIGNMENT] = {0};                                                                                      \
+    (total) += fwrite(__zeros, 1, (TABLE_ALIGNMENT - (total) % TABLE_ALIGNMENT) % TABLE_ALIGNMENT, (stream));                              \
+  } while (0)
+
+/** @brief Advance a mmap cursor until its offset from `base` is a multiple of TABLE_ALIGNMENT. */
+#define ALIGN_MAP(map, base) ((map) += (TABLE_ALIGNMENT - ((map) - (base)) % TABLE_ALIGNMENT) % TABLE_ALIGNMENT)
+
 /** @brief Copy one scalar field from a mmap cursor and advance the cursor. */
 #define READ_FIELD(map, field)                                                                                                             \
   do {                                                                                                                                     \
@@ -75,3 +88,38 @@ void *xrealloc(void *ptr, size_t size);
  * @return Pointer to the mapped file contents.
  */
 char *file_to_mmap(const char *filename, struct stat *sb, int *fd);
+
+/** @brief How pages of a memory-mapped file are brought into and kept in RAM. */
+typedef enum residency_policy {
+  /** @brief Fault in single pages on demand without readahead. */
+  RANDOM_RESIDENCY,
+  /** @brief Start asynchronous readahead of the whole file. */
+  WILLNEED_RESIDENCY,
+  /** @brief Read the whole file before the mapping is returned. */
+  POPULATE_RESIDENCY,
+  /** @brief Like RANDOM_RESIDENCY but index tables are locked in RAM by the reader. */
+  LOCKED_RESIDENCY,
+  /** @brief Map at a huge page boundary and ask for transparent huge pages. Only effective if the kernel supports them for files. */
+  HUGE_PAGE_RESIDENCY,
+} residency_policy;
+
+/** @brief Memory-map a file for read-only access using the given residency policy. */
+char *file_to_mmap_with_policy(const char *filename, struct stat *sb, int *fd, residency_policy policy);
+
+/** @brief Like `file_to_mmap_with_policy()` but return NULL with `errno` set if the file cannot be opened or mapped. */
+char *try_file_to_mmap_with_policy(const char *filename, struct stat *sb, int *fd, residency_policy policy);
+
+/** @brief State of a JKISS32 generator owned by the caller instead of the process. */
+typedef struct rng_state {
+  unsigned int x;
+  unsigned int y;
+  unsigned int z;
+  unsigned int w;
+  unsigned int c;
+} rng_state;
+
+/** @brief Expand a 64-bit seed into a generator state. Distinct seeds give independent looking streams. */
+rng_state seed_rng(unsigned long long seed);
+
+/** @brief Advance a generator and return the next 32-bit output. */
+unsigned int rng_next(rng_state *rng);
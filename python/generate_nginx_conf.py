@@ -28,6 +28,11 @@ if __name__ == "__main__":
         sys.stderr.write("Output path must be provided\n")
         sys.exit(1)
 
+    # Folder written by export_static_responses
+    static_root = None
+    if len(sys.argv) > 2:
+        static_root = os.path.abspath(sys.argv[2])
+
     binary_slugs = set()
 
     for filename in os.listdir(COLLECTION_PATH):
@@ -61,4 +66,19 @@ if __name__ == "__main__":
                 f.write(f"  proxy_set_header Host $host;\n")
                 f.write(f"  proxy_pass http://127.0.0.1:{port}/;\n")
                 f.write(f"}}\n")
+            if slug is not None and static_root is not None:
+                # Serve exported responses from disk and proxy the misses
+                pattern = f"^/api/tsumego/{slug}/moves/([0-9a-f_-]+)$"
+                f.write(f"location ~ {pattern} {{\n")
+                f.write(f"  root {static_root};\n")
+                f.write(f"  default_type application/json;\n")
+                f.write(f"  add_header X-Content-Type-Options nosniff;\n")
+                f.write(f"  add_header X-Frame-Options DENY;\n")
+                f.write(f"  try_files /{slug}/$1.json @{slug}-dynamic;\n")
+                f.write(f"}}\n")
+                f.write(f"location @{slug}-dynamic {{\n")
+                f.write(f"  rewrite ^/api/tsumego/{slug}/(.*)$ /$1 break;\n")
+                f.write(f"  proxy_set_header Host $host;\n")
+                f.write(f"  proxy_pass http://127.0.0.1:{port};\n")
+                f.write(f"}}\n")
             port += 1
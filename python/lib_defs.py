@@ -1,4 +1,5 @@
 import ctypes
+import sys
 from lib_types import *
 
 try:
@@ -7,6 +8,13 @@ except OSError as e:
     sys.stderr.write("Library not found. Did you remember to compile it?\n")
     raise (e)
 
+libc = ctypes.CDLL("libc.so.6")
+libc.open_memstream.restype = ctypes.c_void_p
+libc.open_memstream.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+libc.fputc.argtypes = [ctypes.c_int, ctypes.c_void_p]
+libc.fclose.argtypes = [ctypes.c_void_p]
+libc.free.argtypes = [ctypes.c_void_p]
+
 # stones.h
 lib.rectangle.restype = stones_t
 lib.coords_of.restype = Coordinates
@@ -22,14 +30,51 @@ lib.iterate_dual_graph.restype = ctypes.c_bool
 lib.get_dual_graph_value.restype = Value
 # dual_reader.h
 lib.allocate_dual_graph_reader.restype = ctypes.c_void_p
+lib.allocate_dual_graph_reader_with_policy.restype = ctypes.c_void_p
+lib.try_allocate_dual_graph_reader_with_policy.restype = ctypes.c_void_p
+lib.is_reader_state.restype = ctypes.c_bool
 lib.get_dual_graph_reader_value.restype = DualValue
 lib.dual_graph_reader_python_stuff.restype = ctypes.POINTER(stones_t)
 lib.dual_graph_reader_move_infos.restype = ctypes.POINTER(MoveInfo)
 lib.dual_graph_reader_low_terminal.restype = State
 lib.dual_graph_reader_high_terminal.restype = State
 lib.strip_aesthetics.restype = State
+lib.allocate_reader_context.restype = ctypes.c_void_p
+lib.allocate_reader_context.argtypes = [ctypes.c_void_p, ctypes.c_ulonglong]
+lib.get_dual_graph_reader_value_r.restype = DualValue
+lib.dual_graph_reader_move_infos_r.restype = ctypes.POINTER(MoveInfo)
+lib.dual_graph_reader_low_terminal_r.restype = State
+lib.dual_graph_reader_high_terminal_r.restype = State
+# batch.h
+lib.dual_graph_reader_batch_move_infos.restype = ctypes.POINTER(MoveInfo)
+lib.dual_graph_reader_batch_terminals.argtypes = [
+    ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_int, ctypes.c_bool, ctypes.c_ulonglong, ctypes.c_void_p
+]
+# bundle.h
+lib.allocate_solution_bundle.restype = ctypes.c_void_p
+lib.get_bundle_reader.restype = ctypes.c_void_p
+# registry.h
+lib.allocate_reader_registry.restype = ctypes.c_void_p
+lib.allocate_reader_registry.argtypes = [ctypes.c_size_t, ctypes.c_size_t]
+lib.acquire_reader.restype = ctypes.c_void_p
+lib.is_registered.restype = ctypes.c_bool
+# response_cache.h
+lib.allocate_response_cache.restype = ctypes.c_void_p
+lib.allocate_response_cache.argtypes = [ctypes.c_size_t]
+lib.cached_move_infos.restype = ctypes.POINTER(MoveInfo)
+lib.cached_dead_stones.restype = stones_t
 # scoring.h
 lib.score_terminal.restype = Value
 lib.apply_tactics.restype = Value
 # collection.h
 lib.get_collections.restype = ctypes.POINTER(Collection)
+# json_api.h
+lib.parse_move_request.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_bool, ctypes.c_void_p]
+lib.write_state_response_json.argtypes = [ctypes.c_void_p] * 5
+
+# Extension module built next to the library when CMake finds the Python headers
+sys.path.append("../build/lib")
+try:
+    import _tinytsumego as native
+except ImportError:
+    import native_ctypes as native
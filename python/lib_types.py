@@ -24,6 +24,15 @@ COMPRESSED_KEYSPACE = 0
 SYMMETRIC_KEYSPACE = 1
 MOCK_KEYSPACE = 2
 
+# enum residency_policy
+RESIDENCY_POLICIES = {
+    "random": 0,
+    "willneed": 1,
+    "populate": 2,
+    "locked": 3,
+    "huge": 4,
+}
+
 # stones.h bitboards
 WIDTH = 9
 NORTH_WALL = (1 << WIDTH) - 1
@@ -87,6 +96,37 @@ class State(ctypes.Structure):
             wide,
         )
 
+    @classmethod
+    def from_address(cls, address, wide):
+        """Parse an address produced by to_address(). Raises ValueError if malformed."""
+        fields = address.split("_")
+        if len(fields) != 12:
+            raise ValueError("State address must have 12 fields")
+        stones = [int(field, 16) for field in fields[:8]]
+        passes, ko_threats, button, white_to_play = [int(f) for f in fields[8:]]
+        if white_to_play not in (0, 1):
+            raise ValueError("Turn must be 0 or 1")
+        result = cls(*stones, passes, ko_threats, button, white_to_play, wide)
+        # Reject leading zeros, signs and other spellings of the same state
+        if result.to_address() != address:
+            raise ValueError("State address is not canonical")
+        return result
+
+    def to_address(self):
+        """Name of the precomputed response to this state."""
+        stones = [
+            self.visual_area,
+            self.logical_area,
+            self.player,
+            self.opponent,
+            self.ko,
+            self.target,
+            self.immortal,
+            self.external,
+        ]
+        ints = [self.passes, self.ko_threats, self.button, int(self.white_to_play)]
+        return "_".join([f"{s:x}" for s in stones] + [str(i) for i in ints])
+
     def slice_stones(self, stones):
         wall = NORTH_WALL_16 if self.wide else NORTH_WALL
         shift = V_SHIFT_16 if self.wide else V_SHIFT
@@ -1,7 +1,7 @@
 import ctypes
 from ctypes import pointer
 from lib_types import *
-from lib_defs import lib
+from lib_defs import lib, native
 import http.server
 import json
 import os
@@ -17,8 +17,24 @@ dev_mode = False
 allow_origin = None
 collection_path = None
 readers = {}
+registry = None
+response_cache = None
 collections = {}
 
+# Limits of the lazy reader registry used when serving a folder
+MAX_READERS = 16
+MAX_READER_BYTES = 256 * 1024 * 1024
+
+# Responses shared by all collections
+RESPONSE_CACHE_CAPACITY = 65536
+
+
+def acquire_reader(slug):
+    # Readers of the registry stay loaded while the returned object is alive
+    if registry:
+        return registry.acquire(slug)
+    return readers[slug]
+
 
 class Handler(http.server.BaseHTTPRequestHandler):
     def send_default_headers(self):
@@ -27,15 +43,15 @@ class Handler(http.server.BaseHTTPRequestHandler):
         self.send_header("X-Content-Type-Options", "nosniff")
         self.send_header("X-Frame-Options", "DENY")
 
-    def write_json(self, data):
-        self.wfile.write((json.dumps(data) + "\n").encode("utf-8"))
-
     def json_response(self, data, code=200):
+        self.body_response((json.dumps(data) + "\n").encode("utf-8"), code)
+
+    def body_response(self, body, code=200):
         self.send_response(code)
         self.send_default_headers()
         self.send_header("Content-type", "application/json")
         self.end_headers()
-        self.write_json(data)
+        self.wfile.write(body)
 
     def do_OPTIONS(self):
         self.send_response(204)
@@ -70,59 +86,31 @@ class Handler(http.server.BaseHTTPRequestHandler):
             )
             return
         collection = collections[collection_slug]
-        (reader, root) = readers[collection_slug]
-        content = self.rfile.read(length).decode("utf-8")
+        content = self.rfile.read(length)
         try:
-            data = json.loads(content)
-        except json.JSONDecodeError:
-            self.json_response({"error": "Malformed JSON body"}, 400)
+            state = native.parse_move_request(content, collection.root.wide)
+        except ValueError as e:
+            self.json_response({"error": str(e)}, 400)
             return
-        if "state" not in data:
-            self.json_response({"error": 'Missing "state" field'}, 400)
-            return
-        state = State.from_json(data["state"], root.wide)
-        if state.passes >= 2:
-            state.passes = 0
-            state.ko = 0
-            state.ko_threats = 0
-            # Plain values have been "used up" for area scoring. Take the forcing terminal.
-            low_terminal = lib.dual_graph_reader_low_terminal(
-                reader, pointer(state), FORCING
-            )
-            dead_stones = lib.dead_stones(pointer(state), pointer(low_terminal))
-            if dead_stones:
-                high_terminal = lib.dual_graph_reader_high_terminal(
-                    reader, pointer(state), FORCING
-                )
-                high_stones = lib.dead_stones(pointer(state), pointer(high_terminal))
-                dead_stones &= high_stones
-            self.json_response({"deadStones": state.slice_stones(dead_stones)})
-            return
-        num_move_infos = ctypes.c_int(0)
-        move_infos = lib.dual_graph_reader_move_infos(
-            reader, pointer(state), pointer(num_move_infos)
+        self.respond_state(
+            acquire_reader(collection_slug), state, 'Invalid "state" field'
         )
-        response_data = {"moves": []}
-        for i in range(num_move_infos.value):
-            response_data["moves"].append(
-                {
-                    "x": move_infos[i].coords.x,
-                    "y": move_infos[i].coords.y,
-                    "lowGain": move_infos[i].low_gain,
-                    "highGain": move_infos[i].high_gain,
-                    "lowIdeal": move_infos[i].low_ideal,
-                    "highIdeal": move_infos[i].high_ideal,
-                    "forcing": move_infos[i].forcing,
-                }
-            )
-        libc.free(move_infos)
+
+    def respond_state(self, reader, state, error):
+        # The lookup and the JSON encoding happen without holding the GIL
+        try:
+            body = reader.respond(state, response_cache)
+        except ValueError:
+            # States from other roots would read arbitrary keys
+            self.json_response({"error": error}, 400)
+            return
         if dev_mode:
-            lib.print_state(pointer(state))
-            normalized = lib.strip_aesthetics(reader, pointer(state))
-            v = lib.get_dual_graph_reader_value(reader, pointer(normalized))
-            print(f"Plain: {v.plain.low}, {v.plain.high}")
-            print(f"Forcing: {v.forcing.low}, {v.forcing.high}")
-        self.json_response(response_data)
+            lib.print_state(pointer(State.from_buffer_copy(state)))
+            response_cache.print_stats()
+            plain, forcing = reader.value(reader.normalize(state))
+            print(f"Plain: {plain[0]}, {plain[1]}")
+            print(f"Forcing: {forcing[0]}, {forcing[1]}")
+        self.body_response(body)
 
     def do_GET(self):
         parsed = urlsplit(self.path)
@@ -200,6 +188,19 @@ class Handler(http.server.BaseHTTPRequestHandler):
                 }
                 self.json_response(data)
                 return
+            elif len(parts) == 4 and parts[2] == "moves":
+                # Fallback for precomputed responses that were not exported
+                try:
+                    state = State.from_address(parts[3], collection.root.wide)
+                except ValueError:
+                    self.json_response({"error": "Invalid state address"}, 400)
+                    return
+                self.respond_state(
+                    acquire_reader(collection_slug),
+                    bytes(state),
+                    "Invalid state address",
+                )
+                return
         self.json_response({"error": f"Resource not found"}, 404)
         return
 
@@ -239,21 +240,25 @@ if __name__ == "__main__":
         print("Dev mode enabled: Access-Control-Allow-Origin = '*'")
         allow_origin = "*"
 
-    for filename in os.listdir(collection_path):
-        [slug, ext] = os.path.splitext(filename)
-        if ext != ".bin":
-            continue
-        print("Reading", filename)
-        reader = lib.allocate_dual_graph_reader(
-            os.path.join(collection_path, filename).encode()
-        )
-        dummy = ctypes.c_int(0)
-        root = State()
-        lib.dual_graph_reader_python_stuff(reader, pointer(root), pointer(dummy))
-        readers[slug] = (reader, root)
+    response_cache = native.ResponseCache(RESPONSE_CACHE_CAPACITY)
 
     num_collections = ctypes.c_int(0)
     pc = lib.get_collections(pointer(num_collections))
+
+    if collection_path.endswith(".bundle"):
+        print("Reading bundle", collection_path)
+        readers = native.load_bundle(collection_path)
+    else:
+        # Readers are loaded on first use and evicted when idle
+        registry = native.Registry(MAX_READERS, MAX_READER_BYTES)
+        for filename in os.listdir(collection_path):
+            [slug, ext] = os.path.splitext(filename)
+            if ext != ".bin":
+                continue
+            print("Registering", filename)
+            registry.register(slug, os.path.join(collection_path, filename))
+            readers[slug] = None
+
     for i in range(num_collections.value):
         slug = pc[i].slug.decode()
         if slug in readers:
@@ -262,7 +267,8 @@ if __name__ == "__main__":
         else:
             print("Missing binary for", slug)
 
-    server = http.server.HTTPServer(("localhost", 8361), Handler)
+    # Lookups release the GIL so every request gets a thread
+    server = http.server.ThreadingHTTPServer(("localhost", 8361), Handler)
     try:
         server.serve_forever()
     except KeyboardInterrupt:
@@ -273,9 +279,9 @@ if __name__ == "__main__":
     server.server_close()
 
     print("Cleaning up...")
-    for reader, _ in readers.values():
-        lib.unload_dual_graph_reader(reader)
-        libc.free(reader)
+    response_cache.print_stats()
+    readers = {}
+    registry = None
 
     for i in range(num_collections.value):
         libc.free(pc[i].tsumegos)
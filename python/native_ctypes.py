@@ -0,0 +1,170 @@
+"""Stand-in for the _tinytsumego extension when CMake did not find the Python headers.
+
+Offers the parts of the extension used by the servers through ctypes. Lookups on one Reader object are serialized
+and the GIL is only released inside the individual library calls.
+"""
+
+import ctypes
+import threading
+from ctypes import byref
+from lib_types import *
+from lib_defs import lib, libc
+
+MOVE_REQUEST_ERRORS = {
+    1: "Malformed JSON body",
+    2: 'Missing "state" field',
+    3: 'Invalid "state" field',
+}
+
+
+def parse_move_request(body, wide):
+    state = State()
+    status = lib.parse_move_request(body, len(body), wide, byref(state))
+    if status:
+        raise ValueError(MOVE_REQUEST_ERRORS[status])
+    return bytes(state)
+
+
+class ResponseCache:
+    def __init__(self, capacity=65536):
+        if capacity < 1:
+            raise ValueError("Invalid response cache capacity")
+        self.handle = ctypes.c_void_p(lib.allocate_response_cache(capacity))
+
+    def print_stats(self):
+        lib.print_response_cache_stats(self.handle)
+
+    def __del__(self):
+        # Nothing to release if the constructor failed
+        if not hasattr(self, "handle"):
+            return
+        lib.free_response_cache(self.handle)
+        libc.free(self.handle)
+
+
+class Reader:
+    def __init__(self, filename, policy=0):
+        handle = lib.try_allocate_dual_graph_reader_with_policy(filename.encode(), policy)
+        if not handle:
+            raise ValueError(f"{filename} is not a valid dual graph")
+        self._attach(ctypes.c_void_p(handle), None)
+
+    @classmethod
+    def _wrap(cls, handle, owner):
+        result = cls.__new__(cls)
+        result._attach(handle, owner)
+        return result
+
+    def _attach(self, handle, owner):
+        self.handle = handle
+        # Registry or bundle that owns the reader. None when the reader owns its file.
+        self.owner = owner
+        self.context = ctypes.c_void_p(lib.allocate_reader_context(handle, 0))
+        self.lock = threading.Lock()
+
+    def _state(self, state):
+        if len(state) != ctypes.sizeof(State):
+            raise ValueError(f"State must be {ctypes.sizeof(State)} bytes, got {len(state)}")
+        result = State.from_buffer_copy(state)
+        if not lib.is_reader_state(self.handle, byref(result)):
+            raise ValueError("State does not belong to the collection")
+        return result
+
+    @property
+    def root(self):
+        root = State()
+        num_moves = ctypes.c_int(0)
+        lib.dual_graph_reader_python_stuff(self.handle, byref(root), byref(num_moves))
+        return bytes(root)
+
+    def value(self, state):
+        s = self._state(state)
+        with self.lock:
+            v = lib.get_dual_graph_reader_value_r(self.handle, self.context, byref(s))
+        return ((v.plain.low, v.plain.high), (v.forcing.low, v.forcing.high))
+
+    def normalize(self, state):
+        return bytes(lib.strip_aesthetics(self.handle, byref(self._state(state))))
+
+    def respond(self, state, cache):
+        s = self._state(state)
+        body = ctypes.c_void_p()
+        length = ctypes.c_size_t()
+        with self.lock:
+            stream = libc.open_memstream(byref(body), byref(length))
+            lib.write_state_response_json(stream, cache.handle, self.handle, self.context, byref(s))
+            libc.fputc(ord("\n"), stream)
+            libc.fclose(stream)
+        result = ctypes.string_at(body, length.value)
+        libc.free(body)
+        return result
+
+    def print_residency(self):
+        lib.print_dual_graph_residency(self.handle)
+
+    def __del__(self):
+        # Nothing to release if the constructor failed
+        if not hasattr(self, "handle"):
+            return
+        lib.free_reader_context(self.context)
+        libc.free(self.context)
+        if isinstance(self.owner, Registry):
+            lib.release_reader(self.owner.handle, self.handle)
+        elif self.owner is None:
+            lib.unload_dual_graph_reader(self.handle)
+            libc.free(self.handle)
+
+
+class Registry:
+    def __init__(self, max_readers=0, max_bytes=0):
+        if max_readers < 0 or max_bytes < 0:
+            raise ValueError("Invalid registry limits")
+        self.handle = ctypes.c_void_p(lib.allocate_reader_registry(max_readers, max_bytes))
+
+    def register(self, slug, filename):
+        lib.register_reader(self.handle, slug.encode(), filename.encode())
+
+    def acquire(self, slug):
+        handle = lib.acquire_reader(self.handle, slug.encode())
+        if not handle:
+            if lib.is_registered(self.handle, slug.encode()):
+                raise ValueError(f"Collection {slug} could not be loaded")
+            raise KeyError(slug)
+        # The reader keeps the registry alive until it is released
+        return Reader._wrap(ctypes.c_void_p(handle), self)
+
+    def __del__(self):
+        # Nothing to release if the constructor failed
+        if not hasattr(self, "handle"):
+            return
+        lib.free_reader_registry(self.handle)
+        libc.free(self.handle)
+
+
+class _Bundle:
+    def __init__(self, filename):
+        self.handle = ctypes.c_void_p(lib.allocate_solution_bundle(filename.encode()))
+
+    def __del__(self):
+        # Nothing to release if the constructor failed
+        if not hasattr(self, "handle"):
+            return
+        lib.unload_solution_bundle(self.handle)
+        libc.free(self.handle)
+
+
+def load_bundle(filename):
+    bundle = _Bundle(filename)
+    num_collections = ctypes.c_int(0)
+    pc = lib.get_collections(byref(num_collections))
+    result = {}
+    # Readers are initialized up front because bundle access is not thread-safe
+    for i in range(num_collections.value):
+        slug = pc[i].slug.decode()
+        handle = lib.get_bundle_reader(bundle.handle, slug.encode())
+        if handle:
+            result[slug] = Reader._wrap(ctypes.c_void_p(handle), bundle)
+    for i in range(num_collections.value):
+        libc.free(pc[i].tsumegos)
+    libc.free(pc)
+    return result
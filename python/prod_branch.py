@@ -2,7 +2,7 @@ from dotenv import load_dotenv
 import ctypes
 from ctypes import pointer
 from lib_types import *
-from lib_defs import lib
+from lib_defs import lib, native
 from handler import BaseHandler
 import http.server
 import json
@@ -21,6 +21,7 @@ collection_slug = "rectangle-six"
 collection = None
 reader = None
 root = None
+response_cache = None
 
 thread = None
 httpd = None
@@ -45,52 +46,27 @@ class Handler(BaseHandler):
         if length <= 0 or length > MAX_BODY_SIZE:
             self.json_response({"error": "Request body too large"}, 413)
             return
-        content = self.rfile.read(length).decode("utf-8")
+        content = self.rfile.read(length)
         try:
-            data = json.loads(content)
-        except json.JSONDecodeError:
-            self.json_response({"error": "Malformed JSON body"}, 400)
+            state = native.parse_move_request(content, root.wide)
+        except ValueError as e:
+            self.json_response({"error": str(e)}, 400)
             return
-        if "state" not in data:
-            self.json_response({"error": 'Missing "state" field'}, 400)
-            return
-        state = State.from_json(data["state"], root.wide)
-        if state.passes >= 2:
-            state.passes = 0
-            state.ko = 0
-            state.ko_threats = 0
-            # Plain values have been "used up" for area scoring. Take the forcing terminal.
-            low_terminal = lib.dual_graph_reader_low_terminal(
-                reader, pointer(state), FORCING
-            )
-            dead_stones = lib.dead_stones(pointer(state), pointer(low_terminal))
-            if dead_stones:
-                high_terminal = lib.dual_graph_reader_high_terminal(
-                    reader, pointer(state), FORCING
-                )
-                high_stones = lib.dead_stones(pointer(state), pointer(high_terminal))
-                dead_stones &= high_stones
-            self.json_response({"deadStones": state.slice_stones(dead_stones)})
+        self.respond_state(state, 'Invalid "state" field')
+
+    def respond_state(self, state, error):
+        # The lookup and the JSON encoding happen without holding the GIL
+        try:
+            body = reader.respond(state, response_cache)
+        except ValueError:
+            # States from other roots would read arbitrary keys
+            self.json_response({"error": error}, 400)
             return
-        num_move_infos = ctypes.c_int(0)
-        move_infos = lib.dual_graph_reader_move_infos(
-            reader, pointer(state), pointer(num_move_infos)
-        )
-        response_data = {"moves": []}
-        for i in range(num_move_infos.value):
-            response_data["moves"].append(
-                {
-                    "x": move_infos[i].coords.x,
-                    "y": move_infos[i].coords.y,
-                    "lowGain": move_infos[i].low_gain,
-                    "highGain": move_infos[i].high_gain,
-                    "lowIdeal": move_infos[i].low_ideal,
-                    "highIdeal": move_infos[i].high_ideal,
-                    "forcing": move_infos[i].forcing,
-                }
-            )
-        libc.free(move_infos)
-        self.json_response(response_data)
+        self.send_response(200)
+        self.send_default_headers()
+        self.send_header("Content-type", "application/json")
+        self.end_headers()
+        self.wfile.write(body)
 
     def do_GET(self):
         parsed = urlsplit(self.path)
@@ -107,6 +83,15 @@ class Handler(BaseHandler):
             }
             self.json_response(data)
             return
+        elif path.startswith("moves/"):
+            # Fallback for precomputed responses that were not exported
+            try:
+                state = State.from_address(path[len("moves/") :], root.wide)
+            except ValueError:
+                self.json_response({"error": "Invalid state address"}, 400)
+                return
+            self.respond_state(bytes(state), "Invalid state address")
+            return
         else:
             tsumego_slug = path
             if tsumego_slug not in collection.tsumegos_by_slug:
@@ -155,12 +140,18 @@ if __name__ == "__main__":
         sys.stderr.write("COLLECTION_PATH not found in .env\n")
         sys.exit(1)
 
+    RESIDENCY_POLICY = os.getenv("RESIDENCY_POLICY", "random")
+    if RESIDENCY_POLICY not in RESIDENCY_POLICIES:
+        sys.stderr.write(f"Unknown RESIDENCY_POLICY {RESIDENCY_POLICY}\n")
+        sys.exit(1)
+
     filename = os.path.join(COLLECTION_PATH, f"{collection_slug}.bin")
-    print("Reading", filename)
-    reader = lib.allocate_dual_graph_reader(filename.encode())
-    dummy = ctypes.c_int(0)
-    root = State()
-    lib.dual_graph_reader_python_stuff(reader, pointer(root), pointer(dummy))
+    print("Reading", filename, "with residency policy", RESIDENCY_POLICY)
+    reader = native.Reader(filename, RESIDENCY_POLICIES[RESIDENCY_POLICY])
+    reader.print_residency()
+    RESPONSE_CACHE_CAPACITY = int(os.getenv("RESPONSE_CACHE_CAPACITY", "65536"))
+    response_cache = native.ResponseCache(RESPONSE_CACHE_CAPACITY)
+    root = State.from_buffer_copy(reader.root)
 
     num_collections = ctypes.c_int(0)
     pc = lib.get_collections(pointer(num_collections))
@@ -178,7 +169,8 @@ if __name__ == "__main__":
         sys.exit(1)
 
     print(f"Serving {collection_slug} at {PORT}")
-    httpd = http.server.HTTPServer(("localhost", PORT), Handler)
+    # Lookups release the GIL so every request gets a thread
+    httpd = http.server.ThreadingHTTPServer(("localhost", PORT), Handler)
     httpd.serve_forever()
 
     if thread is not None:
@@ -188,9 +180,8 @@ if __name__ == "__main__":
     httpd.server_close()
 
     print(f"Cleaning up {collection_slug}...")
-
-    lib.unload_dual_graph_reader(reader)
-    libc.free(reader)
+    response_cache.print_stats()
+    reader = None
 
     for i in range(num_collections.value):
         libc.free(pc[i].tsumegos)
@@ -0,0 +1,590 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "tinytsumego2/batch.h"
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/json_api.h"
+#include "tinytsumego2/registry.h"
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/util.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Native bindings for the Python bridges. States are passed as raw `state` structs in any buffer such as bytes or a
+// ctypes State. Every lookup releases the GIL so threaded servers can use all cores.
+
+// Reader contexts are recycled between calls so each thread in a lookup owns one
+typedef struct pooled_context {
+  reader_context ctx;
+  struct pooled_context *next;
+} pooled_context;
+
+typedef struct ReaderObject {
+  PyObject_HEAD
+  dual_graph_reader *dgr;
+  // Bundle or registry that owns the reader. NULL when the reader owns its file.
+  PyObject *owner;
+  // Registry to release the reader to when the object is destroyed
+  reader_registry *registry;
+  pthread_mutex_t mutex;
+  pooled_context *idle;
+  unsigned long long num_contexts;
+} ReaderObject;
+
+typedef struct ResponseCacheObject {
+  PyObject_HEAD
+  response_cache cache;
+  bool initialized;
+} ResponseCacheObject;
+
+typedef struct RegistryObject {
+  PyObject_HEAD
+  reader_registry registry;
+  bool initialized;
+} RegistryObject;
+
+static PyTypeObject ReaderType;
+static PyTypeObject ResponseCacheType;
+static PyTypeObject RegistryType;
+
+// Lookups of states from other roots read arbitrary keys
+static bool read_state(const dual_graph_reader *dgr, const Py_buffer *view, state *s) {
+  if (view->len != sizeof(state)) {
+    PyErr_Format(PyExc_ValueError, "State must be %zu bytes, got %zd", sizeof(state), view->len);
+    return false;
+  }
+  memcpy(s, view->buf, sizeof(state));
+  if (!is_reader_state(dgr, s)) {
+    PyErr_SetString(PyExc_ValueError, "State does not belong to the collection");
+    return false;
+  }
+  return true;
+}
+
+static pooled_context *take_context(ReaderObject *self) {
+  pthread_mutex_lock(&(self->mutex));
+  pooled_context *result = self->idle;
+  if (result) {
+    self->idle = result->next;
+  } else {
+    result = xmalloc(sizeof(pooled_context));
+    result->ctx = create_reader_context(self->dgr, ++self->num_contexts);
+  }
+  pthread_mutex_unlock(&(self->mutex));
+  return result;
+}
+
+static void give_context(ReaderObject *self, pooled_context *pc) {
+  pthread_mutex_lock(&(self->mutex));
+  pc->next = self->idle;
+  self->idle = pc;
+  pthread_mutex_unlock(&(self->mutex));
+}
+
+static ReaderObject *wrap_reader(dual_graph_reader *dgr, PyObject *owner, reader_registry *registry) {
+  ReaderObject *self = (ReaderObject *)ReaderType.tp_alloc(&ReaderType, 0);
+  if (!self) {
+    return NULL;
+  }
+  self->dgr = dgr;
+  Py_XINCREF(owner);
+  self->owner = owner;
+  self->registry = registry;
+  pthread_mutex_init(&(self->mutex), NULL);
+  return self;
+}
+
+static PyObject *Reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+  (void)args;
+  (void)kwds;
+  ReaderObject *self = (ReaderObject *)type->tp_alloc(type, 0);
+  if (self) {
+    pthread_mutex_init(&(self->mutex), NULL);
+  }
+  return (PyObject *)self;
+}
+
+static int Reader_init(ReaderObject *self, PyObject *args, PyObject *kwds) {
+  static char *keywords[] = {"filename", "policy", NULL};
+  const char *filename;
+  int policy = RANDOM_RESIDENCY;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|i", keywords, &filename, &policy)) {
+    return -1;
+  }
+  if (self->dgr) {
+    PyErr_SetString(PyExc_RuntimeError, "Reader already loaded");
+    return -1;
+  }
+  dual_graph_reader dgr;
+  bool loaded;
+  Py_BEGIN_ALLOW_THREADS;
+  loaded = try_load_dual_graph_reader_with_policy(filename, policy, &dgr);
+  Py_END_ALLOW_THREADS;
+  if (!loaded) {
+    struct stat sb;
+    if (stat(filename, &sb)) {
+      PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+    } else {
+      PyErr_Format(PyExc_ValueError, "%s is not a valid dual graph", filename);
+    }
+    return -1;
+  }
+  self->dgr = xmalloc(sizeof(dual_graph_reader));
+  *self->dgr = dgr;
+  return 0;
+}
+
+static void Reader_dealloc(ReaderObject *self) {
+  while (self->idle) {
+    pooled_context *next = self->idle->next;
+    free_reader_context(&(self->idle->ctx));
+    free(self->idle);
+    self->idle = next;
+  }
+  if (self->dgr) {
+    if (self->registry) {
+      release_reader(self->registry, self->dgr);
+    } else if (!self->owner) {
+      unload_dual_graph_reader(self->dgr);
+      free(self->dgr);
+    }
+  }
+  Py_XDECREF(self->owner);
+  pthread_mutex_destroy(&(self->mutex));
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static bool check_loaded(ReaderObject *self) {
+  if (!self->dgr) {
+    PyErr_SetString(PyExc_RuntimeError, "Reader not loaded");
+    return false;
+  }
+  return true;
+}
+
+// Parse the arguments of the lookups that only take a state
+static bool parse_state_args(ReaderObject *self, PyObject *args, state *s) {
+  Py_buffer view;
+  if (!check_loaded(self) || !PyArg_ParseTuple(args, "y*", &view)) {
+    return false;
+  }
+  const bool ok = read_state(self->dgr, &view, s);
+  PyBuffer_Release(&view);
+  return ok;
+}
+
+// Parse the arguments of the lookups that go through a response cache
+static bool parse_cached_args(ReaderObject *self, PyObject *args, state *s, ResponseCacheObject **cache) {
+  Py_buffer view;
+  if (!check_loaded(self) || !PyArg_ParseTuple(args, "y*O!", &view, &ResponseCacheType, cache)) {
+    return false;
+  }
+  if (!(*cache)->initialized) {
+    PyErr_SetString(PyExc_RuntimeError, "Response cache not initialized");
+    PyBuffer_Release(&view);
+    return false;
+  }
+  const bool ok = read_state(self->dgr, &view, s);
+  PyBuffer_Release(&view);
+  return ok;
+}
+
+static PyObject *Reader_value(ReaderObject *self, PyObject *args) {
+  state s;
+  if (!parse_state_args(self, args, &s)) {
+    return NULL;
+  }
+  dual_value v;
+  Py_BEGIN_ALLOW_THREADS;
+  pooled_context *pc = take_context(self);
+  v = get_dual_graph_reader_value_r(self->dgr, &(pc->ctx), &s);
+  give_context(self, pc);
+  Py_END_ALLOW_THREADS;
+  return Py_BuildValue("((ff)(ff))", v.plain.low, v.plain.high, v.forcing.low, v.forcing.high);
+}
+
+static PyObject *Reader_normalize(ReaderObject *self, PyObject *args) {
+  state s;
+  if (!parse_state_args(self, args, &s)) {
+    return NULL;
+  }
+  const state normalized = strip_aesthetics(self->dgr, &s);
+  return PyBytes_FromStringAndSize((const char *)&normalized, sizeof(state));
+}
+
+static PyObject *Reader_values(ReaderObject *self, PyObject *args) {
+  Py_buffer view;
+  if (!check_loaded(self) || !PyArg_ParseTuple(args, "y*", &view)) {
+    return NULL;
+  }
+  if (view.len % sizeof(state)) {
+    PyErr_Format(PyExc_ValueError, "States must be a multiple of %zu bytes, got %zd", sizeof(state), view.len);
+    PyBuffer_Release(&view);
+    return NULL;
+  }
+  const size_t count = view.len / sizeof(state);
+  PyObject *result = PyBytes_FromStringAndSize(NULL, count * sizeof(dual_value));
+  if (result && count) {
+    // Arbitrary buffers need not be aligned
+    state *states = xmalloc(count * sizeof(state));
+    memcpy(states, view.buf, count * sizeof(state));
+    for (size_t i = 0; i < count; ++i) {
+      if (!is_reader_state(self->dgr, states + i)) {
+        PyErr_Format(PyExc_ValueError, "State %zu does not belong to the collection", i);
+        free(states);
+        Py_DECREF(result);
+        PyBuffer_Release(&view);
+        return NULL;
+      }
+    }
+    dual_value *values = (dual_value *)PyBytes_AS_STRING(result);
+    Py_BEGIN_ALLOW_THREADS;
+    dual_graph_reader_batch_values(self->dgr, states, count, values);
+    Py_END_ALLOW_THREADS;
+    free(states);
+  }
+  PyBuffer_Release(&view);
+  return result;
+}
+
+static PyObject *Reader_move_infos(ReaderObject *self, PyObject *args) {
+  state s;
+  ResponseCacheObject *cache;
+  if (!parse_cached_args(self, args, &s, &cache)) {
+    return NULL;
+  }
+  move_info *move_infos;
+  int num_move_infos = 0;
+  Py_BEGIN_ALLOW_THREADS;
+  pooled_context *pc = take_context(self);
+  move_infos = cached_move_infos(&(cache->cache), self->dgr, &(pc->ctx), &s, &num_move_infos);
+  give_context(self, pc);
+  Py_END_ALLOW_THREADS;
+  PyObject *result = PyBytes_FromStringAndSize((const char *)move_infos, num_move_infos * sizeof(move_info));
+  free(move_infos);
+  return result;
+}
+
+static PyObject *Reader_dead_stones(ReaderObject *self, PyObject *args) {
+  state s;
+  ResponseCacheObject *cache;
+  if (!parse_cached_args(self, args, &s, &cache)) {
+    return NULL;
+  }
+  stones_t dead;
+  Py_BEGIN_ALLOW_THREADS;
+  pooled_context *pc = take_context(self);
+  dead = cached_dead_stones(&(cache->cache), self->dgr, &(pc->ctx), &s);
+  give_context(self, pc);
+  Py_END_ALLOW_THREADS;
+  return PyLong_FromUnsignedLongLong(dead);
+}
+
+static PyObject *Reader_respond(ReaderObject *self, PyObject *args) {
+  state s;
+  ResponseCacheObject *cache;
+  if (!parse_cached_args(self, args, &s, &cache)) {
+    return NULL;
+  }
+  char *body = NULL;
+  size_t length = 0;
+  Py_BEGIN_ALLOW_THREADS;
+  pooled_context *pc = take_context(self);
+  FILE *stream = open_memstream(&body, &length);
+  write_state_response_json(stream, &(cache->cache), self->dgr, &(pc->ctx), &s);
+  fputc('\n', stream);
+  fclose(stream);
+  give_context(self, pc);
+  Py_END_ALLOW_THREADS;
+  PyObject *result = PyBytes_FromStringAndSize(body, length);
+  free(body);
+  return result;
+}
+
+static PyObject *Reader_print_residency(ReaderObject *self, PyObject *unused) {
+  (void)unused;
+  if (!check_loaded(self)) {
+    return NULL;
+  }
+  print_dual_graph_residency(self->dgr);
+  Py_RETURN_NONE;
+}
+
+static PyObject *Reader_get_root(ReaderObject *self, void *closure) {
+  (void)closure;
+  if (!check_loaded(self)) {
+    return NULL;
+  }
+  return PyBytes_FromStringAndSize((const char *)&(self->dgr->keyspace._.root), sizeof(state));
+}
+
+static PyMethodDef Reader_methods[] = {
+    {"value", (PyCFunction)Reader_value, METH_VARARGS, "value(state) -> ((plain_low, plain_high), (forcing_low, forcing_high))"},
+    {"normalize", (PyCFunction)Reader_normalize, METH_VARARGS, "normalize(state) -> state bytes stripped of aesthetic details"},
+    {"values", (PyCFunction)Reader_values, METH_VARARGS, "values(states) -> bytes of dual_value structs, one per state"},
+    {"move_infos", (PyCFunction)Reader_move_infos, METH_VARARGS, "move_infos(state, cache) -> bytes of move_info structs"},
+    {"dead_stones", (PyCFunction)Reader_dead_stones, METH_VARARGS, "dead_stones(state, cache) -> stones"},
+    {"respond", (PyCFunction)Reader_respond, METH_VARARGS,
+     "respond(state, cache) -> bytes of the JSON response to a move request, newline included"},
+    {"print_residency", (PyCFunction)Reader_print_residency, METH_NOARGS, "Print resident pages of each section"},
+    {NULL},
+};
+
+static PyGetSetDef Reader_getset[] = {
+    {"root", (getter)Reader_get_root, NULL, "Root state of the collection as bytes", NULL},
+    {NULL},
+};
+
+static PyTypeObject ReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "_tinytsumego.Reader",
+    .tp_doc = "Reader(filename, policy=0)\n\nDual graph reader safe to query from any number of threads.",
+    .tp_basicsize = sizeof(ReaderObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Reader_new,
+    .tp_init = (initproc)Reader_init,
+    .tp_dealloc = (destructor)Reader_dealloc,
+    .tp_methods = Reader_methods,
+    .tp_getset = Reader_getset,
+};
+
+static int ResponseCache_init(ResponseCacheObject *self, PyObject *args, PyObject *kwds) {
+  static char *keywords[] = {"capacity", NULL};
+  Py_ssize_t capacity = RESPONSE_CACHE_CAPACITY;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", keywords, &capacity)) {
+    return -1;
+  }
+  if (capacity < 1 || self->initialized) {
+    PyErr_SetString(PyExc_ValueError, "Invalid response cache capacity");
+    return -1;
+  }
+  self->cache = create_response_cache(capacity);
+  self->initialized = true;
+  return 0;
+}
+
+static void ResponseCache_dealloc(ResponseCacheObject *self) {
+  if (self->initialized) {
+    free_response_cache(&(self->cache));
+  }
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *ResponseCache_print_stats(ResponseCacheObject *self, PyObject *unused) {
+  (void)unused;
+  if (!self->initialized) {
+    PyErr_SetString(PyExc_RuntimeError, "Response cache not initialized");
+    return NULL;
+  }
+  print_response_cache_stats(&(self->cache));
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef ResponseCache_methods[] = {
+    {"print_stats", (PyCFunction)ResponseCache_print_stats, METH_NOARGS, "Print hit and miss counts"},
+    {NULL},
+};
+
+static PyTypeObject ResponseCacheType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "_tinytsumego.ResponseCache",
+    .tp_doc = "ResponseCache(capacity=65536)\n\nThread-safe cache of responses shared by all collections.",
+    .tp_basicsize = sizeof(ResponseCacheObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)ResponseCache_init,
+    .tp_dealloc = (destructor)ResponseCache_dealloc,
+    .tp_methods = ResponseCache_methods,
+};
+
+static int Registry_init(RegistryObject *self, PyObject *args, PyObject *kwds) {
+  static char *keywords[] = {"max_readers", "max_bytes", NULL};
+  Py_ssize_t max_readers = 0;
+  Py_ssize_t max_bytes = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nn", keywords, &max_readers, &max_bytes)) {
+    return -1;
+  }
+  if (max_readers < 0 || max_bytes < 0 || self->initialized) {
+    PyErr_SetString(PyExc_ValueError, "Invalid registry limits");
+    return -1;
+  }
+  self->registry = create_reader_registry(max_readers, max_bytes);
+  self->initialized = true;
+  return 0;
+}
+
+static void Registry_dealloc(RegistryObject *self) {
+  // Acquired readers keep the registry alive so none are in use here
+  if (self->initialized) {
+    free_reader_registry(&(self->registry));
+  }
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static bool check_registry(RegistryObject *self) {
+  if (!self->initialized) {
+    PyErr_SetString(PyExc_RuntimeError, "Registry not initialized");
+    return false;
+  }
+  return true;
+}
+
+static PyObject *Registry_register(RegistryObject *self, PyObject *args) {
+  const char *slug;
+  const char *filename;
+  if (!check_registry(self) || !PyArg_ParseTuple(args, "ss", &slug, &filename)) {
+    return NULL;
+  }
+  register_reader(&(self->registry), slug, filename);
+  Py_RETURN_NONE;
+}
+
+static PyObject *Registry_acquire(RegistryObject *self, PyObject *args) {
+  const char *slug;
+  if (!check_registry(self) || !PyArg_ParseTuple(args, "s", &slug)) {
+    return NULL;
+  }
+  dual_graph_reader *dgr;
+  Py_BEGIN_ALLOW_THREADS;
+  dgr = acquire_reader(&(self->registry), slug);
+  Py_END_ALLOW_THREADS;
+  if (!dgr) {
+    if (is_registered(&(self->registry), slug)) {
+      PyErr_Format(PyExc_ValueError, "Collection %s could not be loaded", slug);
+    } else {
+      PyErr_Format(PyExc_KeyError, "%s", slug);
+    }
+    return NULL;
+  }
+  ReaderObject *reader = wrap_reader(dgr, (PyObject *)self, &(self->registry));
+  if (!reader) {
+    release_reader(&(self->registry), dgr);
+  }
+  return (PyObject *)reader;
+}
+
+static PyMethodDef Registry_methods[] = {
+    {"register", (PyCFunction)Registry_register, METH_VARARGS, "register(slug, filename) without loading the reader"},
+    {"acquire", (PyCFunction)Registry_acquire, METH_VARARGS,
+     "acquire(slug) -> Reader that stays loaded until the returned object is destroyed"},
+    {NULL},
+};
+
+static PyTypeObject RegistryType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "_tinytsumego.Registry",
+    .tp_doc = "Registry(max_readers=0, max_bytes=0)\n\nReaders loaded on demand and evicted when idle. Zero for no limit.",
+    .tp_basicsize = sizeof(RegistryObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Registry_init,
+    .tp_dealloc = (destructor)Registry_dealloc,
+    .tp_methods = Registry_methods,
+};
+
+static void free_bundle(PyObject *capsule) {
+  solution_bundle *bundle = PyCapsule_GetPointer(capsule, "solution_bundle");
+  unload_solution_bundle(bundle);
+  free(bundle);
+}
+
+static PyObject *load_bundle(PyObject *module, PyObject *args) {
+  (void)module;
+  const char *filename;
+  if (!PyArg_ParseTuple(args, "s", &filename)) {
+    return NULL;
+  }
+  if (access(filename, R_OK) < 0) {
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+  }
+  solution_bundle *bundle = xmalloc(sizeof(solution_bundle));
+  *bundle = load_solution_bundle(filename);
+  PyObject *capsule = PyCapsule_New(bundle, "solution_bundle", free_bundle);
+  if (!capsule) {
+    unload_solution_bundle(bundle);
+    free(bundle);
+    return NULL;
+  }
+
+  // Readers are initialized up front because bundle access is not thread-safe
+  PyObject *result = PyDict_New();
+  for (size_t i = 0; result && i < bundle->num_collections; ++i) {
+    const char *slug = bundle->entries[i].slug;
+    dual_graph_reader *dgr = get_bundle_reader(bundle, slug);
+    if (!dgr) {
+      PyErr_Format(PyExc_ValueError, "Collection %s of the bundle is malformed", slug);
+      Py_CLEAR(result);
+      break;
+    }
+    PyObject *reader = (PyObject *)wrap_reader(dgr, capsule, NULL);
+    if (!reader || PyDict_SetItemString(result, slug, reader) < 0) {
+      Py_CLEAR(result);
+    }
+    Py_XDECREF(reader);
+  }
+  Py_DECREF(capsule);
+  return result;
+}
+
+static PyObject *parse_request(PyObject *module, PyObject *args) {
+  (void)module;
+  Py_buffer view;
+  int wide;
+  if (!PyArg_ParseTuple(args, "y*p", &view, &wide)) {
+    return NULL;
+  }
+  state s;
+  const move_request_status status = parse_move_request(view.buf, view.len, wide, &s);
+  PyBuffer_Release(&view);
+  if (status == MALFORMED_JSON) {
+    PyErr_SetString(PyExc_ValueError, "Malformed JSON body");
+    return NULL;
+  }
+  if (status == MISSING_STATE) {
+    PyErr_SetString(PyExc_ValueError, "Missing \"state\" field");
+    return NULL;
+  }
+  if (status == INVALID_STATE) {
+    PyErr_SetString(PyExc_ValueError, "Invalid \"state\" field");
+    return NULL;
+  }
+  return PyBytes_FromStringAndSize((const char *)&s, sizeof(state));
+}
+
+static PyMethodDef module_methods[] = {
+    {"load_bundle", load_bundle, METH_VARARGS, "load_bundle(filename) -> dict of Readers by slug"},
+    {"parse_move_request", parse_request, METH_VARARGS,
+     "parse_move_request(body, wide) -> state bytes. Raises ValueError with the message of the API error."},
+    {NULL},
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_tinytsumego",
+    .m_doc = "Native bindings of the dual graph reader for the Python bridges.",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit__tinytsumego(void) {
+  if (PyType_Ready(&ReaderType) < 0 || PyType_Ready(&ResponseCacheType) < 0 || PyType_Ready(&RegistryType) < 0) {
+    return NULL;
+  }
+  PyObject *module = PyModule_Create(&module_def);
+  if (!module) {
+    return NULL;
+  }
+  if (PyModule_AddObjectRef(module, "Reader", (PyObject *)&ReaderType) < 0 ||
+      PyModule_AddObjectRef(module, "ResponseCache", (PyObject *)&ResponseCacheType) < 0 ||
+      PyModule_AddObjectRef(module, "Registry", (PyObject *)&RegistryType) < 0 ||
+      PyModule_AddIntConstant(module, "STATE_SIZE", sizeof(state)) < 0 ||
+      PyModule_AddIntConstant(module, "MOVE_INFO_SIZE", sizeof(move_info)) < 0 ||
+      PyModule_AddIntConstant(module, "DUAL_VALUE_SIZE", sizeof(dual_value)) < 0) {
+    Py_DECREF(module);
+    return NULL;
+  }
+  return module;
+}
@@ -0,0 +1,62 @@
+#include "tinytsumego2/batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of states evaluated in parallel at a time
+#define QUERY_BATCH_SIZE (4096)
+
+// Streams raw `state` structs from stdin and writes raw results to stdout:
+//   values: one dual_value per state
+//   moves: an int32 count followed by that many move_info structs per state
+//   low/high: one terminal state per state
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <dual graph> values|moves|low|high [seed]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *query = argv[2];
+  if (strcmp(query, "values") && strcmp(query, "moves") && strcmp(query, "low") && strcmp(query, "high")) {
+    fprintf(stderr, "Unknown query '%s'\n", query);
+    return EXIT_FAILURE;
+  }
+  const unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+
+  dual_graph_reader dgr = load_dual_graph_reader(argv[1]);
+
+  state *states = xmalloc(QUERY_BATCH_SIZE * sizeof(state));
+  dual_value *values = xmalloc(QUERY_BATCH_SIZE * sizeof(dual_value));
+  state *terminals = xmalloc(QUERY_BATCH_SIZE * sizeof(state));
+  size_t *offsets = xmalloc((QUERY_BATCH_SIZE + 1) * sizeof(size_t));
+
+  size_t total = 0;
+  size_t count;
+  while ((count = fread(states, sizeof(state), QUERY_BATCH_SIZE, stdin)) > 0) {
+    if (query[0] == 'v') {
+      dual_graph_reader_batch_values(&dgr, states, count, values);
+      fwrite(values, sizeof(dual_value), count, stdout);
+    } else if (query[0] == 'm') {
+      move_info *infos = dual_graph_reader_batch_move_infos(&dgr, states, count, offsets);
+      for (size_t i = 0; i < count; ++i) {
+        const int32_t num_move_infos = offsets[i + 1] - offsets[i];
+        fwrite(&num_move_infos, sizeof(int32_t), 1, stdout);
+        fwrite(infos + offsets[i], sizeof(move_info), num_move_infos, stdout);
+      }
+      free(infos);
+    } else {
+      dual_graph_reader_batch_terminals(&dgr, states, count, FORCING, query[0] == 'l', seed + total, terminals);
+      fwrite(terminals, sizeof(state), count, stdout);
+    }
+    total += count;
+  }
+  fflush(stdout);
+  fprintf(stderr, "Answered %zu queries\n", total);
+
+  free(offsets);
+  free(terminals);
+  free(values);
+  free(states);
+  unload_dual_graph_reader(&dgr);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "tinytsumego2/batch.h"
+#include "tinytsumego2/util.h"
+#include <stdlib.h>
+#include <string.h>
+
+void dual_graph_reader_batch_values(const dual_graph_reader *dgr, const state *states, size_t count, dual_value *values) {
+#pragma omp parallel
+  {
+    reader_context ctx = create_reader_context(dgr, 0);
+#pragma omp for schedule(dynamic, 64)
+    for (size_t i = 0; i < count; ++i) {
+      values[i] = get_dual_graph_reader_value_r(dgr, &ctx, states + i);
+    }
+    free_reader_context(&ctx);
+  }
+}
+
+move_info *dual_graph_reader_batch_move_infos(const dual_graph_reader *dgr, const state *states, size_t count, size_t *offsets) {
+  move_info **infos = xmalloc(count * sizeof(move_info *));
+  int *num_infos = xmalloc(count * sizeof(int));
+#pragma omp parallel
+  {
+    reader_context ctx = create_reader_context(dgr, 0);
+#pragma omp for schedule(dynamic, 16)
+    for (size_t i = 0; i < count; ++i) {
+      infos[i] = dual_graph_reader_move_infos_r(dgr, &ctx, states + i, num_infos + i);
+    }
+    free_reader_context(&ctx);
+  }
+
+  // Concatenate in order
+  offsets[0] = 0;
+  for (size_t i = 0; i < count; ++i) {
+    offsets[i + 1] = offsets[i] + num_infos[i];
+  }
+  move_info *result = xmalloc(offsets[count] * sizeof(move_info));
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(result + offsets[i], infos[i], num_infos[i] * sizeof(move_info));
+    free(infos[i]);
+  }
+  free(num_infos);
+  free(infos);
+
+  return result;
+}
+
+void dual_graph_reader_batch_terminals(const dual_graph_reader *dgr, const state *states, size_t count, tactics ts, bool low,
+                                       unsigned long long seed, state *terminals) {
+#pragma omp parallel
+  {
+    reader_context ctx = create_reader_context(dgr, 0);
+#pragma omp for schedule(dynamic, 16)
+    for (size_t i = 0; i < count; ++i) {
+      ctx.rng = seed_rng(seed + i);
+      if (low) {
+        terminals[i] = dual_graph_reader_low_terminal_r(dgr, &ctx, states + i, ts);
+      } else {
+        terminals[i] = dual_graph_reader_high_terminal_r(dgr, &ctx, states + i, ts);
+      }
+    }
+    free_reader_context(&ctx);
+  }
+}
@@ -0,0 +1,313 @@
+#include "tinytsumego2/block_codec.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Leading byte of each encoded block
+#define VERBATIM_BLOCK (0)
+#define RUN_LENGTH_BLOCK (1)
+
+// Number of slots allocated by the first miss of a cache
+#define INITIAL_CACHE_SLOTS (16)
+
+typedef struct bit_writer {
+  unsigned char *out;
+  uint64_t acc;
+  int num_bits;
+} bit_writer;
+
+// Write the lowest `num_bits` bits of `bits` MSB first. At most 56 bits at a time.
+static void write_bits(bit_writer *bw, uint64_t bits, int num_bits) {
+  bw->acc = (bw->acc << num_bits) | bits;
+  bw->num_bits += num_bits;
+  while (bw->num_bits >= 8) {
+    bw->num_bits -= 8;
+    *bw->out++ = (unsigned char)(bw->acc >> bw->num_bits);
+  }
+}
+
+static void flush_bits(bit_writer *bw) {
+  if (bw->num_bits) {
+    *bw->out++ = (unsigned char)(bw->acc << (8 - bw->num_bits));
+    bw->num_bits = 0;
+  }
+}
+
+// Elias gamma code of n > 0: floor(log2(n)) zeros followed by n in binary
+static void write_gamma(bit_writer *bw, uint64_t n) {
+  const int len = 63 - __builtin_clzll(n);
+  write_bits(bw, n, 2 * len + 1);
+}
+
+static int gamma_length(uint64_t n) { return 2 * (63 - __builtin_clzll(n)) + 1; }
+
+// Longest run of leading zeros in a gamma code of a value up to ID_BLOCK_SIZE
+#define MAX_GAMMA_ZEROS (10)
+
+// Read a pair of Elias gamma codes using a single load. Both codes fit in the 57 bits available after alignment
+// because neither value exceeds ID_BLOCK_SIZE. Returns false on codes that no encoded block contains.
+static inline bool read_gamma_pair(const unsigned char *in, size_t *pos, size_t *a, size_t *b) {
+  uint64_t peek;
+  memcpy(&peek, in + (*pos >> 3), sizeof(uint64_t));
+  peek = __builtin_bswap64(peek) << (*pos & 7);
+  const int len_a = peek ? __builtin_clzll(peek) : 64;
+  if (len_a > MAX_GAMMA_ZEROS) {
+    return false;
+  }
+  *a = peek >> (63 - 2 * len_a);
+  peek <<= 2 * len_a + 1;
+  const int len_b = peek ? __builtin_clzll(peek) : 64;
+  if (len_b > MAX_GAMMA_ZEROS) {
+    return false;
+  }
+  *b = peek >> (63 - 2 * len_b);
+  *pos += 2 * (len_a + len_b) + 2;
+  return true;
+}
+
+size_t max_encoded_ids_size(size_t count) { return 1 + count * sizeof(value_id_t) + ID_BLOCK_PADDING; }
+
+typedef struct id_count {
+  value_id_t id;
+  size_t count;
+} id_count;
+
+static int compare_ids(const void *a_, const void *b_) {
+  const id_count *a = a_;
+  const id_count *b = b_;
+  return (a->id > b->id) - (a->id < b->id);
+}
+
+static int compare_counts(const void *a_, const void *b_) {
+  const id_count *a = a_;
+  const id_count *b = b_;
+  // Most common to front with ties broken by id for a deterministic palette
+  if (a->count != b->count) {
+    return (a->count < b->count) - (a->count > b->count);
+  }
+  return compare_ids(a_, b_);
+}
+
+size_t encode_ids(const value_id_t *ids, size_t count, unsigned char *out) {
+  assert(count <= ID_BLOCK_SIZE);
+
+  // Count the runs started by each id
+  id_count *runs = xmalloc(count * sizeof(id_count));
+  size_t num_runs = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (!i || ids[i] != ids[i - 1]) {
+      runs[num_runs++] = (id_count){ids[i], 1};
+    }
+  }
+  qsort(runs, num_runs, sizeof(id_count), compare_ids);
+  size_t palette_size = 0;
+  for (size_t i = 0; i < num_runs; ++i) {
+    if (palette_size && runs[palette_size - 1].id == runs[i].id) {
+      runs[palette_size - 1].count++;
+    } else {
+      runs[palette_size++] = runs[i];
+    }
+  }
+  qsort(runs, palette_size, sizeof(id_count), compare_counts);
+
+  // Palette ranks in id order for encoding
+  id_count *ranks = xmalloc(palette_size * sizeof(id_count));
+  for (size_t i = 0; i < palette_size; ++i) {
+    ranks[i] = (id_count){runs[i].id, i};
+  }
+  qsort(ranks, palette_size, sizeof(id_count), compare_ids);
+  size_t rank_of(value_id_t id) {
+    const id_count needle = {id, 0};
+    const id_count *r = bsearch(&needle, ranks, palette_size, sizeof(id_count), compare_ids);
+    return r->count;
+  }
+
+  size_t num_bits = 0;
+  for (size_t i = 0; i < count;) {
+    size_t j = i + 1;
+    while (j < count && ids[j] == ids[i]) {
+      j++;
+    }
+    num_bits += gamma_length(rank_of(ids[i]) + 1) + gamma_length(j - i);
+    i = j;
+  }
+
+  const size_t encoded_size = 1 + sizeof(value_id_t) * (1 + palette_size) + (num_bits + 7) / 8;
+  size_t result;
+  if (encoded_size >= 1 + count * sizeof(value_id_t)) {
+    out[0] = VERBATIM_BLOCK;
+    memcpy(out + 1, ids, count * sizeof(value_id_t));
+    result = 1 + count * sizeof(value_id_t);
+  } else {
+    out[0] = RUN_LENGTH_BLOCK;
+    const value_id_t p = (value_id_t)palette_size;
+    memcpy(out + 1, &p, sizeof(value_id_t));
+    for (size_t i = 0; i < palette_size; ++i) {
+      memcpy(out + 1 + sizeof(value_id_t) * (1 + i), &(runs[i].id), sizeof(value_id_t));
+    }
+    bit_writer bw = {out + 1 + sizeof(value_id_t) * (1 + palette_size), 0, 0};
+    for (size_t i = 0; i < count;) {
+      size_t j = i + 1;
+      while (j < count && ids[j] == ids[i]) {
+        j++;
+      }
+      write_gamma(&bw, rank_of(ids[i]) + 1);
+      write_gamma(&bw, j - i);
+      i = j;
+    }
+    flush_bits(&bw);
+    result = bw.out - out;
+    assert(result == encoded_size);
+  }
+
+  free(ranks);
+  free(runs);
+  return result;
+}
+
+bool decode_ids(const unsigned char *in, size_t count, value_id_t *ids) {
+  assert(count <= ID_BLOCK_SIZE);
+  if (in[0] == VERBATIM_BLOCK) {
+    memcpy(ids, in + 1, count * sizeof(value_id_t));
+    return true;
+  }
+  if (in[0] != RUN_LENGTH_BLOCK) {
+    return false;
+  }
+  value_id_t palette_size;
+  memcpy(&palette_size, in + 1, sizeof(value_id_t));
+  // The encoder never ranks more ids than there are in a block
+  if (palette_size > count) {
+    return false;
+  }
+  value_id_t palette[ID_BLOCK_SIZE];
+  memcpy(palette, in + 1 + sizeof(value_id_t), palette_size * sizeof(value_id_t));
+
+  const unsigned char *bits = in + 1 + sizeof(value_id_t) * (1 + palette_size);
+  size_t pos = 0;
+  for (size_t i = 0; i < count;) {
+    size_t rank, length;
+    if (!read_gamma_pair(bits, &pos, &rank, &length) || rank > palette_size || length > count - i) {
+      return false;
+    }
+    const value_id_t id = palette[rank - 1];
+    const size_t end = i + length;
+    while (i < end) {
+      ids[i++] = id;
+    }
+  }
+  return true;
+}
+
+id_block_cache create_id_block_cache(size_t size, const uint64_t *offsets, const unsigned char *data, size_t capacity) {
+  id_block_cache result = {0};
+  result.size = size;
+  result.num_blocks = ceil_divz(size, ID_BLOCK_SIZE);
+  result.offsets = offsets;
+  result.data = data;
+
+  result.capacity = capacity < result.num_blocks ? capacity : result.num_blocks;
+  // Storage is allocated by the first lookups
+  result.newest = SIZE_MAX;
+  result.oldest = SIZE_MAX;
+
+  return result;
+}
+
+static void unlink_slot(id_block_cache *cache, size_t slot) {
+  if (cache->newer[slot] == SIZE_MAX) {
+    cache->newest = cache->older[slot];
+  } else {
+    cache->older[cache->newer[slot]] = cache->older[slot];
+  }
+  if (cache->older[slot] == SIZE_MAX) {
+    cache->oldest = cache->newer[slot];
+  } else {
+    cache->newer[cache->older[slot]] = cache->newer[slot];
+  }
+}
+
+static void push_slot(id_block_cache *cache, size_t slot) {
+  cache->newer[slot] = SIZE_MAX;
+  cache->older[slot] = cache->newest;
+  if (cache->newest == SIZE_MAX) {
+    cache->oldest = slot;
+  } else {
+    cache->newer[cache->newest] = slot;
+  }
+  cache->newest = slot;
+}
+
+// Double the slots with storage, allocating the block index on first use
+static void grow_slots(id_block_cache *cache) {
+  if (!cache->slots) {
+    cache->slots = xmalloc(cache->num_blocks * sizeof(size_t));
+    for (size_t i = 0; i < cache->num_blocks; ++i) {
+      cache->slots[i] = SIZE_MAX;
+    }
+  }
+  size_t num_allocated = cache->num_allocated ? 2 * cache->num_allocated : INITIAL_CACHE_SLOTS;
+  if (num_allocated > cache->capacity) {
+    num_allocated = cache->capacity;
+  }
+  cache->ids = xrealloc(cache->ids, num_allocated * ID_BLOCK_SIZE * sizeof(value_id_t));
+  cache->blocks = xrealloc(cache->blocks, num_allocated * sizeof(size_t));
+  cache->newer = xrealloc(cache->newer, num_allocated * sizeof(size_t));
+  cache->older = xrealloc(cache->older, num_allocated * sizeof(size_t));
+  cache->num_allocated = num_allocated;
+}
+
+const value_id_t *get_id_block(id_block_cache *cache, size_t block) {
+  assert(block < cache->num_blocks);
+  size_t slot = cache->slots ? cache->slots[block] : SIZE_MAX;
+  if (slot != SIZE_MAX) {
+    cache->hits++;
+    if (slot != cache->newest) {
+      unlink_slot(cache, slot);
+      push_slot(cache, slot);
+    }
+    return cache->ids + slot * ID_BLOCK_SIZE;
+  }
+
+  cache->misses++;
+  if (cache->num_used < cache->capacity) {
+    if (cache->num_used == cache->num_allocated) {
+      grow_slots(cache);
+    }
+    slot = cache->num_used++;
+  } else {
+    slot = cache->oldest;
+    unlink_slot(cache, slot);
+    cache->slots[cache->blocks[slot]] = SIZE_MAX;
+  }
+  cache->blocks[slot] = block;
+  cache->slots[block] = slot;
+  push_slot(cache, slot);
+
+  const size_t start = block * ID_BLOCK_SIZE;
+  const size_t count = cache->size - start < ID_BLOCK_SIZE ? cache->size - start : ID_BLOCK_SIZE;
+  value_id_t *ids = cache->ids + slot * ID_BLOCK_SIZE;
+  if (!decode_ids(cache->data + cache->offsets[block], count, ids)) {
+    fprintf(stderr, "Id block %zu is malformed\n", block);
+    exit(EXIT_FAILURE);
+  }
+  return ids;
+}
+
+void free_id_block_cache(id_block_cache *cache) {
+  free(cache->ids);
+  free(cache->blocks);
+  free(cache->slots);
+  free(cache->newer);
+  free(cache->older);
+  cache->ids = NULL;
+  cache->blocks = NULL;
+  cache->slots = NULL;
+  cache->newer = NULL;
+  cache->older = NULL;
+  cache->num_used = 0;
+  cache->num_allocated = 0;
+  cache->newest = SIZE_MAX;
+  cache->oldest = SIZE_MAX;
+}
@@ -0,0 +1,203 @@
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Contents of a section stored once in the bundle
+typedef struct unique_section {
+  const char *data;
+  size_t length;
+  uint64_t hash;
+  uint64_t offset;
+} unique_section;
+
+// FNV-1a
+static uint64_t hash_bytes(const char *data, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static size_t align_offset(size_t offset) { return offset + (TABLE_ALIGNMENT - offset % TABLE_ALIGNMENT) % TABLE_ALIGNMENT; }
+
+size_t write_solution_bundle(char **slugs, char **filenames, size_t num_collections, FILE *restrict stream) {
+  struct stat *sbs = xmalloc(num_collections * sizeof(struct stat));
+  int *fds = xmalloc(num_collections * sizeof(int));
+  char **maps = xmalloc(num_collections * sizeof(char *));
+  container_header *headers = xmalloc(num_collections * sizeof(container_header));
+  size_t **section_ids = xmalloc(num_collections * sizeof(size_t *));
+
+  unique_section *uniques = NULL;
+  size_t num_uniques = 0;
+  size_t num_sections = 0;
+
+  for (size_t i = 0; i < num_collections; ++i) {
+    if (strlen(slugs[i]) >= BUNDLE_SLUG_SIZE) {
+      fprintf(stderr, "Slug %s is too long for a bundle\n", slugs[i]);
+      exit(EXIT_FAILURE);
+    }
+    maps[i] = file_to_mmap(filenames[i], sbs + i, fds + i);
+    if (!validate_dual_graph(maps[i], sbs[i].st_size)) {
+      fprintf(stderr, "Failed to bundle %s\n", filenames[i]);
+      exit(EXIT_FAILURE);
+    }
+    memcpy(headers + i, maps[i], sizeof(container_header));
+    const section_entry *entries = (const section_entry *)(maps[i] + sizeof(container_header));
+    section_ids[i] = xmalloc(headers[i].num_sections * sizeof(size_t));
+    for (uint32_t j = 0; j < headers[i].num_sections; ++j) {
+      const char *data = maps[i] + entries[j].offset;
+      const size_t length = entries[j].length;
+      const uint64_t hash = hash_bytes(data, length);
+      size_t k = 0;
+      for (; k < num_uniques; ++k) {
+        if (uniques[k].hash == hash && uniques[k].length == length && !memcmp(uniques[k].data, data, length)) {
+          break;
+        }
+      }
+      if (k == num_uniques) {
+        uniques = xrealloc(uniques, (num_uniques + 1) * sizeof(unique_section));
+        uniques[num_uniques++] = (unique_section){data, length, hash, 0};
+      }
+      section_ids[i][j] = k;
+      num_sections++;
+    }
+  }
+
+  // Bundle directory, then the section directories of each collection, then the sections
+  bundle_entry *bundle_entries = xcalloc(num_collections, sizeof(bundle_entry));
+  size_t offset = sizeof(bundle_header) + num_collections * sizeof(bundle_entry);
+  for (size_t i = 0; i < num_collections; ++i) {
+    offset = align_offset(offset);
+    strcpy(bundle_entries[i].slug, slugs[i]);
+    bundle_entries[i].directory_offset = offset;
+    offset += sizeof(container_header) + headers[i].num_sections * sizeof(section_entry);
+  }
+  for (size_t k = 0; k < num_uniques; ++k) {
+    offset = align_offset(offset);
+    uniques[k].offset = offset;
+    offset += uniques[k].length;
+  }
+
+  bundle_header header = {0};
+  memcpy(header.magic, SOLUTION_BUNDLE_MAGIC, sizeof(header.magic));
+  header.version = num_collections ? headers[0].version : 0;
+  header.num_collections = num_collections;
+  header.file_size = offset;
+
+  size_t total = 0;
+  WRITE_FIELD(total, stream, header);
+  WRITE_ARRAY(total, stream, bundle_entries, num_collections);
+  for (size_t i = 0; i < num_collections; ++i) {
+    WRITE_PADDING(total, stream);
+    container_header h = headers[i];
+    h.file_size = header.file_size;
+    WRITE_FIELD(total, stream, h);
+    const section_entry *entries = (const section_entry *)(maps[i] + sizeof(container_header));
+    for (uint32_t j = 0; j < h.num_sections; ++j) {
+      section_entry e = entries[j];
+      e.offset = uniques[section_ids[i][j]].offset;
+      WRITE_FIELD(total, stream, e);
+    }
+  }
+  for (size_t k = 0; k < num_uniques; ++k) {
+    WRITE_PADDING(total, stream);
+    WRITE_ARRAY(total, stream, uniques[k].data, uniques[k].length);
+  }
+
+  printf("Bundled %zu collections with %zu of %zu sections unique\n", num_collections, num_uniques, num_sections);
+
+  for (size_t i = 0; i < num_collections; ++i) {
+    munmap(maps[i], sbs[i].st_size);
+    close(fds[i]);
+    free(section_ids[i]);
+  }
+  free(bundle_entries);
+  free(uniques);
+  free(section_ids);
+  free(headers);
+  free(maps);
+  free(fds);
+  free(sbs);
+
+  return total;
+}
+
+solution_bundle load_solution_bundle(const char *filename) {
+  solution_bundle result = {0};
+  result.buffer = file_to_mmap(filename, &(result.sb), &(result.fd));
+
+  const size_t size = result.sb.st_size;
+  bundle_header header;
+  if (size < sizeof(bundle_header)) {
+    fprintf(stderr, "%s is too short for a bundle\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  memcpy(&header, result.buffer, sizeof(bundle_header));
+  if (memcmp(header.magic, SOLUTION_BUNDLE_MAGIC, sizeof(header.magic)) || header.file_size != size ||
+      header.num_collections > (size - sizeof(bundle_header)) / sizeof(bundle_entry)) {
+    fprintf(stderr, "%s is not a valid bundle\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  result.num_collections = header.num_collections;
+  result.entries = (const bundle_entry *)(result.buffer + sizeof(bundle_header));
+  result.readers = xmalloc(result.num_collections * sizeof(dual_graph_reader));
+  result.initialized = xcalloc(result.num_collections, sizeof(bool));
+
+  return result;
+}
+
+dual_graph_reader *get_bundle_reader(solution_bundle *bundle, const char *slug) {
+  for (size_t i = 0; i < bundle->num_collections; ++i) {
+    const bundle_entry *entry = bundle->entries + i;
+    if (strncmp(entry->slug, slug, BUNDLE_SLUG_SIZE)) {
+      continue;
+    }
+    if (!bundle->initialized[i]) {
+      if (!validate_dual_graph_at(bundle->buffer, bundle->sb.st_size, entry->directory_offset)) {
+        fprintf(stderr, "Collection %s of the bundle is malformed\n", slug);
+        return NULL;
+      }
+      dual_graph_reader *dgr = bundle->readers + i;
+      *dgr = (dual_graph_reader){0};
+      // The bundle owns the mapping
+      dgr->fd = -1;
+      dgr->buffer = bundle->buffer;
+      dgr->directory = bundle->buffer + entry->directory_offset;
+      unbuffer_dual_graph_reader(dgr);
+      bundle->initialized[i] = true;
+    }
+    return bundle->readers + i;
+  }
+  return NULL;
+}
+
+void unload_solution_bundle(solution_bundle *bundle) {
+  for (size_t i = 0; i < bundle->num_collections; ++i) {
+    if (bundle->initialized[i]) {
+      unload_dual_graph_reader(bundle->readers + i);
+    }
+  }
+  free(bundle->readers);
+  free(bundle->initialized);
+  bundle->readers = NULL;
+  bundle->initialized = NULL;
+  bundle->entries = NULL;
+  bundle->num_collections = 0;
+
+  munmap(bundle->buffer, bundle->sb.st_size);
+  close(bundle->fd);
+  bundle->buffer = NULL;
+  bundle->fd = -1;
+}
+
+solution_bundle *allocate_solution_bundle(const char *filename) {
+  solution_bundle *result = xmalloc(sizeof(solution_bundle));
+  *result = load_solution_bundle(filename);
+  return result;
+}
@@ -6,6 +6,7 @@
 #include "tinytsumego2/util.h"
 #include <assert.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
 #include <search.h>
 #include <stdio.h>
@@ -15,135 +16,662 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#define DUAL_READER_VERSION (5)
+#define DUAL_READER_VERSION (14)
 
-static inline size_t frozen_tail_keys_size(size_t tail_size) { return tail_size / 2; }
+size_t frozen_tail_offsets_size(size_t size, size_t tail_size) { return tail_size ? ceil_divz(size, TAIL_BUCKET_SIZE) : 0; }
+
+#define STORED_KEYS_BLOCK_WORDS (1 + STORED_KEYS_BLOCK_SIZE / 64)
+
+size_t stored_keys_size(size_t size) { return ceil_divz(size, STORED_KEYS_BLOCK_SIZE) * STORED_KEYS_BLOCK_WORDS; }
+
+size_t stored_key_rank(const frozen_hash_table *fht, size_t key) {
+  if (fht->stored_keys_sorted) {
+    size_t lo = 0;
+    size_t hi = fht->num_stored_keys;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (fht->stored_keys[mid] < key) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return (lo < fht->num_stored_keys && fht->stored_keys[lo] == key) ? lo : SIZE_MAX;
+  }
+  const uint64_t *block = fht->stored_keys + (key / STORED_KEYS_BLOCK_SIZE) * STORED_KEYS_BLOCK_WORDS;
+  const size_t offset = key % STORED_KEYS_BLOCK_SIZE;
+  const uint64_t *bits = block + 1;
+  const uint64_t bit = 1ULL << (offset % 64);
+  if (!(bits[offset / 64] & bit)) {
+    return SIZE_MAX;
+  }
+  size_t rank = block[0];
+  for (size_t i = 0; i < offset / 64; ++i) {
+    rank += __builtin_popcountll(bits[i]);
+  }
+  return rank + __builtin_popcountll(bits[offset / 64] & (bit - 1));
+}
 
 size_t __to_compressed_key(const dual_graph_reader *dgr, const state *s) { return to_compressed_key(&(dgr->keyspace.compressed), s); }
 
 size_t __to_symmetric_key(const dual_graph_reader *dgr, const state *s) { return to_symmetric_key(&(dgr->keyspace.symmetric), s); }
 
-size_t write_dual_graph(const dual_graph *restrict dg, const frozen_hash_table *restrict fht, FILE *restrict stream) {
-  int version = DUAL_READER_VERSION;
+// Content of one section before it is placed in the container
+typedef struct section_data {
+  section_type type;
+  const void *data;
+  size_t length;
+} section_data;
+
+static size_t write_sections(const section_data *sections, int num_sections, FILE *restrict stream) {
+  container_header header = {0};
+  memcpy(header.magic, DUAL_GRAPH_MAGIC, sizeof(header.magic));
+  header.version = DUAL_READER_VERSION;
+  header.num_sections = num_sections;
+
+  section_entry *entries = xmalloc(num_sections * sizeof(section_entry));
+  size_t offset = sizeof(container_header) + num_sections * sizeof(section_entry);
+  for (int i = 0; i < num_sections; ++i) {
+    offset += (TABLE_ALIGNMENT - offset % TABLE_ALIGNMENT) % TABLE_ALIGNMENT;
+    entries[i] = (section_entry){sections[i].type, TABLE_ALIGNMENT, offset, sections[i].length};
+    offset += sections[i].length;
+  }
+  header.file_size = offset;
+
   size_t total = 0;
-  WRITE_FIELD(total, stream, version);
+  WRITE_FIELD(total, stream, header);
+  WRITE_ARRAY(total, stream, entries, num_sections);
+  for (int i = 0; i < num_sections; ++i) {
+    WRITE_PADDING(total, stream);
+    WRITE_ARRAY(total, stream, (const char *)sections[i].data, sections[i].length);
+  }
+  free(entries);
+
+  return total;
+}
+
+// Serialize any keyspace variant with ids provided by `get_id`
+static size_t write_container(keyspace_type type, const abstract_keyspace *ks, int num_moves, const stones_t *moves,
+                              const frozen_hash_table *fht, value_id_t (*get_id)(size_t), const side_table *st, FILE *restrict stream) {
+  section_data sections[NUM_SECTION_TYPES];
+  int num_sections = 0;
+  void add_section(section_type section, const void *data, size_t length) {
+    sections[num_sections++] = (section_data){section, data, length};
+  }
+
+  const monotonic_compressor *comp = &(ks->compressor);
+
+  char *metadata = NULL;
+  size_t metadata_length = 0;
+  FILE *meta = open_memstream(&metadata, &metadata_length);
+  size_t unused = 0;
+  WRITE_FIELD(unused, meta, type);
+  WRITE_FIELD(unused, meta, ks->size);
+  WRITE_FIELD(unused, meta, ks->fast_size);
+  WRITE_FIELD(unused, meta, ks->prefix_m);
+  WRITE_FIELD(unused, meta, ks->root);
+  WRITE_FIELD(unused, meta, comp->num_checkpoints);
+  WRITE_FIELD(unused, meta, comp->uncompressed_size);
+  WRITE_FIELD(unused, meta, comp->size);
+  WRITE_FIELD(unused, meta, comp->factor);
+  WRITE_FIELD(unused, meta, num_moves);
+  WRITE_FIELD(unused, meta, fht->id_width);
+  WRITE_FIELD(unused, meta, fht->id_layout);
+  WRITE_FIELD(unused, meta, fht->bulk_map_size);
+  WRITE_FIELD(unused, meta, fht->tail_size);
+  WRITE_FIELD(unused, meta, st->num_slots);
+  fclose(meta);
+  add_section(METADATA_SECTION, metadata, metadata_length);
+
+  add_section(CHECKPOINTS_SECTION, comp->checkpoints, comp->num_checkpoints * sizeof(size_t));
+  add_section(DELTAS_SECTION, comp->deltas, comp->uncompressed_size);
+
+  // Specific keyspace tables are mapped in place on load. Sections are aligned so offsets relative to the section suffice.
+  char *keyspace = NULL;
+  size_t keyspace_length = 0;
+  if (type == COMPRESSED_KEYSPACE || type == SYMMETRIC_KEYSPACE) {
+    FILE *ks_stream = open_memstream(&keyspace, &keyspace_length);
+    if (type == COMPRESSED_KEYSPACE) {
+      write_tight_keyspace(&(((const compressed_keyspace *)ks)->keyspace), 0, ks_stream);
+    } else {
+      const symmetric_keyspace *sks = (const symmetric_keyspace *)ks;
+      size_t total = 0;
+      WRITE_FIELD(total, ks_stream, sks->color_m);
+      write_symmetry(&(sks->symmetry), total, ks_stream);
+    }
+    fclose(ks_stream);
+    add_section(KEYSPACE_SECTION, keyspace, keyspace_length);
+  }
+
+  add_section(MOVES_SECTION, moves, num_moves * sizeof(stones_t));
+
+  // Pruned tables hold ids by rank of the stored keys
+  const size_t num_ids = fht->stored_keys ? fht->num_stored_keys : ks->size;
+  if (fht->stored_keys_sorted) {
+    add_section(STORED_KEY_LIST_SECTION, fht->stored_keys, fht->num_stored_keys * sizeof(uint64_t));
+  } else if (fht->stored_keys) {
+    add_section(STORED_KEYS_SECTION, fht->stored_keys, stored_keys_size(ks->size) * sizeof(uint64_t));
+  }
+
+  uint64_t *bulk_ids = NULL;
+  uint64_t *offsets = NULL;
+  unsigned char *data = NULL;
+  if (fht->id_layout == BLOCK_IDS) {
+    const size_t num_blocks = ceil_divz(num_ids, ID_BLOCK_SIZE);
+    offsets = xmalloc((num_blocks + 1) * sizeof(uint64_t));
+    value_id_t ids[ID_BLOCK_SIZE];
+    offsets[0] = 0;
+    for (size_t b = 0; b < num_blocks; ++b) {
+      const size_t start = b * ID_BLOCK_SIZE;
+      const size_t count = num_ids - start < ID_BLOCK_SIZE ? num_ids - start : ID_BLOCK_SIZE;
+      for (size_t i = 0; i < count; ++i) {
+        ids[i] = get_id(start + i);
+      }
+      data = xrealloc(data, offsets[b] + max_encoded_ids_size(count));
+      offsets[b + 1] = offsets[b] + encode_ids(ids, count, data + offsets[b]);
+    }
+    data = xrealloc(data, offsets[num_blocks] + ID_BLOCK_PADDING);
+    memset(data + offsets[num_blocks], 0, ID_BLOCK_PADDING);
+    add_section(ID_BLOCK_OFFSETS_SECTION, offsets, (num_blocks + 1) * sizeof(uint64_t));
+    add_section(ID_BLOCKS_SECTION, data, offsets[num_blocks] + ID_BLOCK_PADDING);
+  } else {
+    const size_t num_words = frozen_ids_size(num_ids, fht->id_width);
+    bulk_ids = xcalloc(num_words, sizeof(uint64_t));
+    for (size_t i = 0; i < num_ids; ++i) {
+      set_frozen_hash_id(bulk_ids, fht->id_width, i, get_id(i));
+    }
+    add_section(BULK_IDS_SECTION, bulk_ids, num_words * sizeof(uint64_t));
+  }
 
-  WRITE_FIELD(total, stream, dg->type);
-  WRITE_FIELD(total, stream, dg->keyspace._.size);
-  WRITE_FIELD(total, stream, dg->keyspace._.fast_size);
-  WRITE_FIELD(total, stream, dg->keyspace._.prefix_m);
-  WRITE_FIELD(total, stream, dg->keyspace._.root);
+  add_section(BULK_MAP_SECTION, fht->bulk_map, fht->bulk_map_size * sizeof(dual_table_value));
+  add_section(TAIL_VALUES_SECTION, fht->tail_values, fht->tail_size * sizeof(dual_table_value));
+  add_section(TAIL_OFFSETS_SECTION, fht->tail_offsets, frozen_tail_offsets_size(num_ids, fht->tail_size) * sizeof(size_t));
+  add_section(SIDE_KEYS_SECTION, st->keys, st->num_slots * sizeof(size_t));
+  add_section(SIDE_VALUES_SECTION, st->values, st->num_slots * sizeof(dual_table_value));
 
-  const monotonic_compressor *comp = &(dg->keyspace._.compressor);
-  WRITE_FIELD(total, stream, comp->num_checkpoints);
-  WRITE_ARRAY(total, stream, comp->checkpoints, comp->num_checkpoints);
-  WRITE_FIELD(total, stream, comp->uncompressed_size);
-  WRITE_ARRAY(total, stream, comp->deltas, comp->uncompressed_size);
-  WRITE_FIELD(total, stream, comp->size);
-  WRITE_FIELD(total, stream, comp->factor);
+  const size_t total = write_sections(sections, num_sections, stream);
 
-  // Note: Specific keyspaces re-constructed on load
+  free(data);
+  free(offsets);
+  free(bulk_ids);
+  free(keyspace);
+  free(metadata);
 
-  WRITE_FIELD(total, stream, dg->num_moves);
-  WRITE_ARRAY(total, stream, dg->moves, dg->num_moves);
+  return total;
+}
 
-  for (size_t i = 0; i < dg->keyspace._.size; ++i) {
+size_t write_dual_graph(const dual_graph *restrict dg, const frozen_hash_table *restrict fht, FILE *restrict stream) {
+  value_id_t get_id(size_t i) {
     dual_table_value v = (dual_table_value){
         dg->plain_values[i],
         dg->forcing_values[i],
     };
     dual_table_value *tv = bsearch(&v, fht->bulk_map, fht->bulk_map_size, sizeof(dual_table_value), compare_dual_table_values);
-    value_id_t vid = tv ? (value_id_t)(tv - fht->bulk_map) : VALUE_ID_SENTINEL;
-    WRITE_FIELD(total, stream, vid);
+    return tv ? (value_id_t)(tv - fht->bulk_map) : VALUE_ID_SENTINEL(fht->id_width);
   }
 
-  WRITE_FIELD(total, stream, fht->bulk_map_size);
-  WRITE_ARRAY(total, stream, fht->bulk_map, fht->bulk_map_size);
-
-  WRITE_FIELD(total, stream, fht->tail_size);
-  WRITE_ARRAY(total, stream, fht->tail_values, fht->tail_size);
-  WRITE_ARRAY(total, stream, fht->tail_keys, frozen_tail_keys_size(fht->tail_size));
+  side_table st = prepare_side_table(dg);
+  const size_t total = write_container(dg->type, &(dg->keyspace._), dg->num_moves, dg->moves, fht, get_id, &st, stream);
+  free_side_table(&st);
 
   return total;
 }
 
-void unbuffer_dual_graph_reader(dual_graph_reader *dgr) {
-  char *map = dgr->buffer;
+bool validate_dual_graph(const char *buffer, size_t size) { return validate_dual_graph_at(buffer, size, 0); }
 
-  int version = 0;
-  READ_FIELD(map, version);
+bool validate_dual_graph_at(const char *buffer, size_t size, size_t directory_offset) {
+  container_header header;
+  if (directory_offset > size || size - directory_offset < sizeof(container_header)) {
+    fprintf(stderr, "Dual graph of %zu bytes is too short for a header at %zu\n", size, directory_offset);
+    return false;
+  }
+  memcpy(&header, buffer + directory_offset, sizeof(container_header));
+  if (memcmp(header.magic, DUAL_GRAPH_MAGIC, sizeof(header.magic))) {
+    fprintf(stderr, "Not a dual graph container\n");
+    return false;
+  }
+  if (header.version != DUAL_READER_VERSION) {
+    fprintf(stderr, "Unknown dual graph version %d\n", header.version);
+    return false;
+  }
+  if (header.file_size != size) {
+    fprintf(stderr, "Dual graph should be %zu bytes instead of %zu\n", (size_t)header.file_size, size);
+    return false;
+  }
+  if (header.num_sections > (size - directory_offset - sizeof(container_header)) / sizeof(section_entry)) {
+    fprintf(stderr, "Dual graph section directory does not fit the file\n");
+    return false;
+  }
+  // Section offsets are relative to the start of the file
+  const section_entry *entries = (const section_entry *)(buffer + directory_offset + sizeof(container_header));
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    const section_entry *e = entries + i;
+    if (!e->alignment || e->offset % e->alignment || e->offset > size || e->length > size - e->offset) {
+      fprintf(stderr, "Dual graph section %u of type %u is out of bounds or misaligned\n", i, e->type);
+      return false;
+    }
+  }
+  return true;
+}
+
+const section_entry *find_dual_graph_section(const char *buffer, section_type type) {
+  container_header header;
+  memcpy(&header, buffer, sizeof(container_header));
+  const section_entry *entries = (const section_entry *)(buffer + sizeof(container_header));
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    if (entries[i].type == type) {
+      return entries + i;
+    }
+  }
+  return NULL;
+}
+
+// Start of a required section. The length is checked unless it is SIZE_MAX.
+static char *map_section(const dual_graph_reader *dgr, section_type type, size_t length) {
+  const section_entry *entry = find_dual_graph_section(dgr->directory, type);
+  if (!entry) {
+    fprintf(stderr, "Dual graph section of type %d is missing\n", type);
+    exit(EXIT_FAILURE);
+  }
+  if (length != SIZE_MAX && entry->length != length) {
+    fprintf(stderr, "Dual graph section of type %d has %zu bytes instead of %zu\n", type, (size_t)entry->length, length);
+    exit(EXIT_FAILURE);
+  }
+  return dgr->buffer + entry->offset;
+}
+
+// Number of 64-bit words in each move mask
+static size_t move_table_words(int num_moves) { return ceil_divz(num_moves, 64); }
+
+// Four masks followed by two gains per move padded to whole words
+size_t move_record_size(int num_moves) {
+  return 4 * move_table_words(num_moves) * sizeof(uint64_t) + ceil_divz(2 * num_moves * sizeof(float), 8) * 8;
+}
 
-  if (version != DUAL_READER_VERSION) {
-    fprintf(stderr, "Unknown dual graph version %d\n", version);
+void unbuffer_dual_graph_reader(dual_graph_reader *dgr) {
+  if (!dgr->directory) {
+    dgr->directory = dgr->buffer;
+  }
+  // Callers that know the size of the file validate against it before
+  container_header header;
+  memcpy(&header, dgr->directory, sizeof(container_header));
+  if (!validate_dual_graph_at(dgr->buffer, header.file_size, dgr->directory - dgr->buffer)) {
     exit(EXIT_FAILURE);
   }
 
+  char *map = map_section(dgr, METADATA_SECTION, SIZE_MAX);
+  monotonic_compressor *comp = &(dgr->keyspace._.compressor);
   READ_FIELD(map, dgr->type);
   READ_FIELD(map, dgr->keyspace._.size);
   READ_FIELD(map, dgr->keyspace._.fast_size);
   READ_FIELD(map, dgr->keyspace._.prefix_m);
   READ_FIELD(map, dgr->keyspace._.root);
-
-  monotonic_compressor *comp = &(dgr->keyspace._.compressor);
-
   READ_FIELD(map, comp->num_checkpoints);
-
-  // Memory map aux data to save RAM
-  MAP_ARRAY_FIELD(map, comp->checkpoints, comp->num_checkpoints);
-
   READ_FIELD(map, comp->uncompressed_size);
-
-  MAP_ARRAY_FIELD(map, comp->deltas, comp->uncompressed_size);
-
   READ_FIELD(map, comp->size);
-
   READ_FIELD(map, comp->factor);
+  READ_FIELD(map, dgr->num_moves);
+  READ_FIELD(map, dgr->value_table.id_width);
+  READ_FIELD(map, dgr->value_table.id_layout);
+  READ_FIELD(map, dgr->value_table.bulk_map_size);
+  READ_FIELD(map, dgr->value_table.tail_size);
+  READ_FIELD(map, dgr->side_table.num_slots);
+
+  const size_t size = dgr->keyspace._.size;
+
+  // Memory map aux data to save RAM
+  comp->checkpoints = (size_t *)map_section(dgr, CHECKPOINTS_SECTION, comp->num_checkpoints * sizeof(size_t));
+  comp->deltas = (unsigned char *)map_section(dgr, DELTAS_SECTION, comp->uncompressed_size);
 
   if (dgr->type == COMPRESSED_KEYSPACE) {
-    dgr->keyspace.compressed.keyspace = create_tight_keyspace(&(dgr->keyspace._.root), true);
+    map = map_section(dgr, KEYSPACE_SECTION, SIZE_MAX);
+    map_tight_keyspace(&(dgr->keyspace.compressed.keyspace), map, dgr->buffer);
     dgr->to_key = __to_compressed_key;
   } else if (dgr->type == SYMMETRIC_KEYSPACE) {
-    dgr->keyspace.symmetric.symmetry = compute_symmetry(&(dgr->keyspace._.root));
+    map = map_section(dgr, KEYSPACE_SECTION, SIZE_MAX);
+    READ_FIELD(map, dgr->keyspace.symmetric.color_m);
+    map_symmetry(&(dgr->keyspace.symmetric.symmetry), map, dgr->buffer);
     dgr->to_key = __to_symmetric_key;
   } else {
     // Support testing of mock keyspaces
     dgr->to_key = NULL;
   }
-
-  READ_FIELD(map, dgr->num_moves);
+  select_target_predicates(&(dgr->keyspace._.root), &(dgr->in_atari), &(dgr->can_take));
 
   dgr->moves = xmalloc(dgr->num_moves * sizeof(stones_t));
-  READ_ARRAY_FIELD(map, dgr->moves, dgr->num_moves);
+  memcpy(dgr->moves, map_section(dgr, MOVES_SECTION, dgr->num_moves * sizeof(stones_t)), dgr->num_moves * sizeof(stones_t));
+
+  // Ids of pruned exports are indexed by the rank of the stored keys
+  size_t num_ids = size;
+  dgr->value_table.num_stored_keys = 0;
+  dgr->value_table.stored_keys = NULL;
+  dgr->value_table.stored_keys_sorted = false;
+  const section_entry *list_entry = find_dual_graph_section(dgr->directory, STORED_KEY_LIST_SECTION);
+  if (list_entry) {
+    num_ids = list_entry->length / sizeof(uint64_t);
+    const uint64_t *stored_keys = (uint64_t *)map_section(dgr, STORED_KEY_LIST_SECTION, num_ids * sizeof(uint64_t));
+    for (size_t i = 0; i < num_ids; ++i) {
+      if (stored_keys[i] >= size || (i && stored_keys[i] <= stored_keys[i - 1])) {
+        fprintf(stderr, "Stored keys must be increasing and inside the keyspace\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    dgr->value_table.num_stored_keys = num_ids;
+    dgr->value_table.stored_keys = stored_keys;
+    dgr->value_table.stored_keys_sorted = true;
+  } else if (find_dual_graph_section(dgr->directory, STORED_KEYS_SECTION)) {
+    const size_t num_words = stored_keys_size(size);
+    const uint64_t *stored_keys = (uint64_t *)map_section(dgr, STORED_KEYS_SECTION, num_words * sizeof(uint64_t));
+    num_ids = 0;
+    if (num_words) {
+      const uint64_t *last = stored_keys + num_words - STORED_KEYS_BLOCK_WORDS;
+      num_ids = last[0];
+      for (size_t i = 1; i < STORED_KEYS_BLOCK_WORDS; ++i) {
+        num_ids += __builtin_popcountll(last[i]);
+      }
+    }
+    dgr->value_table.num_stored_keys = num_ids;
+    dgr->value_table.stored_keys = stored_keys;
+  }
 
-  MAP_ARRAY_FIELD(map, dgr->value_table.bulk_ids, dgr->keyspace._.size);
+  if (dgr->value_table.id_layout == BLOCK_IDS) {
+    const size_t num_blocks = ceil_divz(num_ids, ID_BLOCK_SIZE);
+    const uint64_t *offsets = (uint64_t *)map_section(dgr, ID_BLOCK_OFFSETS_SECTION, (num_blocks + 1) * sizeof(uint64_t));
+    const unsigned char *data = (unsigned char *)map_section(dgr, ID_BLOCKS_SECTION, offsets[num_blocks] + ID_BLOCK_PADDING);
+    dgr->value_table.bulk_ids = NULL;
+    dgr->value_table.id_blocks = xmalloc(sizeof(id_block_cache));
+    *dgr->value_table.id_blocks = create_id_block_cache(num_ids, offsets, data, ID_BLOCK_CACHE_CAPACITY);
+  } else {
+    const size_t num_words = frozen_ids_size(num_ids, dgr->value_table.id_width);
+    dgr->value_table.bulk_ids = (uint64_t *)map_section(dgr, BULK_IDS_SECTION, num_words * sizeof(uint64_t));
+    dgr->value_table.id_blocks = NULL;
+  }
 
-  READ_FIELD(map, dgr->value_table.bulk_map_size);
+  const size_t bulk_map_length = dgr->value_table.bulk_map_size * sizeof(dual_table_value);
+  dgr->value_table.bulk_map = xmalloc(bulk_map_length);
+  memcpy(dgr->value_table.bulk_map, map_section(dgr, BULK_MAP_SECTION, bulk_map_length), bulk_map_length);
 
-  dgr->value_table.bulk_map = xmalloc(dgr->value_table.bulk_map_size * sizeof(dual_table_value));
-  READ_ARRAY_FIELD(map, dgr->value_table.bulk_map, dgr->value_table.bulk_map_size);
+  const size_t tail_size = dgr->value_table.tail_size;
+  dgr->value_table.tail_values = (dual_table_value *)map_section(dgr, TAIL_VALUES_SECTION, tail_size * sizeof(dual_table_value));
+  dgr->value_table.tail_offsets =
+      (size_t *)map_section(dgr, TAIL_OFFSETS_SECTION, frozen_tail_offsets_size(num_ids, tail_size) * sizeof(size_t));
 
-  READ_FIELD(map, dgr->value_table.tail_size);
+  side_table *st = &(dgr->side_table);
+  if (st->num_slots & (st->num_slots - 1)) {
+    fprintf(stderr, "Number of side slots must be a power of two\n");
+    exit(EXIT_FAILURE);
+  }
+  st->keys = (size_t *)map_section(dgr, SIDE_KEYS_SECTION, st->num_slots * sizeof(size_t));
+  st->values = (dual_table_value *)map_section(dgr, SIDE_VALUES_SECTION, st->num_slots * sizeof(dual_table_value));
+  st->size = 0;
+  for (size_t i = 0; i < st->num_slots; ++i) {
+    st->size += st->keys[i] != SIDE_EMPTY_KEY;
+  }
+  // Probing for a missing key only terminates at an empty slot
+  if (st->num_slots && st->size == st->num_slots) {
+    fprintf(stderr, "Side table has no empty slots\n");
+    exit(EXIT_FAILURE);
+  }
+
+  dgr->move_table = (move_table){0};
+  if (find_dual_graph_section(dgr->directory, MOVE_IDS_SECTION)) {
+    move_table *mt = &(dgr->move_table);
+    mt->size = num_ids;
+    mt->num_words = move_table_words(dgr->num_moves);
+    mt->record_size = move_record_size(dgr->num_moves);
+    mt->ids = (uint32_t *)map_section(dgr, MOVE_IDS_SECTION, num_ids * sizeof(uint32_t));
+    const section_entry *entry = find_dual_graph_section(dgr->directory, MOVE_RECORDS_SECTION);
+    if (!entry || entry->length % mt->record_size) {
+      fprintf(stderr, "Move records do not match the move ids\n");
+      exit(EXIT_FAILURE);
+    }
+    mt->num_records = entry->length / mt->record_size;
+    mt->records = (unsigned char *)map_section(dgr, MOVE_RECORDS_SECTION, entry->length);
+  }
+
+  dgr->terminal_table = (terminal_table){0};
+  if (find_dual_graph_section(dgr->directory, TERMINAL_STEPS_SECTION)) {
+    dgr->terminal_table.size = num_ids;
+    dgr->terminal_table.steps = (terminal_step *)map_section(dgr, TERMINAL_STEPS_SECTION, num_ids * sizeof(terminal_step));
+  }
 
-  MAP_ARRAY_FIELD(map, dgr->value_table.tail_values, dgr->value_table.tail_size);
-  MAP_ARRAY_FIELD(map, dgr->value_table.tail_keys, frozen_tail_keys_size(dgr->value_table.tail_size));
+  // Hot slots are copied to RAM like the bulk map so they stay resident under every policy
+  dgr->hot_table = (hot_table){0};
+  const section_entry *hot_entry = find_dual_graph_section(dgr->directory, HOT_SLOTS_SECTION);
+  if (hot_entry && hot_entry->length) {
+    hot_table *ht = &(dgr->hot_table);
+    ht->num_slots = hot_entry->length / sizeof(hot_slot);
+    if (ht->num_slots & (ht->num_slots - 1)) {
+      fprintf(stderr, "Number of hot slots must be a power of two\n");
+      exit(EXIT_FAILURE);
+    }
+    ht->slots = xmalloc(hot_entry->length);
+    memcpy(ht->slots, map_section(dgr, HOT_SLOTS_SECTION, hot_entry->length), hot_entry->length);
+    for (size_t i = 0; i < ht->num_slots; ++i) {
+      ht->size += ht->slots[i].key != HOT_EMPTY_KEY;
+    }
+  }
 }
 
-dual_graph_reader load_dual_graph_reader(const char *filename) {
-  dual_graph_reader result;
-  char *map = file_to_mmap(filename, &(result.sb), &(result.fd));
+size_t convert_dual_graph_v5(char *buffer, FILE *restrict stream) {
+  char *map = buffer;
+
+  int version = 0;
+  READ_FIELD(map, version);
+  if (version != 5) {
+    fprintf(stderr, "Expected a version 5 dual graph instead of version %d\n", version);
+    exit(EXIT_FAILURE);
+  }
+
+  dual_graph_reader dgr = {0};
+  monotonic_compressor *comp = &(dgr.keyspace._.compressor);
+  READ_FIELD(map, dgr.type);
+  READ_FIELD(map, dgr.keyspace._.size);
+  READ_FIELD(map, dgr.keyspace._.fast_size);
+  READ_FIELD(map, dgr.keyspace._.prefix_m);
+  READ_FIELD(map, dgr.keyspace._.root);
+  READ_FIELD(map, comp->num_checkpoints);
+  MAP_ARRAY_FIELD(map, comp->checkpoints, comp->num_checkpoints);
+  READ_FIELD(map, comp->uncompressed_size);
+  MAP_ARRAY_FIELD(map, comp->deltas, comp->uncompressed_size);
+  READ_FIELD(map, comp->size);
+  READ_FIELD(map, comp->factor);
+
+  // Version 5 re-constructed the keyspace tables on load
+  const state *root = &(dgr.keyspace._.root);
+  size_t fast_size = dgr.keyspace._.fast_size;
+  if (dgr.type == COMPRESSED_KEYSPACE) {
+    dgr.keyspace.compressed.keyspace = create_tight_keyspace(root, true);
+    fast_size = dgr.keyspace.compressed.keyspace.size;
+  } else if (dgr.type == SYMMETRIC_KEYSPACE) {
+    const symmetric_keyspace sks = prepare_symmetric_keyspace(root);
+    dgr.keyspace.symmetric.symmetry = sks.symmetry;
+    dgr.keyspace.symmetric.color_m = sks.color_m;
+    fast_size = sks.fast_size;
+  }
+  if (fast_size != dgr.keyspace._.fast_size) {
+    fprintf(stderr, "Keyspace of %zu keys does not match the %zu keys of the file\n", fast_size, dgr.keyspace._.fast_size);
+    exit(EXIT_FAILURE);
+  }
 
-  result.buffer = map;
+  READ_FIELD(map, dgr.num_moves);
+  MAP_ARRAY_FIELD(map, dgr.moves, dgr.num_moves);
 
-  unbuffer_dual_graph_reader(&result);
+  const size_t size = dgr.keyspace._.size;
+  const value_id_t v5_sentinel = (value_id_t)-1;
+  value_id_t *v5_ids;
+  MAP_ARRAY_FIELD(map, v5_ids, size);
 
+  frozen_hash_table *fht = &(dgr.value_table);
+  READ_FIELD(map, fht->bulk_map_size);
+  MAP_ARRAY_FIELD(map, fht->bulk_map, fht->bulk_map_size);
+  READ_FIELD(map, fht->tail_size);
+  MAP_ARRAY_FIELD(map, fht->tail_values, fht->tail_size);
+  // Sorted tail keys are superseded by tail offsets
+
+  fht->id_width = 1;
+  while (fht->bulk_map_size >= (1ULL << fht->id_width)) {
+    fht->id_width++;
+  }
+  fht->id_layout = PACKED_IDS;
+
+  const size_t num_offsets = frozen_tail_offsets_size(size, fht->tail_size);
+  fht->tail_offsets = xmalloc(num_offsets * sizeof(size_t));
+  size_t j = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (num_offsets && i % TAIL_BUCKET_SIZE == 0) {
+      fht->tail_offsets[i / TAIL_BUCKET_SIZE] = j;
+    }
+    j += v5_ids[i] == v5_sentinel;
+  }
+  if (j != fht->tail_size) {
+    fprintf(stderr, "Found %zu tail keys instead of %zu\n", j, fht->tail_size);
+    exit(EXIT_FAILURE);
+  }
+
+  value_id_t get_id(size_t i) { return v5_ids[i] == v5_sentinel ? VALUE_ID_SENTINEL(fht->id_width) : v5_ids[i]; }
+
+  const side_table st = {0};
+  const size_t total = write_container(dgr.type, &(dgr.keyspace._), dgr.num_moves, dgr.moves, fht, get_id, &st, stream);
+
+  free(fht->tail_offsets);
+  if (dgr.type == COMPRESSED_KEYSPACE) {
+    free_tight_keyspace(&(dgr.keyspace.compressed.keyspace));
+  } else if (dgr.type == SYMMETRIC_KEYSPACE) {
+    free_symmetry(&(dgr.keyspace.symmetric.symmetry));
+  }
+
+  return total;
+}
+
+// Page-aligned range covering a section
+static void section_pages(const char *buffer, const section_entry *entry, char **start, size_t *length) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t first = (uintptr_t)(buffer + entry->offset) / page_size * page_size;
+  const uintptr_t last = ceil_divz((uintptr_t)(buffer + entry->offset + entry->length), page_size) * page_size;
+  *start = (char *)first;
+  *length = last - first;
+}
+
+// Tables consulted on every lookup regardless of the key
+static bool is_index_section(section_type type) {
+  return type == CHECKPOINTS_SECTION || type == DELTAS_SECTION || type == KEYSPACE_SECTION || type == TAIL_OFFSETS_SECTION ||
+         type == ID_BLOCK_OFFSETS_SECTION || type == SIDE_KEYS_SECTION || type == STORED_KEYS_SECTION ||
+         type == STORED_KEY_LIST_SECTION;
+}
+
+static void lock_index_sections(const dual_graph_reader *dgr) {
+  for (section_type type = 0; type < NUM_SECTION_TYPES; ++type) {
+    const section_entry *entry = find_dual_graph_section(dgr->directory, type);
+    if (!entry || !entry->length || !is_index_section(type)) {
+      continue;
+    }
+    char *start;
+    size_t length;
+    section_pages(dgr->buffer, entry, &start, &length);
+    if (mlock(start, length)) {
+      perror("Failed to lock index section");
+    }
+  }
+}
+
+dual_graph_reader load_dual_graph_reader(const char *filename) { return load_dual_graph_reader_with_policy(filename, RANDOM_RESIDENCY); }
+
+dual_graph_reader load_dual_graph_reader_with_policy(const char *filename, residency_policy policy) {
+  dual_graph_reader result;
+  if (!try_load_dual_graph_reader_with_policy(filename, policy, &result)) {
+    fprintf(stderr, "Failed to load %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
   return result;
 }
 
+bool try_load_dual_graph_reader_with_policy(const char *filename, residency_policy policy, dual_graph_reader *result) {
+  char *map = try_file_to_mmap_with_policy(filename, &(result->sb), &(result->fd), policy);
+  if (!map) {
+    return false;
+  }
+
+  if (!validate_dual_graph(map, result->sb.st_size)) {
+    munmap(map, result->sb.st_size);
+    close(result->fd);
+    return false;
+  }
+
+  result->buffer = map;
+  result->directory = map;
+  unbuffer_dual_graph_reader(result);
+
+  if (policy == LOCKED_RESIDENCY) {
+    lock_index_sections(result);
+  }
+
+  return true;
+}
+
+size_t dual_graph_reader_private_bytes(const dual_graph_reader *dgr) {
+  size_t total = dgr->num_moves * sizeof(stones_t) + dgr->value_table.bulk_map_size * sizeof(dual_table_value) +
+                 dgr->hot_table.num_slots * sizeof(hot_slot);
+  if (dgr->type == COMPRESSED_KEYSPACE) {
+    total += 2 * dgr->keyspace.compressed.keyspace.num_blocks * sizeof(stones_t *);
+  } else if (dgr->type == SYMMETRIC_KEYSPACE) {
+    total += 2 * dgr->keyspace.symmetric.symmetry.num_blocks * sizeof(stones_t *);
+  }
+  const id_block_cache *cache = dgr->value_table.id_blocks;
+  if (cache) {
+    total += sizeof(id_block_cache) + cache->num_allocated * (ID_BLOCK_SIZE * sizeof(value_id_t) + 3 * sizeof(size_t)) +
+             (cache->slots ? cache->num_blocks * sizeof(size_t) : 0);
+  }
+  return total;
+}
+
+static const char *SECTION_NAMES[NUM_SECTION_TYPES] = {
+    "metadata",  "checkpoints", "deltas",      "keyspace",     "moves",     "bulk ids",    "id block offsets",
+    "id blocks", "bulk map",    "tail values", "tail offsets", "side keys", "side values",      "move ids",
+    "move records", "terminal steps", "hot slots",   "stored keys", "stored key list",
+};
+
+void get_dual_graph_residency(const dual_graph_reader *dgr, section_residency residency[NUM_SECTION_TYPES]) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  for (section_type type = 0; type < NUM_SECTION_TYPES; ++type) {
+    residency[type] = (section_residency){0, 0};
+    const section_entry *entry = find_dual_graph_section(dgr->directory, type);
+    if (!entry || !entry->length) {
+      continue;
+    }
+    char *start;
+    size_t length;
+    section_pages(dgr->buffer, entry, &start, &length);
+    const size_t num_pages = length / page_size;
+    unsigned char *vec = xmalloc(num_pages);
+    if (mincore(start, length, vec)) {
+      perror("mincore");
+      free(vec);
+      continue;
+    }
+    residency[type].num_pages = num_pages;
+    for (size_t i = 0; i < num_pages; ++i) {
+      residency[type].num_resident += vec[i] & 1;
+    }
+    free(vec);
+  }
+}
+
+void print_dual_graph_residency(const dual_graph_reader *dgr) {
+  section_residency residency[NUM_SECTION_TYPES];
+  get_dual_graph_residency(dgr, residency);
+  for (section_type type = 0; type < NUM_SECTION_TYPES; ++type) {
+    if (residency[type].num_pages) {
+      printf("%-16s %zu / %zu pages resident\n", SECTION_NAMES[type], residency[type].num_resident, residency[type].num_pages);
+    }
+  }
+}
+
 void unload_dual_graph_reader(dual_graph_reader *dgr) {
   if (dgr->type == COMPRESSED_KEYSPACE) {
-    free_tight_keyspace(&(dgr->keyspace.compressed.keyspace));
+    unmap_tight_keyspace(&(dgr->keyspace.compressed.keyspace));
   } else if (dgr->type == SYMMETRIC_KEYSPACE) {
-    free_symmetry(&(dgr->keyspace.symmetric.symmetry));
+    unmap_symmetry(&(dgr->keyspace.symmetric.symmetry));
   } else {
     printf("Unloading mock keyspace\n");
   }
@@ -156,103 +684,192 @@ void unload_dual_graph_reader(dual_graph_reader *dgr) {
   dgr->value_table.bulk_map_size = 0;
   dgr->value_table.bulk_map = NULL;
 
+  free_hot_table(&(dgr->hot_table));
+
+  if (dgr->value_table.id_blocks) {
+    free_id_block_cache(dgr->value_table.id_blocks);
+    free(dgr->value_table.id_blocks);
+    dgr->value_table.id_blocks = NULL;
+  }
+
   if (dgr->fd >= 0) {
     munmap(dgr->buffer, dgr->sb.st_size);
     close(dgr->fd);
 
     dgr->buffer = NULL;
+    dgr->directory = NULL;
     dgr->fd = -1;
 
     dgr->keyspace._.compressor.checkpoints = NULL;
     dgr->keyspace._.compressor.deltas = NULL;
     dgr->value_table.bulk_ids = NULL;
+    dgr->value_table.stored_keys = NULL;
+    dgr->side_table.keys = NULL;
+    dgr->side_table.values = NULL;
+    dgr->move_table.ids = NULL;
+    dgr->move_table.records = NULL;
+    dgr->terminal_table.steps = NULL;
+  }
+}
+
+// Callback resolving states inside the keyspace. The button must not belong to the opponent.
+typedef dual_table_value (*table_lookup_f)(const state *s);
+
+typedef bool (*target_predicate_f)(const state *s);
+
+// Shift a range while leaving infinite and missing bounds alone
+static table_value shift_range_q7(table_value v, score_q7_t delta) {
+  if (v.low == SCORE_Q7_NAN) {
+    return v;
+  }
+  if (v.low != SCORE_Q7_MIN) {
+    v.low += delta;
+  }
+  if (v.high != SCORE_Q7_MAX) {
+    v.high += delta;
+  }
+  return v;
+}
+
+static void negamax_q7(table_value *v, table_value child_value) {
+  if (child_value.high > v->low) {
+    v->low = child_value.high;
+  }
+  if (child_value.low > v->high) {
+    v->high = child_value.low;
   }
 }
 
-dual_value get_dual_graph_reader_value_(const dual_graph_reader *dgr, const state *s, int depth) {
+static dual_table_value compensated_value(const stones_t *moves, int num_moves, table_lookup_f lookup, target_predicate_f in_atari,
+                                          target_predicate_f can_take, const state *s, int depth) {
   if (!depth) {
-    return (dual_value){{-INFINITY, INFINITY}, {-INFINITY, INFINITY}};
+    return (dual_table_value){MAX_RANGE_Q7, MAX_RANGE_Q7};
   }
-  if (target_capturable(s)) {
-    float sc = take_target_score(s);
-    dual_value v = (dual_value){{sc, sc}, {sc, sc}};
+  if (can_take(s)) {
+    const score_q7_t sc = take_target_score_q7(s);
+    dual_table_value v = (dual_table_value){{sc, sc}, {sc, sc}};
     if (!s->passes && !s->button) {
       state child = *s;
       const move_result r = make_move(&child, pass());
-      dual_value child_value = get_dual_graph_reader_value_(dgr, &child, depth - 1);
-      child_value.plain = apply_tactics(NONE, r, &child, child_value.plain);
-      child_value.forcing = apply_tactics(FORCING, r, &child, child_value.forcing);
-      v.plain.low = fmax(v.plain.low, child_value.plain.high);
-      v.plain.high = fmax(v.plain.high, child_value.plain.low);
-      v.forcing.low = fmax(v.forcing.low, child_value.forcing.high);
-      v.forcing.high = fmax(v.forcing.high, child_value.forcing.low);
+      dual_table_value child_value = compensated_value(moves, num_moves, lookup, in_atari, can_take, &child, depth - 1);
+      negamax_q7(&(v.plain), apply_tactics_q7(NONE, r, &child, child_value.plain));
+      negamax_q7(&(v.forcing), apply_tactics_q7(FORCING, r, &child, child_value.forcing));
     }
     return v;
   }
-  if (s->passes || s->ko || target_in_atari(s)) {
+  if (s->passes || s->ko || in_atari(s)) {
     // Compensate for keyspace tightness using negamax
-    dual_value v = (dual_value){{-INFINITY, -INFINITY}, {-INFINITY, -INFINITY}};
+    const table_value nothing = (table_value){SCORE_Q7_MIN, SCORE_Q7_MIN};
+    dual_table_value v = (dual_table_value){nothing, nothing};
 
-    for (int j = 0; j < dgr->num_moves; ++j) {
+    for (int j = 0; j < num_moves; ++j) {
       state child = *s;
-      const move_result r = make_move(&child, dgr->moves[j]);
-      dual_value child_value;
+      const move_result r = make_move(&child, moves[j]);
+      dual_table_value child_value;
       if (r == SECOND_PASS) {
-        value simple_area = score_terminal(r, &child);
-        float delta = child.ko_threats * KO_THREAT_BONUS;
+        const table_value simple_area = score_terminal_q7(r, &child);
+        const score_q7_t delta = child.ko_threats * KO_THREAT_Q7;
         child.passes = 0;
         child.ko = 0ULL;
         child.ko_threats = 0;
-        child_value = get_dual_graph_reader_value_(dgr, &child, depth - 1);
-        child_value.plain.low += delta;
-        child_value.plain.high += delta;
-        child_value.plain = apply_tactics(NONE, r, &child, child_value.plain);
+        child_value = compensated_value(moves, num_moves, lookup, in_atari, can_take, &child, depth - 1);
+        child_value.plain = apply_tactics_q7(NONE, r, &child, shift_range_q7(child_value.plain, delta));
         // Don't break forcing logic
         child_value.forcing = simple_area;
       } else if (r <= TAKE_TARGET) {
         assert(r != TAKE_TARGET);
-        child_value.plain = score_terminal(r, &child);
+        child_value.plain = score_terminal_q7(r, &child);
         child_value.forcing = child_value.plain;
       } else {
-        child_value = get_dual_graph_reader_value_(dgr, &child, depth - 1);
-        child_value.plain = apply_tactics(NONE, r, &child, child_value.plain);
-        child_value.forcing = apply_tactics(FORCING, r, &child, child_value.forcing);
+        child_value = compensated_value(moves, num_moves, lookup, in_atari, can_take, &child, depth - 1);
+        child_value.plain = apply_tactics_q7(NONE, r, &child, child_value.plain);
+        child_value.forcing = apply_tactics_q7(FORCING, r, &child, child_value.forcing);
       }
-      v.plain.low = fmax(v.plain.low, child_value.plain.high);
-      v.plain.high = fmax(v.plain.high, child_value.plain.low);
-      v.forcing.low = fmax(v.forcing.low, child_value.forcing.high);
-      v.forcing.high = fmax(v.forcing.high, child_value.forcing.low);
+      negamax_q7(&(v.plain), child_value.plain);
+      negamax_q7(&(v.forcing), child_value.forcing);
     }
     return v;
   }
 
-  float delta = 0;
-  size_t key;
-
   if (s->button < 0) {
     state c = *s;
     c.button = -c.button;
-    key = dgr->to_key(dgr, &c);
-    delta = -2 * BUTTON_BONUS;
-  } else {
-    key = dgr->to_key(dgr, s);
+    dual_table_value tv = lookup(&c);
+    tv.plain = shift_range_q7(tv.plain, -2 * BUTTON_Q7);
+    tv.forcing = shift_range_q7(tv.forcing, -2 * BUTTON_Q7);
+    return tv;
   }
+  return lookup(s);
+}
 
-  dual_table_value tv = get_frozen_hash_value(&(dgr->value_table), key);
-  return (dual_value){
-      {
-          score_q7_to_float(tv.plain.low) + delta,
-          score_q7_to_float(tv.plain.high) + delta,
-      },
-      {
-          score_q7_to_float(tv.forcing.low) + delta,
-          score_q7_to_float(tv.forcing.high) + delta,
-      },
-  };
+static dual_table_value lookup_frozen_hash_value(const frozen_hash_table *fht, id_block_cache *cache, size_t key);
+
+reader_context create_reader_context(const dual_graph_reader *dgr, unsigned long long seed) {
+  reader_context result = {0};
+  result.rng = seed_rng(seed);
+  const id_block_cache *shared = dgr->value_table.id_blocks;
+  if (shared) {
+    result.id_blocks = xmalloc(sizeof(id_block_cache));
+    *result.id_blocks = create_id_block_cache(shared->size, shared->offsets, shared->data, shared->capacity);
+  }
+  return result;
+}
+
+void free_reader_context(reader_context *ctx) {
+  if (ctx->id_blocks) {
+    free_id_block_cache(ctx->id_blocks);
+    free(ctx->id_blocks);
+    ctx->id_blocks = NULL;
+  }
+}
+
+reader_context *allocate_reader_context(const dual_graph_reader *dgr, unsigned long long seed) {
+  reader_context *result = xmalloc(sizeof(reader_context));
+  *result = create_reader_context(dgr, seed);
+  return result;
+}
+
+// Context of the legacy API borrowing the cache of the reader
+static reader_context shared_context(const dual_graph_reader *dgr) {
+  reader_context result = {0};
+  result.id_blocks = dgr->value_table.id_blocks;
+  return result;
+}
+
+dual_table_value get_dual_graph_reader_table_value_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  // States after a pass are never stored
+  if (dgr->side_table.num_slots && !s->passes && (s->ko || dgr->in_atari(s))) {
+    dual_table_value v;
+    if (get_side_table_value(&(dgr->side_table), side_key(dgr->type, &(dgr->keyspace._), s), &v)) {
+      return v;
+    }
+  }
+
+  dual_table_value lookup(const state *c) {
+    const size_t key = dgr->to_key(dgr, c);
+    dual_table_value v;
+    if (get_hot_table_value(&(dgr->hot_table), key, &v)) {
+      return v;
+    }
+    return lookup_frozen_hash_value(&(dgr->value_table), ctx->id_blocks, key);
+  }
+
+  return compensated_value(dgr->moves, dgr->num_moves, lookup, dgr->in_atari, dgr->can_take, s, MAX_COMPENSATION_DEPTH);
+}
+
+dual_table_value get_dual_graph_reader_table_value(const dual_graph_reader *dgr, const state *s) {
+  reader_context ctx = shared_context(dgr);
+  return get_dual_graph_reader_table_value_r(dgr, &ctx, s);
+}
+
+dual_value get_dual_graph_reader_value_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  const dual_table_value tv = get_dual_graph_reader_table_value_r(dgr, ctx, s);
+  return (dual_value){table_value_to_value(tv.plain), table_value_to_value(tv.forcing)};
 }
 
 dual_value get_dual_graph_reader_value(const dual_graph_reader *dgr, const state *s) {
-  return get_dual_graph_reader_value_(dgr, s, MAX_COMPENSATION_DEPTH);
+  reader_context ctx = shared_context(dgr);
+  return get_dual_graph_reader_value_r(dgr, &ctx, s);
 }
 
 dual_graph_reader *allocate_dual_graph_reader(const char *filename) {
@@ -261,6 +878,21 @@ dual_graph_reader *allocate_dual_graph_reader(const char *filename) {
   return result;
 }
 
+dual_graph_reader *allocate_dual_graph_reader_with_policy(const char *filename, residency_policy policy) {
+  dual_graph_reader *result = xmalloc(sizeof(dual_graph_reader));
+  *result = load_dual_graph_reader_with_policy(filename, policy);
+  return result;
+}
+
+dual_graph_reader *try_allocate_dual_graph_reader_with_policy(const char *filename, residency_policy policy) {
+  dual_graph_reader *result = xmalloc(sizeof(dual_graph_reader));
+  if (!try_load_dual_graph_reader_with_policy(filename, policy, result)) {
+    free(result);
+    return NULL;
+  }
+  return result;
+}
+
 stones_t *dual_graph_reader_python_stuff(dual_graph_reader *dgr, state *root, int *num_moves) {
   *root = dgr->keyspace._.root;
   *num_moves = dgr->num_moves;
@@ -288,19 +920,51 @@ state strip_aesthetics(const dual_graph_reader *dgr, const state *s) {
   return ss;
 }
 
-move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const state *s, int *num_move_infos) {
-  move_info *result = xmalloc(dgr->num_moves * sizeof(move_info));
-  *num_move_infos = 0;
-
-  state parent = strip_aesthetics(dgr, s);
+bool is_reader_state(const dual_graph_reader *dgr, const state *s) {
+  const state *root = &(dgr->keyspace._.root);
+  // Kos next to external liberties fail the stricter ko test of is_legal()
+  state stones = *s;
+  stones.ko = 0;
+  if (s->wide != root->wide || (s->player & s->opponent) || !is_legal(&stones)) {
+    return false;
+  }
+  if ((s->visual_area & ~root->visual_area) || (s->logical_area & ~root->logical_area) || (s->external & ~root->external)) {
+    return false;
+  }
+  // Target stones only grow by connecting inside the playable area
+  const stones_t effective_area = root->logical_area & ~(root->target | root->immortal | root->external);
+  if ((root->target & ~s->target) || (s->target & ~(root->target | effective_area))) {
+    return false;
+  }
+  if (abs(s->ko_threats) > abs(root->ko_threats)) {
+    return false;
+  }
+  if (popcount(s->ko) > 1 || (s->ko & ~effective_area) || (s->ko & (s->player | s->opponent))) {
+    return false;
+  }
+  // Ko, pass and button variants share the stones of a keyspace state. Atari states are only reached through compensation.
+  if (dgr->can_take(s) || dgr->in_atari(s)) {
+    return true;
+  }
+  stones.passes = 0;
+  stones.button = abs(s->button);
+  if (dgr->type == COMPRESSED_KEYSPACE) {
+    const compressed_keyspace *cks = &(dgr->keyspace.compressed);
+    return was_compressed_legal(cks, to_tight_key_fast(&(cks->keyspace), &stones));
+  }
+  return has_symmetric_key(&(dgr->keyspace.symmetric), &stones);
+}
 
-  dual_value v = get_dual_graph_reader_value(dgr, &parent);
+// Annotate every root move. Illegal moves are flagged in `legal`.
+static void annotate_moves(const dual_graph_reader *dgr, reader_context *ctx, const state *parent, bool wide, move_info *infos,
+                           bool *legal) {
+  dual_value v = get_dual_graph_reader_value_r(dgr, ctx, parent);
 
   float lows_high = -INFINITY;
   float highs_low = -INFINITY;
   dual_value *child_values = xmalloc(dgr->num_moves * sizeof(dual_value));
   for (int i = 0; i < dgr->num_moves; ++i) {
-    state child = parent;
+    state child = *parent;
     const move_result r = make_move(&child, dgr->moves[i]);
     if (r == SECOND_PASS) {
       value simple_area = score_terminal(r, &child);
@@ -308,7 +972,7 @@ move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const stat
       child.passes = 0;
       child.ko = 0ULL;
       child.ko_threats = 0;
-      child_values[i] = get_dual_graph_reader_value(dgr, &child);
+      child_values[i] = get_dual_graph_reader_value_r(dgr, ctx, &child);
       child_values[i].plain.low += delta;
       child_values[i].plain.high += delta;
       child_values[i].plain = apply_tactics(NONE, r, &child, child_values[i].plain);
@@ -318,7 +982,7 @@ move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const stat
       child_values[i].plain = score_terminal(r, &child);
       child_values[i].forcing = child_values[i].plain;
     } else {
-      child_values[i] = get_dual_graph_reader_value(dgr, &child);
+      child_values[i] = get_dual_graph_reader_value_r(dgr, ctx, &child);
       child_values[i].plain = apply_tactics(NONE, r, &child, child_values[i].plain);
       child_values[i].forcing = apply_tactics(FORCING, r, &child, child_values[i].forcing);
     }
@@ -331,11 +995,9 @@ move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const stat
   }
 
   for (int i = 0; i < dgr->num_moves; ++i) {
-    if (isnan(child_values[i].plain.low)) {
-      continue;
-    }
-    result[(*num_move_infos)++] = (move_info){
-        s->wide ? coords_of_16(dgr->moves[i]) : coords_of(dgr->moves[i]),
+    legal[i] = !isnan(child_values[i].plain.low);
+    infos[i] = (move_info){
+        wide ? coords_of_16(dgr->moves[i]) : coords_of(dgr->moves[i]),
         child_values[i].plain.high - v.plain.low,
         child_values[i].plain.low - v.plain.high,
         v.plain.low == child_values[i].plain.high && lows_high == child_values[i].plain.low,
@@ -345,20 +1007,88 @@ move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const stat
   }
 
   free(child_values);
+}
+
+// Only plain keyspace states are covered by the move and terminal tables
+static bool is_plain_key_state(const dual_graph_reader *dgr, const state *s) {
+  return !s->passes && !s->ko && s->button >= 0 && !dgr->can_take(s) && !dgr->in_atari(s);
+}
+
+// Index of a key in the move and terminal tables. Pruned readers only index their stored keys like the value ids.
+static bool table_index(const dual_graph_reader *dgr, size_t key, size_t *index) {
+  *index = dgr->value_table.stored_keys ? stored_key_rank(&(dgr->value_table), key) : key;
+  return *index != SIZE_MAX;
+}
+
+// Find the record of a state. States outside the table fall back to annotating the moves.
+static bool has_move_record(const dual_graph_reader *dgr, const state *s, size_t *index) {
+  const move_table *mt = &(dgr->move_table);
+  if (!mt->size || !is_plain_key_state(dgr, s) || !table_index(dgr, dgr->to_key(dgr, s), index)) {
+    return false;
+  }
+  return *index < mt->size && mt->ids[*index] < mt->num_records;
+}
+
+static bool test_mask(const uint64_t *mask, int i) { return (mask[i / 64] >> (i % 64)) & 1; }
+
+move_info *dual_graph_reader_move_infos_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s, int *num_move_infos) {
+  move_info *result = xmalloc(dgr->num_moves * sizeof(move_info));
+  *num_move_infos = 0;
+
+  state parent = strip_aesthetics(dgr, s);
+
+  size_t index;
+  if (has_move_record(dgr, &parent, &index)) {
+    const move_table *mt = &(dgr->move_table);
+    const unsigned char *record = mt->records + mt->ids[index] * mt->record_size;
+    const uint64_t *legal = (const uint64_t *)record;
+    const uint64_t *low_ideal = legal + mt->num_words;
+    const uint64_t *high_ideal = low_ideal + mt->num_words;
+    const uint64_t *forcing = high_ideal + mt->num_words;
+    const float *gains = (const float *)(forcing + mt->num_words);
+    for (int i = 0; i < dgr->num_moves; ++i) {
+      if (!test_mask(legal, i)) {
+        continue;
+      }
+      result[(*num_move_infos)++] = (move_info){
+          s->wide ? coords_of_16(dgr->moves[i]) : coords_of(dgr->moves[i]),
+          gains[2 * i],
+          gains[2 * i + 1],
+          test_mask(low_ideal, i),
+          test_mask(high_ideal, i),
+          test_mask(forcing, i),
+      };
+    }
+    return realloc(result, *num_move_infos * sizeof(move_info));
+  }
+
+  bool *legal = xmalloc(dgr->num_moves * sizeof(bool));
+  annotate_moves(dgr, ctx, &parent, s->wide, result, legal);
+  for (int i = 0; i < dgr->num_moves; ++i) {
+    if (legal[i]) {
+      result[(*num_move_infos)++] = result[i];
+    }
+  }
+  free(legal);
 
   return realloc(result, *num_move_infos * sizeof(move_info));
 }
 
-state dual_graph_reader_high_terminal_(dual_graph_reader *dgr, const state *origin, tactics ts);
+move_info *dual_graph_reader_move_infos(const dual_graph_reader *dgr, const state *s, int *num_move_infos) {
+  reader_context ctx = shared_context(dgr);
+  return dual_graph_reader_move_infos_r(dgr, &ctx, s, num_move_infos);
+}
 
-state dual_graph_reader_low_terminal_(dual_graph_reader *dgr, const state *origin, tactics ts) {
+static state high_terminal(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts);
+
+static state low_terminal(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts) {
   if (origin->passes > 1 || (origin->target & ~(origin->player | origin->opponent))) {
     return *origin;
   }
-  dual_value v = get_dual_graph_reader_value(dgr, origin);
+  dual_value v = get_dual_graph_reader_value_r(dgr, ctx, origin);
 
   // Need to break loops by random navigation
-  unsigned int offset = jrand();
+  unsigned int offset = rng_next(&(ctx->rng));
   for (int i = 0; i < dgr->num_moves; ++i) {
     int j = (i + offset) % dgr->num_moves;
     state child = *origin;
@@ -377,30 +1107,30 @@ state dual_graph_reader_low_terminal_(dual_graph_reader *dgr, const state *origi
         }
       }
     } else {
-      child_value = get_dual_graph_reader_value(dgr, &child);
+      child_value = get_dual_graph_reader_value_r(dgr, ctx, &child);
       if (ts == NONE) {
         child_value.plain = apply_tactics(ts, r, &child, child_value.plain);
         if (v.plain.low == child_value.plain.high) {
-          return dual_graph_reader_high_terminal_(dgr, &child, ts);
+          return high_terminal(dgr, ctx, &child, ts);
         }
       } else {
         child_value.forcing = apply_tactics(ts, r, &child, child_value.forcing);
         if (v.forcing.low == child_value.forcing.high) {
-          return dual_graph_reader_high_terminal_(dgr, &child, ts);
+          return high_terminal(dgr, ctx, &child, ts);
         }
       }
     }
   }
+  // Inconsistent tables must not take a server down with them
   fprintf(stderr, "Low terminal not found\n");
-  exit(EXIT_FAILURE);
   return *origin;
 }
 
-state dual_graph_reader_high_terminal_(dual_graph_reader *dgr, const state *origin, tactics ts) {
+static state high_terminal(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts) {
   if (origin->passes > 1 || (origin->target & ~(origin->player | origin->opponent))) {
     return *origin;
   }
-  dual_value v = get_dual_graph_reader_value(dgr, origin);
+  dual_value v = get_dual_graph_reader_value_r(dgr, ctx, origin);
 
   for (int i = 0; i < dgr->num_moves; ++i) {
     state child = *origin;
@@ -419,33 +1149,163 @@ state dual_graph_reader_high_terminal_(dual_graph_reader *dgr, const state *orig
         }
       }
     } else {
-      child_value = get_dual_graph_reader_value(dgr, &child);
+      child_value = get_dual_graph_reader_value_r(dgr, ctx, &child);
       if (ts == NONE) {
         child_value.plain = apply_tactics(ts, r, &child, child_value.plain);
         if (v.plain.high == child_value.plain.low) {
-          return dual_graph_reader_low_terminal_(dgr, &child, ts);
+          return low_terminal(dgr, ctx, &child, ts);
         }
       } else {
         child_value.forcing = apply_tactics(ts, r, &child, child_value.forcing);
         if (v.forcing.high == child_value.forcing.low) {
-          return dual_graph_reader_low_terminal_(dgr, &child, ts);
+          return low_terminal(dgr, ctx, &child, ts);
         }
       }
     }
   }
+  // Inconsistent tables must not take a server down with them
   fprintf(stderr, "High terminal not found\n");
-  exit(EXIT_FAILURE);
   return *origin;
 }
 
-state dual_graph_reader_low_terminal(dual_graph_reader *dgr, const state *origin, tactics ts) {
+static bool is_resolved(const state *s) { return s->passes > 1 || (s->target & ~(s->player | s->opponent)); }
+
+static unsigned int best_terminal_move(const dual_graph_reader *dgr, reader_context *ctx, const state *s, int track, int depth,
+                                       int *move);
+
+// Plies until forcing play on the track ends and the first move of the continuation
+static unsigned int terminal_plies(const dual_graph_reader *dgr, reader_context *ctx, const state *s, int track, int depth,
+                                   int *move) {
+  *move = -1;
+  if (is_resolved(s)) {
+    return 0;
+  }
+  size_t index;
+  if (dgr->terminal_table.size && is_plain_key_state(dgr, s) && table_index(dgr, dgr->to_key(dgr, s), &index) &&
+      index < dgr->terminal_table.size) {
+    // Relaxed loads because the table may be filled by other threads during preparation
+    const terminal_step *step = dgr->terminal_table.steps + index;
+    *move = __atomic_load_n(step->moves + track, __ATOMIC_RELAXED);
+    return __atomic_load_n(step->plies + track, __ATOMIC_RELAXED);
+  }
+  if (!depth) {
+    return UNRESOLVED_PLIES;
+  }
+  return best_terminal_move(dgr, ctx, s, track, depth, move);
+}
+
+// Search the moves that keep the bound of the track for the shortest continuation. Ties go to the first move.
+static unsigned int best_terminal_move(const dual_graph_reader *dgr, reader_context *ctx, const state *s, int track, int depth,
+                                       int *move) {
+  const value v = get_dual_graph_reader_value_r(dgr, ctx, s).forcing;
+  unsigned int best = UNRESOLVED_PLIES;
+  *move = -1;
+  for (int j = 0; j < dgr->num_moves; ++j) {
+    state child = *s;
+    const move_result r = make_move(&child, dgr->moves[j]);
+    unsigned int plies = 1;
+    value child_value;
+    if (r <= TAKE_TARGET) {
+      child_value = score_terminal(r, &child);
+    } else {
+      child_value = apply_tactics(FORCING, r, &child, get_dual_graph_reader_value_r(dgr, ctx, &child).forcing);
+    }
+    if (track == LOW_TRACK ? v.low != child_value.high : v.high != child_value.low) {
+      continue;
+    }
+    if (r > TAKE_TARGET) {
+      int unused;
+      const unsigned int child_plies = terminal_plies(dgr, ctx, &child, !track, depth - 1, &unused);
+      plies = child_plies >= UNRESOLVED_PLIES - 1 ? UNRESOLVED_PLIES : child_plies + 1;
+    }
+    if (plies < best) {
+      best = plies;
+      *move = j;
+    }
+  }
+  return best;
+}
+
+// Walk the shortest continuation. Returns false if the origin is unresolved.
+static bool follow_terminal_steps(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, int track, state *result) {
+  state s = *origin;
+  int move;
+  unsigned int plies = terminal_plies(dgr, ctx, &s, track, MAX_COMPENSATION_DEPTH, &move);
+  if (plies == UNRESOLVED_PLIES) {
+    return false;
+  }
+  // Steps come from the file so inconsistent ones hand the walk over to the search
+  while (plies) {
+    if (move < 0 || move >= dgr->num_moves) {
+      return false;
+    }
+    const move_result r = make_move(&s, dgr->moves[move]);
+    if (r == ILLEGAL) {
+      return false;
+    }
+    if (r <= TAKE_TARGET) {
+      if (plies != 1) {
+        return false;
+      }
+      break;
+    }
+    track = !track;
+    const unsigned int next = terminal_plies(dgr, ctx, &s, track, MAX_COMPENSATION_DEPTH, &move);
+    if (next >= plies) {
+      return false;
+    }
+    plies = next;
+  }
+  *result = s;
+  return true;
+}
+
+state dual_graph_reader_low_terminal_r(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts) {
   state o = strip_aesthetics(dgr, origin);
-  return dual_graph_reader_low_terminal_(dgr, &o, ts);
+  state result;
+  if (ts == FORCING && dgr->terminal_table.size && follow_terminal_steps(dgr, ctx, &o, LOW_TRACK, &result)) {
+    return result;
+  }
+  return low_terminal(dgr, ctx, &o, ts);
 }
 
-state dual_graph_reader_high_terminal(dual_graph_reader *dgr, const state *origin, tactics ts) {
+state dual_graph_reader_high_terminal_r(const dual_graph_reader *dgr, reader_context *ctx, const state *origin, tactics ts) {
   state o = strip_aesthetics(dgr, origin);
-  return dual_graph_reader_high_terminal_(dgr, &o, ts);
+  state result;
+  if (ts == FORCING && dgr->terminal_table.size && follow_terminal_steps(dgr, ctx, &o, HIGH_TRACK, &result)) {
+    return result;
+  }
+  return high_terminal(dgr, ctx, &o, ts);
+}
+
+state dual_graph_reader_low_terminal(dual_graph_reader *dgr, const state *origin, tactics ts) {
+  reader_context ctx = shared_context(dgr);
+  ctx.rng = seed_rng(jrand());
+  return dual_graph_reader_low_terminal_r(dgr, &ctx, origin, ts);
+}
+
+state dual_graph_reader_high_terminal(dual_graph_reader *dgr, const state *origin, tactics ts) {
+  reader_context ctx = shared_context(dgr);
+  ctx.rng = seed_rng(jrand());
+  return dual_graph_reader_high_terminal_r(dgr, &ctx, origin, ts);
+}
+
+stones_t dual_graph_reader_dead_stones_r(const dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  const state normalized = strip_aesthetics(dgr, s);
+  state terminal = dual_graph_reader_low_terminal_r(dgr, ctx, &normalized, FORCING);
+  stones_t result = dead_stones(&normalized, &terminal);
+  // Only stones dead in both terminals are reported
+  if (result) {
+    terminal = dual_graph_reader_high_terminal_r(dgr, ctx, &normalized, FORCING);
+    result &= dead_stones(&normalized, &terminal);
+  }
+  return result;
+}
+
+stones_t dual_graph_reader_dead_stones(dual_graph_reader *dgr, const state *s) {
+  reader_context ctx = shared_context(dgr);
+  ctx.rng = seed_rng(jrand());
+  return dual_graph_reader_dead_stones_r(dgr, &ctx, s);
 }
 
 int compare_dual_table_values(const void *a_, const void *b_) {
@@ -488,20 +1348,20 @@ typedef struct tree_value {
   size_t count;
 } tree_value;
 
-frozen_hash_table prepare_frozen_hash(const dual_graph *dg, size_t *num_unique) {
+typedef dual_table_value (*value_at_f)(size_t i);
+
+// Build a frozen hash table over `size` values indexed from zero
+static frozen_hash_table freeze_values(size_t size, value_at_f value_at, size_t *num_unique) {
   void *root = NULL;
   dual_table_value *v;
   dual_table_value **tv;
   *num_unique = 0;
 
-  for (size_t i = 0; i < dg->keyspace._.size; ++i) {
+  for (size_t i = 0; i < size; ++i) {
     // Allocate value and count
     v = xmalloc(sizeof(tree_value));
     // Abuse struct overlap
-    v->plain.low = dg->plain_values[i].low;
-    v->plain.high = dg->plain_values[i].high;
-    v->forcing.low = dg->forcing_values[i].low;
-    v->forcing.high = dg->forcing_values[i].high;
+    *v = value_at(i);
     tv = tsearch(v, &root, compare_dual_table_values);
     if (!tv) {
       exit(EXIT_FAILURE);
@@ -517,93 +1377,691 @@ frozen_hash_table prepare_frozen_hash(const dual_graph *dg, size_t *num_unique)
     }
   }
 
-  dual_table_value *value_map = xmalloc((*num_unique) * sizeof(dual_table_value));
+  tree_value *counted = xmalloc((*num_unique) * sizeof(tree_value));
 
   size_t i = 0;
   void action(const void *nodep, VISIT which, int) {
     if (which == postorder || which == leaf) {
-      value_map[i++] = (*(tree_value **)nodep)->value;
+      counted[i++] = **(tree_value **)nodep;
     }
   }
   twalk(root, action);
-
-  if ((*num_unique) <= VALUE_MAP_SIZE - 1) {
-    tdestroy(root, free);
-
-    return (frozen_hash_table){*num_unique, value_map, NULL, 0, NULL, NULL};
-  }
+  tdestroy(root, free);
 
   int cmp(const void *a_, const void *b_) {
-    tree_value *a = *(tree_value **)tfind(a_, &root, compare_dual_table_values);
-    tree_value *b = *(tree_value **)tfind(b_, &root, compare_dual_table_values);
-
+    const tree_value *a = a_;
+    const tree_value *b = b_;
     // Sort most common to front
-    if (a->count > b->count) {
-      return -1;
+    return (a->count < b->count) - (a->count > b->count);
+  }
+  qsort(counted, *num_unique, sizeof(tree_value), cmp);
+
+  // Pick the id width that minimizes the total size of the ids, the bulk map and the tail
+  int width = 0;
+  size_t n = 0;
+  size_t best_bytes = SIZE_MAX;
+  size_t num_bulk = 0;
+  size_t m = 0;
+  for (int w = 1; w <= (int)(sizeof(value_id_t) * CHAR_BIT); ++w) {
+    for (; m < *num_unique && m < VALUE_ID_SENTINEL(w); ++m) {
+      num_bulk += counted[m].count;
     }
-    if (a->count < b->count) {
-      return 1;
+    const size_t tail_size = size - num_bulk;
+    const size_t bytes = frozen_ids_size(size, w) * sizeof(uint64_t) + m * sizeof(dual_table_value) +
+                         tail_size * sizeof(dual_table_value) + frozen_tail_offsets_size(size, tail_size) * sizeof(size_t);
+    if (bytes < best_bytes) {
+      best_bytes = bytes;
+      width = w;
+      n = m;
+    }
+    if (m == *num_unique) {
+      break;
     }
-    return 0;
   }
-  qsort(value_map, *num_unique, sizeof(dual_table_value), cmp);
 
-  const size_t n = VALUE_MAP_SIZE - 1;
-
-  size_t tail_size = 0;
-  for (size_t i = n; i < *num_unique; ++i) {
-    tail_size += (*(tree_value **)tfind(value_map + i, &root, compare_dual_table_values))->count;
+  dual_table_value *value_map = xmalloc(n * sizeof(dual_table_value));
+  size_t tail_size = size;
+  for (size_t i = 0; i < n; ++i) {
+    value_map[i] = counted[i].value;
+    tail_size -= counted[i].count;
   }
-
-  tdestroy(root, free);
-
-  value_map = xrealloc(value_map, n * sizeof(dual_table_value));
+  free(counted);
   qsort(value_map, n, sizeof(dual_table_value), compare_dual_table_values);
 
-  size_t *tail_keys = xmalloc(frozen_tail_keys_size(tail_size) * sizeof(size_t));
+  if (!tail_size) {
+    return (frozen_hash_table){n, value_map, width, NULL, 0, NULL, NULL, PACKED_IDS, NULL, 0, NULL, false};
+  }
+
+  size_t *tail_offsets = xmalloc(frozen_tail_offsets_size(size, tail_size) * sizeof(size_t));
   dual_table_value *tail_values = xmalloc(tail_size * sizeof(dual_table_value));
 
-  v = xmalloc(sizeof(dual_table_value));
   size_t j = 0;
-  for (size_t i = 0; i < dg->keyspace._.size; ++i) {
-    v->plain.low = dg->plain_values[i].low;
-    v->plain.high = dg->plain_values[i].high;
-    v->forcing.low = dg->forcing_values[i].low;
-    v->forcing.high = dg->forcing_values[i].high;
-    if (!bsearch(v, value_map, n, sizeof(dual_table_value), compare_dual_table_values)) {
-      if (j % 2 == 1) {
-        tail_keys[j / 2] = i;
-      }
-      tail_values[j++] = *v;
+  for (size_t i = 0; i < size; ++i) {
+    if (i % TAIL_BUCKET_SIZE == 0) {
+      tail_offsets[i / TAIL_BUCKET_SIZE] = j;
+    }
+    const dual_table_value v = value_at(i);
+    if (!bsearch(&v, value_map, n, sizeof(dual_table_value), compare_dual_table_values)) {
+      tail_values[j++] = v;
     }
   }
   assert(j == tail_size);
-  free(v);
 
-  return (frozen_hash_table){n, value_map, NULL, tail_size, tail_values, tail_keys};
+  return (frozen_hash_table){n, value_map, width, NULL, tail_size, tail_values, tail_offsets, PACKED_IDS, NULL, 0, NULL, false};
 }
 
-dual_table_value get_frozen_hash_value(const frozen_hash_table *fht, size_t key) {
-  value_id_t vid = fht->bulk_ids[key];
-  if (vid == VALUE_ID_SENTINEL) {
-    const size_t tail_keys_size = frozen_tail_keys_size(fht->tail_size);
-    size_t lo = 0;
-    size_t hi = tail_keys_size;
-    while (lo < hi) {
-      size_t mid = lo + (hi - lo) / 2;
-      size_t mid_key = fht->tail_keys[mid];
-      if (mid_key < key) {
-        lo = mid + 1;
-      } else {
-        hi = mid;
-      }
+frozen_hash_table prepare_frozen_hash(const dual_graph *dg, size_t *num_unique) {
+  dual_table_value value_at(size_t i) { return (dual_table_value){dg->plain_values[i], dg->forcing_values[i]}; }
+  return freeze_values(dg->keyspace._.size, value_at, num_unique);
+}
+
+size_t frozen_ids_size(size_t size, int width) { return ceil_divz(size * width, CHAR_BIT * sizeof(uint64_t)) + 1; }
+
+void set_frozen_hash_id(uint64_t *bulk_ids, int width, size_t key, value_id_t id) {
+  const size_t bit = key * width;
+  const int shift = bit % 64;
+  const uint64_t mask = VALUE_ID_SENTINEL(width);
+  bulk_ids[bit / 64] = (bulk_ids[bit / 64] & ~(mask << shift)) | ((uint64_t)id << shift);
+  if (shift + width > 64) {
+    bulk_ids[bit / 64 + 1] = (bulk_ids[bit / 64 + 1] & ~(mask >> (64 - shift))) | ((uint64_t)id >> (64 - shift));
+  }
+}
+
+static inline value_id_t get_packed_id(const frozen_hash_table *fht, size_t key) {
+  const size_t bit = key * fht->id_width;
+  const uint64_t *words = fht->bulk_ids + bit / 64;
+  const int shift = bit % 64;
+  // The double shift keeps the high word out of the result without branching when shift is zero
+  const uint64_t bits = (words[0] >> shift) | ((words[1] << 1) << (63 - shift));
+  return bits & VALUE_ID_SENTINEL(fht->id_width);
+}
+
+value_id_t get_frozen_hash_id(const frozen_hash_table *fht, size_t key) {
+  if (fht->id_blocks) {
+    return get_id_block(fht->id_blocks, key / ID_BLOCK_SIZE)[key % ID_BLOCK_SIZE];
+  }
+  return get_packed_id(fht, key);
+}
+
+static dual_table_value lookup_frozen_hash_value(const frozen_hash_table *fht, id_block_cache *cache, size_t key) {
+  if (fht->stored_keys) {
+    // Continue with the rank of the key
+    key = stored_key_rank(fht, key);
+    if (key == SIZE_MAX) {
+      return (dual_table_value){MAX_RANGE_Q7, MAX_RANGE_Q7};
     }
-    size_t i = 2 * lo;
-    if (lo < tail_keys_size && fht->tail_keys[lo] == key) {
-      i += 1;
+  }
+
+  // Blocks hold whole tail buckets so the block of the key serves the tail scan too
+  const value_id_t *block = NULL;
+  const size_t base = key - key % ID_BLOCK_SIZE;
+  if (cache) {
+    block = get_id_block(cache, key / ID_BLOCK_SIZE);
+  }
+  value_id_t id_of(size_t k) { return block ? block[k - base] : get_packed_id(fht, k); }
+
+  const value_id_t sentinel = VALUE_ID_SENTINEL(fht->id_width);
+  value_id_t vid = id_of(key);
+  if (vid == sentinel) {
+    size_t i = fht->tail_offsets[key / TAIL_BUCKET_SIZE];
+    for (size_t k = key & ~(TAIL_BUCKET_SIZE - 1); k < key; ++k) {
+      i += id_of(k) == sentinel;
     }
     assert(i < fht->tail_size);
     return fht->tail_values[i];
   }
   return fht->bulk_map[vid];
 }
+
+dual_table_value get_frozen_hash_value(const frozen_hash_table *fht, size_t key) {
+  return lookup_frozen_hash_value(fht, fht->id_blocks, key);
+}
+
+side_table prepare_side_table(const dual_graph *dg) {
+  side_table result;
+  if (dg->side_table.num_slots) {
+    const side_table *st = &(dg->side_table);
+    result = (side_table){st->size, st->num_slots, xmalloc(st->num_slots * sizeof(size_t)),
+                          xmalloc(st->num_slots * sizeof(dual_table_value))};
+    memcpy(result.keys, st->keys, st->num_slots * sizeof(size_t));
+  } else {
+    result = create_side_table(dg);
+  }
+
+  // Readers mix area scoring with forcing tactics so solver values are only used for collecting the keys
+  dual_table_value lookup(const state *c) {
+    size_t key = dg->to_key((dual_graph *)dg, c);
+    return (dual_table_value){dg->plain_values[key], dg->forcing_values[key]};
+  }
+
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t i = 0; i < result.num_slots; ++i) {
+    if (result.keys[i] == SIDE_EMPTY_KEY) {
+      result.values[i] = (dual_table_value){MAX_RANGE_Q7, MAX_RANGE_Q7};
+      continue;
+    }
+    const state child = from_side_key(dg->type, &(dg->keyspace._), result.keys[i]);
+    result.values[i] = compensated_value(dg->moves, dg->num_moves, lookup, dg->in_atari, dg->can_take, &child, MAX_COMPENSATION_DEPTH);
+  }
+
+  return result;
+}
+
+move_table prepare_move_table(const dual_graph_reader *dgr) {
+  move_table result = {0};
+  if (dgr->type != COMPRESSED_KEYSPACE) {
+    return result;
+  }
+  const compressed_keyspace *cks = &(dgr->keyspace.compressed);
+  // Pruned readers only cover their stored keys
+  result.size = dgr->value_table.stored_keys ? dgr->value_table.num_stored_keys : cks->size;
+  result.num_words = move_table_words(dgr->num_moves);
+  result.record_size = move_record_size(dgr->num_moves);
+  result.ids = xmalloc(result.size * sizeof(uint32_t));
+
+  size_t capacity = 1024;
+  result.records = xmalloc(capacity * result.record_size);
+
+  // Tree nodes hold record indices offset by one so that they are never null
+  int compare_records(const void *a_, const void *b_) {
+    const size_t a = (uintptr_t)a_ - 1;
+    const size_t b = (uintptr_t)b_ - 1;
+    return memcmp(result.records + a * result.record_size, result.records + b * result.record_size, result.record_size);
+  }
+  void *root = NULL;
+
+  move_info *infos = xmalloc(dgr->num_moves * sizeof(move_info));
+  bool *legal = xmalloc(dgr->num_moves * sizeof(bool));
+  const bool wide = dgr->keyspace._.root.wide;
+  reader_context ctx = shared_context(dgr);
+
+  for (size_t key = 0; key < cks->size; ++key) {
+    size_t index;
+    if (!table_index(dgr, key, &index)) {
+      continue;
+    }
+    const state parent = from_compressed_key(cks, key);
+    annotate_moves(dgr, &ctx, &parent, wide, infos, legal);
+
+    // Build the candidate record in the first free slot
+    if (result.num_records >= capacity) {
+      capacity *= 2;
+      result.records = xrealloc(result.records, capacity * result.record_size);
+    }
+    unsigned char *record = result.records + result.num_records * result.record_size;
+    memset(record, 0, result.record_size);
+    uint64_t *masks = (uint64_t *)record;
+    float *gains = (float *)(masks + 4 * result.num_words);
+    for (int i = 0; i < dgr->num_moves; ++i) {
+      const uint64_t bit = 1ULL << (i % 64);
+      const size_t word = i / 64;
+      if (!legal[i]) {
+        continue;
+      }
+      masks[word] |= bit;
+      if (infos[i].low_ideal) {
+        masks[result.num_words + word] |= bit;
+      }
+      if (infos[i].high_ideal) {
+        masks[2 * result.num_words + word] |= bit;
+      }
+      if (infos[i].forcing) {
+        masks[3 * result.num_words + word] |= bit;
+      }
+      gains[2 * i] = infos[i].low_gain;
+      gains[2 * i + 1] = infos[i].high_gain;
+    }
+
+    void *candidate = (void *)(uintptr_t)(result.num_records + 1);
+    void **node = tsearch(candidate, &root, compare_records);
+    if (!node) {
+      exit(EXIT_FAILURE);
+    }
+    if (*node == candidate) {
+      result.num_records++;
+    }
+    result.ids[index] = (uint32_t)((uintptr_t)*node - 1);
+  }
+
+  void keep(void *) {}
+  tdestroy(root, keep);
+  free(legal);
+  free(infos);
+
+  result.records = xrealloc(result.records, result.num_records * result.record_size);
+  return result;
+}
+
+size_t write_dual_graph_with_move_table(const dual_graph_reader *dgr, const move_table *mt, FILE *restrict stream) {
+  container_header header;
+  memcpy(&header, dgr->directory, sizeof(container_header));
+  const section_entry *entries = (const section_entry *)(dgr->directory + sizeof(container_header));
+
+  section_data *sections = xmalloc((header.num_sections + 2) * sizeof(section_data));
+  int num_sections = 0;
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    if (entries[i].type == MOVE_IDS_SECTION || entries[i].type == MOVE_RECORDS_SECTION) {
+      continue;
+    }
+    sections[num_sections++] = (section_data){entries[i].type, dgr->buffer + entries[i].offset, entries[i].length};
+  }
+  if (mt->size) {
+    sections[num_sections++] = (section_data){MOVE_IDS_SECTION, mt->ids, mt->size * sizeof(uint32_t)};
+    sections[num_sections++] = (section_data){MOVE_RECORDS_SECTION, mt->records, mt->num_records * mt->record_size};
+  }
+
+  const size_t total = write_sections(sections, num_sections, stream);
+  free(sections);
+
+  return total;
+}
+
+void free_move_table(move_table *mt) {
+  free(mt->ids);
+  mt->ids = NULL;
+  free(mt->records);
+  mt->records = NULL;
+  mt->size = 0;
+  mt->num_records = 0;
+}
+
+terminal_table prepare_terminal_table(const dual_graph_reader *dgr, bool verbose) {
+  terminal_table result = {0};
+  if (dgr->type != COMPRESSED_KEYSPACE) {
+    return result;
+  }
+  const compressed_keyspace *cks = &(dgr->keyspace.compressed);
+  // Pruned readers only cover their stored keys
+  result.size = dgr->value_table.stored_keys ? dgr->value_table.num_stored_keys : cks->size;
+  result.steps = xmalloc(result.size * sizeof(terminal_step));
+  for (size_t index = 0; index < result.size; ++index) {
+    result.steps[index] = (terminal_step){{UNRESOLVED_PLIES, UNRESOLVED_PLIES}, {0, 0}};
+  }
+
+  // Consult the partial table while it is being built
+  dual_graph_reader partial = *dgr;
+  partial.terminal_table = result;
+
+  // Every key is owned by one thread and only ever decreases in (plies, move) order, so stale reads of other keys merely delay
+  // convergence. The fixed point stores the minimal plies and the first move reaching them regardless of the schedule.
+  for (int sweep = 0;; ++sweep) {
+    size_t num_updated = 0;
+    size_t num_unresolved = 0;
+#pragma omp parallel
+    {
+      reader_context ctx = create_reader_context(dgr, 0);
+#pragma omp for schedule(dynamic, 256) reduction(+ : num_updated, num_unresolved)
+      for (size_t key = 0; key < cks->size; ++key) {
+        size_t index;
+        if (!table_index(dgr, key, &index)) {
+          continue;
+        }
+        const state s = from_compressed_key(cks, key);
+        terminal_step *step = result.steps + index;
+        for (int track = LOW_TRACK; track <= HIGH_TRACK; ++track) {
+          int move;
+          const unsigned int plies = best_terminal_move(&partial, &ctx, &s, track, MAX_COMPENSATION_DEPTH, &move);
+          const unsigned int current = step->plies[track];
+          if (plies < current || (plies == current && plies < UNRESOLVED_PLIES && move < step->moves[track])) {
+            __atomic_store_n(step->moves + track, move, __ATOMIC_RELAXED);
+            __atomic_store_n(step->plies + track, plies, __ATOMIC_RELAXED);
+            num_updated++;
+          }
+          num_unresolved += step->plies[track] == UNRESOLVED_PLIES;
+        }
+      }
+      free_reader_context(&ctx);
+    }
+    if (verbose) {
+      printf("Sweep %d: %zu steps updated, %zu unresolved\n", sweep, num_updated, num_unresolved);
+    }
+    if (!num_updated) {
+      break;
+    }
+  }
+
+  return result;
+}
+
+size_t write_dual_graph_with_terminal_table(const dual_graph_reader *dgr, const terminal_table *tt, FILE *restrict stream) {
+  container_header header;
+  memcpy(&header, dgr->directory, sizeof(container_header));
+  const section_entry *entries = (const section_entry *)(dgr->directory + sizeof(container_header));
+
+  section_data *sections = xmalloc((header.num_sections + 1) * sizeof(section_data));
+  int num_sections = 0;
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    if (entries[i].type == TERMINAL_STEPS_SECTION) {
+      continue;
+    }
+    sections[num_sections++] = (section_data){entries[i].type, dgr->buffer + entries[i].offset, entries[i].length};
+  }
+  if (tt->size) {
+    sections[num_sections++] = (section_data){TERMINAL_STEPS_SECTION, tt->steps, tt->size * sizeof(terminal_step)};
+  }
+
+  const size_t total = write_sections(sections, num_sections, stream);
+  free(sections);
+
+  return total;
+}
+
+void free_terminal_table(terminal_table *tt) {
+  free(tt->steps);
+  tt->steps = NULL;
+  tt->size = 0;
+}
+
+static size_t hot_slot_index(const hot_table *ht, size_t key) {
+  return ((key * 11400714819323198485ULL) >> 32) & (ht->num_slots - 1);
+}
+
+// Open addressing set of the states outside the plain keyspace, i.e. ko, atari and pass states
+typedef struct region_states {
+  size_t num_slots;
+  size_t size;
+  state *slots;
+  bool *used;
+} region_states;
+
+static size_t region_state_index(const region_states *rs, const state *s) {
+  return ((hash_b(s) * 11400714819323198485ULL) >> 32) & (rs->num_slots - 1);
+}
+
+// Returns false if the state was already present
+static bool insert_region_state(region_states *rs, const state *s) {
+  if (2 * (rs->size + 1) > rs->num_slots) {
+    region_states grown = {rs->num_slots ? 2 * rs->num_slots : 1024, 0, NULL, NULL};
+    grown.slots = xmalloc(grown.num_slots * sizeof(state));
+    grown.used = xcalloc(grown.num_slots, sizeof(bool));
+    for (size_t i = 0; i < rs->num_slots; ++i) {
+      if (rs->used[i]) {
+        insert_region_state(&grown, rs->slots + i);
+      }
+    }
+    free(rs->slots);
+    free(rs->used);
+    *rs = grown;
+  }
+  for (size_t index = region_state_index(rs, s);; index = (index + 1) & (rs->num_slots - 1)) {
+    if (!rs->used[index]) {
+      rs->slots[index] = *s;
+      rs->used[index] = true;
+      rs->size++;
+      return true;
+    }
+    if (equals(rs->slots + index, s)) {
+      return false;
+    }
+  }
+}
+
+// Sorted keys looked up while evaluating every state within `max_depth` moves of the origins. The side keys of the ko and atari
+// states among them are listed too if `side_keys` is not NULL.
+static size_t *collect_region_keys(const dual_graph_reader *dgr, const state *origins, size_t num_origins, int max_depth,
+                                   size_t *num_keys, size_t **side_keys, size_t *num_side_keys) {
+  // Plain states are deduplicated by a bitmap over their keys and the few others by a set of whole states
+  const size_t num_words = ceil_divz(dgr->keyspace._.size, 64);
+  uint64_t *visited = xcalloc(num_words, sizeof(uint64_t));
+  uint64_t *recorded = xcalloc(num_words, sizeof(uint64_t));
+  region_states others = {0};
+  bool visit(const state *s) {
+    if (is_plain_key_state(dgr, s)) {
+      const size_t key = dgr->to_key(dgr, s);
+      const uint64_t bit = 1ULL << (key % 64);
+      return !(__atomic_fetch_or(visited + key / 64, bit, __ATOMIC_RELAXED) & bit);
+    }
+    bool inserted;
+#pragma omp critical(region_states)
+    inserted = insert_region_state(&others, s);
+    return inserted;
+  }
+
+  // Breadth-first so that depth limits are exact. States are marked when they enter the frontier.
+  size_t frontier_size = 0;
+  state *frontier = xmalloc(num_origins * sizeof(state));
+  for (size_t i = 0; i < num_origins; ++i) {
+    if (visit(origins + i)) {
+      frontier[frontier_size++] = origins[i];
+    }
+  }
+  for (int depth = 0; depth <= max_depth && frontier_size; ++depth) {
+    size_t next_size = 0;
+    state *next = NULL;
+#pragma omp parallel
+    {
+      reader_context ctx = create_reader_context(dgr, 0);
+      dual_table_value record(const state *c) {
+        const size_t key = dgr->to_key(dgr, c);
+        __atomic_fetch_or(recorded + key / 64, 1ULL << (key % 64), __ATOMIC_RELAXED);
+        return lookup_frozen_hash_value(&(dgr->value_table), ctx.id_blocks, key);
+      }
+      size_t local_size = 0;
+      size_t local_capacity = 0;
+      state *local = NULL;
+#pragma omp for schedule(dynamic, 64)
+      for (size_t i = 0; i < frontier_size; ++i) {
+        const state *s = frontier + i;
+        compensated_value(dgr->moves, dgr->num_moves, record, dgr->in_atari, dgr->can_take, s, MAX_COMPENSATION_DEPTH);
+        if (depth == max_depth) {
+          continue;
+        }
+        for (int j = 0; j < dgr->num_moves; ++j) {
+          state child = *s;
+          const move_result r = make_move(&child, dgr->moves[j]);
+          if (r == SECOND_PASS) {
+            // Dead stones are resolved from the cleared state
+            child.passes = 0;
+            child.ko = 0;
+            child.ko_threats = 0;
+          } else if (r <= TAKE_TARGET) {
+            continue;
+          }
+          if (!visit(&child)) {
+            continue;
+          }
+          if (local_size == local_capacity) {
+            local_capacity = local_capacity ? 2 * local_capacity : 1024;
+            local = xrealloc(local, local_capacity * sizeof(state));
+          }
+          local[local_size++] = child;
+        }
+      }
+#pragma omp critical(region_frontier)
+      {
+        next = xrealloc(next, (next_size + local_size) * sizeof(state));
+        memcpy(next + next_size, local, local_size * sizeof(state));
+        next_size += local_size;
+      }
+      free(local);
+      free_reader_context(&ctx);
+    }
+    free(frontier);
+    frontier = next;
+    frontier_size = next_size;
+  }
+  free(frontier);
+
+  // Mirror images of a state can share a side key
+  if (side_keys) {
+    *num_side_keys = 0;
+    *side_keys = xmalloc(others.size * sizeof(size_t));
+    for (size_t i = 0; i < others.num_slots; ++i) {
+      const state *s = others.slots + i;
+      if (others.used[i] && !s->passes && (s->ko || dgr->in_atari(s))) {
+        (*side_keys)[(*num_side_keys)++] = side_key(dgr->type, &(dgr->keyspace._), s);
+      }
+    }
+    qsort(*side_keys, *num_side_keys, sizeof(size_t), compare_keys);
+    size_t num_unique = 0;
+    for (size_t i = 0; i < *num_side_keys; ++i) {
+      if (!num_unique || (*side_keys)[i] != (*side_keys)[num_unique - 1]) {
+        (*side_keys)[num_unique++] = (*side_keys)[i];
+      }
+    }
+    *num_side_keys = num_unique;
+  }
+  free(others.slots);
+  free(others.used);
+  free(visited);
+
+  // The bitmap lists the keys in order
+  *num_keys = 0;
+  for (size_t i = 0; i < num_words; ++i) {
+    *num_keys += __builtin_popcountll(recorded[i]);
+  }
+  size_t *keys = xmalloc(*num_keys * sizeof(size_t));
+  size_t index = 0;
+  for (size_t i = 0; i < num_words; ++i) {
+    for (uint64_t bits = recorded[i]; bits; bits &= bits - 1) {
+      keys[index++] = 64 * i + __builtin_ctzll(bits);
+    }
+  }
+  free(recorded);
+
+  return keys;
+}
+
+hot_table prepare_hot_table(const dual_graph_reader *dgr, const state *origins, size_t num_origins, int plies) {
+  reader_context ctx = shared_context(dgr);
+
+  // One extra layer so that move hints of the last layer are covered too
+  size_t num_unique;
+  size_t *keys = collect_region_keys(dgr, origins, num_origins, plies + 1, &num_unique, NULL, NULL);
+
+  hot_table result = {0};
+  if (!num_unique) {
+    free(keys);
+    return result;
+  }
+  result.num_slots = 1;
+  while (result.num_slots < 2 * num_unique) {
+    result.num_slots <<= 1;
+  }
+  result.slots = xmalloc(result.num_slots * sizeof(hot_slot));
+  for (size_t i = 0; i < result.num_slots; ++i) {
+    result.slots[i] = (hot_slot){HOT_EMPTY_KEY, {{0, 0}, {0, 0}}, 0};
+  }
+  for (size_t i = 0; i < num_unique; ++i) {
+    size_t index = hot_slot_index(&result, keys[i]);
+    while (result.slots[index].key != HOT_EMPTY_KEY) {
+      index = (index + 1) & (result.num_slots - 1);
+    }
+    result.slots[index] = (hot_slot){keys[i], lookup_frozen_hash_value(&(dgr->value_table), ctx.id_blocks, keys[i]), 0};
+  }
+  result.size = num_unique;
+  free(keys);
+
+  return result;
+}
+
+bool get_hot_table_value(const hot_table *ht, size_t key, dual_table_value *v) {
+  if (!ht->num_slots) {
+    return false;
+  }
+  for (size_t index = hot_slot_index(ht, key);; index = (index + 1) & (ht->num_slots - 1)) {
+    if (ht->slots[index].key == key) {
+      *v = ht->slots[index].value;
+      return true;
+    }
+    if (ht->slots[index].key == HOT_EMPTY_KEY) {
+      return false;
+    }
+  }
+}
+
+size_t write_dual_graph_with_hot_table(const dual_graph_reader *dgr, const hot_table *ht, FILE *restrict stream) {
+  container_header header;
+  memcpy(&header, dgr->directory, sizeof(container_header));
+  const section_entry *entries = (const section_entry *)(dgr->directory + sizeof(container_header));
+
+  section_data *sections = xmalloc((header.num_sections + 1) * sizeof(section_data));
+  int num_sections = 0;
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    if (entries[i].type == HOT_SLOTS_SECTION) {
+      continue;
+    }
+    sections[num_sections++] = (section_data){entries[i].type, dgr->buffer + entries[i].offset, entries[i].length};
+  }
+  if (ht->num_slots) {
+    sections[num_sections++] = (section_data){HOT_SLOTS_SECTION, ht->slots, ht->num_slots * sizeof(hot_slot)};
+  }
+
+  const size_t total = write_sections(sections, num_sections, stream);
+  free(sections);
+
+  return total;
+}
+
+void free_hot_table(hot_table *ht) {
+  free(ht->slots);
+  ht->slots = NULL;
+  ht->num_slots = 0;
+  ht->size = 0;
+}
+
+size_t write_pruned_dual_graph(const dual_graph_reader *dgr, const state *origins, size_t num_origins, FILE *restrict stream) {
+  reader_context ctx = shared_context(dgr);
+
+  size_t num_keys;
+  size_t *side_keys;
+  size_t num_side_keys;
+  size_t *keys = collect_region_keys(dgr, origins, num_origins, INT_MAX, &num_keys, &side_keys, &num_side_keys);
+  dual_table_value *values = xmalloc(num_keys * sizeof(dual_table_value));
+  for (size_t i = 0; i < num_keys; ++i) {
+    values[i] = lookup_frozen_hash_value(&(dgr->value_table), ctx.id_blocks, keys[i]);
+  }
+
+  dual_table_value value_at(size_t i) { return values[i]; }
+  size_t value_map_size;
+  frozen_hash_table fht = freeze_values(num_keys, value_at, &value_map_size);
+  fht.id_layout = dgr->value_table.id_layout;
+  fht.num_stored_keys = num_keys;
+
+  // The bitmap grows with the keyspace so small regions list their keys instead
+  const size_t num_words = stored_keys_size(dgr->keyspace._.size);
+  uint64_t *stored_keys;
+  if (num_keys < num_words) {
+    stored_keys = xmalloc(num_keys * sizeof(uint64_t));
+    for (size_t i = 0; i < num_keys; ++i) {
+      stored_keys[i] = keys[i];
+    }
+    fht.stored_keys_sorted = true;
+  } else {
+    stored_keys = xcalloc(num_words, sizeof(uint64_t));
+    for (size_t i = 0; i < num_keys; ++i) {
+      stored_keys[(keys[i] / STORED_KEYS_BLOCK_SIZE) * STORED_KEYS_BLOCK_WORDS + 1 + (keys[i] % STORED_KEYS_BLOCK_SIZE) / 64] |=
+          1ULL << (keys[i] % 64);
+    }
+    size_t rank = 0;
+    for (size_t i = 0; i < num_words; i += STORED_KEYS_BLOCK_WORDS) {
+      stored_keys[i] = rank;
+      for (size_t j = 1; j < STORED_KEYS_BLOCK_WORDS; ++j) {
+        rank += __builtin_popcountll(stored_keys[i + j]);
+      }
+    }
+    assert(rank == num_keys);
+  }
+  fht.stored_keys = stored_keys;
+
+  value_id_t get_id(size_t i) {
+    dual_table_value *tv = bsearch(values + i, fht.bulk_map, fht.bulk_map_size, sizeof(dual_table_value), compare_dual_table_values);
+    return tv ? (value_id_t)(tv - fht.bulk_map) : VALUE_ID_SENTINEL(fht.id_width);
+  }
+
+  // Only the ko and atari states of the region are looked up in the side table
+  side_table st = subset_side_table(&(dgr->side_table), side_keys, num_side_keys);
+
+  const size_t total = write_container(dgr->type, &(dgr->keyspace._), dgr->num_moves, dgr->moves, &fht, get_id, &st, stream);
+
+  free_side_table(&st);
+  free(stored_keys);
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  free(values);
+  free(side_keys);
+  free(keys);
+
+  return total;
+}
@@ -58,6 +58,219 @@ bool can_take_single(const state *s) {
 
 bool there_is_no_target(const state *) { return false; }
 
+void select_target_predicates(const state *root, bool (**in_atari)(const state *s), bool (**can_take)(const state *s)) {
+  int num_player_chains = 0;
+  int num_opponent_chains = 0;
+  if (root->wide) {
+    free(chains_16(root->player & root->target, &num_player_chains));
+    free(chains_16(root->opponent & root->target, &num_opponent_chains));
+  } else {
+    free(chains(root->player & root->target, &num_player_chains));
+    free(chains(root->opponent & root->target, &num_opponent_chains));
+  }
+  if (!num_player_chains && !num_opponent_chains) {
+    *in_atari = there_is_no_target;
+    *can_take = there_is_no_target;
+  } else if (num_player_chains < 2 && num_opponent_chains < 2) {
+    *in_atari = in_atari_single;
+    *can_take = can_take_single;
+  } else {
+    *in_atari = target_in_atari;
+    *can_take = target_capturable;
+  }
+}
+
+// Number of ko point codes of a side key. Zero stands for no ko.
+#define SIDE_KO_M (CHAR_BIT * sizeof(stones_t) + 1)
+
+size_t side_key(keyspace_type type, const abstract_keyspace *ks, const state *s) {
+  state c = *s;
+  c.button = 0;
+  size_t key;
+  stones_t ko = s->ko;
+  if (type == COMPRESSED_KEYSPACE) {
+    key = to_tight_key_fast(&(((const compressed_keyspace *)ks)->keyspace), &c);
+  } else {
+    key = to_fast_ko_key((const symmetric_keyspace *)ks, &c, &ko);
+  }
+  key = key * 3 + (s->button + 1);
+  return key * SIDE_KO_M + (ko ? ctz(ko) + 1 : 0);
+}
+
+state from_side_key(keyspace_type type, const abstract_keyspace *ks, size_t key) {
+  const int ko_code = key % SIDE_KO_M;
+  key /= SIDE_KO_M;
+  const int button = (int)(key % 3) - 1;
+  key /= 3;
+  state result;
+  if (type == COMPRESSED_KEYSPACE) {
+    result = from_tight_key_fast(&(((const compressed_keyspace *)ks)->keyspace), key);
+  } else {
+    result = from_fast_key((const symmetric_keyspace *)ks, key);
+  }
+  result.button = button;
+  if (ko_code) {
+    result.ko = 1ULL << (ko_code - 1);
+  }
+  return result;
+}
+
+// Smallest power of two that keeps `size` entries at most three quarters full
+static size_t side_num_slots(size_t size) {
+  size_t result = 1;
+  while (4 * size > 3 * result) {
+    result <<= 1;
+  }
+  return result;
+}
+
+static inline size_t side_slot_index(size_t num_slots, size_t key) {
+  return ((key * 11400714819323198485ULL) >> 32) & (num_slots - 1);
+}
+
+// Returns the slot of the key after claiming an empty one if necessary. Safe to call concurrently.
+static size_t insert_side_key(size_t *keys, size_t num_slots, size_t key) {
+  for (size_t index = side_slot_index(num_slots, key);; index = (index + 1) & (num_slots - 1)) {
+    size_t expected = SIDE_EMPTY_KEY;
+    if (__atomic_compare_exchange_n(keys + index, &expected, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED) || expected == key) {
+      return index;
+    }
+  }
+}
+
+// Call `visit` with the ko and atari children of every keyspace state. Returns the number of visits.
+static size_t for_each_side_child(const dual_graph *dg, void (*visit)(const state *child)) {
+  dual_graph *g = (dual_graph *)dg;
+  size_t count = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+ : count)
+  for (size_t k = 0; k < dg->keyspace._.fast_size; ++k) {
+    if (!dg->was_legal(g, k)) {
+      continue;
+    }
+    state parent = dg->from_fast_key(g, k);
+    for (;;) {
+      for (int j = 0; j < dg->num_moves; ++j) {
+        state child = parent;
+        const move_result r = make_move(&child, dg->moves[j]);
+        if (r <= TAKE_TARGET || child.passes || !(child.ko || dg->in_atari(&child))) {
+          continue;
+        }
+        if (visit) {
+          visit(&child);
+        }
+        count++;
+      }
+      // Readers also serve parents that have handed the button over to the opponent
+      if (parent.button <= 0) {
+        break;
+      }
+      parent.button = -parent.button;
+    }
+  }
+  return count;
+}
+
+side_table create_side_table(const dual_graph *dg) {
+  side_table result = {0};
+  if (dg->type != COMPRESSED_KEYSPACE && dg->type != SYMMETRIC_KEYSPACE) {
+    return result;
+  }
+  const keyspace_type type = dg->type;
+  const abstract_keyspace *ks = &(dg->keyspace._);
+
+  // Parents share most of their children so deduplicate in a scratch set sized by the number of edges
+  const size_t num_scratch_slots = side_num_slots(for_each_side_child(dg, NULL));
+  size_t *scratch = xmalloc(num_scratch_slots * sizeof(size_t));
+  for (size_t i = 0; i < num_scratch_slots; ++i) {
+    scratch[i] = SIDE_EMPTY_KEY;
+  }
+  void insert(const state *child) { insert_side_key(scratch, num_scratch_slots, side_key(type, ks, child)); }
+  for_each_side_child(dg, insert);
+
+  for (size_t i = 0; i < num_scratch_slots; ++i) {
+    result.size += (scratch[i] != SIDE_EMPTY_KEY);
+  }
+  if (!result.size) {
+    free(scratch);
+    return result;
+  }
+
+  result.num_slots = side_num_slots(result.size);
+  result.keys = xmalloc(result.num_slots * sizeof(size_t));
+  result.values = xmalloc(result.num_slots * sizeof(dual_table_value));
+  for (size_t i = 0; i < result.num_slots; ++i) {
+    result.keys[i] = SIDE_EMPTY_KEY;
+    result.values[i] = (dual_table_value){MAX_RANGE_Q7, MAX_RANGE_Q7};
+  }
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t i = 0; i < num_scratch_slots; ++i) {
+    if (scratch[i] != SIDE_EMPTY_KEY) {
+      insert_side_key(result.keys, result.num_slots, scratch[i]);
+    }
+  }
+  free(scratch);
+  return result;
+}
+
+// Slot holding the key or SIZE_MAX if it is absent
+static size_t find_side_slot(const side_table *st, size_t key) {
+  if (!st->num_slots) {
+    return SIZE_MAX;
+  }
+  for (size_t index = side_slot_index(st->num_slots, key);; index = (index + 1) & (st->num_slots - 1)) {
+    if (st->keys[index] == key) {
+      return index;
+    }
+    if (st->keys[index] == SIDE_EMPTY_KEY) {
+      return SIZE_MAX;
+    }
+  }
+}
+
+bool get_side_table_value(const side_table *st, size_t key, dual_table_value *v) {
+  const size_t index = find_side_slot(st, key);
+  if (index == SIZE_MAX) {
+    return false;
+  }
+  *v = st->values[index];
+  return true;
+}
+
+side_table subset_side_table(const side_table *st, const size_t *keys, size_t num_keys) {
+  size_t *indices = xmalloc(num_keys * sizeof(size_t));
+  side_table result = {0};
+  for (size_t i = 0; i < num_keys; ++i) {
+    const size_t index = find_side_slot(st, keys[i]);
+    if (index != SIZE_MAX) {
+      indices[result.size++] = index;
+    }
+  }
+  if (result.size) {
+    result.num_slots = side_num_slots(result.size);
+    result.keys = xmalloc(result.num_slots * sizeof(size_t));
+    result.values = xmalloc(result.num_slots * sizeof(dual_table_value));
+    for (size_t i = 0; i < result.num_slots; ++i) {
+      result.keys[i] = SIDE_EMPTY_KEY;
+      result.values[i] = (dual_table_value){MAX_RANGE_Q7, MAX_RANGE_Q7};
+    }
+    for (size_t i = 0; i < result.size; ++i) {
+      const size_t index = insert_side_key(result.keys, result.num_slots, st->keys[indices[i]]);
+      result.values[index] = st->values[indices[i]];
+    }
+  }
+  free(indices);
+  return result;
+}
+
+void free_side_table(side_table *st) {
+  free(st->keys);
+  free(st->values);
+  st->keys = NULL;
+  st->values = NULL;
+  st->size = 0;
+  st->num_slots = 0;
+}
+
 void print_dual_graph(dual_graph *dg) {
   for (size_t i = 0; i < dg->keyspace._.size; ++i) {
     value pv = table_value_to_value(dg->plain_values[i]);
@@ -94,25 +307,7 @@ dual_graph create_dual_graph(const state *root, keyspace_type type) {
     exit(EXIT_FAILURE);
   }
 
-  int num_player_chains = 0;
-  int num_opponent_chains = 0;
-  if (root->wide) {
-    free(chains_16(root->player & root->target, &num_player_chains));
-    free(chains_16(root->opponent & root->target, &num_opponent_chains));
-  } else {
-    free(chains(root->player & root->target, &num_player_chains));
-    free(chains(root->opponent & root->target, &num_opponent_chains));
-  }
-  if (!num_player_chains && !num_opponent_chains) {
-    dg.in_atari = there_is_no_target;
-    dg.can_take = there_is_no_target;
-  } else if (num_player_chains < 2 && num_opponent_chains < 2) {
-    dg.in_atari = in_atari_single;
-    dg.can_take = can_take_single;
-  } else {
-    dg.in_atari = target_in_atari;
-    dg.can_take = target_capturable;
-  }
+  select_target_predicates(root, &dg.in_atari, &dg.can_take);
 
   dg.moves = moves_of(root, &dg.num_moves);
 
@@ -241,6 +436,44 @@ value get_dual_graph_value(dual_graph *dg, const state *s, tactics ts) {
   return (value){NAN, NAN};
 }
 
+// Value of a ko or atari child of a keyspace state from the side table of the graph
+static bool get_side_child_values(dual_graph *dg, const state *child, table_value *plain_value, table_value *forcing_value) {
+  if (!dg->side_table.num_slots || child->passes || !(child->ko || dg->in_atari(child))) {
+    return false;
+  }
+  dual_table_value v;
+  if (!get_side_table_value(&(dg->side_table), side_key(dg->type, &(dg->keyspace._), child), &v)) {
+    return false;
+  }
+  *plain_value = v.plain;
+  *forcing_value = v.forcing;
+  return true;
+}
+
+table_value get_dual_graph_area_value_(dual_graph *dg, const state *s, int depth);
+
+// Compensate for every side table entry once per sweep instead of once per parent
+static void refresh_side_table(dual_graph *dg, bool area) {
+  side_table *st = &(dg->side_table);
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t i = 0; i < st->num_slots; ++i) {
+    if (st->keys[i] == SIDE_EMPTY_KEY) {
+      continue;
+    }
+    dual_table_value *v = st->values + i;
+    const state s = from_side_key(dg->type, &(dg->keyspace._), st->keys[i]);
+    // Sweeps never visit parents that have handed over the button
+    if (s.button > 0) {
+      continue;
+    }
+    if (area) {
+      v->plain = get_dual_graph_area_value_(dg, &s, MAX_COMPENSATION_DEPTH);
+    } else if (v->plain.low != v->plain.high || v->forcing.low != v->forcing.high) {
+      get_dual_graph_values(dg, &s, MAX_COMPENSATION_DEPTH, &(v->plain), &(v->forcing));
+    }
+  }
+}
+
 size_t update_dual_graph_batch(dual_graph *dg, size_t batch_size) {
   const stones_t *moves = dg->moves;
   const int num_moves = dg->num_moves;
@@ -264,7 +497,9 @@ size_t update_dual_graph_batch(dual_graph *dg, size_t batch_size) {
         assert(r == ILLEGAL);
         continue;
       } else {
-        get_dual_graph_values(dg, &child, MAX_COMPENSATION_DEPTH, &child_plain, &child_forcing);
+        if (!get_side_child_values(dg, &child, &child_plain, &child_forcing)) {
+          get_dual_graph_values(dg, &child, MAX_COMPENSATION_DEPTH, &child_plain, &child_forcing);
+        }
         child_plain = apply_tactics_q7(NONE, r, &child, child_plain);
         child_forcing = apply_tactics_q7(FORCING, r, &child, child_forcing);
       }
@@ -295,6 +530,7 @@ size_t update_dual_graph_batch(dual_graph *dg, size_t batch_size) {
 }
 
 bool iterate_dual_graph(dual_graph *dg, bool verbose) {
+  refresh_side_table(dg, false);
   size_t num_updated = 0;
   size_t batch_size = 0;
   const size_t fast_size = dg->keyspace._.fast_size;
@@ -426,7 +662,10 @@ size_t update_dual_graph_area_batch(dual_graph *dg, size_t batch_size) {
         assert(r == ILLEGAL);
         continue;
       } else {
-        child_value = get_dual_graph_area_value_(dg, &child, MAX_COMPENSATION_DEPTH);
+        table_value child_forcing;
+        if (!get_side_child_values(dg, &child, &child_value, &child_forcing)) {
+          child_value = get_dual_graph_area_value_(dg, &child, MAX_COMPENSATION_DEPTH);
+        }
         child_value = apply_tactics_q7(NONE, r, &child, child_value);
       }
       if (child_value.high > low)
@@ -449,6 +688,7 @@ size_t update_dual_graph_area_batch(dual_graph *dg, size_t batch_size) {
 }
 
 bool area_iterate_dual_graph(dual_graph *dg, bool verbose) {
+  refresh_side_table(dg, true);
   size_t num_updated = 0;
   size_t batch_size = 0;
   const size_t fast_size = dg->keyspace._.fast_size;
@@ -476,7 +716,7 @@ bool area_iterate_dual_graph(dual_graph *dg, bool verbose) {
   return num_updated;
 }
 
-state dual_graph_low_terminal(dual_graph *dg, const state *origin, tactics ts) {
+state dual_graph_low_terminal_r(dual_graph *dg, rng_state *rng, const state *origin, tactics ts) {
   if (origin->passes > 1 || (origin->target & ~(origin->player | origin->opponent))) {
     return *origin;
   }
@@ -485,7 +725,7 @@ state dual_graph_low_terminal(dual_graph *dg, const state *origin, tactics ts) {
   get_dual_graph_values(dg, origin, MAX_COMPENSATION_DEPTH, &plain_value, &forcing_value);
 
   // Need to break loops by random navigation
-  unsigned int offset = jrand();
+  unsigned int offset = rng_next(rng);
   for (int i = 0; i < dg->num_moves; ++i) {
     int j = (i + offset) % dg->num_moves;
     state child = *origin;
@@ -526,6 +766,11 @@ state dual_graph_low_terminal(dual_graph *dg, const state *origin, tactics ts) {
   return *origin;
 }
 
+state dual_graph_low_terminal(dual_graph *dg, const state *origin, tactics ts) {
+  rng_state rng = seed_rng(jrand());
+  return dual_graph_low_terminal_r(dg, &rng, origin, ts);
+}
+
 state dual_graph_high_terminal(dual_graph *dg, const state *origin, tactics ts) {
   if (origin->passes > 1 || (origin->target & ~(origin->player | origin->opponent))) {
     return *origin;
@@ -591,4 +836,6 @@ void free_dual_graph(dual_graph *dg) {
   dg->plain_values = NULL;
   free(dg->forcing_values);
   dg->forcing_values = NULL;
+
+  free_side_table(&(dg->side_table));
 }
@@ -0,0 +1,579 @@
+#include "tinytsumego2/json_api.h"
+#include "tinytsumego2/stones.h"
+#include "tinytsumego2/stones16.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Nesting accepted in request bodies
+#define MAX_JSON_DEPTH (64)
+
+void write_json_float(FILE *stream, double x) {
+  if (isnan(x)) {
+    fputs("NaN", stream);
+    return;
+  }
+  if (isinf(x)) {
+    fputs(x < 0 ? "-Infinity" : "Infinity", stream);
+    return;
+  }
+
+  // Shortest digits that round-trip
+  char buffer[32];
+  for (int precision = 1; precision <= 17; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, x);
+    if (strtod(buffer, NULL) == x) {
+      break;
+    }
+  }
+
+  char digits[24];
+  int num_digits = 0;
+  const char *p = buffer;
+  if (*p == '-') {
+    fputc('-', stream);
+    p++;
+  }
+  for (; *p != 'e'; ++p) {
+    if (*p != '.') {
+      digits[num_digits++] = *p;
+    }
+  }
+  while (num_digits > 1 && digits[num_digits - 1] == '0') {
+    num_digits--;
+  }
+  // Position of the decimal point relative to the first digit
+  const int point = atoi(p + 1) + 1;
+
+  if (point <= -4 || point > 16) {
+    fputc(digits[0], stream);
+    if (num_digits > 1) {
+      fputc('.', stream);
+      fwrite(digits + 1, 1, num_digits - 1, stream);
+    }
+    fprintf(stream, "e%c%02d", point - 1 < 0 ? '-' : '+', abs(point - 1));
+  } else if (point <= 0) {
+    fputs("0.", stream);
+    for (int i = point; i < 0; ++i) {
+      fputc('0', stream);
+    }
+    fwrite(digits, 1, num_digits, stream);
+  } else if (num_digits <= point) {
+    fwrite(digits, 1, num_digits, stream);
+    for (int i = num_digits; i < point; ++i) {
+      fputc('0', stream);
+    }
+    fputs(".0", stream);
+  } else {
+    fwrite(digits, 1, point, stream);
+    fputc('.', stream);
+    fwrite(digits + point, 1, num_digits - point, stream);
+  }
+}
+
+void write_json_string(FILE *stream, const char *str) {
+  const unsigned char *p = (const unsigned char *)str;
+  fputc('"', stream);
+  while (*p) {
+    uint32_t c = *p++;
+    if (c >= 0x80) {
+      // Decode UTF-8 leniently so that stray bytes come out as themselves
+      int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+      c &= 0x3F >> extra;
+      for (; extra && (*p & 0xC0) == 0x80; --extra) {
+        c = (c << 6) | (*p++ & 0x3F);
+      }
+    }
+    if (c == '"') {
+      fputs("\\\"", stream);
+    } else if (c == '\\') {
+      fputs("\\\\", stream);
+    } else if (c == '\n') {
+      fputs("\\n", stream);
+    } else if (c == '\r') {
+      fputs("\\r", stream);
+    } else if (c == '\t') {
+      fputs("\\t", stream);
+    } else if (c == '\b') {
+      fputs("\\b", stream);
+    } else if (c == '\f') {
+      fputs("\\f", stream);
+    } else if (c < 0x20 || (c >= 0x7F && c < 0x10000)) {
+      fprintf(stream, "\\u%04x", c);
+    } else if (c >= 0x10000) {
+      c -= 0x10000;
+      fprintf(stream, "\\u%04x\\u%04x", 0xD800 | (c >> 10), 0xDC00 | (c & 0x3FF));
+    } else {
+      fputc(c, stream);
+    }
+  }
+  fputc('"', stream);
+}
+
+void write_stones_json(FILE *stream, stones_t stones, bool wide) {
+  const stones_t wall = wide ? NORTH_WALL_16 : NORTH_WALL;
+  const int shift = wide ? V_SHIFT_16 : V_SHIFT;
+  fputc('[', stream);
+  for (bool first = true; stones; stones >>= shift, first = false) {
+    fprintf(stream, first ? "%llu" : ", %llu", (unsigned long long)(stones & wall));
+  }
+  fputc(']', stream);
+}
+
+static void write_json_bool(FILE *stream, bool b) { fputs(b ? "true" : "false", stream); }
+
+void write_state_json(FILE *stream, const state *s) {
+  const char *names[] = {"visualArea", "logicalArea", "player", "opponent", "ko", "target", "immortal", "external"};
+  const stones_t stones[] = {s->visual_area, s->logical_area, s->player, s->opponent, s->ko, s->target, s->immortal, s->external};
+  fputc('{', stream);
+  for (int i = 0; i < 8; ++i) {
+    fprintf(stream, "\"%s\": ", names[i]);
+    write_stones_json(stream, stones[i], s->wide);
+    fputs(", ", stream);
+  }
+  fprintf(stream, "\"passes\": %d, \"koThreats\": %d, \"button\": %d, \"whiteToPlay\": ", s->passes, s->ko_threats, s->button);
+  write_json_bool(stream, s->white_to_play);
+  fputc('}', stream);
+}
+
+void write_move_infos_json(FILE *stream, const move_info *move_infos, int num_move_infos) {
+  fputs("{\"moves\": [", stream);
+  for (int i = 0; i < num_move_infos; ++i) {
+    const move_info *m = move_infos + i;
+    fprintf(stream, "%s{\"x\": %d, \"y\": %d, \"lowGain\": ", i ? ", " : "", m->coords.x, m->coords.y);
+    write_json_float(stream, m->low_gain);
+    fputs(", \"highGain\": ", stream);
+    write_json_float(stream, m->high_gain);
+    fputs(", \"lowIdeal\": ", stream);
+    write_json_bool(stream, m->low_ideal);
+    fputs(", \"highIdeal\": ", stream);
+    write_json_bool(stream, m->high_ideal);
+    fputs(", \"forcing\": ", stream);
+    write_json_bool(stream, m->forcing);
+    fputc('}', stream);
+  }
+  fputs("]}", stream);
+}
+
+void write_dead_stones_json(FILE *stream, stones_t dead_stones, bool wide) {
+  fputs("{\"deadStones\": ", stream);
+  write_stones_json(stream, dead_stones, wide);
+  fputc('}', stream);
+}
+
+void write_state_response_json(FILE *stream, response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  if (s->passes >= 2) {
+    state terminal = *s;
+    terminal.passes = 0;
+    terminal.ko = 0;
+    terminal.ko_threats = 0;
+    // Plain values have been "used up" for area scoring. Take the forcing terminal.
+    write_dead_stones_json(stream, cached_dead_stones(cache, dgr, ctx, &terminal), s->wide);
+    return;
+  }
+  int num_move_infos = 0;
+  move_info *move_infos = cached_move_infos(cache, dgr, ctx, s, &num_move_infos);
+  write_move_infos_json(stream, move_infos, num_move_infos);
+  free(move_infos);
+}
+
+void write_error_json(FILE *stream, const char *message) {
+  fputs("{\"error\": ", stream);
+  write_json_string(stream, message);
+  fputc('}', stream);
+}
+
+void write_collections_json(FILE *stream, const collection *collections, size_t num_collections, bool deep) {
+  fputs("{\"collections\": [", stream);
+  for (size_t i = 0; i < num_collections; ++i) {
+    const collection *c = collections + i;
+    fputs(i ? ", {\"slug\": " : "{\"slug\": ", stream);
+    write_json_string(stream, c->slug);
+    if (deep) {
+      fputs(", \"tsumegos\": [", stream);
+      for (size_t j = 0; j < c->num_tsumegos; ++j) {
+        if (j) {
+          fputs(", ", stream);
+        }
+        write_json_string(stream, c->tsumegos[j].slug);
+      }
+      fputs("]}", stream);
+    } else {
+      fputs(", \"title\": ", stream);
+      write_json_string(stream, c->title);
+      fputc('}', stream);
+    }
+  }
+  fputs("]}", stream);
+}
+
+void write_collection_json(FILE *stream, const collection *c) {
+  fputs("{\"title\": ", stream);
+  write_json_string(stream, c->title);
+  fputs(", \"root\": ", stream);
+  write_state_json(stream, &(c->root));
+  fputs(", \"canStretch\": ", stream);
+  write_json_bool(stream, c->can_stretch);
+  fputs(", \"tsumegos\": [", stream);
+  for (size_t j = 0; j < c->num_tsumegos; ++j) {
+    fputs(j ? ", {\"slug\": " : "{\"slug\": ", stream);
+    write_json_string(stream, c->tsumegos[j].slug);
+    fputs(", \"subtitle\": ", stream);
+    write_json_string(stream, c->tsumegos[j].subtitle);
+    fputc('}', stream);
+  }
+  fputs("]}", stream);
+}
+
+void write_tsumego_json(FILE *stream, const collection *c, const tsumego *t) {
+  fputs("{\"title\": ", stream);
+  write_json_string(stream, c->title);
+  fputs(", \"subtitle\": ", stream);
+  write_json_string(stream, t->subtitle);
+  fputs(", \"state\": ", stream);
+  write_state_json(stream, &(t->state));
+  fputs(", \"botToPlay\": ", stream);
+  write_json_bool(stream, t->bot_to_play);
+  fputs(", \"canStretch\": ", stream);
+  write_json_bool(stream, c->can_stretch);
+  fputc('}', stream);
+}
+
+typedef struct json_cursor {
+  const char *p;
+  const char *end;
+} json_cursor;
+
+static void skip_whitespace(json_cursor *jc) {
+  while (jc->p < jc->end && (*jc->p == ' ' || *jc->p == '\t' || *jc->p == '\n' || *jc->p == '\r')) {
+    jc->p++;
+  }
+}
+
+static bool skip_literal(json_cursor *jc, const char *literal) {
+  const size_t n = strlen(literal);
+  if ((size_t)(jc->end - jc->p) < n || memcmp(jc->p, literal, n)) {
+    return false;
+  }
+  jc->p += n;
+  return true;
+}
+
+static bool is_digit(json_cursor *jc) { return jc->p < jc->end && *jc->p >= '0' && *jc->p <= '9'; }
+
+static bool skip_string(json_cursor *jc) {
+  if (jc->p >= jc->end || *jc->p != '"') {
+    return false;
+  }
+  for (jc->p++; jc->p < jc->end; jc->p++) {
+    const unsigned char c = *jc->p;
+    if (c == '"') {
+      jc->p++;
+      return true;
+    }
+    if (c < 0x20) {
+      return false;
+    }
+    if (c == '\\') {
+      if (++jc->p >= jc->end) {
+        return false;
+      }
+      if (*jc->p == 'u') {
+        for (int i = 0; i < 4; ++i) {
+          if (++jc->p >= jc->end || !strchr("0123456789abcdefABCDEF", *jc->p)) {
+            return false;
+          }
+        }
+      } else if (!strchr("\"\\/bfnrt", *jc->p)) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+// Skip a number and report whether it is an integer
+static bool skip_number(json_cursor *jc, bool *integral) {
+  *integral = true;
+  if (jc->p < jc->end && *jc->p == '-') {
+    jc->p++;
+  }
+  if (skip_literal(jc, "Infinity")) {
+    *integral = false;
+    return true;
+  }
+  if (!is_digit(jc)) {
+    return false;
+  }
+  if (*jc->p++ != '0') {
+    while (is_digit(jc)) {
+      jc->p++;
+    }
+  }
+  if (jc->p < jc->end && *jc->p == '.') {
+    *integral = false;
+    jc->p++;
+    if (!is_digit(jc)) {
+      return false;
+    }
+    while (is_digit(jc)) {
+      jc->p++;
+    }
+  }
+  if (jc->p < jc->end && (*jc->p == 'e' || *jc->p == 'E')) {
+    *integral = false;
+    jc->p++;
+    if (jc->p < jc->end && (*jc->p == '+' || *jc->p == '-')) {
+      jc->p++;
+    }
+    if (!is_digit(jc)) {
+      return false;
+    }
+    while (is_digit(jc)) {
+      jc->p++;
+    }
+  }
+  return true;
+}
+
+static bool skip_value(json_cursor *jc, int depth) {
+  skip_whitespace(jc);
+  if (jc->p >= jc->end || depth > MAX_JSON_DEPTH) {
+    return false;
+  }
+  bool integral;
+  switch (*jc->p) {
+  case '"':
+    return skip_string(jc);
+  case 't':
+    return skip_literal(jc, "true");
+  case 'f':
+    return skip_literal(jc, "false");
+  case 'n':
+    return skip_literal(jc, "null");
+  case 'N':
+    return skip_literal(jc, "NaN");
+  case '[':
+  case '{': {
+    const char close = *jc->p == '[' ? ']' : '}';
+    const bool object = close == '}';
+    jc->p++;
+    skip_whitespace(jc);
+    if (jc->p < jc->end && *jc->p == close) {
+      jc->p++;
+      return true;
+    }
+    for (;;) {
+      if (object) {
+        skip_whitespace(jc);
+        if (!skip_string(jc)) {
+          return false;
+        }
+        skip_whitespace(jc);
+        if (jc->p >= jc->end || *jc->p++ != ':') {
+          return false;
+        }
+      }
+      if (!skip_value(jc, depth + 1)) {
+        return false;
+      }
+      skip_whitespace(jc);
+      if (jc->p >= jc->end) {
+        return false;
+      }
+      const char c = *jc->p++;
+      if (c == close) {
+        return true;
+      }
+      if (c != ',') {
+        return false;
+      }
+    }
+  }
+  default:
+    return skip_number(jc, &integral);
+  }
+}
+
+// Position of the value of the last member named `key` of a validated object or NULL
+static const char *find_member(const char *object, const char *end, const char *key) {
+  json_cursor jc = {object, end};
+  skip_whitespace(&jc);
+  if (jc.p >= jc.end || *jc.p != '{') {
+    return NULL;
+  }
+  jc.p++;
+  const char *result = NULL;
+  const size_t key_length = strlen(key);
+  for (;;) {
+    skip_whitespace(&jc);
+    if (*jc.p == '}') {
+      return result;
+    }
+    const char *name = jc.p + 1;
+    skip_string(&jc);
+    const bool match = (size_t)(jc.p - 1 - name) == key_length && !memcmp(name, key, key_length);
+    skip_whitespace(&jc);
+    jc.p++;
+    skip_whitespace(&jc);
+    if (match) {
+      result = jc.p;
+    }
+    skip_value(&jc, 0);
+    skip_whitespace(&jc);
+    if (*jc.p++ == '}') {
+      return result;
+    }
+  }
+}
+
+// Integers and booleans are accepted wherever Python would accept an int
+static bool parse_integer(const char *value, const char *end, long long *result) {
+  json_cursor jc = {value, end};
+  if (skip_literal(&jc, "true")) {
+    *result = 1;
+    return true;
+  }
+  if (skip_literal(&jc, "false")) {
+    *result = 0;
+    return true;
+  }
+  bool integral;
+  if (!skip_number(&jc, &integral) || !integral) {
+    return false;
+  }
+  // Python integers are unbounded so keep the low bits like the ctypes conversion does
+  const bool negative = *value == '-';
+  unsigned long long magnitude = 0;
+  for (const char *p = value + negative; p < jc.p; ++p) {
+    magnitude = 10 * magnitude + (*p - '0');
+  }
+  *result = (long long)(negative ? -magnitude : magnitude);
+  return true;
+}
+
+static bool parse_stones(const char *value, const char *end, bool wide, stones_t *result) {
+  const stones_t wall = wide ? NORTH_WALL_16 : NORTH_WALL;
+  const int shift = wide ? V_SHIFT_16 : V_SHIFT;
+  json_cursor jc = {value, end};
+  if (jc.p >= jc.end || *jc.p != '[') {
+    return false;
+  }
+  // Rows are listed from the top so collect them before shifting from the bottom
+  stones_t rows[64];
+  int num_rows = 0;
+  jc.p++;
+  skip_whitespace(&jc);
+  while (*jc.p != ']') {
+    long long row;
+    skip_whitespace(&jc);
+    if (!parse_integer(jc.p, jc.end, &row)) {
+      return false;
+    }
+    if (num_rows < 64) {
+      rows[num_rows] = (stones_t)row & wall;
+    }
+    num_rows++;
+    skip_value(&jc, 0);
+    skip_whitespace(&jc);
+    if (*jc.p == ',') {
+      jc.p++;
+      skip_whitespace(&jc);
+    }
+  }
+  *result = 0;
+  for (int i = (num_rows < 64 ? num_rows : 64) - 1; i >= 0; --i) {
+    *result = (*result << shift) | rows[i];
+  }
+  return true;
+}
+
+move_request_status parse_move_request(const char *body, size_t length, bool wide, state *s) {
+  const char *end = body + length;
+  json_cursor jc = {body, end};
+  if (!skip_value(&jc, 0)) {
+    return MALFORMED_JSON;
+  }
+  skip_whitespace(&jc);
+  if (jc.p != end) {
+    return MALFORMED_JSON;
+  }
+
+  const char *data = find_member(body, end, "state");
+  if (!data) {
+    return MISSING_STATE;
+  }
+  if (*data != '{') {
+    return INVALID_STATE;
+  }
+
+  *s = (state){0};
+  const char *names[] = {"visualArea", "logicalArea", "player", "opponent", "ko", "target", "immortal", "external"};
+  stones_t *stones[] = {&s->visual_area, &s->logical_area, &s->player, &s->opponent, &s->ko, &s->target, &s->immortal, &s->external};
+  for (int i = 0; i < 8; ++i) {
+    const char *value = find_member(data, end, names[i]);
+    if (!value || !parse_stones(value, end, wide, stones[i])) {
+      return INVALID_STATE;
+    }
+  }
+
+  const char *int_names[] = {"passes", "koThreats", "button", "whiteToPlay"};
+  long long ints[4];
+  for (int i = 0; i < 4; ++i) {
+    const char *value = find_member(data, end, int_names[i]);
+    if (!value || !parse_integer(value, end, ints + i)) {
+      return INVALID_STATE;
+    }
+  }
+  s->passes = (int)ints[0];
+  s->ko_threats = (int)ints[1];
+  s->button = (int)ints[2];
+  s->white_to_play = ints[3] != 0;
+  s->wide = wide;
+
+  return MOVE_REQUEST_OK;
+}
+
+void format_state_address(const state *s, char *address) {
+  snprintf(address, STATE_ADDRESS_SIZE, "%llx_%llx_%llx_%llx_%llx_%llx_%llx_%llx_%d_%d_%d_%d", (unsigned long long)s->visual_area,
+           (unsigned long long)s->logical_area, (unsigned long long)s->player, (unsigned long long)s->opponent,
+           (unsigned long long)s->ko, (unsigned long long)s->target, (unsigned long long)s->immortal,
+           (unsigned long long)s->external, s->passes, s->ko_threats, s->button, s->white_to_play ? 1 : 0);
+}
+
+bool parse_state_address(const char *address, size_t length, bool wide, state *s) {
+  char buffer[STATE_ADDRESS_SIZE];
+  if (length >= STATE_ADDRESS_SIZE) {
+    return false;
+  }
+  memcpy(buffer, address, length);
+  buffer[length] = '\0';
+
+  unsigned long long stones[8];
+  int ints[4];
+  if (sscanf(buffer, "%llx_%llx_%llx_%llx_%llx_%llx_%llx_%llx_%d_%d_%d_%d", stones, stones + 1, stones + 2, stones + 3, stones + 4,
+             stones + 5, stones + 6, stones + 7, ints, ints + 1, ints + 2, ints + 3) != 12 ||
+      (ints[3] != 0 && ints[3] != 1)) {
+    return false;
+  }
+  *s = (state){0};
+  s->visual_area = stones[0];
+  s->logical_area = stones[1];
+  s->player = stones[2];
+  s->opponent = stones[3];
+  s->ko = stones[4];
+  s->target = stones[5];
+  s->immortal = stones[6];
+  s->external = stones[7];
+  s->passes = ints[0];
+  s->ko_threats = ints[1];
+  s->button = ints[2];
+  s->white_to_play = ints[3];
+  s->wide = wide;
+
+  // Reject leading zeros, signs and other spellings of the same state
+  char canonical[STATE_ADDRESS_SIZE];
+  format_state_address(s, canonical);
+  return strcmp(buffer, canonical) == 0;
+}
@@ -198,6 +198,102 @@ state from_tight_key_fast(const tight_keyspace *tks, size_t key) {
   return result;
 }
 
+// Number of entries in a trit block covering (part of) `num_points` points
+static size_t trit_block_m(int num_points, int block) {
+  if (block < num_points / TRIT_BLOCK_SIZE) {
+    return TRIT_BLOCK_M;
+  }
+  size_t m = 1;
+  for (int j = 0; j < num_points % TRIT_BLOCK_SIZE; ++j) {
+    m *= 3;
+  }
+  return m;
+}
+
+static int tight_effective_size(const state *root) {
+  return popcount(root->logical_area & ~(root->target | root->immortal | root->external));
+}
+
+size_t write_tight_keyspace(const tight_keyspace *restrict tks, size_t offset, FILE *restrict stream) {
+  size_t total = offset;
+  WRITE_FIELD(total, stream, tks->root);
+  WRITE_FIELD(total, stream, tks->size);
+  WRITE_FIELD(total, stream, tks->symmetric_threats);
+  WRITE_FIELD(total, stream, tks->ko_m);
+  WRITE_FIELD(total, stream, tks->num_tritters);
+  WRITE_FIELD(total, stream, tks->external_m);
+  WRITE_FIELD(total, stream, tks->external_prime);
+  WRITE_FIELD(total, stream, tks->prefix_m);
+  WRITE_FIELD(total, stream, tks->num_blocks);
+
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, tks->tritters, tks->num_tritters);
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, tks->external_keys, tks->external_prime);
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, tks->prefixes, tks->prefix_m);
+  const int effective_size = tight_effective_size(&(tks->root));
+  for (int i = 0; i < tks->num_blocks; ++i) {
+    WRITE_PADDING(total, stream);
+    WRITE_ARRAY(total, stream, tks->black_blocks[i], trit_block_m(effective_size, i));
+    WRITE_ARRAY(total, stream, tks->white_blocks[i], trit_block_m(effective_size, i));
+  }
+  return total - offset;
+}
+
+size_t tight_keyspace_bytes(const state *root, const bool symmetric_threats) {
+  const int effective_size = tight_effective_size(root);
+  const size_t ko_m = symmetric_threats ? 2 * abs(root->ko_threats) + 1 : abs(root->ko_threats) + 1;
+  const size_t external_m = 1 << popcount(root->external);
+  const int num_blocks = ceil_div(effective_size, TRIT_BLOCK_SIZE);
+
+  // Header, one tritter per block and the smallest possible perfect hash. Padding is ignored.
+  size_t result = sizeof(tight_keyspace) + num_blocks * sizeof(tritter) + (external_m + 1) * sizeof(size_t);
+  result += 4 * ko_m * external_m * sizeof(state);
+  for (int i = 0; i < num_blocks; ++i) {
+    result += 2 * trit_block_m(effective_size, i) * sizeof(stones_t);
+  }
+  return result;
+}
+
+char *map_tight_keyspace(tight_keyspace *tks, char *map, const char *base) {
+  READ_FIELD(map, tks->root);
+  READ_FIELD(map, tks->size);
+  READ_FIELD(map, tks->symmetric_threats);
+  READ_FIELD(map, tks->ko_m);
+  READ_FIELD(map, tks->num_tritters);
+  READ_FIELD(map, tks->external_m);
+  READ_FIELD(map, tks->external_prime);
+  READ_FIELD(map, tks->prefix_m);
+  READ_FIELD(map, tks->num_blocks);
+
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, tks->tritters, tks->num_tritters);
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, tks->external_keys, tks->external_prime);
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, tks->prefixes, tks->prefix_m);
+  const int effective_size = tight_effective_size(&(tks->root));
+  tks->black_blocks = xmalloc(tks->num_blocks * sizeof(stones_t *));
+  tks->white_blocks = xmalloc(tks->num_blocks * sizeof(stones_t *));
+  for (int i = 0; i < tks->num_blocks; ++i) {
+    ALIGN_MAP(map, base);
+    MAP_ARRAY_FIELD(map, tks->black_blocks[i], trit_block_m(effective_size, i));
+    MAP_ARRAY_FIELD(map, tks->white_blocks[i], trit_block_m(effective_size, i));
+  }
+  return map;
+}
+
+void unmap_tight_keyspace(tight_keyspace *tks) {
+  tks->external_keys = NULL;
+  tks->tritters = NULL;
+  tks->prefixes = NULL;
+  free(tks->black_blocks);
+  tks->black_blocks = NULL;
+  free(tks->white_blocks);
+  tks->white_blocks = NULL;
+}
+
 void free_tight_keyspace(tight_keyspace *tks) {
   tks->external_prime = 0;
   free(tks->external_keys);
@@ -221,12 +317,32 @@ void free_tight_keyspace(tight_keyspace *tks) {
 }
 
 monotonic_compressor create_monotonic_compressor(size_t num_keys, indicator_f indicator) {
+  unsigned long long mask_indicator(size_t first) {
+    unsigned long long mask = 0ULL;
+    for (size_t i = 0; i < 64 && first + i < num_keys; ++i) {
+      if (indicator(first + i)) {
+        mask |= 1ULL << i;
+      }
+    }
+    return mask;
+  }
+  return create_monotonic_compressor_64(num_keys, mask_indicator);
+}
+
+monotonic_compressor create_monotonic_compressor_64(size_t num_keys, mask_indicator_f indicator) {
   monotonic_compressor result = {0};
   result.uncompressed_size = num_keys;
   result.num_checkpoints = ceil_divz(num_keys, 1 << CHAR_BIT);
   result.checkpoints = xmalloc(result.num_checkpoints * sizeof(size_t));
   result.deltas = xmalloc(num_keys * sizeof(unsigned char));
 
+  const size_t num_masks = ceil_divz(num_keys, 64);
+  unsigned long long *masks = xmalloc(num_masks * sizeof(unsigned long long));
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t i = 0; i < num_masks; ++i) {
+    masks[i] = indicator(64 * i);
+  }
+
   size_t num_legal = 0;
   size_t last_checkpoint = 0;
   for (size_t key = 0; key < num_keys; ++key) {
@@ -235,10 +351,11 @@ monotonic_compressor create_monotonic_compressor(size_t num_keys, indicator_f in
       last_checkpoint = num_legal;
     }
     result.deltas[key] = num_legal - last_checkpoint;
-    if (indicator(key)) {
+    if (masks[key >> 6] & (1ULL << (key & 63))) {
       num_legal++;
     }
   }
+  free(masks);
 
   result.size = num_legal;
   if (num_legal) {
@@ -283,19 +400,37 @@ void free_monotonic_compressor(monotonic_compressor *mc) {
   mc->deltas = NULL;
 }
 
+bool is_keyspace_state(const state *s) { return !target_in_atari(s) && !target_capturable(s) && is_legal(s); }
+
+// Clear the bits of legal states where the target can be captured or is in atari
+static unsigned long long exclude_target_in_atari(const state *states, unsigned long long mask) {
+  if (!states[0].target) {
+    return mask;
+  }
+  for (unsigned long long m = mask; m; m &= m - 1) {
+    const state *s = states + ctz(m);
+    if (target_in_atari(s) || target_capturable(s)) {
+      mask ^= m & -m;
+    }
+  }
+  return mask;
+}
+
 compressed_keyspace create_compressed_keyspace(const state *root) {
   compressed_keyspace result = {0};
   result.root = *root;
   result.keyspace = create_tight_keyspace(root, true);
   result.prefix_m = result.keyspace.prefix_m / result.keyspace.external_m;
-  bool indicator(size_t key) {
-    const state s = from_tight_key_fast(&(result.keyspace), key * result.prefix_m);
-    if (target_in_atari(&s) || target_capturable(&s)) {
-      return false;
+  const size_t num_keys = result.keyspace.size / result.prefix_m;
+  unsigned long long indicator(size_t first) {
+    state states[64];
+    const int count = first + 64 <= num_keys ? 64 : num_keys - first;
+    for (int i = 0; i < count; ++i) {
+      states[i] = from_tight_key_fast(&(result.keyspace), (first + i) * result.prefix_m);
     }
-    return is_legal(&s);
+    return exclude_target_in_atari(states, is_legal_64(states, count));
   }
-  result.compressor = create_monotonic_compressor(result.keyspace.size / result.prefix_m, indicator);
+  result.compressor = create_monotonic_compressor_64(num_keys, indicator);
   result.size = result.prefix_m * result.compressor.size;
   result.fast_size = result.keyspace.size;
   return result;
@@ -322,7 +457,11 @@ void free_compressed_keyspace(compressed_keyspace *cks) {
   free_monotonic_compressor(&(cks->compressor));
 }
 
-symmetric_keyspace create_symmetric_keyspace(const state *root) {
+symmetric_keyspace prepare_symmetric_keyspace(const state *root) {
+  if (root->external) {
+    fprintf(stderr, "External liberties are not supported with symmetric keyspaces\n");
+    exit(EXIT_FAILURE);
+  }
   symmetric_keyspace result = {0};
   result.root = *root;
   result.symmetry = compute_symmetry(root);
@@ -330,40 +469,133 @@ symmetric_keyspace create_symmetric_keyspace(const state *root) {
   result.prefix_m = 2;
   // Signed ko-threats
   result.prefix_m *= 2 * abs(root->ko_threats) + 1;
-  // Color information dropped
+  // Color information dropped unless there are fixed stones to tell the players apart
+  result.color_m = ((root->player | root->opponent) & ~result.symmetry.variable_area) ? 2 : 1;
 
-  result.fast_size = result.symmetry.size * result.prefix_m;
+  result.fast_size = result.symmetry.size * result.color_m * result.prefix_m;
+
+  return result;
+}
 
-  bool indicator(size_t key) {
-    state s = *root;
-    from_symmetric_bw_key(&(result.symmetry), key, &(s.player), &(s.opponent));
-    // Note that target stones are not supported with symmetries yet
-    return is_legal(&s);
+symmetric_keyspace create_symmetric_keyspace(const state *root) {
+  symmetric_keyspace result = prepare_symmetric_keyspace(root);
+
+  const size_t num_keys = result.symmetry.size * result.color_m;
+  unsigned long long indicator(size_t first) {
+    state states[64];
+    const int count = first + 64 <= num_keys ? 64 : num_keys - first;
+    for (int i = 0; i < count; ++i) {
+      states[i] = from_fast_key(&result, (first + i) * result.prefix_m);
+    }
+    return exclude_target_in_atari(states, is_legal_64(states, count));
   }
 
-  result.compressor = create_monotonic_compressor(result.symmetry.size, indicator);
+  result.compressor = create_monotonic_compressor_64(num_keys, indicator);
   result.size = result.prefix_m * result.compressor.size;
 
   return result;
 }
 
+// Canonical key of the variable stones with the color bit appended when the root has fixed stones
+static inline size_t to_symmetric_stones_key(const symmetric_keyspace *sks, const state *s) {
+  if (sks->color_m == 1) {
+    return to_symmetric_bw_key(&(sks->symmetry), s->player, s->opponent);
+  }
+  const stones_t variable_area = sks->symmetry.variable_area;
+  const stones_t black = (s->white_to_play ? s->opponent : s->player) & variable_area;
+  const stones_t white = (s->white_to_play ? s->player : s->opponent) & variable_area;
+  return to_symmetric_bw_key(&(sks->symmetry), black, white) * 2 + !!s->white_to_play;
+}
+
 size_t to_symmetric_key(const symmetric_keyspace *sks, const state *s) {
-  const size_t key = to_symmetric_bw_key(&(sks->symmetry), s->player, s->opponent);
+  const size_t key = to_symmetric_stones_key(sks, s);
   return (s->button + 2 * (s->ko_threats + abs(sks->root.ko_threats)) + sks->prefix_m * compress_key(&(sks->compressor), key));
 }
 
-state from_symmetric_key(const symmetric_keyspace *sks, size_t key) {
-  state result = sks->root;
-  result.button = key % 2;
-  key /= 2;
-  size_t m = 2 * abs(sks->root.ko_threats) + 1;
-  result.ko_threats = (int)(key % m) - abs(sks->root.ko_threats);
-  key /= m;
-  key = decompress_key(&(sks->compressor), key);
-  from_symmetric_bw_key(&(sks->symmetry), key, &(result.player), &(result.opponent));
+bool has_symmetric_key(const symmetric_keyspace *sks, const state *s) {
+  return has_key(&(sks->compressor), to_symmetric_stones_key(sks, s));
+}
+
+// Map points to the orientation of the symmetric key of the stones
+static stones_t to_symmetric_points(const symmetric_keyspace *sks, const state *s, stones_t points) {
+  mirror_op_t op;
+  if (sks->color_m == 1) {
+    op = symmetric_bw_op(&(sks->symmetry), s->player, s->opponent);
+  } else {
+    const stones_t variable_area = sks->symmetry.variable_area;
+    const stones_t black = (s->white_to_play ? s->opponent : s->player) & variable_area;
+    const stones_t white = (s->white_to_play ? s->player : s->opponent) & variable_area;
+    op = symmetric_bw_op(&(sks->symmetry), black, white);
+  }
+  if (op == UCHAR_MAX) {
+    return points;
+  }
+  return apply_mirror_op(&(sks->symmetry), op, points);
+}
+
+size_t to_fast_ko_key(const symmetric_keyspace *sks, const state *s, stones_t *ko) {
+  const symmetry *sym = &(sks->symmetry);
+  size_t result = SIZE_MAX;
+  *ko = 0;
+  for (mirror_op_t op = MIRROR_NONE; op <= (MIRROR_V | MIRROR_H | MIRROR_D); ++op) {
+    if (!preserves_root(sym, op, &(sks->root))) {
+      continue;
+    }
+    state m = *s;
+    m.player = apply_mirror_op(sym, op, s->player);
+    m.opponent = apply_mirror_op(sym, op, s->opponent);
+    const size_t key = to_fast_key(sks, &m);
+    const stones_t k = to_symmetric_points(sks, &m, apply_mirror_op(sym, op, s->ko));
+    if (key < result || (key == result && k < *ko)) {
+      result = key;
+      *ko = k;
+    }
+  }
   return result;
 }
 
+// Inverse of to_symmetric_stones_key()
+static inline void from_symmetric_stones_key(const symmetric_keyspace *sks, size_t key, state *result) {
+  if (sks->color_m == 1) {
+    from_symmetric_bw_key(&(sks->symmetry), key, &(result->player), &(result->opponent));
+    return;
+  }
+  const state *root = &(sks->root);
+  const stones_t fixed = ~sks->symmetry.variable_area;
+  stones_t black = (root->white_to_play ? root->opponent : root->player) & fixed;
+  stones_t white = (root->white_to_play ? root->player : root->opponent) & fixed;
+  stones_t variable_black;
+  stones_t variable_white;
+  result->white_to_play = key & 1;
+  from_symmetric_bw_key(&(sks->symmetry), key >> 1, &variable_black, &variable_white);
+  black |= variable_black;
+  white |= variable_white;
+  if (result->white_to_play) {
+    result->player = white;
+    result->opponent = black;
+  } else {
+    result->player = black;
+    result->opponent = white;
+  }
+  // Facilitate target_capturable() and target_in_atari()
+  if (root->target) {
+    if (root->wide) {
+      result->target |= flood_16(result->player & result->target, result->player);
+      result->target |= flood_16(result->opponent & result->target, result->opponent);
+    } else {
+      result->target |= flood(result->player & result->target, result->player);
+      result->target |= flood(result->opponent & result->target, result->opponent);
+    }
+    result->logical_area &= ~result->target;
+  }
+}
+
+state from_symmetric_key(const symmetric_keyspace *sks, size_t key) {
+  const size_t prefix = key % sks->prefix_m;
+  key = decompress_key(&(sks->compressor), key / sks->prefix_m);
+  return from_fast_key(sks, prefix + sks->prefix_m * key);
+}
+
 void free_symmetric_keyspace(symmetric_keyspace *sks) {
   free_symmetry(&(sks->symmetry));
   free_monotonic_compressor(&(sks->compressor));
@@ -382,11 +614,11 @@ state from_fast_key(const symmetric_keyspace *sks, size_t key) {
   size_t m = 2 * abs(sks->root.ko_threats) + 1;
   result.ko_threats = (int)(key % m) - abs(sks->root.ko_threats);
   key /= m;
-  from_symmetric_bw_key(&(sks->symmetry), key, &(result.player), &(result.opponent));
+  from_symmetric_stones_key(sks, key, &result);
   return result;
 }
 
 size_t to_fast_key(const symmetric_keyspace *sks, const state *s) {
-  const size_t key = to_symmetric_bw_key(&(sks->symmetry), s->player, s->opponent);
+  const size_t key = to_symmetric_stones_key(sks, s);
   return (s->button + 2 * (s->ko_threats + abs(sks->root.ko_threats)) + sks->prefix_m * key);
 }
@@ -0,0 +1,229 @@
+#include "tinytsumego2/planner.h"
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/keyspace.h"
+#include "tinytsumego2/symmetry.h"
+#include "tinytsumego2/util.h"
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Number of sampled legal states expanded to time a sweep
+#define NUM_TIMED_SAMPLES (256)
+
+// Deterministic sampling keeps the estimates and the choice reproducible and leaves the global RNG alone. Timings are only
+// reported.
+static inline size_t next_sample(size_t *seed) {
+  size_t z = (*seed += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + 1e-9 * (now.tv_nsec - start->tv_nsec);
+}
+
+size_t physical_ram() { return (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE); }
+
+planner_options default_planner_options() {
+  planner_options result = {0};
+  result.ram_budget = physical_ram();
+  result.node_costs[COMPRESSED_KEYSPACE] = PLANNER_COMPRESSED_NODE_COST;
+  result.node_costs[SYMMETRIC_KEYSPACE] = PLANNER_SYMMETRIC_NODE_COST;
+  result.num_samples = PLANNER_NUM_SAMPLES;
+  return result;
+}
+
+// Sample stone arrangements of the root, count the side table children and time the expansion of the legal states found.
+// Each legal arrangement stands for `weigh()` of the `num_keys` raw keys without prefix, or for one key if `weigh` is NULL.
+static void sample_keyspace(keyspace_estimate *estimate, const state *root, size_t num_arrangements, size_t num_keys,
+                            size_t prefix_m, const planner_options *options, state (*decode)(size_t arrangement),
+                            double (*weigh)(const state *s)) {
+  int num_moves = 0;
+  stones_t *moves = moves_of(root, &num_moves);
+  bool (*in_atari)(const state *s);
+  bool (*can_take)(const state *s);
+  select_target_predicates(root, &in_atari, &can_take);
+
+  size_t seed = num_arrangements;
+  int num_legal = 0;
+  double legal_weight = 0;
+  size_t num_side_children = 0;
+  int num_timed = 0;
+  double elapsed = 0;
+  for (int i = 0; i < options->num_samples; ++i) {
+    const state s = decode(next_sample(&seed) % num_arrangements);
+    if (!is_keyspace_state(&s)) {
+      continue;
+    }
+    num_legal++;
+    legal_weight += weigh ? weigh(&s) : 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int j = 0; j < num_moves; ++j) {
+      state child = s;
+      const move_result r = make_move(&child, moves[j]);
+      if (r <= TAKE_TARGET || child.passes) {
+        continue;
+      }
+      if (child.ko || in_atari(&child)) {
+        // The side table also stores the children with the button handed over
+        num_side_children += s.button > 0 ? 2 : 1;
+      }
+    }
+    if (num_timed < NUM_TIMED_SAMPLES) {
+      elapsed += seconds_since(&start);
+      num_timed++;
+    }
+  }
+  free(moves);
+
+  const double num_legal_keys = options->num_samples ? legal_weight / options->num_samples * num_arrangements : num_keys;
+  estimate->raw_size = num_keys * prefix_m;
+  estimate->legal_density = num_keys ? num_legal_keys / num_keys : 1;
+  estimate->num_nodes = (size_t)(estimate->legal_density * num_keys) * prefix_m;
+  const double node_cost = options->node_costs[estimate->type];
+  estimate->sweep_cost = node_cost * estimate->num_nodes * num_moves;
+
+  // Compressor checkpoints and deltas
+  estimate->keyspace_bytes += num_keys * sizeof(unsigned char) + ceil_divz(num_keys, 1 << CHAR_BIT) * sizeof(size_t);
+  estimate->solver_bytes = estimate->num_nodes * 2 * sizeof(table_value) + estimate->keyspace_bytes;
+
+  estimate->packed_id_bytes = ceil_divz(estimate->num_nodes * PLANNER_ID_WIDTH, CHAR_BIT);
+  estimate->block_id_bytes = estimate->packed_id_bytes + (ceil_divz(estimate->num_nodes, ID_BLOCK_SIZE) + 1) * sizeof(uint64_t);
+  if (estimate->type == COMPRESSED_KEYSPACE) {
+    const size_t num_side_entries = num_legal ? (double)num_side_children / num_legal * estimate->num_nodes : 0;
+    estimate->side_bytes = num_side_entries * (sizeof(size_t) + sizeof(dual_table_value));
+    estimate->move_table_bytes = estimate->num_nodes * (sizeof(uint32_t) + PLANNER_MOVE_RECORD_FRACTION * move_record_size(num_moves));
+    estimate->terminal_table_bytes = estimate->num_nodes * sizeof(terminal_step);
+  }
+  estimate->reader_bytes = estimate->keyspace_bytes + estimate->packed_id_bytes + estimate->side_bytes;
+
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  estimate->sweep_seconds = num_timed ? node_cost * elapsed / num_timed * estimate->num_nodes / num_threads : 0;
+}
+
+// Number of tight keys that only differ by the player to play, button and ko threats
+static size_t tight_prefix_m(const state *root) { return 4 * (2 * abs(root->ko_threats) + 1); }
+
+static keyspace_estimate estimate_compressed(const state *root, const planner_options *options) {
+  keyspace_estimate result = {0};
+  result.type = COMPRESSED_KEYSPACE;
+  result.supported = true;
+  result.keyspace_bytes = tight_keyspace_bytes(root, true);
+
+  // Stone arrangements and external liberties map one to one to raw keys
+  const size_t prefix_m = tight_prefix_m(root);
+  const size_t num_keys = tight_keyspace_size(root, true) / prefix_m;
+  state decode(size_t arrangement) { return from_tight_key(root, arrangement * prefix_m, true); }
+  sample_keyspace(&result, root, num_keys, num_keys, prefix_m, options, decode, NULL);
+
+  return result;
+}
+
+static keyspace_estimate estimate_symmetric(const state *root, const planner_options *options) {
+  keyspace_estimate result = {0};
+  result.type = SYMMETRIC_KEYSPACE;
+
+  symmetry sym = {0};
+  pick_mirrors(&sym, root);
+  mirror_op_t ops[8];
+  const int num_ops = compute_automorphisms(root, ops);
+  if (root->external || num_ops < 2) {
+    return result;
+  }
+  result.supported = true;
+  result.keyspace_bytes = sizeof(size_t) + estimate_symmetry_bytes(root);
+
+  // Same layout as prepare_symmetric_keyspace() without computing the symmetry
+  const stones_t variable_area = root->logical_area & ~(root->target | root->immortal | root->external);
+  const size_t color_m = ((root->player | root->opponent) & ~variable_area) ? 2 : 1;
+  const size_t prefix_m = 2 * (2 * abs(root->ko_threats) + 1);
+  const size_t num_keys = count_symmetry_orbits(root) * color_m;
+
+  // Arrangements are sampled without symmetry reduction and weighed by the reciprocal of their orbit size
+  const size_t tight_m = tight_prefix_m(root);
+  const size_t num_arrangements = tight_keyspace_size(root, true) / tight_m * color_m;
+  state decode(size_t arrangement) { return from_tight_key(root, arrangement / color_m * tight_m + arrangement % color_m, true); }
+  double weigh(const state *s) {
+    int num_fixed = 0;
+    for (int i = 0; i < num_ops; ++i) {
+      if (apply_mirror_op(&sym, ops[i], s->player) == s->player && apply_mirror_op(&sym, ops[i], s->opponent) == s->opponent) {
+        num_fixed++;
+      }
+    }
+    return (double)num_fixed / num_ops;
+  }
+  sample_keyspace(&result, root, num_arrangements, num_keys, prefix_m, options, decode, weigh);
+
+  return result;
+}
+
+keyspace_plan plan_keyspace(const state *root, const planner_options *options) {
+  keyspace_plan result = {0};
+  result.ram_budget = options->ram_budget;
+  result.estimates[COMPRESSED_KEYSPACE] = estimate_compressed(root, options);
+  result.estimates[SYMMETRIC_KEYSPACE] = estimate_symmetric(root, options);
+
+  const keyspace_estimate *best = NULL;
+  const keyspace_estimate *smallest = NULL;
+  for (int i = 0; i < MOCK_KEYSPACE; ++i) {
+    const keyspace_estimate *e = result.estimates + i;
+    if (!e->supported) {
+      continue;
+    }
+    if (!smallest || e->solver_bytes < smallest->solver_bytes) {
+      smallest = e;
+    }
+    if (e->solver_bytes <= options->ram_budget && (!best || e->sweep_cost < best->sweep_cost)) {
+      best = e;
+    }
+  }
+  result.fits = best != NULL;
+  result.choice = best ? best->type : smallest->type;
+
+  return result;
+}
+
+static const char *keyspace_type_name(keyspace_type type) {
+  switch (type) {
+  case COMPRESSED_KEYSPACE:
+    return "compressed";
+  case SYMMETRIC_KEYSPACE:
+    return "symmetric";
+  default:
+    return "mock";
+  }
+}
+
+static double mebibytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+void print_keyspace_plan(const keyspace_plan *plan) {
+  printf("Keyspace plan for a budget of %.0f MiB\n", mebibytes(plan->ram_budget));
+  for (int i = 0; i < MOCK_KEYSPACE; ++i) {
+    const keyspace_estimate *e = plan->estimates + i;
+    if (!e->supported) {
+      printf(" %-10s unsupported\n", keyspace_type_name(e->type));
+      continue;
+    }
+    printf(" %-10s %zu raw keys, %.1f %% legal, ~%zu nodes, %.1f MiB to solve, ~%.2f s per sweep\n", keyspace_type_name(e->type),
+           e->raw_size, 100 * e->legal_density, e->num_nodes, mebibytes(e->solver_bytes), e->sweep_seconds);
+    printf("            on disk: %.1f MiB keyspace, %.1f MiB packed ids or %.1f MiB block ids, %.1f MiB side table\n",
+           mebibytes(e->keyspace_bytes), mebibytes(e->packed_id_bytes), mebibytes(e->block_id_bytes), mebibytes(e->side_bytes));
+    if (e->type == COMPRESSED_KEYSPACE) {
+      printf("            optional: %.1f MiB move table, %.1f MiB terminal table\n", mebibytes(e->move_table_bytes),
+             mebibytes(e->terminal_table_bytes));
+    }
+  }
+  printf(" Choice: %s%s\n", keyspace_type_name(plan->choice), plan->fits ? "" : " (over budget)");
+}
@@ -0,0 +1,175 @@
+#include "tinytsumego2/registry.h"
+#include "tinytsumego2/util.h"
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+reader_registry create_reader_registry(size_t max_readers, size_t max_bytes) {
+  reader_registry result = {0};
+  result.max_readers = max_readers;
+  result.max_bytes = max_bytes;
+  // Static initialization keeps the returned copy valid
+  result.mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+  return result;
+}
+
+static char *duplicate_string(const char *str) {
+  char *result = xmalloc(strlen(str) + 1);
+  strcpy(result, str);
+  return result;
+}
+
+void register_reader(reader_registry *registry, const char *slug, const char *filename) {
+  pthread_mutex_lock(&(registry->mutex));
+  registry->entries = xrealloc(registry->entries, (registry->num_entries + 1) * sizeof(registry_entry));
+  registry->entries[registry->num_entries++] = (registry_entry){duplicate_string(slug), duplicate_string(filename), NULL, 0, 0, 0};
+  pthread_mutex_unlock(&(registry->mutex));
+}
+
+size_t register_reader_folder(reader_registry *registry, const char *path) {
+  DIR *dir = opendir(path);
+  if (!dir) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  size_t count = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir))) {
+    const size_t length = strlen(ent->d_name);
+    if (length <= strlen(".bin") || strcmp(ent->d_name + length - strlen(".bin"), ".bin")) {
+      continue;
+    }
+    char *slug = duplicate_string(ent->d_name);
+    slug[length - strlen(".bin")] = 0;
+    char *filename = xmalloc(strlen(path) + length + 2);
+    sprintf(filename, "%s/%s", path, ent->d_name);
+    register_reader(registry, slug, filename);
+    free(filename);
+    free(slug);
+    count++;
+  }
+  closedir(dir);
+  return count;
+}
+
+static void unload_entry(reader_registry *registry, registry_entry *entry) {
+  unload_dual_graph_reader(entry->reader);
+  free(entry->reader);
+  entry->reader = NULL;
+  registry->num_loaded--;
+  registry->loaded_bytes -= entry->private_bytes;
+  entry->private_bytes = 0;
+}
+
+static bool over_limits(const reader_registry *registry, size_t num_new) {
+  if (registry->max_readers && registry->num_loaded + num_new > registry->max_readers) {
+    return true;
+  }
+  return registry->max_bytes && registry->loaded_bytes > registry->max_bytes;
+}
+
+// Unload idle readers in least recently used order until there is room for `num_new` more or only readers in use remain
+static void evict(reader_registry *registry, size_t num_new) {
+  while (over_limits(registry, num_new)) {
+    registry_entry *oldest = NULL;
+    for (size_t i = 0; i < registry->num_entries; ++i) {
+      registry_entry *entry = registry->entries + i;
+      if (entry->reader && !entry->num_users && (!oldest || entry->last_used < oldest->last_used)) {
+        oldest = entry;
+      }
+    }
+    if (!oldest) {
+      return;
+    }
+    unload_entry(registry, oldest);
+    registry->evictions++;
+  }
+}
+
+bool is_registered(reader_registry *registry, const char *slug) {
+  pthread_mutex_lock(&(registry->mutex));
+  bool result = false;
+  for (size_t i = 0; i < registry->num_entries; ++i) {
+    if (!strcmp(registry->entries[i].slug, slug)) {
+      result = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&(registry->mutex));
+  return result;
+}
+
+dual_graph_reader *acquire_reader(reader_registry *registry, const char *slug) {
+  pthread_mutex_lock(&(registry->mutex));
+  dual_graph_reader *result = NULL;
+  for (size_t i = 0; i < registry->num_entries; ++i) {
+    registry_entry *entry = registry->entries + i;
+    if (strcmp(entry->slug, slug)) {
+      continue;
+    }
+    if (entry->reader) {
+      registry->hits++;
+    } else {
+      registry->misses++;
+      evict(registry, 1);
+      dual_graph_reader dgr;
+      if (!try_load_dual_graph_reader_with_policy(entry->filename, RANDOM_RESIDENCY, &dgr)) {
+        fprintf(stderr, "Failed to load %s\n", entry->filename);
+        registry->failures++;
+        break;
+      }
+      entry->reader = xmalloc(sizeof(dual_graph_reader));
+      *entry->reader = dgr;
+      entry->private_bytes = dual_graph_reader_private_bytes(entry->reader);
+      registry->num_loaded++;
+      registry->loaded_bytes += entry->private_bytes;
+    }
+    entry->num_users++;
+    entry->last_used = registry->clock++;
+    result = entry->reader;
+    // The new reader is in use so only others are evicted
+    evict(registry, 0);
+    break;
+  }
+  pthread_mutex_unlock(&(registry->mutex));
+  return result;
+}
+
+void release_reader(reader_registry *registry, const dual_graph_reader *reader) {
+  pthread_mutex_lock(&(registry->mutex));
+  for (size_t i = 0; i < registry->num_entries; ++i) {
+    registry_entry *entry = registry->entries + i;
+    if (entry->reader == reader) {
+      assert(entry->num_users);
+      entry->num_users--;
+      entry->last_used = registry->clock++;
+      break;
+    }
+  }
+  evict(registry, 0);
+  pthread_mutex_unlock(&(registry->mutex));
+}
+
+void free_reader_registry(reader_registry *registry) {
+  for (size_t i = 0; i < registry->num_entries; ++i) {
+    registry_entry *entry = registry->entries + i;
+    assert(!entry->num_users);
+    if (entry->reader) {
+      unload_entry(registry, entry);
+    }
+    free(entry->slug);
+    free(entry->filename);
+  }
+  free(registry->entries);
+  registry->entries = NULL;
+  registry->num_entries = 0;
+  pthread_mutex_destroy(&(registry->mutex));
+}
+
+reader_registry *allocate_reader_registry(size_t max_readers, size_t max_bytes) {
+  reader_registry *result = xmalloc(sizeof(reader_registry));
+  *result = create_reader_registry(max_readers, max_bytes);
+  return result;
+}
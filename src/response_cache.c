@@ -0,0 +1,328 @@
+#include "tinytsumego2/response_cache.h"
+#include "tinytsumego2/util.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+response_cache create_response_cache(size_t capacity) {
+  if (!capacity) {
+    fprintf(stderr, "Response cache capacity must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+  response_cache result = {0};
+  result.capacity = capacity;
+  result.slots = xcalloc(capacity, sizeof(cached_response));
+  result.num_buckets = 1;
+  while (result.num_buckets < 2 * capacity) {
+    result.num_buckets <<= 1;
+  }
+  result.buckets = xmalloc(result.num_buckets * sizeof(size_t));
+  for (size_t i = 0; i < result.num_buckets; ++i) {
+    result.buckets[i] = SIZE_MAX;
+  }
+  result.newest = SIZE_MAX;
+  result.oldest = SIZE_MAX;
+  // Static initialization keeps the returned copy valid
+  result.mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+  return result;
+}
+
+static void apply_symmetry(state *s, mirror_op_t op) {
+  snap(s);
+  if (op & MIRROR_D) {
+    mirror_d(s);
+  }
+  if (op & MIRROR_H) {
+    mirror_h(s);
+  }
+  if (op & MIRROR_V) {
+    mirror_v(s);
+  }
+  snap(s);
+}
+
+// Image of stones of `s` in the frame of `apply_symmetry(s, op)`
+static stones_t map_stones(const state *s, mirror_op_t op, stones_t stones) {
+  state carrier = {0};
+  carrier.visual_area = s->visual_area;
+  carrier.wide = s->wide;
+  carrier.player = stones;
+  apply_symmetry(&carrier, op);
+  return carrier.player;
+}
+
+#define COMPARE_FIELD(field)                                                                                                       \
+  if (a->field != b->field) {                                                                                                      \
+    return a->field < b->field ? -1 : 1;                                                                                           \
+  }
+
+// Total order over every field. Unlike `compare()` the geometry is not assumed to be shared.
+static int compare_states(const state *a, const state *b) {
+  COMPARE_FIELD(visual_area);
+  COMPARE_FIELD(logical_area);
+  COMPARE_FIELD(player);
+  COMPARE_FIELD(opponent);
+  COMPARE_FIELD(ko);
+  COMPARE_FIELD(target);
+  COMPARE_FIELD(immortal);
+  COMPARE_FIELD(external);
+  COMPARE_FIELD(passes);
+  COMPARE_FIELD(ko_threats);
+  COMPARE_FIELD(button);
+  COMPARE_FIELD(white_to_play);
+  COMPARE_FIELD(wide);
+  return 0;
+}
+
+#undef COMPARE_FIELD
+
+state canonical_state(const state *s, mirror_op_t *op) {
+  state snapped = *s;
+  snap(&snapped);
+  const bool diagonal = can_mirror_d(&snapped);
+
+  state result = snapped;
+  *op = MIRROR_NONE;
+  for (mirror_op_t candidate = MIRROR_H; candidate <= (MIRROR_H | MIRROR_V | MIRROR_D); ++candidate) {
+    if ((candidate & MIRROR_D) && !diagonal) {
+      break;
+    }
+    state image = *s;
+    apply_symmetry(&image, candidate);
+    if (compare_states(&image, &result) < 0) {
+      result = image;
+      *op = candidate;
+    }
+  }
+  return result;
+}
+
+static size_t bucket_of(const response_cache *cache, response_kind kind, const state *key) {
+  const stones_t h = hash_a(key) ^ (hash_b(key) * 31) ^ (key->visual_area * 1000003ULL) ^ kind;
+  return (h ^ (h >> 29)) & (cache->num_buckets - 1);
+}
+
+static size_t find_slot(const response_cache *cache, response_kind kind, const state *key) {
+  for (size_t slot = cache->buckets[bucket_of(cache, kind, key)]; slot != SIZE_MAX; slot = cache->slots[slot].next) {
+    if (cache->slots[slot].kind == kind && equals(&(cache->slots[slot].key), key)) {
+      return slot;
+    }
+  }
+  return SIZE_MAX;
+}
+
+static void unlink_slot(response_cache *cache, size_t slot) {
+  cached_response *r = cache->slots + slot;
+  if (r->newer == SIZE_MAX) {
+    cache->newest = r->older;
+  } else {
+    cache->slots[r->newer].older = r->older;
+  }
+  if (r->older == SIZE_MAX) {
+    cache->oldest = r->newer;
+  } else {
+    cache->slots[r->older].newer = r->newer;
+  }
+}
+
+static void push_slot(response_cache *cache, size_t slot) {
+  cached_response *r = cache->slots + slot;
+  r->newer = SIZE_MAX;
+  r->older = cache->newest;
+  if (cache->newest == SIZE_MAX) {
+    cache->oldest = slot;
+  } else {
+    cache->slots[cache->newest].newer = slot;
+  }
+  cache->newest = slot;
+}
+
+static void touch_slot(response_cache *cache, size_t slot) {
+  if (slot != cache->newest) {
+    unlink_slot(cache, slot);
+    push_slot(cache, slot);
+  }
+}
+
+// Drop the least recently used response and return its slot
+static size_t evict(response_cache *cache) {
+  const size_t slot = cache->oldest;
+  cached_response *r = cache->slots + slot;
+  unlink_slot(cache, slot);
+  size_t *link = cache->buckets + bucket_of(cache, r->kind, &(r->key));
+  while (*link != slot) {
+    link = &(cache->slots[*link].next);
+  }
+  *link = r->next;
+  free(r->moves);
+  free(r->move_infos);
+  r->moves = NULL;
+  r->move_infos = NULL;
+  cache->evictions++;
+  return slot;
+}
+
+// Take ownership of a response unless an equal one was inserted while the lock was released
+static void insert_response(response_cache *cache, const cached_response *response) {
+  if (find_slot(cache, response->kind, &(response->key)) != SIZE_MAX) {
+    free(response->moves);
+    free(response->move_infos);
+    return;
+  }
+  const size_t slot = cache->num_used < cache->capacity ? cache->num_used++ : evict(cache);
+  cached_response *r = cache->slots + slot;
+  *r = *response;
+  const size_t bucket = bucket_of(cache, r->kind, &(r->key));
+  r->next = cache->buckets[bucket];
+  cache->buckets[bucket] = slot;
+  push_slot(cache, slot);
+}
+
+// Map annotated moves of the canonical frame to the reader moves of the query in reader order
+static move_info *emit_move_infos(const dual_graph_reader *dgr, const state *normalized, mirror_op_t op,
+                                  const cached_response *r, int *num_move_infos) {
+  move_info *result = xmalloc(r->num_move_infos * sizeof(move_info));
+  *num_move_infos = 0;
+  for (int i = 0; i < dgr->num_moves; ++i) {
+    const stones_t image = map_stones(normalized, op, dgr->moves[i]);
+    for (int j = 0; j < r->num_move_infos; ++j) {
+      if (r->moves[j] == image) {
+        result[*num_move_infos] = r->move_infos[j];
+        result[(*num_move_infos)++].coords = normalized->wide ? coords_of_16(dgr->moves[i]) : coords_of(dgr->moves[i]);
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+// Find the reader move at the given coordinates
+static stones_t move_at(const dual_graph_reader *dgr, bool wide, coordinates coords) {
+  for (int i = 0; i < dgr->num_moves; ++i) {
+    const coordinates c = wide ? coords_of_16(dgr->moves[i]) : coords_of(dgr->moves[i]);
+    if (c.x == coords.x && c.y == coords.y) {
+      return dgr->moves[i];
+    }
+  }
+  fprintf(stderr, "Move at (%d, %d) not found\n", coords.x, coords.y);
+  exit(EXIT_FAILURE);
+}
+
+move_info *cached_move_infos(response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s,
+                             int *num_move_infos) {
+  const state normalized = strip_aesthetics(dgr, s);
+  mirror_op_t op;
+  const state key = canonical_state(&normalized, &op);
+
+  pthread_mutex_lock(&(cache->mutex));
+  const size_t slot = find_slot(cache, MOVE_INFOS_RESPONSE, &key);
+  if (slot != SIZE_MAX) {
+    cache->hits++;
+    touch_slot(cache, slot);
+    move_info *result = emit_move_infos(dgr, &normalized, op, cache->slots + slot, num_move_infos);
+    pthread_mutex_unlock(&(cache->mutex));
+    return result;
+  }
+  cache->misses++;
+  pthread_mutex_unlock(&(cache->mutex));
+
+  move_info *result = ctx ? dual_graph_reader_move_infos_r(dgr, ctx, &normalized, num_move_infos)
+                          : dual_graph_reader_move_infos(dgr, &normalized, num_move_infos);
+
+  cached_response response = {0};
+  response.kind = MOVE_INFOS_RESPONSE;
+  response.key = key;
+  response.num_move_infos = *num_move_infos;
+  response.moves = xmalloc(*num_move_infos * sizeof(stones_t));
+  response.move_infos = xmalloc(*num_move_infos * sizeof(move_info));
+  for (int i = 0; i < *num_move_infos; ++i) {
+    response.moves[i] = map_stones(&normalized, op, move_at(dgr, s->wide, result[i].coords));
+    response.move_infos[i] = result[i];
+  }
+
+  pthread_mutex_lock(&(cache->mutex));
+  insert_response(cache, &response);
+  pthread_mutex_unlock(&(cache->mutex));
+
+  return result;
+}
+
+// Stones of `s` whose images are in `stones`
+static stones_t pull_back_stones(const state *s, mirror_op_t op, stones_t stones) {
+  stones_t result = 0;
+  stones_t candidates = s->player | s->opponent;
+  while (candidates) {
+    const stones_t stone = candidates & -candidates;
+    if (map_stones(s, op, stone) & stones) {
+      result |= stone;
+    }
+    candidates ^= stone;
+  }
+  return result;
+}
+
+stones_t cached_dead_stones(response_cache *cache, dual_graph_reader *dgr, reader_context *ctx, const state *s) {
+  const state normalized = strip_aesthetics(dgr, s);
+  mirror_op_t op;
+  const state key = canonical_state(&normalized, &op);
+
+  pthread_mutex_lock(&(cache->mutex));
+  const size_t slot = find_slot(cache, DEAD_STONES_RESPONSE, &key);
+  if (slot != SIZE_MAX) {
+    cache->hits++;
+    touch_slot(cache, slot);
+    const stones_t result = pull_back_stones(&normalized, op, cache->slots[slot].dead_stones);
+    pthread_mutex_unlock(&(cache->mutex));
+    return result;
+  }
+  cache->misses++;
+  pthread_mutex_unlock(&(cache->mutex));
+
+  const stones_t result =
+      ctx ? dual_graph_reader_dead_stones_r(dgr, ctx, &normalized) : dual_graph_reader_dead_stones(dgr, &normalized);
+
+  cached_response response = {0};
+  response.kind = DEAD_STONES_RESPONSE;
+  response.key = key;
+  response.dead_stones = map_stones(&normalized, op, result);
+
+  pthread_mutex_lock(&(cache->mutex));
+  insert_response(cache, &response);
+  pthread_mutex_unlock(&(cache->mutex));
+
+  return result;
+}
+
+response_cache_stats get_response_cache_stats(response_cache *cache) {
+  pthread_mutex_lock(&(cache->mutex));
+  const response_cache_stats result = {cache->num_used, cache->capacity, cache->hits, cache->misses, cache->evictions};
+  pthread_mutex_unlock(&(cache->mutex));
+  return result;
+}
+
+void print_response_cache_stats(response_cache *cache) {
+  const response_cache_stats stats = get_response_cache_stats(cache);
+  const size_t total = stats.hits + stats.misses;
+  printf("Response cache: %zu / %zu entries, %zu hits, %zu misses (%.1f%% hit rate), %zu evictions\n", stats.size,
+         stats.capacity, stats.hits, stats.misses, total ? 100.0 * stats.hits / total : 0.0, stats.evictions);
+}
+
+void free_response_cache(response_cache *cache) {
+  for (size_t i = 0; i < cache->num_used; ++i) {
+    free(cache->slots[i].moves);
+    free(cache->slots[i].move_infos);
+  }
+  free(cache->slots);
+  free(cache->buckets);
+  cache->slots = NULL;
+  cache->buckets = NULL;
+  cache->num_used = 0;
+  cache->newest = SIZE_MAX;
+  cache->oldest = SIZE_MAX;
+  pthread_mutex_destroy(&(cache->mutex));
+}
+
+response_cache *allocate_response_cache(size_t capacity) {
+  response_cache *result = xmalloc(sizeof(response_cache));
+  *result = create_response_cache(capacity);
+  return result;
+}
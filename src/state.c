@@ -1018,6 +1018,113 @@ bool is_legal(const state *s) {
   return true;
 }
 
+// Mark chains of `stones` that reach a liberty or an immortal stone. All arrays are bit-sliced by point.
+static unsigned long long dead_chains_64(const stones_t *stones, const stones_t *libs, const stones_t *immortal, bool wide) {
+  const int width = wide ? WIDTH_16 : WIDTH;
+  const int num_points = wide ? WIDTH_16 * HEIGHT_16 : WIDTH * HEIGHT;
+  stones_t alive[64];
+
+  stones_t neighbours(const stones_t *words, int p) {
+    stones_t result = 0ULL;
+    if (p % width) {
+      result |= words[p - 1];
+    }
+    if (p % width != width - 1) {
+      result |= words[p + 1];
+    }
+    if (p >= width) {
+      result |= words[p - width];
+    }
+    if (p + width < num_points) {
+      result |= words[p + width];
+    }
+    return result;
+  }
+
+  for (int p = 0; p < num_points; ++p) {
+    alive[p] = stones[p] & (immortal[p] | neighbours(libs, p));
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int p = 0; p < num_points; ++p) {
+      const stones_t spread = stones[p] & neighbours(alive, p) & ~alive[p];
+      if (spread) {
+        alive[p] |= spread;
+        changed = true;
+      }
+    }
+  }
+
+  unsigned long long dead = 0ULL;
+  for (int p = 0; p < num_points; ++p) {
+    dead |= stones[p] & ~alive[p];
+  }
+  return dead;
+}
+
+unsigned long long is_legal_64(const state *states, int count) {
+  assert(count <= 64);
+  unsigned long long result = 0ULL;
+  unsigned long long candidates = 0ULL;
+
+  stones_t player[64] = {0};
+  stones_t opponent[64] = {0};
+  stones_t immortal[64] = {0};
+  stones_t external[64] = {0};
+
+  for (int i = 0; i < count; ++i) {
+    const state *s = states + i;
+    if (s->ko) {
+      if (is_legal(s)) {
+        result |= 1ULL << i;
+      }
+      continue;
+    }
+    if (s->passes < 0 || s->passes > 2) {
+      continue;
+    }
+    if (s->button != -1 && s->button != 0 && s->button != 1) {
+      continue;
+    }
+    if ((s->logical_area | s->player | s->opponent | s->immortal | s->external) & ~s->visual_area) {
+      continue;
+    }
+    if ((s->immortal | s->external | s->target) & ~(s->player | s->opponent)) {
+      continue;
+    }
+    candidates |= 1ULL << i;
+    player[i] = s->player & ~s->external;
+    opponent[i] = s->opponent & ~s->external;
+    immortal[i] = s->immortal;
+    external[i] = s->external;
+  }
+  if (!candidates) {
+    return result;
+  }
+
+  transpose_64(player);
+  transpose_64(opponent);
+  transpose_64(immortal);
+  transpose_64(external);
+
+  stones_t libs[64];
+  const stones_t visual_area = states[0].visual_area;
+  for (int p = 0; p < 64; ++p) {
+    libs[p] = external[p];
+    if (visual_area & (1ULL << p)) {
+      libs[p] |= ~(player[p] | opponent[p] | external[p]);
+    }
+  }
+
+  const bool wide = states[0].wide;
+  unsigned long long dead = dead_chains_64(player, libs, immortal, wide);
+  dead |= dead_chains_64(opponent, libs, immortal, wide);
+
+  return result | (candidates & ~dead);
+}
+
 void mirror_v(state *s) {
   if (s->wide) {
     s->visual_area = stones_mirror_v_16(s->visual_area);
@@ -51,6 +51,17 @@ int ctz(const stones_t stones) { return __builtin_ctzll(stones); }
 
 int clz(const stones_t stones) { return __builtin_clzll(stones); }
 
+void transpose_64(stones_t *rows) {
+  stones_t m = 0xFFFFFFFFULL;
+  for (int j = 32; j; j >>= 1, m ^= m << j) {
+    for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      const stones_t t = ((rows[k] >> j) ^ rows[k | j]) & m;
+      rows[k | j] ^= t;
+      rows[k] ^= t << j;
+    }
+  }
+}
+
 stones_t liberties(const stones_t stones, const stones_t empty) {
   return (((stones & WEST_BLOCK) << H_SHIFT) | ((stones >> H_SHIFT) & WEST_BLOCK) | (stones << V_SHIFT) | (stones >> V_SHIFT)) & ~stones &
          empty;
@@ -237,6 +237,7 @@ void prepare_odd_even_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (core_mask << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = odd_even_core_idx;
   size_t size = 1 << 20;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -328,6 +329,7 @@ void prepare_odd_odd_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (core_mask << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = odd_odd_core_idx;
   size_t size = 1 << 22;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -435,6 +437,7 @@ void prepare_odd_square_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (rectangle(3, 3) << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = odd_square_core_idx;
   size_t size = 1 << 18;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -537,6 +540,7 @@ void prepare_even_square_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (core_mask << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = even_square_core_idx;
   size_t size = 1 << 16;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -597,14 +601,403 @@ void prepare_even_square_symmetry(symmetry *sym, stones_t visual_area) {
 
 #include "symmetry16.inc.c"
 
+void prepare_pulp_blocks(symmetry *sym) {
+  sym->num_blocks = ceil_div(sym->pulp_count, TRIT_BLOCK_SIZE);
+  sym->black_blocks = xmalloc(sym->num_blocks * sizeof(stones_t *));
+  sym->white_blocks = xmalloc(sym->num_blocks * sizeof(stones_t *));
+
+  size_t m = 1;
+  int i;
+  for (i = 0; i < sym->pulp_count / TRIT_BLOCK_SIZE; ++i) {
+    sym->black_blocks[i] = xcalloc(TRIT_BLOCK_M, sizeof(stones_t));
+    sym->white_blocks[i] = xcalloc(TRIT_BLOCK_M, sizeof(stones_t));
+    for (size_t j = 0; j < TRIT_BLOCK_M; ++j) {
+      size_t key = m * j;
+      for (int k = sym->pulp_count - 1; k >= 0; --k) {
+        switch (key % 3) {
+        case 1:
+          sym->black_blocks[i][j] |= sym->pulp_dots[k];
+          break;
+        case 2:
+          sym->white_blocks[i][j] |= sym->pulp_dots[k];
+          break;
+        }
+        key /= 3;
+      }
+    }
+    m *= TRIT_BLOCK_M;
+  }
+
+  size_t tail_m = 1;
+  for (int j = 0; j < sym->pulp_count % TRIT_BLOCK_SIZE; ++j) {
+    tail_m *= 3;
+  }
+  if (tail_m != 1) {
+    sym->black_blocks[i] = xcalloc(tail_m, sizeof(stones_t));
+    sym->white_blocks[i] = xcalloc(tail_m, sizeof(stones_t));
+    for (size_t j = 0; j < tail_m; ++j) {
+      size_t key = m * j;
+      for (int k = sym->pulp_count - 1; k >= 0; --k) {
+        switch (key % 3) {
+        case 1:
+          sym->black_blocks[i][j] |= sym->pulp_dots[k];
+          break;
+        case 2:
+          sym->white_blocks[i][j] |= sym->pulp_dots[k];
+          break;
+        }
+        key /= 3;
+      }
+    }
+  }
+
+  sym->size = 1;
+  for (int i = 0; i < sym->pulp_count; ++i) {
+    sym->size *= 3;
+  }
+  sym->size *= sym->core_m;
+}
+
+// Generic symmetries for roots not covered by the hand-tuned cores above
+
+// Maximum number of points in a generic core. The core tables take 9 bytes per 4^size entries.
+#define GENERIC_CORE_MAX_SIZE (10)
+
+static const mirror_f HORIZONTAL_MIRRORS[] = {
+    NULL, NULL, stones_mirror_h_2, stones_mirror_h_3, stones_mirror_h_4, stones_mirror_h_5, stones_mirror_h_6, stones_mirror_h_7,
+    stones_mirror_h_8, stones_mirror_h,
+};
+
+static const mirror_f VERTICAL_MIRRORS[] = {
+    NULL, NULL, stones_mirror_v_2, stones_mirror_v_3, stones_mirror_v_4, stones_mirror_v_5, stones_mirror_v_6, stones_mirror_v,
+};
+
+static const mirror_f DIAGONAL_MIRRORS[] = {
+    NULL, NULL, stones_mirror_d, stones_mirror_d_3, stones_mirror_d_4, stones_mirror_d_5, stones_mirror_d_6, stones_mirror_d,
+};
+
+static const mirror_f HORIZONTAL_MIRRORS_16[] = {
+    NULL, NULL, NULL, stones_mirror_h_w3, stones_mirror_h_w4, stones_mirror_h_w5, stones_mirror_h_w6, stones_mirror_h_w7,
+    stones_mirror_h_w8, stones_mirror_h_w9, NULL, NULL, NULL, NULL, NULL, NULL, stones_mirror_h_16,
+};
+
+static const mirror_f VERTICAL_MIRRORS_16[] = {
+    NULL, NULL, stones_mirror_v_w2, NULL, stones_mirror_v_16,
+};
+
+// Select the mirrors of the bounding box of the visual area. Unavailable mirrors are left `NULL`.
+void pick_mirrors(symmetry *sym, const state *s) {
+  if (s->wide) {
+    int w = width_of_16(s->visual_area);
+    int h = height_of_16(s->visual_area);
+    sym->horizontal = w <= WIDTH_16 ? HORIZONTAL_MIRRORS_16[w] : NULL;
+    sym->vertical = h <= HEIGHT_16 ? VERTICAL_MIRRORS_16[h] : NULL;
+    sym->diagonal = NULL;
+  } else {
+    int w = width_of(s->visual_area);
+    int h = height_of(s->visual_area);
+    sym->horizontal = w <= WIDTH ? HORIZONTAL_MIRRORS[w] : NULL;
+    sym->vertical = h <= HEIGHT ? VERTICAL_MIRRORS[h] : NULL;
+    sym->diagonal = (w == h && h <= HEIGHT) ? DIAGONAL_MIRRORS[w] : NULL;
+  }
+}
+
+stones_t apply_mirror_op(const symmetry *sym, const mirror_op_t op, stones_t stones) {
+  if (op & MIRROR_V) {
+    stones = sym->vertical(stones);
+  }
+  if (op & MIRROR_H) {
+    stones = sym->horizontal(stones);
+  }
+  if (op & MIRROR_D) {
+    stones = sym->diagonal(stones);
+  }
+  return stones;
+}
+
+bool preserves_root(const symmetry *sym, const mirror_op_t op, const state *s) {
+  if ((op & MIRROR_V) && !sym->vertical) {
+    return false;
+  }
+  if ((op & MIRROR_H) && !sym->horizontal) {
+    return false;
+  }
+  if ((op & MIRROR_D) && !sym->diagonal) {
+    return false;
+  }
+  const stones_t masks[] = {s->visual_area, s->logical_area, s->player, s->opponent, s->ko, s->target, s->immortal, s->external};
+  for (size_t i = 0; i < sizeof(masks) / sizeof(stones_t); ++i) {
+    if (apply_mirror_op(sym, op, masks[i]) != masks[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int compute_automorphisms(const state *s, mirror_op_t *ops) {
+  symmetry sym = {0};
+  pick_mirrors(&sym, s);
+  int num_ops = 0;
+  for (mirror_op_t op = MIRROR_NONE; op <= (MIRROR_V | MIRROR_H | MIRROR_D); ++op) {
+    if (preserves_root(&sym, op, s)) {
+      ops[num_ops++] = op;
+    }
+  }
+  return num_ops;
+}
+
+// Compress the bits of `stones` selected by `mask` into the low bits of the result
+static inline size_t gather_stones(stones_t stones, stones_t mask) {
+  size_t result = 0;
+  for (size_t bit = 1; mask; bit <<= 1) {
+    const stones_t p = mask & -mask;
+    if (stones & p) {
+      result |= bit;
+    }
+    mask ^= p;
+  }
+  return result;
+}
+
+// Inverse of gather_stones()
+static inline stones_t scatter_stones(size_t bits, stones_t mask) {
+  stones_t result = 0ULL;
+  for (; mask; bits >>= 1) {
+    const stones_t p = mask & -mask;
+    if (bits & 1) {
+      result |= p;
+    }
+    mask ^= p;
+  }
+  return result;
+}
+
+// Black bits are more significant so that index order agrees with the (black, white) order of least_of_2() and friends
+static inline size_t generic_core_idx(const symmetry *sym, stones_t black, stones_t white) {
+  const int core_count = popcount(sym->core_mask);
+  return gather_stones(white, sym->core_mask) | (gather_stones(black, sym->core_mask) << core_count);
+}
+
+// True when a chain in the core cannot have liberties no matter what the pulp contains
+bool core_chains_suffocate(stones_t stones, stones_t other, stones_t open, bool wide) {
+  int num_chains = 0;
+  stones_t *cs = wide ? chains_16(stones, &num_chains) : chains(stones, &num_chains);
+  for (int i = 0; i < num_chains; ++i) {
+    if (!(wide ? liberties_16(cs[i], open & ~other) : liberties(cs[i], open & ~other))) {
+      free(cs);
+      return true;
+    }
+  }
+  free(cs);
+  return false;
+}
+
+void prepare_generic_symmetry(symmetry *sym, const state *s, const mirror_op_t *ops, int num_ops) {
+  sym->core_shift = 0;
+  sym->core_idx = NULL;
+  sym->variable_area = s->logical_area & ~(s->target | s->immortal | s->external);
+
+  // Partition the variable area into orbits and grow the core from the largest ones
+  stones_t orbits[64];
+  int num_orbits = 0;
+  stones_t unassigned = sym->variable_area;
+  while (unassigned) {
+    const stones_t p = unassigned & -unassigned;
+    stones_t orbit = 0ULL;
+    for (int i = 0; i < num_ops; ++i) {
+      orbit |= apply_mirror_op(sym, ops[i], p);
+    }
+    orbits[num_orbits++] = orbit;
+    unassigned &= ~orbit;
+  }
+  sym->core_mask = 0ULL;
+  for (int size = num_ops; size > 1; --size) {
+    for (int i = 0; i < num_orbits; ++i) {
+      if (popcount(orbits[i]) == size && popcount(sym->core_mask | orbits[i]) <= GENERIC_CORE_MAX_SIZE) {
+        sym->core_mask |= orbits[i];
+      }
+    }
+  }
+
+  sym->pulp_dots = dots(sym->variable_area & ~sym->core_mask, &(sym->pulp_count));
+
+  const int core_count = popcount(sym->core_mask);
+  const size_t core_bits = (1ULL << core_count) - 1;
+  const stones_t open = s->visual_area | s->external;
+  size_t size = 1ULL << (2 * core_count);
+  sym->num_core_indices = size;
+  sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
+  sym->core_map = xmalloc(size * sizeof(size_t));
+
+  // First pass: Store the index of the canonical representative
+  sym->core_m = 0;
+  for (size_t idx = 0; idx < size; ++idx) {
+    stones_t black = scatter_stones(idx >> core_count, sym->core_mask);
+    stones_t white = scatter_stones(idx & core_bits, sym->core_mask);
+
+    // Skip overlapping
+    if (black & white) {
+      sym->pulp_ops[idx] = UCHAR_MAX;
+      sym->core_map[idx] = SIZE_MAX;
+      continue;
+    }
+
+    // Skip illegal
+    if (core_chains_suffocate(black, white, open, s->wide) || core_chains_suffocate(white, black, open, s->wide)) {
+      sym->pulp_ops[idx] = UCHAR_MAX;
+      sym->core_map[idx] = SIZE_MAX;
+      continue;
+    }
+
+#ifdef CHECK_SYM_SANITY
+    assert(generic_core_idx(sym, black, white) == idx);
+#endif
+
+    mirror_op_t op = MIRROR_NONE;
+    for (int i = 1; i < num_ops; ++i) {
+      stones_t cb = apply_mirror_op(sym, ops[i], black);
+      stones_t cw = apply_mirror_op(sym, ops[i], white);
+      stones_t lb = apply_mirror_op(sym, op, black);
+      stones_t lw = apply_mirror_op(sym, op, white);
+      if (cb < lb || (cb == lb && cw < lw)) {
+        op = ops[i];
+      }
+    }
+    sym->pulp_ops[idx] = op;
+    sym->core_map[idx] = generic_core_idx(sym, apply_mirror_op(sym, op, black), apply_mirror_op(sym, op, white));
+    if (sym->core_map[idx] == idx) {
+      sym->core_m++;
+    }
+  }
+
+  // Second pass: Number the representatives. They never come after the members of their class.
+  sym->black_core = xmalloc(sym->core_m * sizeof(stones_t));
+  sym->white_core = xmalloc(sym->core_m * sizeof(stones_t));
+  size_t k = 0;
+  for (size_t idx = 0; idx < size; ++idx) {
+    const size_t representative = sym->core_map[idx];
+    if (representative == SIZE_MAX) {
+      continue;
+    }
+    if (representative == idx) {
+      sym->black_core[k] = scatter_stones(idx >> core_count, sym->core_mask);
+      sym->white_core[k] = scatter_stones(idx & core_bits, sym->core_mask);
+      sym->core_map[idx] = k++;
+    } else {
+      sym->core_map[idx] = sym->core_map[representative];
+    }
+  }
+  assert(k == sym->core_m);
+}
+
+// True when one of the hand-tuned cores covers the root
+bool has_tuned_symmetry(const state *s) {
+  if (s->logical_area != s->visual_area || s->player || s->opponent || s->target || s->immortal || s->external) {
+    return false;
+  }
+  if (s->wide) {
+    int w = width_of_16(s->visual_area);
+    int h = height_of_16(s->visual_area);
+    if (s->visual_area != rectangle_16(w, h)) {
+      return false;
+    }
+    return w >= 4 && w <= 9 && w != h && (h == 2 || h == 4);
+  }
+  int w = width_of(s->visual_area);
+  int h = height_of(s->visual_area);
+  if (s->visual_area != rectangle(w, h)) {
+    return false;
+  }
+  if (w < 3 || w > WIDTH || h < 2 || h > HEIGHT) {
+    return false;
+  }
+  if (w == h) {
+    return true;
+  }
+  // Even by even rectangles and odd by two rectangles are only tuned for the alternate width
+  return (w & 1) ? (h != 2) : (h & 1);
+}
+
+symmetry compute_generic_symmetry(const state *s) {
+  symmetry result = {0};
+  pick_mirrors(&result, s);
+
+  mirror_op_t ops[8];
+  int num_ops = compute_automorphisms(s, ops);
+  if (num_ops < 2) {
+    fprintf(stderr, "The root has no symmetries to reduce\n");
+    exit(EXIT_FAILURE);
+  }
+
+  prepare_generic_symmetry(&result, s, ops, num_ops);
+  prepare_pulp_blocks(&result);
+
+  return result;
+}
+
+size_t count_symmetry_orbits(const state *s) {
+  symmetry sym = {0};
+  pick_mirrors(&sym, s);
+  mirror_op_t ops[8];
+  const int num_ops = compute_automorphisms(s, ops);
+  const stones_t variable_area = s->logical_area & ~(s->target | s->immortal | s->external);
+
+  // Burnside's lemma: Average the number of arrangements left fixed by each automorphism
+  size_t total = 0;
+  for (int i = 0; i < num_ops; ++i) {
+    size_t num_fixed = 1;
+    stones_t remaining = variable_area;
+    while (remaining) {
+      // Mirrors compose to rotations of order four at most
+      stones_t cycle = remaining & -remaining;
+      for (int j = 0; j < 3; ++j) {
+        cycle |= apply_mirror_op(&sym, ops[i], cycle);
+      }
+      remaining &= ~cycle;
+      num_fixed *= 3;
+    }
+    total += num_fixed;
+  }
+  return total / num_ops;
+}
+
+size_t estimate_symmetry_bytes(const state *s) {
+  mirror_op_t ops[8];
+  const int num_ops = compute_automorphisms(s, ops);
+  const int num_points = popcount(s->logical_area & ~(s->target | s->immortal | s->external));
+  const int core_size = num_points < GENERIC_CORE_MAX_SIZE ? num_points : GENERIC_CORE_MAX_SIZE;
+  const int pulp_count = num_points - core_size;
+
+  size_t core_m = 1;
+  for (int i = 0; i < core_size; ++i) {
+    core_m *= 3;
+  }
+  core_m = ceil_divz(core_m, num_ops);
+  const size_t num_core_indices = 1ULL << (2 * core_size);
+
+  size_t result = sizeof(symmetry) + pulp_count * sizeof(stones_t);
+  result += num_core_indices * (sizeof(size_t) + sizeof(mirror_op_t)) + 2 * core_m * sizeof(stones_t);
+  size_t m = 1;
+  for (int i = 0; i < pulp_count; ++i) {
+    m *= 3;
+    if (i % TRIT_BLOCK_SIZE == TRIT_BLOCK_SIZE - 1 || i == pulp_count - 1) {
+      result += 2 * m * sizeof(stones_t);
+      m = 1;
+    }
+  }
+  return result;
+}
+
 symmetry compute_symmetry(const state *s) {
+  if (!has_tuned_symmetry(s)) {
+    return compute_generic_symmetry(s);
+  }
+
   symmetry result = {0};
   int w = s->wide ? width_of_16(s->visual_area) : width_of(s->visual_area);
   int h = s->wide ? height_of_16(s->visual_area) : height_of(s->visual_area);
+  // Narrower roots fall back to generic symmetry above
   switch (w) {
-  case 2:
-    assert(false && "Width of 2 not implemented. Try flipping input diagonally.");
-    break;
   case 3:
     result.horizontal = stones_mirror_h_3;
     break;
@@ -746,66 +1139,26 @@ symmetry compute_symmetry(const state *s) {
     }
   }
 
-  result.num_blocks = ceil_div(result.pulp_count, TRIT_BLOCK_SIZE);
-  result.black_blocks = xmalloc(result.num_blocks * sizeof(stones_t *));
-  result.white_blocks = xmalloc(result.num_blocks * sizeof(stones_t *));
-
-  size_t m = 1;
-  int i;
-  for (i = 0; i < result.pulp_count / TRIT_BLOCK_SIZE; ++i) {
-    result.black_blocks[i] = xcalloc(TRIT_BLOCK_M, sizeof(stones_t));
-    result.white_blocks[i] = xcalloc(TRIT_BLOCK_M, sizeof(stones_t));
-    for (size_t j = 0; j < TRIT_BLOCK_M; ++j) {
-      size_t key = m * j;
-      for (int k = result.pulp_count - 1; k >= 0; --k) {
-        switch (key % 3) {
-        case 1:
-          result.black_blocks[i][j] |= result.pulp_dots[k];
-          break;
-        case 2:
-          result.white_blocks[i][j] |= result.pulp_dots[k];
-          break;
-        }
-        key /= 3;
-      }
-    }
-    m *= TRIT_BLOCK_M;
-  }
+  result.variable_area = s->visual_area;
+  prepare_pulp_blocks(&result);
 
-  size_t tail_m = 1;
-  for (int j = 0; j < result.pulp_count % TRIT_BLOCK_SIZE; ++j) {
-    tail_m *= 3;
-  }
-  if (tail_m != 1) {
-    result.black_blocks[i] = xcalloc(tail_m, sizeof(stones_t));
-    result.white_blocks[i] = xcalloc(tail_m, sizeof(stones_t));
-    for (size_t j = 0; j < tail_m; ++j) {
-      size_t key = m * j;
-      for (int k = result.pulp_count - 1; k >= 0; --k) {
-        switch (key % 3) {
-        case 1:
-          result.black_blocks[i][j] |= result.pulp_dots[k];
-          break;
-        case 2:
-          result.white_blocks[i][j] |= result.pulp_dots[k];
-          break;
-        }
-        key /= 3;
-      }
-    }
-  }
+  return result;
+}
 
-  result.size = 1;
-  for (int i = 0; i < result.pulp_count; ++i) {
-    result.size *= 3;
+// Index of the core configuration of the stones
+static inline size_t root_core_idx(const symmetry *sym, stones_t black, stones_t white) {
+  if (sym->core_idx) {
+    return sym->core_idx(black >> sym->core_shift, white >> sym->core_shift);
   }
-  result.size *= result.core_m;
+  return generic_core_idx(sym, black, white);
+}
 
-  return result;
+mirror_op_t symmetric_bw_op(const symmetry *sym, const stones_t black, const stones_t white) {
+  return sym->pulp_ops[root_core_idx(sym, black, white)];
 }
 
 size_t to_symmetric_bw_key(const symmetry *sym, stones_t black, stones_t white) {
-  size_t idx = sym->core_idx(black >> sym->core_shift, white >> sym->core_shift);
+  const size_t idx = root_core_idx(sym, black, white);
   mirror_op_t op = sym->pulp_ops[idx];
   if (op == UCHAR_MAX) {
     // The client can send illegal queries. It's better to give a wrong answer than to crash the server.
@@ -869,3 +1222,153 @@ void free_symmetry(symmetry *sym) {
   free(sym->white_blocks);
   sym->white_blocks = NULL;
 }
+
+// Function pointers are serialized as indices into these registries
+static const mirror_f MIRROR_REGISTRY[] = {
+    NULL,               stones_mirror_v_2,  stones_mirror_v_3,  stones_mirror_v_4,  stones_mirror_v_5,  stones_mirror_v_6,
+    stones_mirror_v,    stones_mirror_h_2,  stones_mirror_h_3,  stones_mirror_h_4,  stones_mirror_h_5,  stones_mirror_h_6,
+    stones_mirror_h_7,  stones_mirror_h_8,  stones_mirror_h,    stones_mirror_d_3,  stones_mirror_d_4,  stones_mirror_d_5,
+    stones_mirror_d_6,  stones_mirror_d,    stones_mirror_v_w2, stones_mirror_v_16, stones_mirror_h_w3, stones_mirror_h_w4,
+    stones_mirror_h_w5, stones_mirror_h_w6, stones_mirror_h_w7, stones_mirror_h_w8, stones_mirror_h_w9, stones_mirror_h_16,
+};
+
+static const core_idx_f CORE_IDX_REGISTRY[] = {
+    NULL,
+    odd_even_core_idx,
+    even_odd_core_idx,
+    odd_odd_core_idx,
+    odd_square_core_idx,
+    even_square_core_idx,
+    even_even_core_idx,
+    odd_two_core_idx,
+    odd_four_core_idx,
+};
+
+#define MIRROR_REGISTRY_SIZE ((int)(sizeof(MIRROR_REGISTRY) / sizeof(mirror_f)))
+#define CORE_IDX_REGISTRY_SIZE ((int)(sizeof(CORE_IDX_REGISTRY) / sizeof(core_idx_f)))
+
+static int mirror_index(mirror_f f) {
+  for (int i = 0; i < MIRROR_REGISTRY_SIZE; ++i) {
+    if (MIRROR_REGISTRY[i] == f) {
+      return i;
+    }
+  }
+  fprintf(stderr, "Unregistered mirror function\n");
+  exit(EXIT_FAILURE);
+}
+
+static int core_idx_index(core_idx_f f) {
+  for (int i = 0; i < CORE_IDX_REGISTRY_SIZE; ++i) {
+    if (CORE_IDX_REGISTRY[i] == f) {
+      return i;
+    }
+  }
+  fprintf(stderr, "Unregistered core indexer\n");
+  exit(EXIT_FAILURE);
+}
+
+static size_t pulp_block_m(const symmetry *sym, int block) {
+  if (block < sym->pulp_count / TRIT_BLOCK_SIZE) {
+    return TRIT_BLOCK_M;
+  }
+  size_t m = 1;
+  for (int j = 0; j < sym->pulp_count % TRIT_BLOCK_SIZE; ++j) {
+    m *= 3;
+  }
+  return m;
+}
+
+size_t write_symmetry(const symmetry *restrict sym, size_t offset, FILE *restrict stream) {
+  size_t total = offset;
+  const int functions[4] = {
+      mirror_index(sym->vertical),
+      mirror_index(sym->horizontal),
+      mirror_index(sym->diagonal),
+      core_idx_index(sym->core_idx),
+  };
+  WRITE_ARRAY(total, stream, functions, 4);
+  WRITE_FIELD(total, stream, sym->core_shift);
+  WRITE_FIELD(total, stream, sym->core_mask);
+  WRITE_FIELD(total, stream, sym->variable_area);
+  WRITE_FIELD(total, stream, sym->pulp_count);
+  WRITE_FIELD(total, stream, sym->num_core_indices);
+  WRITE_FIELD(total, stream, sym->core_m);
+  WRITE_FIELD(total, stream, sym->num_blocks);
+  WRITE_FIELD(total, stream, sym->size);
+
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, sym->pulp_dots, sym->pulp_count);
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, sym->core_map, sym->num_core_indices);
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, sym->black_core, sym->core_m);
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, sym->white_core, sym->core_m);
+  for (int i = 0; i < sym->num_blocks; ++i) {
+    WRITE_PADDING(total, stream);
+    WRITE_ARRAY(total, stream, sym->black_blocks[i], pulp_block_m(sym, i));
+    WRITE_ARRAY(total, stream, sym->white_blocks[i], pulp_block_m(sym, i));
+  }
+  WRITE_PADDING(total, stream);
+  WRITE_ARRAY(total, stream, sym->pulp_ops, sym->num_core_indices);
+  return total - offset;
+}
+
+char *map_symmetry(symmetry *sym, char *map, const char *base) {
+  int functions[4];
+  READ_ARRAY_FIELD(map, functions, 4);
+  for (int i = 0; i < 3; ++i) {
+    if (functions[i] < 0 || functions[i] >= MIRROR_REGISTRY_SIZE) {
+      fprintf(stderr, "Invalid mirror function index %d\n", functions[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (functions[3] < 0 || functions[3] >= CORE_IDX_REGISTRY_SIZE) {
+    fprintf(stderr, "Invalid core indexer index %d\n", functions[3]);
+    exit(EXIT_FAILURE);
+  }
+  sym->vertical = MIRROR_REGISTRY[functions[0]];
+  sym->horizontal = MIRROR_REGISTRY[functions[1]];
+  sym->diagonal = MIRROR_REGISTRY[functions[2]];
+  sym->core_idx = CORE_IDX_REGISTRY[functions[3]];
+  READ_FIELD(map, sym->core_shift);
+  READ_FIELD(map, sym->core_mask);
+  READ_FIELD(map, sym->variable_area);
+  READ_FIELD(map, sym->pulp_count);
+  READ_FIELD(map, sym->num_core_indices);
+  READ_FIELD(map, sym->core_m);
+  READ_FIELD(map, sym->num_blocks);
+  READ_FIELD(map, sym->size);
+
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, sym->pulp_dots, sym->pulp_count);
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, sym->core_map, sym->num_core_indices);
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, sym->black_core, sym->core_m);
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, sym->white_core, sym->core_m);
+  sym->black_blocks = xmalloc(sym->num_blocks * sizeof(stones_t *));
+  sym->white_blocks = xmalloc(sym->num_blocks * sizeof(stones_t *));
+  for (int i = 0; i < sym->num_blocks; ++i) {
+    ALIGN_MAP(map, base);
+    MAP_ARRAY_FIELD(map, sym->black_blocks[i], pulp_block_m(sym, i));
+    MAP_ARRAY_FIELD(map, sym->white_blocks[i], pulp_block_m(sym, i));
+  }
+  ALIGN_MAP(map, base);
+  MAP_ARRAY_FIELD(map, sym->pulp_ops, sym->num_core_indices);
+  return map;
+}
+
+void unmap_symmetry(symmetry *sym) {
+  sym->pulp_count = 0;
+  sym->pulp_dots = NULL;
+  sym->pulp_ops = NULL;
+  sym->core_map = NULL;
+  sym->black_core = NULL;
+  sym->white_core = NULL;
+  free(sym->black_blocks);
+  sym->black_blocks = NULL;
+  free(sym->white_blocks);
+  sym->white_blocks = NULL;
+}
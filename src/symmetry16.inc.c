@@ -63,6 +63,7 @@ void prepare_even_even_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (rectangle_16(4, 2) << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = even_even_core_idx;
   size_t size = 1 << 16;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -136,6 +137,7 @@ void prepare_odd_two_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (rectangle_16(5, 2) << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = odd_two_core_idx;
   size_t size = 1 << 20;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
@@ -244,6 +246,7 @@ void prepare_odd_four_symmetry(symmetry *sym, stones_t visual_area) {
   sym->pulp_dots = dots(visual_area ^ (rectangle_16(3, 4) << sym->core_shift), &(sym->pulp_count));
   sym->core_idx = odd_four_core_idx;
   size_t size = 1 << 24;
+  sym->num_core_indices = size;
   sym->pulp_ops = xmalloc(size * sizeof(mirror_op_t));
   sym->core_map = xmalloc(size * sizeof(size_t));
   sym->core_m = 0;
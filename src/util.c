@@ -1,4 +1,5 @@
 #include "tinytsumego2/util.h"
+#include <stdint.h>
 
 static void allocation_failure(const char *fn, size_t count, size_t size) {
   fprintf(stderr, "%s failed to allocate %zu byte(s)", fn, count * size);
@@ -50,12 +51,107 @@ void *xrealloc(void *ptr, size_t size) {
   return result;
 }
 
-char *file_to_mmap(const char *filename, struct stat *sb, int *fd) {
-  stat(filename, sb);
+char *file_to_mmap(const char *filename, struct stat *sb, int *fd) { return file_to_mmap_with_policy(filename, sb, fd, RANDOM_RESIDENCY); }
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Map a file at a huge page boundary by reserving a larger range and trimming it
+static char *mmap_huge_aligned(size_t size, int fd) {
+  const size_t reserved_size = size + HUGE_PAGE_SIZE;
+  char *reserved = (char *)mmap(NULL, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  char *aligned = reserved + (HUGE_PAGE_SIZE - (uintptr_t)reserved % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+  char *map = (char *)mmap(aligned, size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0);
+  if (map == MAP_FAILED) {
+    munmap(reserved, reserved_size);
+    return MAP_FAILED;
+  }
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t end = ceil_divz(size, page_size) * page_size;
+  if (aligned > reserved) {
+    munmap(reserved, aligned - reserved);
+  }
+  if (aligned + end < reserved + reserved_size) {
+    munmap(aligned + end, reserved + reserved_size - (aligned + end));
+  }
+#ifdef MADV_HUGEPAGE
+  if (madvise(map, size, MADV_HUGEPAGE)) {
+    fprintf(stderr, "Transparent huge pages are not supported for mapped files\n");
+  }
+#endif
+  return map;
+}
+
+char *file_to_mmap_with_policy(const char *filename, struct stat *sb, int *fd, residency_policy policy) {
+  char *map = try_file_to_mmap_with_policy(filename, sb, fd, policy);
+  if (!map) {
+    fprintf(stderr, "Failed to map %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  return map;
+}
+
+char *try_file_to_mmap_with_policy(const char *filename, struct stat *sb, int *fd, residency_policy policy) {
   *fd = open(filename, O_RDONLY);
-  assert(*fd != -1);
+  if (*fd < 0) {
+    return NULL;
+  }
+  if (fstat(*fd, sb)) {
+    close(*fd);
+    *fd = -1;
+    return NULL;
+  }
   char *map;
-  map = (char *)mmap(NULL, sb->st_size, PROT_READ, MAP_SHARED, *fd, 0);
-  madvise(map, sb->st_size, MADV_RANDOM);
+  if (policy == HUGE_PAGE_RESIDENCY) {
+    map = mmap_huge_aligned(sb->st_size, *fd);
+  } else {
+    const int flags = policy == POPULATE_RESIDENCY ? MAP_SHARED | MAP_POPULATE : MAP_SHARED;
+    map = (char *)mmap(NULL, sb->st_size, PROT_READ, flags, *fd, 0);
+  }
+  if (map == MAP_FAILED) {
+    close(*fd);
+    *fd = -1;
+    return NULL;
+  }
+  if (policy == WILLNEED_RESIDENCY) {
+    madvise(map, sb->st_size, MADV_WILLNEED);
+  } else if (policy == RANDOM_RESIDENCY || policy == LOCKED_RESIDENCY) {
+    madvise(map, sb->st_size, MADV_RANDOM);
+  }
   return map;
 }
+
+// SplitMix64 step used to spread seeds over the whole generator state
+static unsigned long long split_mix(unsigned long long *seed) {
+  unsigned long long z = (*seed += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+rng_state seed_rng(unsigned long long seed) {
+  rng_state result;
+  const unsigned long long a = split_mix(&seed);
+  const unsigned long long b = split_mix(&seed);
+  result.x = (unsigned int)a;
+  // The xorshift component must not be zero
+  result.y = (unsigned int)(a >> 32) | 1;
+  result.z = (unsigned int)b & 2147483647;
+  result.w = (unsigned int)(b >> 32) & 2147483647;
+  result.c = 0;
+  return result;
+}
+
+unsigned int rng_next(rng_state *rng) {
+  rng->y ^= rng->y << 5;
+  rng->y ^= rng->y >> 7;
+  rng->y ^= rng->y << 22;
+  const int t = rng->z + rng->w + rng->c;
+  rng->z = rng->w;
+  rng->c = t < 0;
+  rng->w = t & 2147483647;
+  rng->x += 1411392427;
+  return rng->x + rng->y + rng->w;
+}
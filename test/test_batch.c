@@ -0,0 +1,105 @@
+#include "tinytsumego2/batch.h"
+#include "tinytsumego2/dual_solver.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_FILE_SIZE (1000000)
+
+state straight(int length) {
+  state s = {0};
+  s.visual_area = rectangle(length + 1, 2);
+  s.logical_area = rectangle(length, 1);
+  s.target = s.visual_area ^ s.logical_area;
+  s.opponent = s.target;
+  return s;
+}
+
+// Compares fields as move_info has padding
+bool same_move_info(const move_info *a, const move_info *b) {
+  return a->coords.x == b->coords.x && a->coords.y == b->coords.y && a->low_gain == b->low_gain &&
+         a->high_gain == b->high_gain && a->low_ideal == b->low_ideal && a->high_ideal == b->high_ideal &&
+         a->forcing == b->forcing;
+}
+
+void test_batch() {
+  const state root = straight(5);
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+  fht.id_layout = BLOCK_IDS;
+  char *buffer = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(buffer, MEM_FILE_SIZE, "wb");
+  write_dual_graph(&dg, &fht, stream);
+  fclose(stream);
+  free(fht.bulk_map);
+  free_dual_graph(&dg);
+
+  dual_graph_reader dgr = {0};
+  dgr.fd = -1;
+  dgr.buffer = buffer;
+  unbuffer_dual_graph_reader(&dgr);
+
+  const size_t count = dgr.keyspace._.size;
+  state *states = malloc(count * sizeof(state));
+  for (size_t key = 0; key < count; ++key) {
+    states[key] = from_compressed_key(&(dgr.keyspace.compressed), key);
+  }
+
+  dual_value *values = malloc(count * sizeof(dual_value));
+  dual_graph_reader_batch_values(&dgr, states, count, values);
+
+  size_t *offsets = malloc((count + 1) * sizeof(size_t));
+  move_info *infos = dual_graph_reader_batch_move_infos(&dgr, states, count, offsets);
+
+  state *lows = malloc(count * sizeof(state));
+  state *highs = malloc(count * sizeof(state));
+  dual_graph_reader_batch_terminals(&dgr, states, count, FORCING, true, 42, lows);
+  dual_graph_reader_batch_terminals(&dgr, states, count, FORCING, false, 42, highs);
+
+  // Batches agree with one-by-one queries
+  for (size_t i = 0; i < count; ++i) {
+    const dual_value v = get_dual_graph_reader_value(&dgr, states + i);
+    assert(memcmp(&v, values + i, sizeof(dual_value)) == 0);
+
+    int num_move_infos = 0;
+    move_info *expected = dual_graph_reader_move_infos(&dgr, states + i, &num_move_infos);
+    assert(offsets[i + 1] - offsets[i] == (size_t)num_move_infos);
+    for (int j = 0; j < num_move_infos; ++j) {
+      assert(same_move_info(expected + j, infos + offsets[i] + j));
+    }
+    free(expected);
+
+    reader_context ctx = create_reader_context(&dgr, 42 + i);
+    state terminal = dual_graph_reader_low_terminal_r(&dgr, &ctx, states + i, FORCING);
+    assert(memcmp(&terminal, lows + i, sizeof(state)) == 0);
+    ctx.rng = seed_rng(42 + i);
+    terminal = dual_graph_reader_high_terminal_r(&dgr, &ctx, states + i, FORCING);
+    assert(memcmp(&terminal, highs + i, sizeof(state)) == 0);
+    free_reader_context(&ctx);
+  }
+  printf("%zu states and %zu move infos in a batch\n", count, offsets[count]);
+
+  // Empty batches are fine
+  dual_graph_reader_batch_values(&dgr, states, 0, values);
+  free(dual_graph_reader_batch_move_infos(&dgr, states, 0, offsets));
+  assert(offsets[0] == 0);
+
+  free(highs);
+  free(lows);
+  free(infos);
+  free(offsets);
+  free(values);
+  free(states);
+  unload_dual_graph_reader(&dgr);
+  free(buffer);
+}
+
+int main() {
+  test_batch();
+  return 0;
+}
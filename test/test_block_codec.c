@@ -0,0 +1,152 @@
+#include "jkiss/jkiss.h"
+#include "tinytsumego2/block_codec.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void round_trip(const value_id_t *ids, size_t count, size_t *encoded_size) {
+  unsigned char *buffer = calloc(max_encoded_ids_size(count), 1);
+  value_id_t *decoded = malloc(count * sizeof(value_id_t));
+  *encoded_size = encode_ids(ids, count, buffer);
+  assert(*encoded_size + ID_BLOCK_PADDING <= max_encoded_ids_size(count));
+  assert(decode_ids(buffer, count, decoded));
+  assert(memcmp(ids, decoded, count * sizeof(value_id_t)) == 0);
+  free(decoded);
+  free(buffer);
+}
+
+void test_runs() {
+  value_id_t ids[ID_BLOCK_SIZE];
+  for (size_t i = 0; i < ID_BLOCK_SIZE; ++i) {
+    ids[i] = (i / 100) % 3 ? 7 : 65534;
+  }
+  size_t size;
+  round_trip(ids, ID_BLOCK_SIZE, &size);
+  printf("Alternating runs encoded in %zu bytes\n", size);
+  assert(size < 64);
+
+  round_trip(ids, 1, &size);
+  round_trip(ids, 123, &size);
+
+  // A single run
+  for (size_t i = 0; i < ID_BLOCK_SIZE; ++i) {
+    ids[i] = 3;
+  }
+  round_trip(ids, ID_BLOCK_SIZE, &size);
+  assert(size < 16);
+}
+
+void test_noise() {
+  value_id_t ids[ID_BLOCK_SIZE];
+  for (int bits = 1; bits <= 16; ++bits) {
+    for (size_t i = 0; i < ID_BLOCK_SIZE; ++i) {
+      ids[i] = jrand() & ((1U << bits) - 1);
+    }
+    size_t size;
+    round_trip(ids, ID_BLOCK_SIZE, &size);
+    // Incompressible data falls back to verbatim storage
+    assert(size <= 1 + ID_BLOCK_SIZE * sizeof(value_id_t));
+  }
+}
+
+void test_malformed() {
+  value_id_t ids[ID_BLOCK_SIZE];
+  for (size_t i = 0; i < ID_BLOCK_SIZE; ++i) {
+    ids[i] = i / 100;
+  }
+  unsigned char *buffer = calloc(max_encoded_ids_size(ID_BLOCK_SIZE), 1);
+  value_id_t decoded[ID_BLOCK_SIZE];
+  encode_ids(ids, ID_BLOCK_SIZE, buffer);
+  assert(buffer[0] == 1);
+
+  // Palette larger than the block
+  value_id_t palette_size;
+  memcpy(&palette_size, buffer + 1, sizeof(value_id_t));
+  const value_id_t huge = 60000;
+  memcpy(buffer + 1, &huge, sizeof(value_id_t));
+  assert(!decode_ids(buffer, ID_BLOCK_SIZE, decoded));
+  memcpy(buffer + 1, &palette_size, sizeof(value_id_t));
+  assert(decode_ids(buffer, ID_BLOCK_SIZE, decoded));
+
+  // Rank past the palette: a gamma code of 2^10 instead of the first rank
+  unsigned char *bits = buffer + 1 + sizeof(value_id_t) * (1 + palette_size);
+  unsigned char saved[8];
+  memcpy(saved, bits, sizeof(saved));
+  memset(bits, 0, sizeof(saved));
+  bits[1] = 0x20;
+  bits[2] = 0x04;
+  assert(!decode_ids(buffer, ID_BLOCK_SIZE, decoded));
+
+  // Codes longer than any value in a block
+  bits[1] = 0;
+  assert(!decode_ids(buffer, ID_BLOCK_SIZE, decoded));
+
+  // The last run ends past the requested count
+  memcpy(bits, saved, sizeof(saved));
+  assert(!decode_ids(buffer, ID_BLOCK_SIZE - 1, decoded));
+
+  buffer[0] = 7;
+  assert(!decode_ids(buffer, ID_BLOCK_SIZE, decoded));
+  free(buffer);
+}
+
+void test_cache() {
+  const size_t size = 5 * ID_BLOCK_SIZE + 17;
+  value_id_t *ids = malloc(size * sizeof(value_id_t));
+  for (size_t i = 0; i < size; ++i) {
+    ids[i] = (i / 1000) ^ (i % 7 == 0);
+  }
+
+  const size_t num_blocks = 6;
+  uint64_t offsets[num_blocks + 1];
+  unsigned char *data = calloc(num_blocks * max_encoded_ids_size(ID_BLOCK_SIZE), 1);
+  offsets[0] = 0;
+  for (size_t b = 0; b < num_blocks; ++b) {
+    const size_t count = b + 1 < num_blocks ? ID_BLOCK_SIZE : size % ID_BLOCK_SIZE;
+    offsets[b + 1] = offsets[b] + encode_ids(ids + b * ID_BLOCK_SIZE, count, data + offsets[b]);
+  }
+
+  id_block_cache cache = create_id_block_cache(size, offsets, data, 2);
+  assert(cache.num_blocks == num_blocks);
+  assert(!cache.slots && !cache.num_allocated);
+
+  void check(size_t block) {
+    const value_id_t *decoded = get_id_block(&cache, block);
+    const size_t count = block + 1 < num_blocks ? ID_BLOCK_SIZE : size % ID_BLOCK_SIZE;
+    assert(memcmp(decoded, ids + block * ID_BLOCK_SIZE, count * sizeof(value_id_t)) == 0);
+  }
+
+  check(0);
+  check(1);
+  check(0);
+  assert(cache.hits == 1 && cache.misses == 2);
+  assert(cache.num_allocated == 2);
+
+  // Evicts block 1 as the least recently used
+  check(5);
+  assert(cache.slots[1] == SIZE_MAX);
+  assert(cache.slots[0] != SIZE_MAX);
+  check(0);
+  assert(cache.hits == 2 && cache.misses == 3);
+  check(1);
+  assert(cache.slots[5] == SIZE_MAX);
+  assert(cache.hits == 2 && cache.misses == 4);
+
+  for (size_t b = 0; b < num_blocks; ++b) {
+    check(b);
+    check(num_blocks - 1 - b);
+  }
+
+  free_id_block_cache(&cache);
+  free(data);
+  free(ids);
+}
+
+int main() {
+  jkiss_init();
+  test_runs();
+  test_noise();
+  test_malformed();
+  test_cache();
+  return 0;
+}
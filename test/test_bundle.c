@@ -0,0 +1,135 @@
+#include "tinytsumego2/bundle.h"
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/dual_solver.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+state corner_six() {
+  state s = {0};
+  s.visual_area = rectangle(4, 3);
+  s.logical_area = rectangle(3, 2);
+  s.target = s.visual_area ^ s.logical_area;
+  s.opponent = s.target;
+  return s;
+}
+
+state corner_eight() {
+  state s = {0};
+  s.visual_area = rectangle(5, 3);
+  s.logical_area = rectangle(4, 2);
+  s.target = s.visual_area ^ s.logical_area;
+  s.opponent = s.target;
+  return s;
+}
+
+// Solve and serialize a root to a temporary file
+char *write_temporary(const state *root) {
+  dual_graph dg = create_dual_graph(root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+
+  char *filename = malloc(32);
+  sprintf(filename, "/tmp/test_bundle_XXXXXX");
+  const int fd = mkstemp(filename);
+  assert(fd != -1);
+  FILE *f = fdopen(fd, "wb");
+  write_dual_graph(&dg, &fht, f);
+  fclose(f);
+
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  free_dual_graph(&dg);
+  return filename;
+}
+
+void test_bundle() {
+  const state roots[3] = {corner_six(), corner_eight(), corner_six()};
+  char *slugs[3] = {"corner-six", "corner-eight", "corner-six-again"};
+  char *filenames[3];
+  size_t total_size = 0;
+  for (int i = 0; i < 3; ++i) {
+    filenames[i] = write_temporary(roots + i);
+    struct stat sb;
+    stat(filenames[i], &sb);
+    total_size += sb.st_size;
+  }
+
+  char bundle_filename[] = "/tmp/test_bundle_XXXXXX";
+  const int fd = mkstemp(bundle_filename);
+  assert(fd != -1);
+  FILE *f = fdopen(fd, "wb");
+  const size_t bundle_size = write_solution_bundle(slugs, filenames, 3, f);
+  fclose(f);
+  printf("%zu bytes bundled into %zu bytes\n", total_size, bundle_size);
+  // The duplicate collection only adds its directory
+  assert(bundle_size < total_size);
+
+  solution_bundle bundle = load_solution_bundle(bundle_filename);
+  assert(bundle.num_collections == 3);
+  assert(get_bundle_reader(&bundle, "corner-seven") == NULL);
+  assert(!bundle.initialized[0] && !bundle.initialized[1] && !bundle.initialized[2]);
+
+  for (int i = 0; i < 3; ++i) {
+    dual_graph_reader *bundled = get_bundle_reader(&bundle, slugs[i]);
+    assert(bundled);
+    assert(bundled == get_bundle_reader(&bundle, slugs[i]));
+    dual_graph_reader standalone = load_dual_graph_reader(filenames[i]);
+    assert(bundled->keyspace._.size == standalone.keyspace._.size);
+    for (size_t key = 0; key < standalone.keyspace._.size; ++key) {
+      const state s = from_compressed_key(&(standalone.keyspace.compressed), key);
+      const dual_value a = get_dual_graph_reader_value(&standalone, &s);
+      const dual_value b = get_dual_graph_reader_value(bundled, &s);
+      assert(a.plain.low == b.plain.low);
+      assert(a.plain.high == b.plain.high);
+      assert(a.forcing.low == b.forcing.low);
+      assert(a.forcing.high == b.forcing.high);
+    }
+    unload_dual_graph_reader(&standalone);
+  }
+  // Identical collections share their sections
+  assert(bundle.readers[0].keyspace._.compressor.deltas == bundle.readers[2].keyspace._.compressor.deltas);
+  assert(bundle.readers[0].value_table.bulk_ids == bundle.readers[2].value_table.bulk_ids);
+
+  unload_solution_bundle(&bundle);
+
+  // Broken collections fail their own lookup without taking down the rest of the bundle
+  FILE *g = fopen(bundle_filename, "r+b");
+  assert(g);
+  bundle_entry entries[3];
+  assert(fseek(g, sizeof(bundle_header), SEEK_SET) == 0);
+  assert(fread(entries, sizeof(bundle_entry), 3, g) == 3);
+  section_entry section;
+  const long section_offset = entries[1].directory_offset + sizeof(container_header);
+  assert(fseek(g, section_offset, SEEK_SET) == 0);
+  assert(fread(&section, sizeof(section_entry), 1, g) == 1);
+  section.length = bundle_size;
+  assert(fseek(g, section_offset, SEEK_SET) == 0);
+  assert(fwrite(&section, sizeof(section_entry), 1, g) == 1);
+  entries[2].directory_offset = bundle_size - sizeof(container_header) / 2;
+  assert(fseek(g, sizeof(bundle_header), SEEK_SET) == 0);
+  assert(fwrite(entries, sizeof(bundle_entry), 3, g) == 3);
+  fclose(g);
+
+  bundle = load_solution_bundle(bundle_filename);
+  assert(get_bundle_reader(&bundle, slugs[0]));
+  assert(get_bundle_reader(&bundle, slugs[1]) == NULL);
+  assert(get_bundle_reader(&bundle, slugs[2]) == NULL);
+  assert(bundle.initialized[0] && !bundle.initialized[1] && !bundle.initialized[2]);
+  unload_solution_bundle(&bundle);
+
+  unlink(bundle_filename);
+  for (int i = 0; i < 3; ++i) {
+    unlink(filenames[i]);
+    free(filenames[i]);
+  }
+}
+
+int main() {
+  test_bundle();
+  return 0;
+}
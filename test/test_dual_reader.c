@@ -5,6 +5,9 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #define MEM_FILE_SIZE (1000000)
 
@@ -30,32 +33,64 @@ state rectangle_six() {
   return s;
 }
 
-void test_bulky_five() {
-  const state root = bulky_five();
-  print_state(&root);
-  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+// Load a reader from a serialized dual graph in memory
+dual_graph_reader buffered_reader(char *buffer) {
+  dual_graph_reader dgr = {0};
+  dgr.fd = -1;
+  dgr.buffer = buffer;
+  unbuffer_dual_graph_reader(&dgr);
+  return dgr;
+}
+
+// Serialize a solved graph into a new buffer and load it back. The buffer outlives the reader.
+dual_graph_reader exported_reader(const dual_graph *dg, id_layout layout, char **buffer) {
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(dg, &value_map_size);
+  fht.id_layout = layout;
+  size_t size = 0;
+  FILE *stream = open_memstream(buffer, &size);
+  write_dual_graph(dg, &fht, stream);
+  fclose(stream);
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  return buffered_reader(*buffer);
+}
+
+// Solve a root under both scoring rules and load the result through a reader backed by `*buffer`
+dual_graph_reader solved_reader(const state *root, keyspace_type type, id_layout layout, char **buffer) {
+  dual_graph dg = create_dual_graph(root, type);
   while (iterate_dual_graph(&dg, false))
     ;
   while (area_iterate_dual_graph(&dg, true))
     ;
+  dual_graph_reader dgr = exported_reader(&dg, layout, buffer);
+  free_dual_graph(&dg);
+  return dgr;
+}
 
-  size_t value_map_size = 0;
-  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+// Number of distinct value quads stored in the bulk map and the tail of a table
+size_t num_unique_values(const frozen_hash_table *fht) {
+  dual_table_value *tail = malloc(fht->tail_size * sizeof(dual_table_value));
+  memcpy(tail, fht->tail_values, fht->tail_size * sizeof(dual_table_value));
+  qsort(tail, fht->tail_size, sizeof(dual_table_value), compare_dual_table_values);
+  size_t result = fht->bulk_map_size;
+  for (size_t i = 0; i < fht->tail_size; ++i) {
+    result += !i || compare_dual_table_values(tail + i - 1, tail + i);
+  }
+  free(tail);
+  return result;
+}
+
+void test_bulky_five() {
+  const state root = bulky_five();
+  print_state(&root);
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+  const size_t value_map_size = num_unique_values(&(dgr.value_table));
   printf("%zu unique value quads in the graph\n", value_map_size);
   assert(value_map_size == 16);
 
-  char *buffer = malloc(MEM_FILE_SIZE);
-  FILE *stream = fmemopen(buffer, MEM_FILE_SIZE, "wb");
-  write_dual_graph(&dg, &fht, stream);
-  fclose(stream);
-  free(fht.bulk_map);
-  free_dual_graph(&dg);
-
-  dual_graph_reader dgr = {0};
-  dgr.fd = -1;
-  dgr.buffer = buffer;
-  unbuffer_dual_graph_reader(&dgr);
-
   for (size_t i = 0; i < dgr.value_table.bulk_map_size; ++i) {
     dual_table_value tv = dgr.value_table.bulk_map[i];
     dual_value v = (dual_value){
@@ -92,6 +127,29 @@ void test_bulky_five() {
   assert(terminal.white_to_play);
   assert(!terminal.player);
 
+  // Materialized ko and atari values agree with the compensation negamax
+  printf("%zu entries in the side table\n", dgr.side_table.size);
+  assert(dgr.side_table.size > 0);
+  dual_graph_reader bare = dgr;
+  bare.side_table.num_slots = 0;
+  size_t num_hits = 0;
+  for (size_t key = 0; key < dgr.keyspace._.size; ++key) {
+    const state parent = from_compressed_key(&(dgr.keyspace.compressed), key);
+    for (int j = 0; j < dgr.num_moves; ++j) {
+      state child = parent;
+      const move_result r = make_move(&child, dgr.moves[j]);
+      if (r <= TAKE_TARGET || !(child.ko || target_in_atari(&child))) {
+        continue;
+      }
+      dual_table_value sv;
+      assert(get_side_table_value(&(dgr.side_table), side_key(dgr.type, &(dgr.keyspace._), &child), &sv));
+      const dual_table_value cv = get_dual_graph_reader_table_value(&bare, &child);
+      assert(memcmp(&sv, &cv, sizeof(dual_table_value)) == 0);
+      num_hits++;
+    }
+  }
+  assert(num_hits >= dgr.side_table.size);
+
   unload_dual_graph_reader(&dgr);
 
   free(buffer);
@@ -100,29 +158,12 @@ void test_bulky_five() {
 void test_external_liberties() {
   const state root = rectangle_six();
   print_state(&root);
-  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
-  while (iterate_dual_graph(&dg, false))
-    ;
-  while (area_iterate_dual_graph(&dg, true))
-    ;
-
-  size_t value_map_size = 0;
-  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+  const size_t value_map_size = num_unique_values(&(dgr.value_table));
   printf("%zu unique value quads in the graph\n", value_map_size);
   assert(value_map_size == 31);
 
-  char *buffer = malloc(MEM_FILE_SIZE);
-  FILE *stream = fmemopen(buffer, MEM_FILE_SIZE, "wb");
-  write_dual_graph(&dg, &fht, stream);
-  fclose(stream);
-  free(fht.bulk_map);
-  free_dual_graph(&dg);
-
-  dual_graph_reader dgr = {0};
-  dgr.fd = -1;
-  dgr.buffer = buffer;
-  unbuffer_dual_graph_reader(&dgr);
-
   for (size_t i = 0; i < dgr.value_table.bulk_map_size; ++i) {
     dual_table_value tv = dgr.value_table.bulk_map[i];
     dual_value v = (dual_value){
@@ -218,6 +259,629 @@ void test_external_liberties() {
   free(buffer);
 }
 
+void test_solver_agreement() {
+  const state root = rectangle_six();
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+  while (area_iterate_dual_graph(&dg, true))
+    ;
+
+  char *buffer;
+  dual_graph_reader dgr = exported_reader(&dg, PACKED_IDS, &buffer);
+
+  // The reader picks the same specialized predicates as the solver
+  assert(dgr.in_atari == dg.in_atari);
+  assert(dgr.can_take == dg.can_take);
+  assert(dg.in_atari == in_atari_single);
+
+  void check(const state *s) {
+    const value plain = get_dual_graph_value(&dg, s, NONE);
+    const value forcing = get_dual_graph_value(&dg, s, FORCING);
+    const dual_value v = get_dual_graph_reader_value(&dgr, s);
+    assert(memcmp(&plain, &(v.plain), sizeof(value)) == 0);
+    assert(memcmp(&forcing, &(v.forcing), sizeof(value)) == 0);
+
+    const dual_table_value tv = get_dual_graph_reader_table_value(&dgr, s);
+    const dual_value converted = {table_value_to_value(tv.plain), table_value_to_value(tv.forcing)};
+    assert(memcmp(&converted, &v, sizeof(dual_value)) == 0);
+  }
+
+  // A second pass scores the position in the solver but the reader continues it with the passes cleared like the API does.
+  // Plain values after a pass are checked against that convention using solver values.
+  void check_passed(const state *s) {
+    value plain = {-INFINITY, -INFINITY};
+    for (int j = 0; j < dg.num_moves; ++j) {
+      state child = *s;
+      const move_result r = make_move(&child, dg.moves[j]);
+      value child_plain;
+      if (r == ILLEGAL) {
+        continue;
+      } else if (r == SECOND_PASS) {
+        const float delta = child.ko_threats * KO_THREAT_BONUS;
+        child.passes = 0;
+        child.ko = 0ULL;
+        child.ko_threats = 0;
+        child_plain = get_dual_graph_value(&dg, &child, NONE);
+        child_plain.low += delta;
+        child_plain.high += delta;
+        child_plain = apply_tactics(NONE, r, &child, child_plain);
+      } else if (r <= TAKE_TARGET) {
+        child_plain = score_terminal(r, &child);
+      } else {
+        child_plain = apply_tactics(NONE, r, &child, get_dual_graph_value(&dg, &child, NONE));
+      }
+      plain.low = fmax(plain.low, child_plain.high);
+      plain.high = fmax(plain.high, child_plain.low);
+    }
+    const value forcing = get_dual_graph_value(&dg, s, FORCING);
+    const dual_value v = get_dual_graph_reader_value(&dgr, s);
+    assert(memcmp(&plain, &(v.plain), sizeof(value)) == 0);
+    assert(memcmp(&forcing, &(v.forcing), sizeof(value)) == 0);
+  }
+
+  // Ko, atari and pass states only exist as children and go through compensation
+  int num_ko = 0;
+  int num_atari = 0;
+  int num_passed = 0;
+  void check_children(const state *s) {
+    for (int j = 0; j < dg.num_moves; ++j) {
+      state child = *s;
+      const move_result r = make_move(&child, dg.moves[j]);
+      if (r <= TAKE_TARGET || !(child.ko || child.passes || dg.in_atari(&child))) {
+        continue;
+      }
+      num_ko += !!child.ko;
+      num_atari += dg.in_atari(&child);
+      num_passed += !!child.passes;
+      if (child.passes) {
+        check_passed(&child);
+      } else {
+        check(&child);
+      }
+    }
+  }
+
+  const side_table st = dgr.side_table;
+  assert(st.size);
+  for (int with_side_table = 1; with_side_table >= 0; --with_side_table) {
+    dgr.side_table.num_slots = with_side_table ? st.num_slots : 0;
+    for (size_t key = 0; key < dg.keyspace._.size; ++key) {
+      state s = from_compressed_key(&(dg.keyspace.compressed), key);
+      check(&s);
+      check_children(&s);
+      if (s.button > 0) {
+        s.button = -s.button;
+        check(&s);
+        check_children(&s);
+      }
+    }
+  }
+  printf("%d ko, %d atari and %d pass states agree\n", num_ko, num_atari, num_passed);
+  assert(num_ko && num_atari && num_passed);
+  dgr.side_table.num_slots = st.num_slots;
+
+  unload_dual_graph_reader(&dgr);
+  free(buffer);
+  free_dual_graph(&dg);
+}
+
+void test_reader_states() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+
+  // Everything reached by play belongs to the reader
+  srand(11);
+  size_t num_states = 0;
+  for (int n = 0; n < 100; ++n) {
+    state s = root;
+    for (int ply = 0; ply < 30; ++ply) {
+      assert(is_reader_state(&dgr, &s));
+      num_states++;
+      state child = s;
+      const move_result r = make_move(&child, dgr.moves[rand() % dgr.num_moves]);
+      if (r <= TAKE_TARGET) {
+        break;
+      }
+      s = child;
+    }
+  }
+  printf("%zu states reached by play accepted\n", num_states);
+
+  // Tsumegos may trim the areas of the root
+  state trimmed = root;
+  trimmed.visual_area &= ~single(3, 4);
+  trimmed.player &= ~single(3, 4);
+  trimmed.immortal &= ~single(3, 4);
+  assert(is_reader_state(&dgr, &trimmed));
+
+  state s = root;
+  s.visual_area |= single(4, 0);
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.external |= single(2, 3);
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.ko_threats = 1;
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.target = 0;
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.ko = single(0, 0) | single(1, 0);
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.ko = single(3, 0);
+  assert(!is_reader_state(&dgr, &s));
+
+  s = root;
+  s.wide = true;
+  assert(!is_reader_state(&dgr, &s));
+
+  // Overlapping stones
+  s = root;
+  s.player |= single(3, 0);
+  assert(!is_reader_state(&dgr, &s));
+
+  unload_dual_graph_reader(&dgr);
+  free(buffer);
+}
+
+void test_move_table() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+  assert(!dgr.move_table.size);
+
+  move_table mt = prepare_move_table(&dgr);
+  printf("%zu distinct move records for %zu keys\n", mt.num_records, mt.size);
+  assert(mt.size == dgr.keyspace._.size);
+  assert(mt.num_records > 1 && mt.num_records < mt.size);
+
+  char *extended = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(extended, MEM_FILE_SIZE, "wb");
+  const size_t size = write_dual_graph_with_move_table(&dgr, &mt, stream);
+  fclose(stream);
+  assert(validate_dual_graph(extended, size));
+
+  dual_graph_reader fast = buffered_reader(extended);
+  assert(fast.move_table.size == mt.size);
+  assert(fast.move_table.num_records == mt.num_records);
+
+  void check(const state *s) {
+    int num_slow = 0;
+    int num_fast = 0;
+    move_info *slow = dual_graph_reader_move_infos(&dgr, s, &num_slow);
+    move_info *quick = dual_graph_reader_move_infos(&fast, s, &num_fast);
+    assert(num_slow == num_fast);
+    for (int i = 0; i < num_slow; ++i) {
+      assert(slow[i].coords.x == quick[i].coords.x);
+      assert(slow[i].coords.y == quick[i].coords.y);
+      assert(memcmp(&(slow[i].low_gain), &(quick[i].low_gain), sizeof(float)) == 0);
+      assert(memcmp(&(slow[i].high_gain), &(quick[i].high_gain), sizeof(float)) == 0);
+      assert(slow[i].low_ideal == quick[i].low_ideal);
+      assert(slow[i].high_ideal == quick[i].high_ideal);
+      assert(slow[i].forcing == quick[i].forcing);
+    }
+    free(slow);
+    free(quick);
+  }
+
+  for (size_t key = 0; key < dgr.keyspace._.size; ++key) {
+    state parent = from_compressed_key(&(dgr.keyspace.compressed), key);
+    check(&parent);
+    // States outside the table fall back to evaluating each move
+    for (int j = 0; j < dgr.num_moves; ++j) {
+      state child = parent;
+      if (make_move(&child, dgr.moves[j]) > TAKE_TARGET) {
+        check(&child);
+      }
+    }
+  }
+
+  // Keys past the end of a short table fall back too
+  fast.move_table.size /= 2;
+  for (size_t key = fast.move_table.size; key < dgr.keyspace._.size; ++key) {
+    const state parent = from_compressed_key(&(dgr.keyspace.compressed), key);
+    check(&parent);
+  }
+  fast.move_table.size = mt.size;
+
+  unload_dual_graph_reader(&dgr);
+
+  // Rewriting without a table strips it
+  move_table empty = {0};
+  char *stripped;
+  size_t stripped_size = 0;
+  stream = open_memstream(&stripped, &stripped_size);
+  write_dual_graph_with_move_table(&fast, &empty, stream);
+  fclose(stream);
+  assert(!find_dual_graph_section(stripped, MOVE_IDS_SECTION));
+  assert(!find_dual_graph_section(stripped, MOVE_RECORDS_SECTION));
+  free(stripped);
+
+  free_move_table(&mt);
+  unload_dual_graph_reader(&fast);
+  free(extended);
+  free(buffer);
+}
+
+void test_terminal_table() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+  assert(!dgr.terminal_table.size);
+
+  terminal_table tt = prepare_terminal_table(&dgr, false);
+  assert(tt.size == dgr.keyspace._.size);
+
+  char *extended = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(extended, MEM_FILE_SIZE, "wb");
+  const size_t size = write_dual_graph_with_terminal_table(&dgr, &tt, stream);
+  fclose(stream);
+  assert(validate_dual_graph(extended, size));
+
+  dual_graph_reader fast = buffered_reader(extended);
+  assert(fast.terminal_table.size == tt.size);
+
+  size_t num_resolved = 0;
+  unsigned int max_plies = 0;
+  for (size_t key = 0; key < tt.size; ++key) {
+    const state s = from_compressed_key(&(fast.keyspace.compressed), key);
+    for (int track = LOW_TRACK; track <= HIGH_TRACK; ++track) {
+      const unsigned int plies = tt.steps[key].plies[track];
+      if (plies == UNRESOLVED_PLIES) {
+        continue;
+      }
+      num_resolved++;
+      max_plies = plies > max_plies ? plies : max_plies;
+      assert(plies > 0);
+
+      // Walks are deterministic and end the game regardless of the generator
+      state terminals[2];
+      for (int i = 0; i < 2; ++i) {
+        reader_context ctx = create_reader_context(&fast, 1000 * i + key);
+        if (track == LOW_TRACK) {
+          terminals[i] = dual_graph_reader_low_terminal_r(&fast, &ctx, &s, FORCING);
+        } else {
+          terminals[i] = dual_graph_reader_high_terminal_r(&fast, &ctx, &s, FORCING);
+        }
+        free_reader_context(&ctx);
+      }
+      assert(memcmp(terminals, terminals + 1, sizeof(state)) == 0);
+      assert(terminals[0].passes > 1 || (terminals[0].target & ~(terminals[0].player | terminals[0].opponent)));
+
+      // The stored first move is legal
+      state child = s;
+      const move_result r = make_move(&child, fast.moves[tt.steps[key].moves[track]]);
+      assert(r != ILLEGAL);
+    }
+  }
+  printf("%zu of %zu tracks resolved in at most %u plies\n", num_resolved, 2 * tt.size, max_plies);
+  assert(num_resolved > tt.size);
+
+  // Unresolved origins and plain tactics fall back to the randomized walk
+  const state low = dual_graph_reader_low_terminal(&fast, &root, NONE);
+  assert(low.passes > 1 || (low.target & ~(low.player | low.opponent)));
+
+  // Corrupt steps fall back to the search instead of aborting
+  terminal_step *steps = (terminal_step *)fast.terminal_table.steps;
+  for (size_t key = 0; key < tt.size; ++key) {
+    steps[key].moves[LOW_TRACK] = UINT8_MAX;
+    if (steps[key].plies[HIGH_TRACK] != UNRESOLVED_PLIES) {
+      steps[key].plies[HIGH_TRACK] = 1;
+    }
+  }
+  for (size_t key = 0; key < tt.size; key += 7) {
+    const state s = from_compressed_key(&(fast.keyspace.compressed), key);
+    const state terminals[] = {dual_graph_reader_low_terminal(&fast, &s, FORCING), dual_graph_reader_high_terminal(&fast, &s, FORCING)};
+    for (int i = 0; i < 2; ++i) {
+      assert(terminals[i].passes > 1 || (terminals[i].target & ~(terminals[i].player | terminals[i].opponent)));
+    }
+  }
+
+  free_terminal_table(&tt);
+  unload_dual_graph_reader(&fast);
+  unload_dual_graph_reader(&dgr);
+  free(extended);
+  free(buffer);
+}
+
+void test_hot_table() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+  assert(!dgr.hot_table.num_slots);
+
+  hot_table ht = prepare_hot_table(&dgr, &root, 1, 2);
+  printf("%zu hot keys in %zu slots\n", ht.size, ht.num_slots);
+  assert(ht.size > 1);
+  assert(ht.size < dgr.keyspace._.size);
+  assert(2 * ht.size <= ht.num_slots);
+  dual_table_value v;
+  assert(get_hot_table_value(&ht, dgr.to_key(&dgr, &root), &v));
+
+  char *extended = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(extended, MEM_FILE_SIZE, "wb");
+  const size_t size = write_dual_graph_with_hot_table(&dgr, &ht, stream);
+  fclose(stream);
+  assert(validate_dual_graph(extended, size));
+
+  dual_graph_reader fast = buffered_reader(extended);
+  assert(fast.hot_table.num_slots == ht.num_slots);
+  assert(fast.hot_table.size == ht.size);
+  assert(dual_graph_reader_private_bytes(&fast) > dual_graph_reader_private_bytes(&dgr));
+
+  // Hot values agree with the frozen hash table
+  for (size_t key = 0; key < dgr.keyspace._.size; ++key) {
+    const state s = from_compressed_key(&(dgr.keyspace.compressed), key);
+    const dual_table_value expected = get_dual_graph_reader_table_value(&dgr, &s);
+    const dual_table_value actual = get_dual_graph_reader_table_value(&fast, &s);
+    assert(memcmp(&expected, &actual, sizeof(dual_table_value)) == 0);
+    if (get_hot_table_value(&(fast.hot_table), key, &v)) {
+      const dual_table_value frozen = get_frozen_hash_value(&(dgr.value_table), key);
+      assert(memcmp(&v, &frozen, sizeof(dual_table_value)) == 0);
+    }
+  }
+
+  // The hot table is consulted first
+  for (size_t i = 0; i < fast.hot_table.num_slots; ++i) {
+    if (fast.hot_table.slots[i].key == dgr.to_key(&dgr, &root)) {
+      fast.hot_table.slots[i].value.plain.low = 17;
+    }
+  }
+  assert(get_dual_graph_reader_table_value(&fast, &root).plain.low == 17);
+
+  free_hot_table(&ht);
+  unload_dual_graph_reader(&fast);
+  unload_dual_graph_reader(&dgr);
+  free(extended);
+  free(buffer);
+}
+
+void test_pruned_export() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, BLOCK_IDS, &buffer);
+  const size_t full_size = ((const container_header *)buffer)->file_size;
+  assert(!dgr.value_table.stored_keys);
+
+  // Start a few moves in so that the closure misses part of the keyspace
+  state origin = root;
+  assert(make_move(&origin, single(1, 1)) > TAKE_TARGET);
+  assert(make_move(&origin, single(0, 0)) > TAKE_TARGET);
+
+  char *pruned_buffer = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(pruned_buffer, MEM_FILE_SIZE, "wb");
+  const size_t size = write_pruned_dual_graph(&dgr, &origin, 1, stream);
+  fclose(stream);
+  assert(validate_dual_graph(pruned_buffer, size));
+
+  dual_graph_reader pruned = buffered_reader(pruned_buffer);
+  printf("%zu of %zu keys stored in %zu instead of %zu bytes\n", pruned.value_table.num_stored_keys, dgr.keyspace._.size, size,
+         full_size);
+  assert(pruned.value_table.stored_keys);
+  assert(pruned.value_table.num_stored_keys > 1);
+  assert(pruned.value_table.num_stored_keys < dgr.keyspace._.size);
+  assert(pruned.value_table.id_layout == BLOCK_IDS);
+  assert(!pruned.value_table.stored_keys_sorted);
+  assert(pruned.side_table.size > 0);
+  assert(pruned.side_table.size < dgr.side_table.size);
+  assert(size < full_size);
+
+  // Stored values are unchanged and the rest of the keyspace is unknown
+  size_t num_stored = 0;
+  for (size_t key = 0; key < dgr.keyspace._.size; ++key) {
+    const dual_table_value v = get_frozen_hash_value(&(pruned.value_table), key);
+    const size_t rank = stored_key_rank(&(pruned.value_table), key);
+    if (rank != SIZE_MAX) {
+      assert(rank == num_stored);
+      const dual_table_value expected = get_frozen_hash_value(&(dgr.value_table), key);
+      assert(memcmp(&expected, &v, sizeof(dual_table_value)) == 0);
+      num_stored++;
+    } else {
+      assert(v.plain.low == SCORE_Q7_MIN && v.plain.high == SCORE_Q7_MAX);
+      assert(v.forcing.low == SCORE_Q7_MIN && v.forcing.high == SCORE_Q7_MAX);
+    }
+  }
+  assert(num_stored == pruned.value_table.num_stored_keys);
+
+  // Move and terminal tables of the pruned reader only cover the stored keys
+  move_table mt = prepare_move_table(&pruned);
+  assert(mt.size == pruned.value_table.num_stored_keys);
+  char *moves_buffer = malloc(MEM_FILE_SIZE);
+  stream = fmemopen(moves_buffer, MEM_FILE_SIZE, "wb");
+  const size_t moves_size = write_dual_graph_with_move_table(&pruned, &mt, stream);
+  fclose(stream);
+  free_move_table(&mt);
+  assert(validate_dual_graph(moves_buffer, moves_size));
+  dual_graph_reader with_moves = buffered_reader(moves_buffer);
+  assert(with_moves.move_table.size == pruned.value_table.num_stored_keys);
+
+  terminal_table tt = prepare_terminal_table(&with_moves, false);
+  assert(tt.size == pruned.value_table.num_stored_keys);
+  char *tabled_buffer = malloc(MEM_FILE_SIZE);
+  stream = fmemopen(tabled_buffer, MEM_FILE_SIZE, "wb");
+  const size_t tabled_size = write_dual_graph_with_terminal_table(&with_moves, &tt, stream);
+  fclose(stream);
+  free_terminal_table(&tt);
+  assert(validate_dual_graph(tabled_buffer, tabled_size));
+  dual_graph_reader tabled = buffered_reader(tabled_buffer);
+  assert(tabled.move_table.size == pruned.value_table.num_stored_keys);
+  assert(tabled.terminal_table.size == pruned.value_table.num_stored_keys);
+
+  // Answers agree along random lines of play from the origin
+  srand(7);
+  for (int n = 0; n < 200; ++n) {
+    state s = origin;
+    for (int ply = 0; ply < 30; ++ply) {
+      const dual_table_value expected = get_dual_graph_reader_table_value(&dgr, &s);
+      const dual_table_value actual = get_dual_graph_reader_table_value(&pruned, &s);
+      assert(memcmp(&expected, &actual, sizeof(dual_table_value)) == 0);
+
+      int num_full = 0;
+      move_info *full_infos = dual_graph_reader_move_infos(&dgr, &s, &num_full);
+      const dual_graph_reader *readers[] = {&pruned, &tabled};
+      for (int k = 0; k < 2; ++k) {
+        int num_pruned = 0;
+        move_info *pruned_infos = dual_graph_reader_move_infos(readers[k], &s, &num_pruned);
+        assert(num_full == num_pruned);
+        for (int i = 0; i < num_full; ++i) {
+          assert(full_infos[i].coords.x == pruned_infos[i].coords.x);
+          assert(full_infos[i].coords.y == pruned_infos[i].coords.y);
+          assert(memcmp(&(full_infos[i].low_gain), &(pruned_infos[i].low_gain), sizeof(float)) == 0);
+          assert(memcmp(&(full_infos[i].high_gain), &(pruned_infos[i].high_gain), sizeof(float)) == 0);
+          assert(full_infos[i].low_ideal == pruned_infos[i].low_ideal);
+          assert(full_infos[i].high_ideal == pruned_infos[i].high_ideal);
+          assert(full_infos[i].forcing == pruned_infos[i].forcing);
+        }
+        free(pruned_infos);
+      }
+      free(full_infos);
+
+      // Walks along the stored steps end in a resolved state
+      const state low = dual_graph_reader_low_terminal(&tabled, &s, FORCING);
+      const state high = dual_graph_reader_high_terminal(&tabled, &s, FORCING);
+      assert(low.passes > 1 || (low.target & ~(low.player | low.opponent)));
+      assert(high.passes > 1 || (high.target & ~(high.player | high.opponent)));
+
+      state child = s;
+      if (make_move(&child, dgr.moves[rand() % dgr.num_moves]) <= TAKE_TARGET) {
+        break;
+      }
+      s = child;
+    }
+  }
+
+  unload_dual_graph_reader(&tabled);
+  unload_dual_graph_reader(&with_moves);
+  unload_dual_graph_reader(&pruned);
+  unload_dual_graph_reader(&dgr);
+  free(tabled_buffer);
+  free(moves_buffer);
+  free(pruned_buffer);
+  free(buffer);
+}
+
+void test_pruned_key_list() {
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, PACKED_IDS, &buffer);
+
+  // Close to the end of the game the closure is smaller than the bitmap over the keyspace
+  state origin = root;
+  const stones_t moves[] = {single(1, 1), single(0, 0), single(2, 1), single(0, 1), single(2, 0)};
+  for (size_t i = 0; i < sizeof(moves) / sizeof(stones_t); ++i) {
+    assert(make_move(&origin, moves[i]) > TAKE_TARGET);
+  }
+
+  char *pruned_buffer = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(pruned_buffer, MEM_FILE_SIZE, "wb");
+  const size_t size = write_pruned_dual_graph(&dgr, &origin, 1, stream);
+  fclose(stream);
+  assert(validate_dual_graph(pruned_buffer, size));
+
+  dual_graph_reader pruned = buffered_reader(pruned_buffer);
+  const section_entry *entry = find_dual_graph_section(pruned.directory, STORED_KEY_LIST_SECTION);
+  printf("%zu keys listed in %zu bytes instead of a %zu byte bitmap\n", pruned.value_table.num_stored_keys, (size_t)entry->length,
+         stored_keys_size(dgr.keyspace._.size) * sizeof(uint64_t));
+  assert(pruned.value_table.stored_keys_sorted);
+  assert(!find_dual_graph_section(pruned.directory, STORED_KEYS_SECTION));
+  assert(entry->length < stored_keys_size(dgr.keyspace._.size) * sizeof(uint64_t));
+
+  size_t num_stored = 0;
+  for (size_t key = 0; key < dgr.keyspace._.size; ++key) {
+    const size_t rank = stored_key_rank(&(pruned.value_table), key);
+    if (rank != SIZE_MAX) {
+      assert(rank == num_stored);
+      const dual_table_value expected = get_frozen_hash_value(&(dgr.value_table), key);
+      const dual_table_value v = get_frozen_hash_value(&(pruned.value_table), key);
+      assert(memcmp(&expected, &v, sizeof(dual_table_value)) == 0);
+      num_stored++;
+    }
+  }
+  assert(num_stored == pruned.value_table.num_stored_keys);
+
+  srand(11);
+  for (int n = 0; n < 100; ++n) {
+    state s = origin;
+    for (int ply = 0; ply < 20; ++ply) {
+      const dual_table_value expected = get_dual_graph_reader_table_value(&dgr, &s);
+      const dual_table_value actual = get_dual_graph_reader_table_value(&pruned, &s);
+      assert(memcmp(&expected, &actual, sizeof(dual_table_value)) == 0);
+      state child = s;
+      if (make_move(&child, dgr.moves[rand() % dgr.num_moves]) <= TAKE_TARGET) {
+        break;
+      }
+      s = child;
+    }
+  }
+
+  unload_dual_graph_reader(&pruned);
+  unload_dual_graph_reader(&dgr);
+  free(pruned_buffer);
+  free(buffer);
+}
+
+void test_concurrent_queries() {
+  // Compressed ids exercise the per-context block cache
+  const state root = rectangle_six();
+  char *buffer;
+  dual_graph_reader dgr = solved_reader(&root, COMPRESSED_KEYSPACE, BLOCK_IDS, &buffer);
+  assert(dgr.value_table.id_blocks);
+
+  const size_t size = dgr.keyspace._.size;
+  state *states = malloc(size * sizeof(state));
+  dual_table_value *expected = malloc(size * sizeof(dual_table_value));
+  state *terminals = malloc(size * sizeof(state));
+  for (size_t key = 0; key < size; ++key) {
+    states[key] = from_compressed_key(&(dgr.keyspace.compressed), key);
+    expected[key] = get_dual_graph_reader_table_value(&dgr, states + key);
+    reader_context ctx = create_reader_context(&dgr, key);
+    terminals[key] = dual_graph_reader_low_terminal_r(&dgr, &ctx, states + key, FORCING);
+    free_reader_context(&ctx);
+  }
+
+  size_t num_failures = 0;
+#pragma omp parallel reduction(+ : num_failures)
+  {
+    reader_context ctx = create_reader_context(&dgr, 0);
+#pragma omp for schedule(dynamic, 64)
+    for (size_t j = 0; j < 8 * size; ++j) {
+      // Stride across blocks so that every thread decodes into its own cache
+      const size_t key = (j * 7919) % size;
+      const dual_table_value tv = get_dual_graph_reader_table_value_r(&dgr, &ctx, states + key);
+      num_failures += memcmp(&tv, expected + key, sizeof(dual_table_value)) != 0;
+
+      int num_move_infos = 0;
+      free(dual_graph_reader_move_infos_r(&dgr, &ctx, states + key, &num_move_infos));
+      num_failures += num_move_infos < 1;
+
+      // The walk only depends on the seed of the context
+      reader_context walker = {0};
+      walker.rng = seed_rng(key);
+      walker.id_blocks = ctx.id_blocks;
+      const state terminal = dual_graph_reader_low_terminal_r(&dgr, &walker, states + key, FORCING);
+      num_failures += memcmp(&terminal, terminals + key, sizeof(state)) != 0;
+    }
+    free_reader_context(&ctx);
+  }
+  printf("%zu failures in concurrent queries\n", num_failures);
+  assert(num_failures == 0);
+
+  free(terminals);
+  free(expected);
+  free(states);
+  unload_dual_graph_reader(&dgr);
+  free(buffer);
+}
+
 void test_frozen_hash_table() {
   // There's no natural way to construct frozen hash tables so we mock the game graph and disk round-trip
   dual_graph dg = {0};
@@ -263,17 +927,20 @@ void test_frozen_hash_table() {
 
   assert(num_unique == num_common + num_uncommon + num_rare);
 
-  assert(fht.tail_size == num_unique - (VALUE_MAP_SIZE - 1));
+  printf("%d bit ids, %zu bulk values, %zu tail values\n", fht.id_width, fht.bulk_map_size, fht.tail_size);
+  assert(fht.id_width <= 16);
+  assert(fht.bulk_map_size == VALUE_ID_SENTINEL(fht.id_width));
+  assert(fht.tail_size > 0);
 
   // Mock bulk map
-  fht.bulk_ids = malloc(dg.keyspace._.size * sizeof(value_id_t));
+  fht.bulk_ids = calloc(frozen_ids_size(dg.keyspace._.size, fht.id_width), sizeof(uint64_t));
   for (size_t i = 0; i < dg.keyspace._.size; ++i) {
     dual_table_value v = (dual_table_value){
         dg.plain_values[i],
         dg.forcing_values[i],
     };
     dual_table_value *tv = bsearch(&v, fht.bulk_map, fht.bulk_map_size, sizeof(dual_table_value), compare_dual_table_values);
-    fht.bulk_ids[i] = tv ? (value_id_t)(tv - fht.bulk_map) : VALUE_ID_SENTINEL;
+    set_frozen_hash_id(fht.bulk_ids, fht.id_width, i, tv ? (value_id_t)(tv - fht.bulk_map) : VALUE_ID_SENTINEL(fht.id_width));
   }
 
   // Make sure it works
@@ -289,102 +956,416 @@ void test_frozen_hash_table() {
   free(fht.bulk_ids);
   fht.bulk_ids = NULL;
 
-  const size_t mem_file_size = (MEM_FILE_SIZE + dg.keyspace._.size * sizeof(value_id_t) + fht.bulk_map_size * sizeof(dual_table_value) +
-                                fht.tail_size * sizeof(dual_table_value) + (fht.tail_size / 2) * sizeof(size_t));
+  const size_t mem_file_size =
+      (MEM_FILE_SIZE + frozen_ids_size(dg.keyspace._.size, fht.id_width) * sizeof(uint64_t) +
+       fht.bulk_map_size * sizeof(dual_table_value) + fht.tail_size * sizeof(dual_table_value) +
+       frozen_tail_offsets_size(dg.keyspace._.size, fht.tail_size) * sizeof(size_t));
 
   char *buffer = malloc(mem_file_size);
-  for (size_t i = 0; i < mem_file_size; ++i) {
-    buffer[i] = 1;
-  }
-  FILE *stream = fmemopen(buffer, mem_file_size, "wb");
-  write_dual_graph(&dg, &fht, stream);
-  fclose(stream);
 
-  dual_graph_reader dgr = {0};
-  dgr.fd = -1;
-  dgr.buffer = buffer;
-  unbuffer_dual_graph_reader(&dgr);
+  for (id_layout layout = PACKED_IDS; layout <= BLOCK_IDS; ++layout) {
+    for (size_t i = 0; i < mem_file_size; ++i) {
+      buffer[i] = 1;
+    }
+    fht.id_layout = layout;
+    FILE *stream = fmemopen(buffer, mem_file_size, "wb");
+    write_dual_graph(&dg, &fht, stream);
+    fclose(stream);
+
+    dual_graph_reader dgr = buffered_reader(buffer);
+
+    assert(dgr.value_table.bulk_map_size == fht.bulk_map_size);
+    assert(dgr.value_table.tail_size == fht.tail_size);
+    assert(dgr.value_table.id_layout == layout);
 
-  assert(dgr.value_table.bulk_map_size == fht.bulk_map_size);
-  assert(dgr.value_table.tail_size == fht.tail_size);
+    // Make sure it works after the mock round-trip
+    for (size_t i = 0; i < dg.keyspace._.size; ++i) {
+      dual_table_value v = get_frozen_hash_value(&(dgr.value_table), i);
+      assert(v.plain.low == dg.plain_values[i].low);
+      assert(v.plain.high == dg.plain_values[i].high);
+      assert(v.forcing.low == dg.forcing_values[i].low);
+      assert(v.forcing.high == dg.forcing_values[i].high);
+    }
+    if (layout == BLOCK_IDS) {
+      // Sequential access decodes each block once
+      assert(dgr.value_table.id_blocks->misses == ceil_divz(dg.keyspace._.size, ID_BLOCK_SIZE));
+    }
+
+    unload_dual_graph_reader(&dgr);
+  }
 
   // Free generic mocks
   free(fht.bulk_map);
-  free(fht.tail_keys);
+  free(fht.tail_offsets);
   free(fht.tail_values);
 
-  // Make sure it works after the mock round-trip
-  for (size_t i = 0; i < dg.keyspace._.size; ++i) {
-    dual_table_value v = get_frozen_hash_value(&(dgr.value_table), i);
-    assert(v.plain.low == dg.plain_values[i].low);
-    assert(v.plain.high == dg.plain_values[i].high);
-    assert(v.forcing.low == dg.forcing_values[i].low);
-    assert(v.forcing.high == dg.forcing_values[i].high);
-  }
-
   // Free generic mocks
   free(dg.plain_values);
   free(dg.forcing_values);
-  unload_dual_graph_reader(&dgr);
 
   // Free memory file
   free(buffer);
 }
 
-void test_frozen_hash_table_compact_tail_sizes() {
-  for (size_t tail_size = 1; tail_size <= 8; ++tail_size) {
-    const size_t max_key = 3 * (tail_size - 1) + 1;
-
-    value_id_t *bulk_ids = malloc((max_key + 1) * sizeof(value_id_t));
-    for (size_t i = 0; i <= max_key; ++i) {
-      bulk_ids[i] = VALUE_ID_SENTINEL;
+void test_packed_ids() {
+  const size_t size = 1000;
+  value_id_t *ids = malloc(size * sizeof(value_id_t));
+  for (int width = 1; width <= 16; ++width) {
+    uint64_t *bulk_ids = calloc(frozen_ids_size(size, width), sizeof(uint64_t));
+    frozen_hash_table fht = {.id_width = width, .bulk_ids = bulk_ids};
+    // Write twice to make sure stale bits are cleared
+    for (int pass = 0; pass < 2; ++pass) {
+      for (size_t i = 0; i < size; ++i) {
+        ids[i] = (value_id_t)((i * 2654435761ULL + pass * 40503ULL) >> 7) & VALUE_ID_SENTINEL(width);
+        set_frozen_hash_id(bulk_ids, width, i, ids[i]);
+      }
+    }
+    for (size_t i = 0; i < size; ++i) {
+      assert(get_frozen_hash_id(&fht, i) == ids[i]);
     }
+    free(bulk_ids);
+  }
+  free(ids);
+}
 
-    dual_table_value *tail_values = malloc(tail_size * sizeof(dual_table_value));
-    size_t *full_tail_keys = malloc(tail_size * sizeof(size_t));
-    for (size_t i = 0; i < tail_size; ++i) {
-      full_tail_keys[i] = 3 * i + 1;
-      tail_values[i].plain.low = (score_q7_t)(10 + i);
-      tail_values[i].plain.high = (score_q7_t)(20 + i);
-      tail_values[i].forcing.low = (score_q7_t)(30 + i);
-      tail_values[i].forcing.high = (score_q7_t)(40 + i);
+void test_frozen_hash_table_tail_buckets() {
+  for (size_t stride = 1; stride <= 8; ++stride) {
+    const size_t size = 3 * TAIL_BUCKET_SIZE + stride;
+    const int width = (int)stride + 1;
+    const value_id_t sentinel = VALUE_ID_SENTINEL(width);
+
+    // Every stride'th key plus a few clustered at the ends of buckets falls through to the tail
+    uint64_t *bulk_ids = calloc(frozen_ids_size(size, width), sizeof(uint64_t));
+    size_t tail_size = 0;
+    bool in_tail(size_t i) { return (i % stride == 0) || (i % TAIL_BUCKET_SIZE >= TAIL_BUCKET_SIZE - 2); }
+    for (size_t i = 0; i < size; ++i) {
+      set_frozen_hash_id(bulk_ids, width, i, in_tail(i) ? sentinel : 0);
+      tail_size += in_tail(i);
     }
 
-    const size_t compact_tail_keys_size = tail_size / 2;
-    size_t *compact_tail_keys = compact_tail_keys_size ? malloc(compact_tail_keys_size * sizeof(size_t)) : NULL;
-    for (size_t i = 0; i < compact_tail_keys_size; ++i) {
-      compact_tail_keys[i] = full_tail_keys[2 * i + 1];
+    dual_table_value bulk_value = {{1, 2}, {3, 4}};
+    dual_table_value *tail_values = malloc(tail_size * sizeof(dual_table_value));
+    size_t *tail_offsets = malloc(frozen_tail_offsets_size(size, tail_size) * sizeof(size_t));
+    size_t j = 0;
+    for (size_t i = 0; i < size; ++i) {
+      if (i % TAIL_BUCKET_SIZE == 0) {
+        tail_offsets[i / TAIL_BUCKET_SIZE] = j;
+      }
+      if (in_tail(i)) {
+        tail_values[j].plain.low = (score_q7_t)(i % 100);
+        tail_values[j].plain.high = (score_q7_t)(i / 100);
+        tail_values[j].forcing.low = (score_q7_t)(-(int)(i % 100));
+        tail_values[j].forcing.high = (score_q7_t)stride;
+        j++;
+      }
     }
+    assert(j == tail_size);
 
     frozen_hash_table fht = {
-        .bulk_map_size = 0,
-        .bulk_map = NULL,
+        .bulk_map_size = 1,
+        .bulk_map = &bulk_value,
+        .id_width = width,
         .bulk_ids = bulk_ids,
         .tail_size = tail_size,
         .tail_values = tail_values,
-        .tail_keys = compact_tail_keys,
+        .tail_offsets = tail_offsets,
     };
 
-    for (size_t i = 0; i < tail_size; ++i) {
-      const size_t key = full_tail_keys[i];
-      dual_table_value v = get_frozen_hash_value(&fht, key);
-      assert(v.plain.low == tail_values[i].plain.low);
-      assert(v.plain.high == tail_values[i].plain.high);
-      assert(v.forcing.low == tail_values[i].forcing.low);
-      assert(v.forcing.high == tail_values[i].forcing.high);
+    for (size_t i = 0; i < size; ++i) {
+      assert(get_frozen_hash_id(&fht, i) == (in_tail(i) ? sentinel : 0));
+      dual_table_value v = get_frozen_hash_value(&fht, i);
+      if (in_tail(i)) {
+        assert(v.plain.low == (score_q7_t)(i % 100));
+        assert(v.plain.high == (score_q7_t)(i / 100));
+        assert(v.forcing.low == (score_q7_t)(-(int)(i % 100)));
+        assert(v.forcing.high == (score_q7_t)stride);
+      } else {
+        assert(v.plain.low == 1);
+        assert(v.forcing.high == 4);
+      }
     }
 
-    free(compact_tail_keys);
-    free(full_tail_keys);
+    free(tail_offsets);
     free(tail_values);
     free(bulk_ids);
   }
 }
 
+void test_symmetric_keyspace() {
+  state root = {0};
+  root.visual_area = rectangle(3, 3);
+  root.logical_area = root.visual_area;
+  char *buffers[2];
+  dual_graph_reader dgrs[2];
+  for (int i = 0; i < 2; ++i) {
+    dgrs[i] = solved_reader(&root, i ? SYMMETRIC_KEYSPACE : COMPRESSED_KEYSPACE, PACKED_IDS, buffers + i);
+  }
+  const size_t mem_file_size = ((const container_header *)buffers[1])->file_size;
+  assert(dgrs[1].type == SYMMETRIC_KEYSPACE);
+
+  // Keyspace tables are used in place at their serialized alignment
+  const symmetry *sym = &(dgrs[1].keyspace.symmetric.symmetry);
+  const char *core_map = (const char *)sym->core_map;
+  assert(core_map > buffers[1] && core_map < buffers[1] + mem_file_size);
+  assert((core_map - buffers[1]) % TABLE_ALIGNMENT == 0);
+  const char *tritters = (const char *)dgrs[0].keyspace.compressed.keyspace.tritters;
+  assert(tritters > buffers[0] && tritters < buffers[0] + mem_file_size);
+  assert((tritters - buffers[0]) % TABLE_ALIGNMENT == 0);
+
+  for (size_t key = 0; key < dgrs[0].keyspace._.size; ++key) {
+    const state s = from_compressed_key(&(dgrs[0].keyspace.compressed), key);
+    const dual_value cv = get_dual_graph_reader_value(dgrs, &s);
+    const dual_value sv = get_dual_graph_reader_value(dgrs + 1, &s);
+    assert(is_reader_state(dgrs, &s));
+    assert(is_reader_state(dgrs + 1, &s));
+    assert(cv.plain.low == sv.plain.low);
+    assert(cv.plain.high == sv.plain.high);
+    assert(cv.forcing.low == sv.forcing.low);
+    assert(cv.forcing.high == sv.forcing.high);
+  }
+
+  // Ko points are mirrored along with the stones of the canonical orientation
+  printf("%zu entries in the symmetric side table\n", dgrs[1].side_table.size);
+  assert(dgrs[1].side_table.size > 0);
+  assert(dgrs[1].side_table.size < dgrs[0].side_table.size);
+  dual_graph_reader bare = dgrs[1];
+  bare.side_table.num_slots = 0;
+  size_t num_ko = 0;
+  for (size_t key = 0; key < dgrs[0].keyspace._.size; ++key) {
+    const state parent = from_compressed_key(&(dgrs[0].keyspace.compressed), key);
+    for (int j = 0; j < dgrs[0].num_moves; ++j) {
+      state child = parent;
+      const move_result r = make_move(&child, dgrs[0].moves[j]);
+      if (r <= TAKE_TARGET || child.passes || !child.ko) {
+        continue;
+      }
+      dual_table_value sv;
+      assert(get_side_table_value(&(dgrs[1].side_table), side_key(SYMMETRIC_KEYSPACE, &(dgrs[1].keyspace._), &child), &sv));
+      const dual_table_value cv = get_dual_graph_reader_table_value(dgrs, &child);
+      const dual_table_value bv = get_dual_graph_reader_table_value(&bare, &child);
+      assert(memcmp(&sv, &cv, sizeof(dual_table_value)) == 0);
+      assert(memcmp(&sv, &bv, sizeof(dual_table_value)) == 0);
+      num_ko++;
+    }
+  }
+  assert(num_ko > dgrs[1].side_table.size);
+
+  for (int i = 0; i < 2; ++i) {
+    unload_dual_graph_reader(dgrs + i);
+    free(buffers[i]);
+  }
+}
+
+void test_container() {
+  const state root = bulky_five();
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+
+  char *buffer = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(buffer, MEM_FILE_SIZE, "wb");
+  const size_t size = write_dual_graph(&dg, &fht, stream);
+  fclose(stream);
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  free_dual_graph(&dg);
+
+  assert(validate_dual_graph(buffer, size));
+  assert(!validate_dual_graph(buffer, size - 1));
+
+  container_header header;
+  memcpy(&header, buffer, sizeof(container_header));
+  printf("%u sections in %zu bytes\n", header.num_sections, size);
+  for (section_type type = METADATA_SECTION; type <= SIDE_VALUES_SECTION; ++type) {
+    const section_entry *entry = find_dual_graph_section(buffer, type);
+    if (type == ID_BLOCK_OFFSETS_SECTION || type == ID_BLOCKS_SECTION) {
+      assert(!entry);
+      continue;
+    }
+    assert(entry);
+    assert(entry->offset % TABLE_ALIGNMENT == 0);
+    assert(entry->offset + entry->length <= size);
+  }
+
+  // Corrupted directory
+  section_entry *entries = (section_entry *)(buffer + sizeof(container_header));
+  entries[1].offset += 8;
+  assert(!validate_dual_graph(buffer, size));
+  entries[1].offset -= 8;
+  entries[1].length = size;
+  assert(!validate_dual_graph(buffer, size));
+
+  free(buffer);
+}
+
+// Serialize in the layout of version 5 with 16-bit ids and the last `num_tail` bulk values moved to the tail
+static size_t write_dual_graph_v5(const dual_graph *dg, const frozen_hash_table *fht, size_t num_tail, FILE *stream) {
+  size_t total = 0;
+  const int version = 5;
+  WRITE_FIELD(total, stream, version);
+  WRITE_FIELD(total, stream, dg->type);
+  WRITE_FIELD(total, stream, dg->keyspace._.size);
+  WRITE_FIELD(total, stream, dg->keyspace._.fast_size);
+  WRITE_FIELD(total, stream, dg->keyspace._.prefix_m);
+  WRITE_FIELD(total, stream, dg->keyspace._.root);
+  const monotonic_compressor *comp = &(dg->keyspace._.compressor);
+  WRITE_FIELD(total, stream, comp->num_checkpoints);
+  WRITE_ARRAY(total, stream, comp->checkpoints, comp->num_checkpoints);
+  WRITE_FIELD(total, stream, comp->uncompressed_size);
+  WRITE_ARRAY(total, stream, comp->deltas, comp->uncompressed_size);
+  WRITE_FIELD(total, stream, comp->size);
+  WRITE_FIELD(total, stream, comp->factor);
+  WRITE_FIELD(total, stream, dg->num_moves);
+  WRITE_ARRAY(total, stream, dg->moves, dg->num_moves);
+
+  const size_t bulk_map_size = fht->bulk_map_size - num_tail;
+  dual_table_value *tail_values = malloc(dg->keyspace._.size * sizeof(dual_table_value));
+  size_t *tail_keys = malloc(dg->keyspace._.size * sizeof(size_t));
+  size_t tail_size = 0;
+  for (size_t i = 0; i < dg->keyspace._.size; ++i) {
+    const dual_table_value v = {dg->plain_values[i], dg->forcing_values[i]};
+    dual_table_value *tv = bsearch(&v, fht->bulk_map, bulk_map_size, sizeof(dual_table_value), compare_dual_table_values);
+    const value_id_t vid = tv ? (value_id_t)(tv - fht->bulk_map) : (value_id_t)-1;
+    WRITE_FIELD(total, stream, vid);
+    if (!tv) {
+      if (tail_size % 2) {
+        tail_keys[tail_size / 2] = i;
+      }
+      tail_values[tail_size++] = v;
+    }
+  }
+  WRITE_FIELD(total, stream, bulk_map_size);
+  WRITE_ARRAY(total, stream, fht->bulk_map, bulk_map_size);
+  WRITE_FIELD(total, stream, tail_size);
+  WRITE_ARRAY(total, stream, tail_values, tail_size);
+  WRITE_ARRAY(total, stream, tail_keys, tail_size / 2);
+  free(tail_keys);
+  free(tail_values);
+  return total;
+}
+
+void test_convert_v5() {
+  const state root = rectangle_six();
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+  while (area_iterate_dual_graph(&dg, false))
+    ;
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+
+  char *buffers[3];
+  for (int i = 0; i < 3; ++i) {
+    buffers[i] = malloc(MEM_FILE_SIZE);
+  }
+  FILE *stream = fmemopen(buffers[0], MEM_FILE_SIZE, "wb");
+  write_dual_graph(&dg, &fht, stream);
+  fclose(stream);
+
+  stream = fmemopen(buffers[1], MEM_FILE_SIZE, "wb");
+  write_dual_graph_v5(&dg, &fht, 5, stream);
+  fclose(stream);
+
+  stream = fmemopen(buffers[2], MEM_FILE_SIZE, "wb");
+  convert_dual_graph_v5(buffers[1], stream);
+  fclose(stream);
+
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  free_dual_graph(&dg);
+
+  dual_graph_reader dgrs[2];
+  for (int i = 0; i < 2; ++i) {
+    dgrs[i] = buffered_reader(buffers[2 * i]);
+  }
+  printf("%zu tail values after conversion\n", dgrs[1].value_table.tail_size);
+  assert(dgrs[1].value_table.tail_size > 0);
+  assert(dgrs[1].side_table.size == 0);
+
+  for (size_t key = 0; key < dgrs[0].keyspace._.size; ++key) {
+    const state s = from_compressed_key(&(dgrs[0].keyspace.compressed), key);
+    const dual_value a = get_dual_graph_reader_value(dgrs, &s);
+    const dual_value b = get_dual_graph_reader_value(dgrs + 1, &s);
+    assert(a.plain.low == b.plain.low);
+    assert(a.plain.high == b.plain.high);
+    assert(a.forcing.low == b.forcing.low);
+    assert(a.forcing.high == b.forcing.high);
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    unload_dual_graph_reader(dgrs + i);
+  }
+  for (int i = 0; i < 3; ++i) {
+    free(buffers[i]);
+  }
+}
+
+void test_residency_policies() {
+  const state root = bulky_five();
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+
+  char filename[] = "/tmp/test_dual_reader_XXXXXX";
+  const int fd = mkstemp(filename);
+  assert(fd != -1);
+  FILE *stream = fdopen(fd, "wb");
+  write_dual_graph(&dg, &fht, stream);
+  fclose(stream);
+
+  for (residency_policy policy = RANDOM_RESIDENCY; policy <= HUGE_PAGE_RESIDENCY; ++policy) {
+    dual_graph_reader dgr = load_dual_graph_reader_with_policy(filename, policy);
+    const value v = get_dual_graph_value(&dg, &root, FORCING);
+    const dual_value dv = get_dual_graph_reader_value(&dgr, &root);
+    assert(v.low == dv.forcing.low);
+    assert(v.high == dv.forcing.high);
+
+    section_residency residency[NUM_SECTION_TYPES];
+    get_dual_graph_residency(&dgr, residency);
+    assert(residency[BULK_IDS_SECTION].num_pages > 0);
+    assert(residency[ID_BLOCKS_SECTION].num_pages == 0);
+    if (policy == POPULATE_RESIDENCY || policy == LOCKED_RESIDENCY) {
+      printf("Policy %d:\n", policy);
+      print_dual_graph_residency(&dgr);
+      for (section_type type = 0; type < NUM_SECTION_TYPES; ++type) {
+        if (policy == POPULATE_RESIDENCY || type == KEYSPACE_SECTION) {
+          assert(residency[type].num_resident == residency[type].num_pages);
+        }
+      }
+    }
+    unload_dual_graph_reader(&dgr);
+  }
+
+  unlink(filename);
+  free(fht.bulk_map);
+  free(fht.tail_values);
+  free(fht.tail_offsets);
+  free_dual_graph(&dg);
+}
+
 int main() {
   test_bulky_five();
   test_external_liberties();
+  test_solver_agreement();
+  test_reader_states();
+  test_move_table();
+  test_terminal_table();
+  test_hot_table();
+  test_pruned_export();
+  test_pruned_key_list();
+  test_concurrent_queries();
   test_frozen_hash_table();
-  test_frozen_hash_table_compact_tail_sizes();
+  test_packed_ids();
+  test_frozen_hash_table_tail_buckets();
+  test_symmetric_keyspace();
+  test_container();
+  test_convert_v5();
+  test_residency_policies();
   return 0;
 }
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 state bulky_five() {
   state s = {0};
@@ -151,6 +152,72 @@ void test_bent_four_in_the_corner_is_dead() {
   free_dual_graph(&dg);
 }
 
+void test_bent_four_in_the_corner_symmetric() {
+  const state root = bent_four_in_the_corner_is_dead();
+  dual_graph cdg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  dual_graph sdg = create_dual_graph(&root, SYMMETRIC_KEYSPACE);
+  printf("%zu compressed vs. %zu symmetric keys\n", cdg.keyspace._.size, sdg.keyspace._.size);
+  assert(sdg.keyspace._.size < cdg.keyspace._.size);
+
+  while (iterate_dual_graph(&cdg, false))
+    ;
+  while (iterate_dual_graph(&sdg, false))
+    ;
+
+  for (size_t key = 0; key < cdg.keyspace._.size; ++key) {
+    const state s = from_compressed_key(&(cdg.keyspace.compressed), key);
+    value cv = get_dual_graph_value(&cdg, &s, NONE);
+    value sv = get_dual_graph_value(&sdg, &s, NONE);
+    assert(cv.low == sv.low);
+    assert(cv.high == sv.high);
+    cv = get_dual_graph_value(&cdg, &s, FORCING);
+    sv = get_dual_graph_value(&sdg, &s, FORCING);
+    assert(cv.low == sv.low);
+    assert(cv.high == sv.high);
+  }
+
+  free_dual_graph(&cdg);
+  free_dual_graph(&sdg);
+}
+
+void test_side_table() {
+  const state root = bent_four_in_the_corner_is_dead();
+  for (keyspace_type type = COMPRESSED_KEYSPACE; type <= SYMMETRIC_KEYSPACE; ++type) {
+    dual_graph dg = create_dual_graph(&root, type);
+    dual_graph sdg = create_dual_graph(&root, type);
+    sdg.side_table = create_side_table(&sdg);
+    printf("%zu side entries in %zu slots\n", sdg.side_table.size, sdg.side_table.num_slots);
+    assert(sdg.side_table.size > 0);
+    assert(4 * sdg.side_table.size <= 3 * sdg.side_table.num_slots);
+
+    for (size_t i = 0; i < sdg.side_table.num_slots; ++i) {
+      const size_t key = sdg.side_table.keys[i];
+      if (key != SIDE_EMPTY_KEY) {
+        const state s = from_side_key(type, &(sdg.keyspace._), key);
+        assert(side_key(type, &(sdg.keyspace._), &s) == key);
+        assert(!s.passes);
+        assert(s.ko || sdg.in_atari(&s));
+      }
+    }
+
+    // Sweeps reading the side table converge to the same values
+    while (iterate_dual_graph(&dg, false))
+      ;
+    while (iterate_dual_graph(&sdg, false))
+      ;
+    assert(memcmp(dg.plain_values, sdg.plain_values, dg.keyspace._.size * sizeof(table_value)) == 0);
+    assert(memcmp(dg.forcing_values, sdg.forcing_values, dg.keyspace._.size * sizeof(table_value)) == 0);
+    while (area_iterate_dual_graph(&dg, false))
+      ;
+    while (area_iterate_dual_graph(&sdg, false))
+      ;
+    assert(memcmp(dg.plain_values, sdg.plain_values, dg.keyspace._.size * sizeof(table_value)) == 0);
+
+    free_dual_graph(&dg);
+    free_dual_graph(&sdg);
+  }
+}
+
 void test_bent_four_in_the_might_be_seki() {
   const state root = bent_four_in_the_corner_might_be_seki();
   bool did_change;
@@ -281,6 +348,8 @@ void test_seki() {
 int main() {
   test_bulky_five();
   test_bent_four_in_the_corner_is_dead();
+  test_bent_four_in_the_corner_symmetric();
+  test_side_table();
   test_bent_four_in_the_might_be_seki();
   test_dead_three();
   test_no_moves_terminals();
@@ -0,0 +1,230 @@
+#include "tinytsumego2/json_api.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void check_float(double x, const char *expected) {
+  char *buffer = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&buffer, &length);
+  write_json_float(stream, x);
+  fclose(stream);
+  if (strcmp(buffer, expected)) {
+    printf("%.17g formatted as %s instead of %s\n", x, buffer, expected);
+  }
+  assert(strcmp(buffer, expected) == 0);
+  free(buffer);
+}
+
+// Expected outputs are from Python's json.dumps()
+void test_floats() {
+  check_float(0.1, "0.1");
+  check_float(1, "1.0");
+  check_float(-2.5, "-2.5");
+  check_float(1e16, "1e+16");
+  check_float(1e15, "1000000000000000.0");
+  check_float(0.0001, "0.0001");
+  check_float(0.00001, "1e-05");
+  check_float(123456789.125, "123456789.125");
+  check_float(INFINITY, "Infinity");
+  check_float(-INFINITY, "-Infinity");
+  check_float(-0.0, "-0.0");
+  check_float(1.5e-7, "1.5e-07");
+  check_float(1e22, "1e+22");
+  check_float(3.0000001, "3.0000001");
+  check_float(0.1f, "0.10000000149011612");
+}
+
+void test_strings() {
+  char *buffer = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&buffer, &length);
+  write_json_string(stream, "\xc3\xa9\"\\\n\x01\xf0\x9f\x98\x80 ok");
+  fclose(stream);
+  assert(strcmp(buffer, "\"\\u00e9\\\"\\\\\\n\\u0001\\ud83d\\ude00 ok\"") == 0);
+  free(buffer);
+}
+
+void test_documents() {
+  move_info infos[2] = {
+      {{1, 2}, 0.5, -1, true, false, false},
+      {{0, 3}, 0, 0.25, false, true, true},
+  };
+  char *buffer = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&buffer, &length);
+  write_move_infos_json(stream, infos, 2);
+  fclose(stream);
+  assert(strcmp(buffer, "{\"moves\": [{\"x\": 1, \"y\": 2, \"lowGain\": 0.5, \"highGain\": -1.0, \"lowIdeal\": true, \"highIdeal\": "
+                        "false, \"forcing\": false}, {\"x\": 0, \"y\": 3, \"lowGain\": 0.0, \"highGain\": 0.25, \"lowIdeal\": "
+                        "false, \"highIdeal\": true, \"forcing\": true}]}") == 0);
+  free(buffer);
+
+  stream = open_memstream(&buffer, &length);
+  write_move_infos_json(stream, infos, 0);
+  fclose(stream);
+  assert(strcmp(buffer, "{\"moves\": []}") == 0);
+  free(buffer);
+
+  stream = open_memstream(&buffer, &length);
+  write_dead_stones_json(stream, single(1, 0) | single(2, 1), false);
+  fclose(stream);
+  assert(strcmp(buffer, "{\"deadStones\": [2, 4]}") == 0);
+  free(buffer);
+
+  stream = open_memstream(&buffer, &length);
+  write_error_json(stream, "Collection nope not found");
+  fclose(stream);
+  assert(strcmp(buffer, "{\"error\": \"Collection nope not found\"}") == 0);
+  free(buffer);
+}
+
+void test_round_trip() {
+  size_t num_collections;
+  collection *cs = get_collections(&num_collections);
+
+  char *buffer = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&buffer, &length);
+  write_collections_json(stream, cs, 2, true);
+  fclose(stream);
+  assert(strncmp(buffer, "{\"collections\": [{\"slug\": \"rectangle-six\", \"tsumegos\": [\"no-liberties\", ", 71) == 0);
+  free(buffer);
+
+  for (size_t i = 0; i < num_collections; ++i) {
+    for (size_t j = 0; j < cs[i].num_tsumegos; ++j) {
+      state s = cs[i].tsumegos[j].state;
+      s.passes = 1;
+      s.button = -1;
+      s.white_to_play = true;
+      s.wide = cs[i].root.wide;
+
+      char *buffer = NULL;
+      size_t length = 0;
+      FILE *stream = open_memstream(&buffer, &length);
+      fputs("{\"state\": ", stream);
+      write_state_json(stream, &s);
+      fputc('}', stream);
+      fclose(stream);
+
+      state parsed;
+      assert(parse_move_request(buffer, length, s.wide, &parsed) == MOVE_REQUEST_OK);
+      assert(equals(&s, &parsed));
+      assert(parsed.wide == s.wide);
+      assert(parsed.white_to_play);
+      free(buffer);
+    }
+
+    // Documents of the collection are valid JSON
+    stream = open_memstream(&buffer, &length);
+    write_collection_json(stream, cs + i);
+    fclose(stream);
+    state dummy;
+    assert(parse_move_request(buffer, length, false, &dummy) == MISSING_STATE);
+    free(buffer);
+    free(cs[i].tsumegos);
+  }
+
+  free(cs);
+}
+
+void test_requests() {
+  const char *format = "%s{\"state\": {\"visualArea\": [], \"logicalArea\": [], \"player\": %s, \"opponent\": [], \"ko\": [], "
+                       "\"target\": [], \"immortal\": [], \"external\": [], \"passes\": 0, \"koThreats\": 0, \"button\": %s, "
+                       "\"whiteToPlay\": %s}%s";
+  state s;
+  char body[1024];
+  move_request_status parse(const char *prefix, const char *player, const char *button, const char *white_to_play,
+                            const char *suffix) {
+    sprintf(body, format, prefix, player, button, white_to_play, suffix);
+    return parse_move_request(body, strlen(body), false, &s);
+  }
+  move_request_status parse_raw(const char *raw) { return parse_move_request(raw, strlen(raw), false, &s); }
+
+  assert(parse(" ", "[]", "0", "false", "} \n") == MOVE_REQUEST_OK);
+  assert(!s.visual_area && !s.player && !s.passes && !s.white_to_play);
+
+  assert(parse("", "[]", "0", "false", "") == MALFORMED_JSON);
+  assert(parse("", "[]", "0", "false", "} x") == MALFORMED_JSON);
+  assert(parse("", "[1 2]", "0", "false", "}") == MALFORMED_JSON);
+  assert(parse_raw("") == MALFORMED_JSON);
+  assert(parse_raw("{\"state\": [1, 2,]}") == MALFORMED_JSON);
+  assert(parse_raw("{\"state\": \"\x01\"}") == MALFORMED_JSON);
+  assert(parse_raw("{\"state\": 01}") == MALFORMED_JSON);
+
+  assert(parse_raw("{}") == MISSING_STATE);
+  assert(parse_raw("[\"state\"]") == MISSING_STATE);
+  assert(parse_raw("{\"states\": {}}") == MISSING_STATE);
+
+  assert(parse_raw("{\"state\": 1}") == INVALID_STATE);
+  assert(parse_raw("{\"state\": {}}") == INVALID_STATE);
+  assert(parse("", "{}", "0", "false", "}") == INVALID_STATE);
+  assert(parse("", "[0.5]", "0", "false", "}") == INVALID_STATE);
+  assert(parse("", "[]", "\"0\"", "false", "}") == INVALID_STATE);
+
+  // Later members win, rows mask to the board width and booleans count as integers
+  assert(parse("", "[]", "0", "false", ", \"state\": null}") == INVALID_STATE);
+  assert(parse("{\"state\": null, \"x\": ", "[]", "0", "false", "}, \"state\": null}") == INVALID_STATE);
+  assert(parse("", "[1, 1025, true ]", "1", "1", "}") == MOVE_REQUEST_OK);
+  assert(s.player == (1ULL | (1ULL << V_SHIFT) | (1ULL << (2 * V_SHIFT))));
+  assert(s.button == 1);
+  assert(s.white_to_play);
+  assert(parse("", "[-1]", "-2", "0", "}") == MOVE_REQUEST_OK);
+  assert(s.player == NORTH_WALL);
+  assert(s.button == -2);
+  assert(!s.white_to_play);
+}
+
+void test_addresses() {
+  size_t num_collections;
+  collection *cs = get_collections(&num_collections);
+
+  char address[STATE_ADDRESS_SIZE];
+  state parsed;
+  for (size_t i = 0; i < num_collections; ++i) {
+    for (size_t j = 0; j < cs[i].num_tsumegos; ++j) {
+      state s = cs[i].tsumegos[j].state;
+      s.passes = 1;
+      s.ko_threats = -1;
+      s.button = j % 2;
+      s.white_to_play = true;
+      s.wide = cs[i].root.wide;
+      format_state_address(&s, address);
+      assert(strspn(address, "0123456789abcdef_-") == strlen(address));
+      assert(parse_state_address(address, strlen(address), s.wide, &parsed));
+      assert(equals(&s, &parsed));
+      assert(parsed.wide == s.wide);
+      assert(parsed.white_to_play);
+    }
+    free(cs[i].tsumegos);
+  }
+  free(cs);
+
+  state s = {0};
+  s.player = 0xff;
+  s.button = -1;
+  format_state_address(&s, address);
+  assert(strcmp(address, "0_0_ff_0_0_0_0_0_0_0_-1_0") == 0);
+
+  // Only the canonical spelling is accepted and the length bounds the address
+  assert(parse_state_address(address, strlen(address), false, &parsed));
+  assert(parse_state_address("0_0_ff_0_0_0_0_0_0_0_-1_0_", 25, false, &parsed));
+  assert(!parse_state_address("0_0_ff_0_0_0_0_0_0_0_-1_0_", 26, false, &parsed));
+  assert(!parse_state_address("0_0_0ff_0_0_0_0_0_0_0_-1_0", 26, false, &parsed));
+  assert(!parse_state_address("0_0_FF_0_0_0_0_0_0_0_-1_0", 25, false, &parsed));
+  assert(!parse_state_address("0_0_ff_0_0_0_0_0_0_0_-1_2", 25, false, &parsed));
+  assert(!parse_state_address("0_0_ff_0_0_0_0_0_0_0_-1", 23, false, &parsed));
+  assert(!parse_state_address("", 0, false, &parsed));
+}
+
+int main() {
+  test_floats();
+  test_strings();
+  test_documents();
+  test_round_trip();
+  test_requests();
+  test_addresses();
+  return 0;
+}
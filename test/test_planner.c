@@ -0,0 +1,119 @@
+#include "jkiss/jkiss.h"
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/keyspace.h"
+#include "tinytsumego2/planner.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+void test_rectangle() {
+  state root = {0};
+  root.visual_area = rectangle(3, 4);
+  root.logical_area = root.visual_area;
+
+  planner_options options = default_planner_options();
+  options.ram_budget = 1ULL << 30;
+  keyspace_plan plan = plan_keyspace(&root, &options);
+  print_keyspace_plan(&plan);
+
+  const keyspace_estimate *c = plan.estimates + COMPRESSED_KEYSPACE;
+  const keyspace_estimate *s = plan.estimates + SYMMETRIC_KEYSPACE;
+  assert(c->supported);
+  assert(s->supported);
+  assert(c->raw_size == tight_keyspace_size(&root, true));
+  assert(c->legal_density > 0 && c->legal_density <= 1);
+  assert(s->legal_density > 0 && s->legal_density <= 1);
+  assert(s->raw_size < c->raw_size);
+
+  // Orbits undercount the keys of the reduced core a little
+  symmetric_keyspace sks = create_symmetric_keyspace(&root);
+  assert(s->raw_size <= sks.fast_size);
+  assert(s->raw_size > 0.95 * sks.fast_size);
+  printf("%zu estimated vs. %zu actual\n", s->num_nodes, sks.size);
+  assert(fabs((double)s->num_nodes / sks.size - 1) < 0.1);
+
+  // Table sizes are estimated without building the tables
+  char *buffer = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&buffer, &length);
+  const size_t symmetry_bytes = sizeof(sks.color_m) + write_symmetry(&(sks.symmetry), sizeof(sks.color_m), stream);
+  fclose(stream);
+  free(buffer);
+  printf("%zu estimated vs. %zu actual symmetry bytes\n", estimate_symmetry_bytes(&root), symmetry_bytes);
+  assert(fabs((double)s->keyspace_bytes / symmetry_bytes - 1) < 0.2);
+  free_symmetric_keyspace(&sks);
+
+  tight_keyspace tks = create_tight_keyspace(&root, true);
+  stream = open_memstream(&buffer, &length);
+  const size_t tight_bytes = write_tight_keyspace(&tks, 0, stream);
+  fclose(stream);
+  free(buffer);
+  printf("%zu estimated vs. %zu actual tight keyspace bytes\n", tight_keyspace_bytes(&root, true), tight_bytes);
+  assert(fabs((double)tight_keyspace_bytes(&root, true) / tight_bytes - 1) < 0.1);
+  free_tight_keyspace(&tks);
+
+  // Compressed keyspaces carry the optional tables, symmetric ones do not
+  assert(c->keyspace_bytes > 0 && s->keyspace_bytes > 0);
+  assert(c->side_bytes > 0);
+  assert(c->terminal_table_bytes == c->num_nodes * sizeof(terminal_step));
+  assert(c->move_table_bytes > c->num_nodes * sizeof(uint32_t));
+  assert(!s->side_bytes && !s->move_table_bytes && !s->terminal_table_bytes);
+  assert(c->packed_id_bytes < c->num_nodes * sizeof(value_id_t));
+  assert(c->block_id_bytes > c->packed_id_bytes);
+  assert(c->reader_bytes == c->keyspace_bytes + c->packed_id_bytes + c->side_bytes);
+
+  assert(plan.fits);
+  assert(plan.choice == SYMMETRIC_KEYSPACE);
+  assert(s->sweep_cost < c->sweep_cost);
+
+  // Estimates other than timings are reproducible
+  keyspace_plan again = plan_keyspace(&root, &options);
+  for (int i = 0; i < MOCK_KEYSPACE; ++i) {
+    assert(again.estimates[i].num_nodes == plan.estimates[i].num_nodes);
+    assert(again.estimates[i].sweep_cost == plan.estimates[i].sweep_cost);
+    assert(again.estimates[i].reader_bytes == plan.estimates[i].reader_bytes);
+  }
+  assert(again.choice == plan.choice);
+
+  // Expensive symmetric nodes tip the choice
+  options.node_costs[SYMMETRIC_KEYSPACE] = 100;
+  plan = plan_keyspace(&root, &options);
+  assert(plan.fits);
+  assert(plan.choice == COMPRESSED_KEYSPACE);
+  assert(plan.estimates[SYMMETRIC_KEYSPACE].sweep_cost > plan.estimates[COMPRESSED_KEYSPACE].sweep_cost);
+
+  // Symmetry tables outweigh the smaller value tables of this root
+  options = default_planner_options();
+  options.ram_budget = 0;
+  plan = plan_keyspace(&root, &options);
+  assert(!plan.fits);
+  assert(plan.choice == COMPRESSED_KEYSPACE);
+}
+
+void test_external() {
+  state root = {0};
+  root.visual_area = rectangle(4, 5);
+  root.external = rectangle(2, 1) << (3 * V_SHIFT);
+  root.logical_area = rectangle(3, 2) | root.external;
+  root.opponent = rectangle(4, 3) ^ rectangle(3, 2);
+  root.target = root.opponent;
+  root.player = rectangle(4, 2) << (3 * V_SHIFT);
+  root.immortal = root.player ^ root.external;
+
+  planner_options options = default_planner_options();
+  options.ram_budget = 1ULL << 30;
+  keyspace_plan plan = plan_keyspace(&root, &options);
+  print_keyspace_plan(&plan);
+
+  assert(plan.estimates[COMPRESSED_KEYSPACE].supported);
+  assert(!plan.estimates[SYMMETRIC_KEYSPACE].supported);
+  assert(plan.fits);
+  assert(plan.choice == COMPRESSED_KEYSPACE);
+}
+
+int main() {
+  jkiss_init();
+  test_rectangle();
+  test_external();
+  return 0;
+}
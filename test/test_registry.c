@@ -0,0 +1,125 @@
+#include "tinytsumego2/dual_reader.h"
+#include "tinytsumego2/dual_solver.h"
+#include "tinytsumego2/registry.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_COLLECTIONS (3)
+
+state straight(int length) {
+  state s = {0};
+  s.visual_area = rectangle(length + 1, 2);
+  s.logical_area = rectangle(length, 1);
+  s.target = s.visual_area ^ s.logical_area;
+  s.opponent = s.target;
+  return s;
+}
+
+void test_registry() {
+  char path[] = "/tmp/test_registry_XXXXXX";
+  assert(mkdtemp(path));
+
+  value root_values[NUM_COLLECTIONS];
+  state roots[NUM_COLLECTIONS];
+  char filenames[NUM_COLLECTIONS][64];
+  for (int i = 0; i < NUM_COLLECTIONS; ++i) {
+    roots[i] = straight(i + 3);
+    dual_graph dg = create_dual_graph(roots + i, COMPRESSED_KEYSPACE);
+    while (iterate_dual_graph(&dg, false))
+      ;
+    root_values[i] = get_dual_graph_value(&dg, roots + i, FORCING);
+    size_t value_map_size = 0;
+    frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+    sprintf(filenames[i], "%s/straight-%d.bin", path, i);
+    FILE *f = fopen(filenames[i], "wb");
+    write_dual_graph(&dg, &fht, f);
+    fclose(f);
+    free(fht.bulk_map);
+    free(fht.tail_values);
+    free(fht.tail_offsets);
+    free_dual_graph(&dg);
+  }
+
+  reader_registry registry = create_reader_registry(2, 0);
+  assert(register_reader_folder(&registry, path) == NUM_COLLECTIONS);
+  assert(registry.num_loaded == 0);
+  assert(acquire_reader(&registry, "straight-9") == NULL);
+
+  dual_graph_reader *a = acquire_reader(&registry, "straight-0");
+  dual_graph_reader *b = acquire_reader(&registry, "straight-1");
+  assert(a && b && a != b);
+  release_reader(&registry, b);
+  release_reader(&registry, a);
+  assert(registry.num_loaded == 2);
+  assert(registry.misses == 2);
+  assert(registry.loaded_bytes > 0);
+
+  // straight-1 is the least recently used
+  dual_graph_reader *c = acquire_reader(&registry, "straight-2");
+  assert(registry.num_loaded == 2);
+  assert(registry.evictions == 1);
+  assert(acquire_reader(&registry, "straight-0") == a);
+  assert(registry.hits == 1);
+
+  // Readers in use are kept even beyond the limit
+  b = acquire_reader(&registry, "straight-1");
+  assert(registry.num_loaded == 3);
+  release_reader(&registry, a);
+  assert(registry.num_loaded == 2);
+  release_reader(&registry, b);
+  release_reader(&registry, c);
+
+  // Truncated and missing files fail the acquisition without touching the loaded readers
+  char truncated[64];
+  sprintf(truncated, "%s/truncated.dat", path);
+  FILE *src = fopen(filenames[0], "rb");
+  FILE *dst = fopen(truncated, "wb");
+  char chunk[256];
+  fwrite(chunk, 1, fread(chunk, 1, sizeof(chunk), src), dst);
+  fclose(dst);
+  fclose(src);
+  register_reader(&registry, "truncated", truncated);
+  register_reader(&registry, "missing", "/nonexistent/missing.bin");
+  const size_t num_loaded = registry.num_loaded;
+  assert(is_registered(&registry, "truncated"));
+  assert(!is_registered(&registry, "straight-9"));
+  assert(acquire_reader(&registry, "truncated") == NULL);
+  assert(acquire_reader(&registry, "missing") == NULL);
+  assert(registry.failures == 2);
+  assert(registry.num_loaded <= num_loaded);
+  free_reader_registry(&registry);
+  unlink(truncated);
+
+  // Concurrent queries with room for a single reader
+  registry = create_reader_registry(1, 0);
+  register_reader_folder(&registry, path);
+  size_t num_failures = 0;
+#pragma omp parallel for reduction(+ : num_failures)
+  for (int j = 0; j < 300; ++j) {
+    const int i = (j * 7) % NUM_COLLECTIONS;
+    char slug[32];
+    sprintf(slug, "straight-%d", i);
+    dual_graph_reader *dgr = acquire_reader(&registry, slug);
+    const dual_value v = get_dual_graph_reader_value(dgr, roots + i);
+    num_failures += v.forcing.low != root_values[i].low || v.forcing.high != root_values[i].high;
+    release_reader(&registry, dgr);
+  }
+  assert(num_failures == 0);
+  assert(registry.hits + registry.misses == 300);
+  assert(registry.num_loaded <= 1);
+  printf("%zu hits, %zu misses, %zu evictions\n", registry.hits, registry.misses, registry.evictions);
+  free_reader_registry(&registry);
+
+  for (int i = 0; i < NUM_COLLECTIONS; ++i) {
+    unlink(filenames[i]);
+  }
+  rmdir(path);
+}
+
+int main() {
+  test_registry();
+  return 0;
+}
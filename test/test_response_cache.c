@@ -0,0 +1,149 @@
+#include "tinytsumego2/response_cache.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_FILE_SIZE (1000000)
+
+// Symmetric about the vertical axis
+state straight_edge(int length) {
+  state s = {0};
+  s.visual_area = rectangle(length, 2);
+  s.logical_area = rectangle(length, 1);
+  s.target = s.visual_area ^ s.logical_area;
+  s.opponent = s.target;
+  return s;
+}
+
+bool same_move_infos(const move_info *a, int num_a, const move_info *b, int num_b) {
+  if (num_a != num_b) {
+    return false;
+  }
+  for (int i = 0; i < num_a; ++i) {
+    if (a[i].coords.x != b[i].coords.x || a[i].coords.y != b[i].coords.y || a[i].low_gain != b[i].low_gain ||
+        a[i].high_gain != b[i].high_gain || a[i].low_ideal != b[i].low_ideal || a[i].high_ideal != b[i].high_ideal ||
+        a[i].forcing != b[i].forcing) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void test_canonical_state() {
+  state s = straight_edge(5);
+  s.player = single(1, 0);
+  mirror_op_t op;
+  const state a = canonical_state(&s, &op);
+
+  state m = s;
+  mirror_h(&m);
+  snap(&m);
+  const state b = canonical_state(&m, &op);
+  assert(equals(&a, &b));
+
+  // Translation does not matter
+  state t = s;
+  t.visual_area <<= 1;
+  t.logical_area <<= 1;
+  t.target <<= 1;
+  t.opponent <<= 1;
+  t.player <<= 1;
+  const state c = canonical_state(&t, &op);
+  assert(equals(&a, &c));
+}
+
+void test_response_cache() {
+  const state root = straight_edge(5);
+  dual_graph dg = create_dual_graph(&root, COMPRESSED_KEYSPACE);
+  while (iterate_dual_graph(&dg, false))
+    ;
+
+  size_t value_map_size = 0;
+  frozen_hash_table fht = prepare_frozen_hash(&dg, &value_map_size);
+  char *buffer = malloc(MEM_FILE_SIZE);
+  FILE *stream = fmemopen(buffer, MEM_FILE_SIZE, "wb");
+  write_dual_graph(&dg, &fht, stream);
+  fclose(stream);
+  free(fht.bulk_map);
+  free_dual_graph(&dg);
+
+  dual_graph_reader dgr = {0};
+  dgr.fd = -1;
+  dgr.buffer = buffer;
+  unbuffer_dual_graph_reader(&dgr);
+
+  response_cache cache = create_response_cache(RESPONSE_CACHE_CAPACITY);
+  const size_t size = dgr.keyspace._.size;
+  size_t num_checked = 0;
+  for (size_t key = 0; key < size; ++key) {
+    const state s = from_compressed_key(&(dgr.keyspace.compressed), key);
+    if (!is_legal(&s)) {
+      continue;
+    }
+    state m = s;
+    mirror_h(&m);
+    snap(&m);
+
+    int num_expected, num_cached, num_mirrored;
+    move_info *expected = dual_graph_reader_move_infos(&dgr, &s, &num_expected);
+    move_info *cached = cached_move_infos(&cache, &dgr, NULL, &s, &num_cached);
+    assert(same_move_infos(expected, num_expected, cached, num_cached));
+    free(cached);
+    free(expected);
+
+    // The mirror image is served from the cache with mirrored coordinates
+    expected = dual_graph_reader_move_infos(&dgr, &m, &num_expected);
+    cached = cached_move_infos(&cache, &dgr, NULL, &m, &num_mirrored);
+    assert(same_move_infos(expected, num_expected, cached, num_mirrored));
+    free(cached);
+    free(expected);
+
+    state ended = s;
+    ended.passes = 0;
+    ended.ko = 0;
+    const stones_t dead = cached_dead_stones(&cache, &dgr, NULL, &ended);
+    assert(!(dead & ~(ended.player | ended.opponent)));
+    state mirrored_ended = ended;
+    mirror_h(&mirrored_ended);
+    snap(&mirrored_ended);
+    assert(cached_dead_stones(&cache, &dgr, NULL, &mirrored_ended) == stones_mirror_h(dead) >> (WIDTH - 5));
+    num_checked++;
+  }
+  print_response_cache_stats(&cache);
+  response_cache_stats stats = get_response_cache_stats(&cache);
+  assert(stats.hits >= num_checked);
+  assert(stats.hits + stats.misses == 4 * num_checked);
+  assert(stats.evictions == 0);
+  free_response_cache(&cache);
+
+  // Eviction in least recently used order
+  cache = create_response_cache(2);
+  state a = from_compressed_key(&(dgr.keyspace.compressed), 0);
+  state b = a;
+  b.white_to_play = !a.white_to_play;
+  state c = a;
+  c.button = 1;
+  int n;
+  free(cached_move_infos(&cache, &dgr, NULL, &a, &n));
+  free(cached_move_infos(&cache, &dgr, NULL, &b, &n));
+  free(cached_move_infos(&cache, &dgr, NULL, &a, &n));
+  free(cached_move_infos(&cache, &dgr, NULL, &c, &n));
+  free(cached_move_infos(&cache, &dgr, NULL, &a, &n));
+  stats = get_response_cache_stats(&cache);
+  assert(stats.size == 2);
+  assert(stats.hits == 2 && stats.misses == 3 && stats.evictions == 1);
+  free(cached_move_infos(&cache, &dgr, NULL, &b, &n));
+  stats = get_response_cache_stats(&cache);
+  assert(stats.misses == 4 && stats.evictions == 2);
+  free_response_cache(&cache);
+
+  unload_dual_graph_reader(&dgr);
+  free(buffer);
+}
+
+int main() {
+  test_canonical_state();
+  test_response_cache();
+  return 0;
+}
@@ -704,6 +704,40 @@ void test_compressed_keyspace() {
   free_compressed_keyspace(&cks);
 }
 
+void test_legality_64() {
+  void check(const state *root) {
+    tight_keyspace tks = create_tight_keyspace(root, true);
+    state states[64];
+    size_t num_legal = 0;
+    for (size_t first = 0; first < tks.size; first += 64) {
+      int count = 0;
+      for (; count < 64 && first + count < tks.size; ++count) {
+        states[count] = from_tight_key_fast(&tks, first + count);
+      }
+      unsigned long long mask = is_legal_64(states, count);
+      for (int i = 0; i < count; ++i) {
+        assert(is_legal(states + i) == !!(mask & (1ULL << i)));
+      }
+      num_legal += popcount(mask);
+    }
+    printf("%zu / %zu legal\n", num_legal, tks.size);
+    assert(num_legal);
+    free_tight_keyspace(&tks);
+  }
+
+  state root = rectangle_six();
+  check(&root);
+
+  root = (state){16547391ULL, 8408623ULL, 8138768ULL, 8405024ULL, 0ULL, 8138768ULL, 0ULL, 8405024ULL, 0, -1, -1, false, false};
+  check(&root);
+
+  root = (state){0};
+  root.wide = true;
+  root.visual_area = rectangle_16(5, 2);
+  root.logical_area = root.visual_area;
+  check(&root);
+}
+
 void test_illegal_ko() {
   state s = parse_state(" \
               @ 0 . . . . . B , \
@@ -738,6 +772,7 @@ int main() {
   test_wide_keyspace();
   test_legality();
   test_compressed_keyspace();
+  test_legality_64();
   test_illegal_ko();
 
   return EXIT_SUCCESS;
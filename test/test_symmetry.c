@@ -501,6 +501,80 @@ void test_5x2_wide() {
   assert(k < sym.size);
 }
 
+void test_diagonal_corner() {
+  state root = {0};
+  root.visual_area = rectangle(4, 4) ^ single(3, 3);
+  root.logical_area = root.visual_area;
+
+  mirror_op_t ops[8];
+  int num_ops = compute_automorphisms(&root, ops);
+  assert(num_ops == 2);
+  assert(ops[0] == MIRROR_NONE);
+  assert(ops[1] == MIRROR_D);
+
+  symmetry sym = compute_symmetry(&root);
+  printf("Core modulus = %zu\n", sym.core_m);
+  assert(sym.core_m == 24090);
+  printf("Keyspace size = %zu\n", sym.size);
+  assert(sym.size == 5853870);
+  assert(sym.pulp_count == 5);
+  assert(sym.variable_area == root.visual_area);
+
+  for (int i = 0; i < 10; ++i) {
+    state s = root;
+    s.player = jlrand() & s.visual_area;
+    s.opponent = jlrand() & s.visual_area & ~s.player;
+    if (!is_legal(&s)) {
+      i--;
+      continue;
+    }
+    size_t key = to_symmetric_bw_key(&sym, s.player, s.opponent);
+    size_t k = to_symmetric_bw_key(&sym, stones_mirror_d(s.player), stones_mirror_d(s.opponent));
+    assert(k == key);
+
+    state s0 = root;
+    from_symmetric_bw_key(&sym, key, &(s0.player), &(s0.opponent));
+    state s1 = s0;
+    mirror_d(&s1);
+    print_state(&s0);
+    assert(equals(&s, &s0) || equals(&s, &s1));
+    assert(to_symmetric_bw_key(&sym, s0.player, s0.opponent) == key);
+  }
+
+  free_symmetry(&sym);
+}
+
+void test_2x5() {
+  state root = {0};
+  root.visual_area = rectangle(2, 5);
+  root.logical_area = root.visual_area;
+
+  // Width of two goes through generic symmetry
+  symmetry sym = compute_symmetry(&root);
+  printf("Core modulus = %zu\n", sym.core_m);
+  assert(sym.core_m == 8973);
+  printf("Keyspace size = %zu\n", sym.size);
+  assert(sym.size == 8973);
+  assert(sym.variable_area == root.visual_area);
+
+  for (int i = 0; i < 10; ++i) {
+    state s = root;
+    s.player = jlrand() & s.visual_area;
+    s.opponent = jlrand() & s.visual_area & ~s.player;
+    if (!is_legal(&s)) {
+      i--;
+      continue;
+    }
+    size_t key = to_symmetric_bw_key(&sym, s.player, s.opponent);
+    assert(key < sym.size);
+    state s0 = root;
+    from_symmetric_bw_key(&sym, key, &(s0.player), &(s0.opponent));
+    assert(to_symmetric_bw_key(&sym, s0.player, s0.opponent) == key);
+  }
+
+  free_symmetry(&sym);
+}
+
 int main() {
   jkiss_init();
   test_3x4();
@@ -511,6 +585,8 @@ int main() {
   test_4x4();
 
   test_5x2_wide();
+  test_diagonal_corner();
+  test_2x5();
 
 #ifdef RUN_HEAVY_TESTS
   test_5x4_wide();
@@ -17,5 +17,17 @@ int main() {
   assert(ptr != NULL);
   free(ptr);
 
+  // Caller-owned generators are reproducible and independent of each other
+  rng_state a = seed_rng(7);
+  rng_state b = seed_rng(7);
+  rng_state c = seed_rng(8);
+  int num_equal = 0;
+  for (int i = 0; i < 100; ++i) {
+    const unsigned int x = rng_next(&a);
+    assert(x == rng_next(&b));
+    num_equal += x == rng_next(&c);
+  }
+  assert(num_equal < 2);
+
   return 0;
 }